@@ -40,9 +40,7 @@ public:
 
 		vector<string> formatPars = { extConfig.model,
 			formatUserMsg(sysMsg), formatUserMsg(userMsg), extConfig.apiKey };
-		requestStr = StrHelper::format<char>(requestStr, formatPars);
-
-		return requestStr;
+		return getOrSetTemplate(requestStr)->render(formatPars);
 	}
 
 	string parseMessageFromResponse(const string& response, bool& error) const override
@@ -73,8 +71,18 @@ private:
 	const string _defaultResponseMsgPattern = GPT_RESPONSE_MSG_PATTERN;
 	const string _defaultErrorMsgPattern = GPT_ERROR_MSG_PATTERN;
 	const string _defaultHttpHeaders = GPT_HTTP_HEADERS;
+	const StrReplaceSet<char> _msgEscapes = StrReplaceSet<char>({
+		pair<string, string>("\n", "\\n"),
+		pair<string, string>("\"", "\\\""),
+	});
+	const StrReplaceSet<char> _msgUnescapes = StrReplaceSet<char>({
+		pair<string, string>("\\\"", "\""),
+		pair<string, string>("\\n", "\n"),
+	});
 
 	mutable unordered_map<string, shared_ptr<Regex>> _regexCache{};
+	// the templates are parsed once per distinct template (ex: until the config changes)
+	mutable unordered_map<string, shared_ptr<StrTemplate<char>>> _templateCache{};
 	const function<shared_ptr<Regex>(const string& pattern)> _regexMap;
 	ConfigRetriever& _configRetriever;
 
@@ -84,22 +92,20 @@ private:
 
 	string getApiUrl(const ExtensionConfig& config) const {
 		vector<string> pars = { config.apiKey, config.model };
-		return StrHelper::format<char>(config.url, pars);
+		return getOrSetTemplate(config.url)->render(pars);
 	}
 
 	vector<string> createHttpHeaders(
 		const ExtensionConfig& config, string headersStr) const
 	{
 		vector<string> pars = { config.apiKey, config.model };
-		headersStr = StrHelper::format<char>(headersStr, pars);
+		headersStr = getOrSetTemplate(headersStr)->render(pars);
 
 		return StrHelper::split(headersStr, HEADERS_DELIM, true);
 	}
 
 	string formatUserMsg(const string& msg) const {
-		string formattedMsg = StrHelper::replace<char>(msg, "\n", "\\n");
-		formattedMsg = StrHelper::replace<char>(formattedMsg, "\"", "\\\"");
-		return formattedMsg;
+		return StrHelper::replace<char>(msg, _msgEscapes);
 	}
 
 	string parseMessageFromResponse(const string& response, const string& pattern) const {
@@ -107,9 +113,7 @@ private:
 		vector<string> captures = regex->findMatchCaptures(response);
 		if (captures.size() < 2) return "";
 
-		string msg = StrHelper::replace<char>(captures[1], "\\\"", "\"");
-		msg = StrHelper::replace<char>(msg, "\\n", "\n");
-		return msg;
+		return StrHelper::replace<char>(captures[1], _msgUnescapes);
 	}
 
 	shared_ptr<Regex> getOrSetRegex(const string& pattern) const {
@@ -118,4 +122,11 @@ private:
 		_regexCache[pattern] = regex;
 		return regex;
 	}
+
+	shared_ptr<StrTemplate<char>> getOrSetTemplate(const string& templateStr) const {
+		if (_templateCache.find(templateStr) != _templateCache.end()) return _templateCache.at(templateStr);
+		shared_ptr<StrTemplate<char>> strTemplate = make_shared<StrTemplate<char>>(templateStr);
+		_templateCache[templateStr] = strTemplate;
+		return strTemplate;
+	}
 };
@@ -1,8 +1,10 @@
 
 #pragma once
+#include <atomic>
 #include <condition_variable>
 #include <functional>
 #include <mutex>
+#include <shared_mutex>
 #include <unordered_map>
 #include <windows.h>
 using namespace std;
@@ -30,255 +32,244 @@ public:
 };
 
 
-class BasicLocker : public Locker {
+// Implements the 'Locker' interface with the 'lockAction'/'tryLockAction' templates of 'DerivedT',
+// which are also exposed as the 'lock'/'tryLock' templates below. These take the action as it is
+// (no 'function' wrapping it, so no allocation, and it can be inlined), and return what it returns.
+// ex: wstring value = locker.lock([this, &key]() { return _map[key]; });
+template<class DerivedT>
+class TemplatedLocker : public Locker {
 public:
+	template<class Fn>
+	auto lock(Fn&& action) -> decltype(action()) {
+		return derived().lockAction(forward<Fn>(action));
+	}
+
+	// returns false, without running 'action', if it can't lock right away
+	template<class Fn>
+	bool tryLock(Fn&& action) {
+		return derived().tryLockAction(forward<Fn>(action));
+	}
+
+	template<class Fn, class T>
+	bool tryLock(Fn&& action, T& output) {
+		return derived().tryLockAction([&action, &output]() { output = action(); });
+	}
+
 	bool tryLock(const function<void()>& action) override {
-		bool dummy;
-		return tryLock<bool>([&action]() {
-			action();
-			return true;
-			}, dummy);
+		return derived().tryLockAction(action);
 	}
 
 	bool tryLockS(const function<string()>& action, string& output) override {
-		return tryLock<string>(action, output);
+		return tryLock(action, output);
 	}
 
-	bool tryLockWS(const function<wstring()>& action, wstring& output) {
-		return tryLock<wstring>(action, output);
+	bool tryLockWS(const function<wstring()>& action, wstring& output) override {
+		return tryLock(action, output);
 	}
 
 	bool tryLockB(const function<bool()>& action, bool& output) override {
-		return tryLock<bool>(action, output);
+		return tryLock(action, output);
 	}
 
 	bool tryLockI(const function<int()>& action, int& output) override {
-		return tryLock<int>(action, output);
+		return tryLock(action, output);
 	}
 
 	bool tryLockD(const function<double()>& action, double& output) override {
-		return tryLock<double>(action, output);
+		return tryLock(action, output);
 	}
 
 	bool tryLockDW(const function<DWORD()>& action, DWORD& output) override {
-		return tryLock<DWORD>(action, output);
+		return tryLock(action, output);
 	}
 
 	void lock(const function<void()>& action) override {
-		lock<bool>([&action]() {
-			action();
-			return true;
-			});
+		derived().lockAction(action);
 	}
 
 	string lockS(const function<string()>& action) override {
-		return lock<string>(action);
+		return derived().lockAction(action);
 	}
 
 	wstring lockWS(const function<wstring()>& action) override {
-		return lock<wstring>(action);
+		return derived().lockAction(action);
 	}
 
 	bool lockB(const function<bool()>& action) override {
-		return lock<bool>(action);
+		return derived().lockAction(action);
 	}
 
 	int lockI(const function<int()>& action) override {
-		return lock<int>(action);
+		return derived().lockAction(action);
 	}
 
 	double lockD(const function<double()>& action) override {
-		return lock<double>(action);
+		return derived().lockAction(action);
 	}
 
 	DWORD lockDW(const function<DWORD()>& action) override {
-		return lock<DWORD>(action);
+		return derived().lockAction(action);
+	}
+private:
+	DerivedT& derived() {
+		return static_cast<DerivedT&>(*this);
 	}
+};
 
+
+// Runs one action at a time.
+class BasicLocker : public TemplatedLocker<BasicLocker> {
+public:
+	// waits for the running action (if any) to be done
 	void waitForUnlock() override {
-		unique_lock<mutex> lock(_mtx);
-		_cv.wait(lock, [this]() { return !_busy; });
+		lock_guard<mutex> lock(_mtx);
 	}
 private:
+	friend class TemplatedLocker<BasicLocker>;
 	mutex _mtx;
-	condition_variable _cv;
-	bool _busy = false;
-
-	template<typename T>
-	bool tryLock(const function<T()>& action, T& output) {
-		if (!_mtx.try_lock()) return false;
-
-		{
-			lock_guard<mutex> lock(_mtx, adopt_lock);
-			output = performAction(action);
-		}
-
-		_cv.notify_all();
-		return true;
-	}
-
-	template<typename T>
-	T lock(const function<T()>& action) {
-		T output;
-		{
-			lock_guard<mutex> lock(_mtx);
-			output = performAction(action);
-		}
 
-		_cv.notify_all();
-		return output;
+	template<class Fn>
+	auto lockAction(Fn&& action) -> decltype(action()) {
+		lock_guard<mutex> lock(_mtx);
+		return action();
 	}
 
-	template<typename T>
-	T performAction(const function<T()>& action) {
-		_busy = true;
+	template<class Fn>
+	bool tryLockAction(Fn&& action) {
+		if (!_mtx.try_lock()) return false;
 
-		try {
-			T output = action();
-			_busy = false;
-			return output;
-		}
-		catch (exception&) {
-			_busy = false;
-			_cv.notify_all();
-			throw;
-		}
+		lock_guard<mutex> lock(_mtx, adopt_lock);
+		action();
+		return true;
 	}
 };
 
 
-class SemaphoreLocker : public Locker {
+// Runs up to 'maxCount' actions at a time.
+class SemaphoreLocker : public TemplatedLocker<SemaphoreLocker> {
 public:
 	SemaphoreLocker(int maxCount = MAXINT) : _maxCount(maxCount) { }
 
-	bool tryLock(const function<void()>& action) override {
-		bool dummy;
-		return tryLock<bool>([&action]() {
-			action();
-			return true;
-			}, dummy);
-	}
-
-	bool tryLockS(const function<string()>& action, string& output) override {
-		return tryLock<string>(action, output);
-	}
-
-	bool tryLockWS(const function<wstring()>& action, wstring& output) override {
-		return tryLock<wstring>(action, output);
-	}
-
-	bool tryLockB(const function<bool()>& action, bool& output) override {
-		return tryLock<bool>(action, output);
-	}
-
-	bool tryLockI(const function<int()>& action, int& output) override {
-		return tryLock<int>(action, output);
-	}
-
-	bool tryLockD(const function<double()>& action, double& output) override {
-		return tryLock<double>(action, output);
-	}
-
-	bool tryLockDW(const function<DWORD()>& action, DWORD& output) override {
-		return tryLock<DWORD>(action, output);
-	}
-
-	void lock(const function<void()>& action) override {
-		lock<bool>([&action]() {
-			action();
-			return true;
-			});
-	}
-
-	string lockS(const function<string()>& action) override {
-		return lock<string>(action);
-	}
-
-	wstring lockWS(const function<wstring()>& action) override {
-		return lock<wstring>(action);
-	}
-
-	bool lockB(const function<bool()>& action) override {
-		return lock<bool>(action);
-	}
-
-	int lockI(const function<int()>& action) override {
-		return lock<int>(action);
-	}
-
-	double lockD(const function<double()>& action) override {
-		return lock<double>(action);
-	}
-
-	DWORD lockDW(const function<DWORD()>& action) override {
-		return lock<DWORD>(action);
-	}
-
 	void waitForUnlock() override {
 		unique_lock<mutex> lock(_mtx);
-		waitForUnlock(lock);
+		waitFor(lock, [this]() { return _takenCount < _maxCount; });
 	}
 
 	void waitForAllUnlocked() {
 		unique_lock<mutex> lock(_mtx);
-		waitForAllUnlocked(lock);
+		waitFor(lock, [this]() { return _takenCount == 0; });
 	}
 private:
+	friend class TemplatedLocker<SemaphoreLocker>;
+
+	// gives back the count taken by an action once it is done (or has thrown)
+	class TakenScope {
+	public:
+		TakenScope(SemaphoreLocker& locker) : _locker(locker) { }
+		~TakenScope() { _locker.release(); }
+	private:
+		SemaphoreLocker& _locker;
+	};
+
 	mutex _mtx;
 	condition_variable _cv;
-	int _maxCount;
-	atomic<int> _takenCount = 0;
-
-	template<typename T>
-	bool tryLock(const function<T()>& action, T& output) {
+	const int _maxCount;
+	// only taken and waited for under '_mtx', but given back without it (see 'release')
+	atomic<int> _takenCount{ 0 };
+	// threads waiting on '_cv'; an action being done only notifies them if there are any
+	atomic<int> _waiterCount{ 0 };
+
+	template<class Fn>
+	auto lockAction(Fn&& action) -> decltype(action()) {
 		{
 			unique_lock<mutex> lock(_mtx);
-			if (allTaken()) return false;
+			waitFor(lock, [this]() { return _takenCount < _maxCount; });
+			_takenCount++;
+		}
 
-			waitForUnlock(lock);
+		TakenScope takenScope(*this);
+		return action();
+	}
+
+	template<class Fn>
+	bool tryLockAction(Fn&& action) {
+		{
+			lock_guard<mutex> lock(_mtx);
+			if (_takenCount >= _maxCount) return false;
 			_takenCount++;
 		}
 
-		output = performAction(action);
+		TakenScope takenScope(*this);
+		action();
 		return true;
 	}
 
-	bool allTaken() {
-		return _takenCount == _maxCount;
+	template<class PredT>
+	void waitFor(unique_lock<mutex>& lock, PredT predicate) {
+		if (predicate()) return;
+
+		_waiterCount++;
+		_cv.wait(lock, predicate);
+		_waiterCount--;
 	}
 
-	template<typename T>
-	T lock(const function<T()>& action) {
+	// a waiter counts itself before checking the count under '_mtx', so either it sees the count given back,
+	// or it is seen here and notified (after '_mtx' is taken, so that it is waiting by then)
+	void release() {
+		_takenCount--;
+		if (_waiterCount == 0) return;
+
 		{
-			unique_lock<mutex> lock(_mtx);
-			waitForUnlock(lock);
-			_takenCount++;
+			lock_guard<mutex> lock(_mtx);
 		}
 
-		return performAction(action);
+		_cv.notify_all();
 	}
+};
 
-	template<typename T>
-	T performAction(const function<T()>& action) {
-		try {
-			T output = action();
-			_takenCount--;
-			_cv.notify_all();
-			return output;
-		}
-		catch (exception&) {
-			_takenCount--;
-			_cv.notify_all();
-			throw;
-		}
+
+// Runs either one exclusive action ('lock'/'tryLock', and the 'Locker' interface) at a time,
+// or any number of shared ones ('lockShared'/'tryLockShared') at once. For data which is read far more
+// often than it is written: reads lock shared, writes lock exclusive.
+class SharedLocker : public TemplatedLocker<SharedLocker> {
+public:
+	template<class Fn>
+	auto lockShared(Fn&& action) -> decltype(action()) {
+		shared_lock<shared_timed_mutex> lock(_mtx);
+		return action();
 	}
 
-	void waitForUnlock(unique_lock<mutex>& lock) {
-		_cv.wait(lock, [this]() { return _takenCount < _maxCount; });
+	template<class Fn>
+	bool tryLockShared(Fn&& action) {
+		shared_lock<shared_timed_mutex> lock(_mtx, try_to_lock);
+		if (!lock.owns_lock()) return false;
+
+		action();
+		return true;
 	}
 
-	void waitForAllUnlocked(unique_lock<mutex>& lock) {
-		_cv.wait(lock, [this]() { return _takenCount == 0; });
+	// waits for the running exclusive action (if any) to be done
+	void waitForUnlock() override {
+		shared_lock<shared_timed_mutex> lock(_mtx);
+	}
+private:
+	friend class TemplatedLocker<SharedLocker>;
+	// 'shared_mutex' is C++17
+	shared_timed_mutex _mtx;
+
+	template<class Fn>
+	auto lockAction(Fn&& action) -> decltype(action()) {
+		lock_guard<shared_timed_mutex> lock(_mtx);
+		return action();
+	}
+
+	template<class Fn>
+	bool tryLockAction(Fn&& action) {
+		unique_lock<shared_timed_mutex> lock(_mtx, try_to_lock);
+		if (!lock.owns_lock()) return false;
+
+		action();
+		return true;
 	}
 };
 
@@ -302,16 +293,12 @@ public:
 	}
 
 	Locker& getOrCreateLocker(const T& key) override {
-		Locker* locker = nullptr;
-
-		_mainLocker.lock([this, &key, &locker]() {
-			if (_lockerMap.find(key) == _lockerMap.end())
-				_lockerMap[key] = unique_ptr<Locker>(_lockerCreator());
+		return *_mainLocker.lock([this, &key]() {
+			unique_ptr<Locker>& locker = _lockerMap[key];
+			if (!locker) locker = unique_ptr<Locker>(_lockerCreator());
 
-			locker = _lockerMap[key].get();
+			return locker.get();
 			});
-
-		return *locker;
 	}
 private:
 	BasicLocker _mainLocker;
@@ -1,14 +1,689 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
 #include <string>
+#include <utility>
 #include <vector>
 #include <windows.h>
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#include <emmintrin.h>
+#define STRHELPER_SSE2_AVAILABLE
+#endif
 using namespace std;
 
 template<class charT>
 using string_base = basic_string<charT, char_traits<charT>, allocator<charT>>;
 
 
+// A non-owning view of a run of characters (like C++17's 'basic_string_view', which isn't available here),
+// to look at the parts of a string without copying them. The viewed string must outlive the view.
+template<class charT>
+class StrView {
+public:
+	static constexpr size_t npos = static_cast<size_t>(-1);
+
+	StrView() : _data(nullptr), _length(0) { }
+	StrView(const charT* data, size_t length) : _data(data), _length(length) { }
+	StrView(const charT* cStr) : _data(cStr), _length(char_traits<charT>::length(cStr)) { }
+	StrView(const string_base<charT>& str) : _data(str.data()), _length(str.length()) { }
+
+	const charT* data() const { return _data; }
+	size_t length() const { return _length; }
+	size_t size() const { return _length; }
+	bool empty() const { return _length == 0; }
+	const charT* begin() const { return _data; }
+	const charT* end() const { return _data + _length; }
+	charT operator[](size_t index) const { return _data[index]; }
+	charT front() const { return _data[0]; }
+	charT back() const { return _data[_length - 1]; }
+
+	string_base<charT> str() const {
+		return string_base<charT>(_data, _length);
+	}
+
+	StrView substr(size_t pos, size_t count = npos) const {
+		if (pos > _length) pos = _length;
+		return StrView(_data + pos, min<size_t>(count, _length - pos));
+	}
+
+	bool startsWith(StrView other) const {
+		return other._length <= _length && char_traits<charT>::compare(_data, other._data, other._length) == 0;
+	}
+
+	bool endsWith(StrView other) const {
+		return other._length <= _length
+			&& char_traits<charT>::compare(_data + _length - other._length, other._data, other._length) == 0;
+	}
+
+	size_t find(charT ch, size_t pos = 0) const {
+		if (pos >= _length) return npos;
+		const charT* found = char_traits<charT>::find(_data + pos, _length - pos, ch);
+		return found != nullptr ? static_cast<size_t>(found - _data) : npos;
+	}
+
+	size_t find(StrView other, size_t pos = 0) const {
+		if (other._length == 0) return pos <= _length ? pos : npos;
+
+		for (size_t i = find(other._data[0], pos); i != npos; i = find(other._data[0], i + 1)) {
+			if (other._length > _length - i) return npos;
+			if (char_traits<charT>::compare(_data + i, other._data, other._length) == 0) return i;
+		}
+
+		return npos;
+	}
+
+	friend bool operator==(StrView view1, StrView view2) {
+		return view1._length == view2._length
+			&& char_traits<charT>::compare(view1._data, view2._data, view1._length) == 0;
+	}
+
+	friend bool operator!=(StrView view1, StrView view2) {
+		return !(view1 == view2);
+	}
+private:
+	const charT* _data;
+	size_t _length;
+};
+
+template<class charT>
+constexpr size_t StrView<charT>::npos;
+
+
+// The parts of a string between its delimiters, found one at a time while iterating (see 'StrHelper::splitView'),
+// so that nothing is allocated. Gives the same parts as 'StrHelper::split' (including empty ones).
+template<class charT>
+class StrSplitView {
+public:
+	class iterator {
+	public:
+		iterator(StrView<charT> str, StrView<charT> delim, charT delimCh, bool chDelim, bool trimWs, bool done)
+			: _str(str), _delim(delim), _delimCh(delimCh), _chDelim(chDelim), _trimWs(trimWs), _done(done)
+		{
+			if (!_done) findPartEnd();
+		}
+
+		StrView<charT> operator*() const {
+			StrView<charT> part = _str.substr(_start, _end - _start);
+			return _trimWs ? trimSpaces(part) : part;
+		}
+
+		iterator& operator++() {
+			if (_end >= _str.length()) _done = true;
+			else {
+				_start = _end + getDelimLength();
+				findPartEnd();
+			}
+
+			return *this;
+		}
+
+		bool operator==(const iterator& other) const {
+			return _done == other._done && (_done || _start == other._start);
+		}
+
+		bool operator!=(const iterator& other) const {
+			return !(*this == other);
+		}
+	private:
+		StrView<charT> _str;
+		StrView<charT> _delim;
+		// used instead of '_delim' if 'chDelim'
+		charT _delimCh;
+		bool _chDelim;
+		bool _trimWs;
+		bool _done;
+		size_t _start = 0;
+		size_t _end = 0;
+
+		size_t getDelimLength() const {
+			return _chDelim ? 1 : _delim.length();
+		}
+
+		void findPartEnd() {
+			// an empty delimiter doesn't split the string
+			if (_chDelim) _end = _str.find(_delimCh, _start);
+			else _end = _delim.empty() ? StrView<charT>::npos : _str.find(_delim, _start);
+
+			if (_end == StrView<charT>::npos) _end = _str.length();
+		}
+
+		static StrView<charT> trimSpaces(StrView<charT> part) {
+			static const charT SPACE = (charT)32; // " "
+			size_t start = 0, end = part.length();
+
+			while (start < end && part[start] == SPACE) start++;
+			while (end > start && part[end - 1] == SPACE) end--;
+			return part.substr(start, end - start);
+		}
+	};
+
+	StrSplitView(StrView<charT> str, StrView<charT> delim, bool trimWs)
+		: _str(str), _delim(delim), _delimCh(charT()), _chDelim(false), _trimWs(trimWs) { }
+
+	StrSplitView(StrView<charT> str, charT delim, bool trimWs)
+		: _str(str), _delim(), _delimCh(delim), _chDelim(true), _trimWs(trimWs) { }
+
+	iterator begin() const {
+		return iterator(_str, _delim, _delimCh, _chDelim, _trimWs, false);
+	}
+
+	iterator end() const {
+		return iterator(_str, _delim, _delimCh, _chDelim, _trimWs, true);
+	}
+
+	// the last part (ex: the text after the last delimiter)
+	StrView<charT> back() const {
+		StrView<charT> last;
+		for (StrView<charT> part : *this) last = part;
+		return last;
+	}
+private:
+	StrView<charT> _str;
+	StrView<charT> _delim;
+	charT _delimCh;
+	bool _chDelim;
+	bool _trimWs;
+};
+
+
+// Converts between UTF-8 and wide strings (UTF-16, or UTF-32 where 'wchar_t' is 4 bytes).
+// Runs of ASCII are converted 16 bytes at a time with SSE2 where it's available; everything else is decoded/encoded
+// by a scalar loop (with the 3-byte sequences of CJK text checked first).
+// Invalid input (ex: a truncated sequence, an unpaired surrogate) is replaced with U+FFFD (one per maximal invalid
+// subsequence, as the Windows conversion functions do), or, if 'strict', fails the conversion.
+class Utf8Transcoder {
+public:
+	static bool isValidUtf8(const char* data, size_t length) {
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+		size_t i = 0;
+
+		while (i < length) {
+			if (bytes[i] < 0x80) {
+				i += skipAscii(bytes + i, length - i);
+				if (i >= length) break;
+			}
+
+			uint32_t codePoint;
+			i += decode(bytes + i, length - i, codePoint);
+			if (codePoint == INVALID) return false;
+		}
+
+		return true;
+	}
+
+	static bool toWide(const char* data, size_t length, wstring& output, bool strict = false) {
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+		// each byte is at most 1 unit (a 4 byte sequence is 2 UTF-16 units)
+		output.resize(length);
+		wchar_t* out = length > 0 ? &output[0] : nullptr;
+		size_t i = 0, o = 0;
+
+		while (i < length) {
+			// in CJK text, most characters are not followed by an ASCII run, so it's only looked for after one
+			if (bytes[i] < 0x80) {
+				size_t asciiLength = copyAscii(bytes + i, length - i, out + o);
+				i += asciiLength;
+				o += asciiLength;
+				if (i >= length) break;
+			}
+
+			uint32_t codePoint;
+			i += decode(bytes + i, length - i, codePoint);
+
+			if (codePoint == INVALID) {
+				if (strict) return failConversion(output);
+				codePoint = REPLACEMENT_CHAR;
+			}
+
+			o += encodeWide(codePoint, out + o);
+		}
+
+		output.resize(o);
+		return true;
+	}
+
+	static bool fromWide(const wchar_t* data, size_t length, string& output, bool strict = false) {
+		// each unit is at most 3 bytes in UTF-16 (a surrogate pair, 2 units, is 4 bytes), and 4 bytes in UTF-32
+		output.resize(length * (sizeof(wchar_t) == 2 ? 3 : 4));
+		char* out = length > 0 ? &output[0] : nullptr;
+		size_t i = 0, o = 0;
+
+		while (i < length) {
+			if (static_cast<uint32_t>(data[i]) < 0x80) {
+				size_t asciiLength = copyAscii(data + i, length - i, out + o);
+				i += asciiLength;
+				o += asciiLength;
+				if (i >= length) break;
+			}
+
+			uint32_t codePoint;
+			i += decodeWide(data + i, length - i, codePoint);
+
+			if (codePoint == INVALID) {
+				if (strict) return failConversion(output);
+				codePoint = REPLACEMENT_CHAR;
+			}
+
+			o += encode(codePoint, reinterpret_cast<unsigned char*>(out + o));
+		}
+
+		output.resize(o);
+		return true;
+	}
+private:
+	static constexpr uint32_t INVALID = 0xFFFFFFFF;
+	static constexpr uint32_t REPLACEMENT_CHAR = 0xFFFD;
+
+	template<class strT>
+	static bool failConversion(strT& output) {
+		output.clear();
+		return false;
+	}
+
+	static bool isContinuation(unsigned char byte) {
+		return (byte & 0xC0) == 0x80;
+	}
+
+	// decodes the sequence at 'bytes' into 'codePoint' ('INVALID' if it isn't valid), and returns its length
+	// (for an invalid sequence, the length of its valid start, or 1)
+	static size_t decode(const unsigned char* bytes, size_t length, uint32_t& codePoint) {
+		unsigned char lead = bytes[0];
+		codePoint = INVALID;
+
+		if (lead < 0x80) {
+			codePoint = lead;
+			return 1;
+		}
+
+		if (lead >= 0xE0 && lead < 0xF0) {
+			// the second byte's range excludes overlong forms (0xE0) and surrogates (0xED)
+			unsigned char min1 = lead == 0xE0 ? 0xA0 : 0x80, max1 = lead == 0xED ? 0x9F : 0xBF;
+			if (length < 2 || bytes[1] < min1 || bytes[1] > max1) return 1;
+			if (length < 3 || !isContinuation(bytes[2])) return 2;
+
+			codePoint = ((lead & 0x0F) << 12) | ((bytes[1] & 0x3F) << 6) | (bytes[2] & 0x3F);
+			return 3;
+		}
+
+		if (lead >= 0xC2 && lead < 0xE0) {
+			if (length < 2 || !isContinuation(bytes[1])) return 1;
+
+			codePoint = ((lead & 0x1F) << 6) | (bytes[1] & 0x3F);
+			return 2;
+		}
+
+		if (lead >= 0xF0 && lead < 0xF5) {
+			// the second byte's range excludes overlong forms (0xF0) and code points past U+10FFFF (0xF4)
+			unsigned char min1 = lead == 0xF0 ? 0x90 : 0x80, max1 = lead == 0xF4 ? 0x8F : 0xBF;
+			if (length < 2 || bytes[1] < min1 || bytes[1] > max1) return 1;
+			if (length < 3 || !isContinuation(bytes[2])) return 2;
+			if (length < 4 || !isContinuation(bytes[3])) return 3;
+
+			codePoint = ((lead & 0x07) << 18) | ((bytes[1] & 0x3F) << 12) | ((bytes[2] & 0x3F) << 6) | (bytes[3] & 0x3F);
+			return 4;
+		}
+
+		return 1;
+	}
+
+	static size_t encode(uint32_t codePoint, unsigned char* out) {
+		if (codePoint < 0x80) {
+			out[0] = static_cast<unsigned char>(codePoint);
+			return 1;
+		}
+		if (codePoint < 0x800) {
+			out[0] = static_cast<unsigned char>(0xC0 | (codePoint >> 6));
+			out[1] = static_cast<unsigned char>(0x80 | (codePoint & 0x3F));
+			return 2;
+		}
+		if (codePoint < 0x10000) {
+			out[0] = static_cast<unsigned char>(0xE0 | (codePoint >> 12));
+			out[1] = static_cast<unsigned char>(0x80 | ((codePoint >> 6) & 0x3F));
+			out[2] = static_cast<unsigned char>(0x80 | (codePoint & 0x3F));
+			return 3;
+		}
+
+		out[0] = static_cast<unsigned char>(0xF0 | (codePoint >> 18));
+		out[1] = static_cast<unsigned char>(0x80 | ((codePoint >> 12) & 0x3F));
+		out[2] = static_cast<unsigned char>(0x80 | ((codePoint >> 6) & 0x3F));
+		out[3] = static_cast<unsigned char>(0x80 | (codePoint & 0x3F));
+		return 4;
+	}
+
+	static size_t decodeWide(const wchar_t* units, size_t length, uint32_t& codePoint) {
+		uint32_t unit = static_cast<uint32_t>(units[0]);
+		codePoint = INVALID;
+
+		if (sizeof(wchar_t) > 2) {
+			if (unit <= 0x10FFFF && (unit < 0xD800 || unit > 0xDFFF)) codePoint = unit;
+			return 1;
+		}
+
+		if (unit < 0xD800 || unit > 0xDFFF) {
+			codePoint = unit;
+			return 1;
+		}
+
+		// a high surrogate has to be followed by a low one
+		if (unit > 0xDBFF || length < 2) return 1;
+		uint32_t lowUnit = static_cast<uint32_t>(units[1]);
+		if (lowUnit < 0xDC00 || lowUnit > 0xDFFF) return 1;
+
+		codePoint = 0x10000 + ((unit - 0xD800) << 10) + (lowUnit - 0xDC00);
+		return 2;
+	}
+
+	static size_t encodeWide(uint32_t codePoint, wchar_t* out) {
+		if (sizeof(wchar_t) > 2 || codePoint < 0x10000) {
+			out[0] = static_cast<wchar_t>(codePoint);
+			return 1;
+		}
+
+		out[0] = static_cast<wchar_t>(0xD800 + ((codePoint - 0x10000) >> 10));
+		out[1] = static_cast<wchar_t>(0xDC00 + ((codePoint - 0x10000) & 0x3FF));
+		return 2;
+	}
+
+	// the number of ASCII bytes at the start of 'bytes'
+	static size_t skipAscii(const unsigned char* bytes, size_t length) {
+		size_t i = 0;
+
+#ifdef STRHELPER_SSE2_AVAILABLE
+		for (; i + 16 <= length; i += 16) {
+			__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i));
+			if (_mm_movemask_epi8(chunk) != 0) break;
+		}
+#endif
+
+		while (i < length && bytes[i] < 0x80) i++;
+		return i;
+	}
+
+	// copies the ASCII bytes at the start of 'bytes' to 'out' (as wide characters), and returns their number
+	static size_t copyAscii(const unsigned char* bytes, size_t length, wchar_t* out) {
+		size_t i = 0;
+
+#ifdef STRHELPER_SSE2_AVAILABLE
+		const __m128i zero = _mm_setzero_si128();
+
+		for (; i + 16 <= length; i += 16) {
+			__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i));
+			if (_mm_movemask_epi8(chunk) != 0) break;
+
+			// widens each byte to 16 bits (and then 32 bits, for UTF-32)
+			__m128i low = _mm_unpacklo_epi8(chunk, zero), high = _mm_unpackhi_epi8(chunk, zero);
+
+			if (sizeof(wchar_t) == 2) {
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), low);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 8), high);
+			}
+			else {
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_unpacklo_epi16(low, zero));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 4), _mm_unpackhi_epi16(low, zero));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 8), _mm_unpacklo_epi16(high, zero));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 12), _mm_unpackhi_epi16(high, zero));
+			}
+		}
+#endif
+
+		for (; i < length && bytes[i] < 0x80; i++) out[i] = static_cast<wchar_t>(bytes[i]);
+		return i;
+	}
+
+	// copies the ASCII characters at the start of 'units' to 'out' (as bytes), and returns their number
+	static size_t copyAscii(const wchar_t* units, size_t length, char* out) {
+		size_t i = 0;
+
+#ifdef STRHELPER_SSE2_AVAILABLE
+		const __m128i zero = _mm_setzero_si128();
+
+		if (sizeof(wchar_t) == 2) {
+			const __m128i nonAsciiMask = _mm_set1_epi16(static_cast<short>(0xFF80));
+
+			for (; i + 8 <= length; i += 8) {
+				__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(units + i));
+				__m128i isAscii = _mm_cmpeq_epi16(_mm_and_si128(chunk, nonAsciiMask), zero);
+				if (_mm_movemask_epi8(isAscii) != 0xFFFF) break;
+
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(chunk, chunk));
+			}
+		}
+		else {
+			const __m128i nonAsciiMask = _mm_set1_epi32(static_cast<int>(0xFFFFFF80));
+
+			for (; i + 8 <= length; i += 8) {
+				__m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(units + i));
+				__m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(units + i + 4));
+				__m128i isAscii = _mm_cmpeq_epi32(_mm_and_si128(_mm_or_si128(low, high), nonAsciiMask), zero);
+				if (_mm_movemask_epi8(isAscii) != 0xFFFF) break;
+
+				__m128i packed = _mm_packs_epi32(low, high);
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(packed, packed));
+			}
+		}
+#endif
+
+		for (; i < length && static_cast<uint32_t>(units[i]) < 0x80; i++) out[i] = static_cast<char>(units[i]);
+		return i;
+	}
+};
+
+
+// A set of (target -> replacement) pairs, prepared once so that 'StrHelper::replace' can apply all of them
+// in a single left-to-right pass (ex: for sets reused on every sentence).
+// Where several targets match at the same position, the longest one is replaced.
+template<class charT>
+class StrReplaceSet {
+public:
+	StrReplaceSet(const vector<pair<string_base<charT>, string_base<charT>>>& replacements) {
+		for (const auto& replacement : replacements) {
+			if (!replacement.first.empty()) _replacements.push_back(replacement);
+		}
+
+		stable_sort(_replacements.begin(), _replacements.end(),
+			[](const pair<string_base<charT>, string_base<charT>>& r1, const pair<string_base<charT>, string_base<charT>>& r2) {
+				return r1.first.length() > r2.first.length();
+			});
+
+		for (const auto& replacement : _replacements) {
+			_firstChars[getBucket(replacement.first[0])] = true;
+		}
+	}
+
+	string_base<charT> apply(const string_base<charT>& str) const {
+		if (str.empty() || _replacements.empty()) return str;
+
+		// matches are found first, so that the output can be allocated once at its final length
+		vector<pair<size_t, size_t>> matches{};
+		size_t outputLength = str.length();
+
+		const charT* data = str.data();
+		size_t length = str.length();
+
+		for (size_t i = 0; i < length;) {
+			// most characters can't start a target, and are skipped without leaving this loop
+			while (i < length && !_firstChars[getBucket(data[i])]) i++;
+			if (i == length) break;
+
+			size_t replacementIndex = match(str, i);
+			if (replacementIndex == NO_MATCH) {
+				i++;
+				continue;
+			}
+
+			const auto& replacement = _replacements[replacementIndex];
+			matches.push_back(pair<size_t, size_t>(i, replacementIndex));
+			outputLength = outputLength - replacement.first.length() + replacement.second.length();
+			i += replacement.first.length();
+		}
+
+		if (matches.empty()) return str;
+
+		string_base<charT> output;
+		output.reserve(outputLength);
+		size_t copiedIndex = 0;
+
+		for (const auto& matched : matches) {
+			const auto& replacement = _replacements[matched.second];
+			output.append(str, copiedIndex, matched.first - copiedIndex);
+			output.append(replacement.second);
+			copiedIndex = matched.first + replacement.first.length();
+		}
+
+		output.append(str, copiedIndex, string_base<charT>::npos);
+		return output;
+	}
+private:
+	static constexpr size_t NO_MATCH = static_cast<size_t>(-1);
+	vector<pair<string_base<charT>, string_base<charT>>> _replacements{};
+	// whether any target starts with a character of each bucket, to skip most characters with a single lookup
+	bool _firstChars[256] = { };
+
+	static size_t getBucket(charT ch) {
+		return static_cast<size_t>(ch) & 0xFF;
+	}
+
+	size_t match(const string_base<charT>& str, size_t index) const {
+		size_t remaining = str.length() - index;
+
+		for (size_t i = 0; i < _replacements.size(); i++) {
+			const string_base<charT>& target = _replacements[i].first;
+			if (target.length() <= remaining && target[0] == str[index]
+				&& char_traits<charT>::compare(str.data() + index, target.data(), target.length()) == 0) return i;
+		}
+
+		return NO_MATCH;
+	}
+};
+
+
+// A template with placeholders (ex: "{0}"), parsed once into its literal and placeholder segments, so that it can be
+// rendered repeatedly (ex: once per sentence) in a single pass, into an output allocated once at its final length.
+// A placeholder is an index, or one of 'names' (which is an alias of the index it's at in 'names').
+// Wrapped text which is neither (ex: the braces of a JSON template) is kept as is.
+template<class charT>
+class StrTemplate {
+public:
+	StrTemplate(const string_base<charT>& templateStr, const vector<string_base<charT>>& names,
+		const pair<string_base<charT>, string_base<charT>>& phWrapper) : _templateStr(templateStr)
+	{
+		parse(names, phWrapper);
+	}
+
+	StrTemplate(const string_base<charT>& templateStr, const vector<string_base<charT>>& names = {})
+		: StrTemplate(templateStr, names, pair<string_base<charT>, string_base<charT>>(
+			string_base<charT>(1, (charT)123), string_base<charT>(1, (charT)125))) { } // "{", "}"
+
+	const string_base<charT>& getTemplate() const {
+		return _templateStr;
+	}
+
+	bool hasPlaceholder(size_t index) const {
+		for (const Segment& segment : _segments) {
+			if (segment.index == index) return true;
+		}
+
+		return false;
+	}
+
+	// 'values[i]' fills the placeholders of index 'i + startIndex'; placeholders without a value are kept as is
+	string_base<charT> render(const vector<string_base<charT>>& values, size_t startIndex = 0) const {
+		size_t outputLength = 0;
+
+		for (const Segment& segment : _segments) {
+			const string_base<charT>* value = getValue(segment, values, startIndex);
+			outputLength += value != nullptr ? value->length() : segment.length;
+		}
+
+		string_base<charT> output;
+		output.reserve(outputLength);
+
+		for (const Segment& segment : _segments) {
+			const string_base<charT>* value = getValue(segment, values, startIndex);
+			if (value != nullptr) output.append(*value);
+			else output.append(_templateStr, segment.start, segment.length);
+		}
+
+		return output;
+	}
+private:
+	static constexpr size_t LITERAL = static_cast<size_t>(-1);
+	static constexpr size_t MAX_INDEX_DIGITS = 9;
+
+	struct Segment {
+		// the segment's text in the template
+		size_t start;
+		size_t length;
+		// the placeholder index, or 'LITERAL'
+		size_t index;
+	};
+
+	const string_base<charT> _templateStr;
+	vector<Segment> _segments{};
+
+	void parse(const vector<string_base<charT>>& names, const pair<string_base<charT>, string_base<charT>>& phWrapper) {
+		const string_base<charT>& prefix = phWrapper.first;
+		const string_base<charT>& suffix = phWrapper.second;
+		size_t literalStart = 0, searchIndex = 0, prefixIndex;
+		if (prefix.empty() || suffix.empty()) prefixIndex = string_base<charT>::npos;
+		else prefixIndex = _templateStr.find(prefix);
+
+		while (prefixIndex != string_base<charT>::npos) {
+			size_t nameIndex = prefixIndex + prefix.length();
+			size_t suffixIndex = _templateStr.find(suffix, nameIndex);
+			if (suffixIndex == string_base<charT>::npos) break;
+
+			size_t index = parseIndex(_templateStr.substr(nameIndex, suffixIndex - nameIndex), names);
+
+			if (index != LITERAL) {
+				addLiteral(literalStart, prefixIndex);
+				_segments.push_back(Segment{ prefixIndex, suffixIndex + suffix.length() - prefixIndex, index });
+				literalStart = searchIndex = suffixIndex + suffix.length();
+			}
+			else {
+				// the prefix is literal text, but a placeholder may still start right after it (ex: "{{0}")
+				searchIndex = prefixIndex + 1;
+			}
+
+			prefixIndex = _templateStr.find(prefix, searchIndex);
+		}
+
+		addLiteral(literalStart, _templateStr.length());
+	}
+
+	void addLiteral(size_t start, size_t end) {
+		if (end > start) _segments.push_back(Segment{ start, end - start, LITERAL });
+	}
+
+	static size_t parseIndex(const string_base<charT>& name, const vector<string_base<charT>>& names) {
+		for (size_t i = 0; i < names.size(); i++) {
+			if (!names[i].empty() && names[i] == name) return i;
+		}
+
+		if (name.empty() || name.length() > MAX_INDEX_DIGITS) return LITERAL;
+		size_t index = 0;
+
+		for (charT ch : name) {
+			if (ch < (charT)48 || ch > (charT)57) return LITERAL; // '0' - '9'
+			index = index * 10 + static_cast<size_t>(ch - (charT)48);
+		}
+
+		return index;
+	}
+
+	static const string_base<charT>* getValue(const Segment& segment,
+		const vector<string_base<charT>>& values, size_t startIndex)
+	{
+		if (segment.index == LITERAL || segment.index < startIndex || segment.index - startIndex >= values.size()) {
+			return nullptr;
+		}
+
+		return &values[segment.index - startIndex];
+	}
+};
+
+
 class StrHelper {
 private:
 	template<class charT>
@@ -24,15 +699,35 @@ public:
 	static string_base<charT> replace(string_base<charT> str,
 		const string_base<charT>& target, const string_base<charT>& replacement)
 	{
-		if (str.empty()) return str;
-		size_t targetIndex;
+		if (str.empty() || target.empty()) return str;
+		size_t targetIndex = str.find(target);
+		if (targetIndex == string_base<charT>::npos) return str;
+
+		string_base<charT> output;
+		output.reserve(replacement.length() > target.length() ? str.length() + str.length() / 4 : str.length());
+		size_t copiedIndex = 0;
+
+		do {
+			output.append(str, copiedIndex, targetIndex - copiedIndex);
+			output.append(replacement);
+			copiedIndex = targetIndex + target.length();
+		} while ((targetIndex = str.find(target, copiedIndex)) != string_base<charT>::npos);
+
+		output.append(str, copiedIndex, string_base<charT>::npos);
+		return output;
+	}
 
-		while ((targetIndex = str.find(target)) != string_base<charT>::npos) {
-			str = str.erase(targetIndex, target.length());
-			str = str.insert(targetIndex, replacement);
-		}
+	// applies all of the (target -> replacement) pairs in a single pass
+	template<class charT>
+	static string_base<charT> replace(const string_base<charT>& str,
+		const vector<pair<string_base<charT>, string_base<charT>>>& replacements)
+	{
+		return StrReplaceSet<charT>(replacements).apply(str);
+	}
 
-		return str;
+	template<class charT>
+	static string_base<charT> replace(const string_base<charT>& str, const StrReplaceSet<charT>& replaceSet) {
+		return replaceSet.apply(str);
 	}
 
 	template<class charT>
@@ -48,26 +743,42 @@ public:
 	}
 
 	template<class charT>
-	static string_base<charT> trim(string_base<charT> s, const string_base<charT>& trim) {
-		return rtrim<charT>(ltrim(s, trim), trim);
+	static string_base<charT> trim(const string_base<charT>& s, const string_base<charT>& trim) {
+		return toString<charT>(s, trimView<charT>(s, trim));
 	}
 
 	template<class charT>
-	static string_base<charT> ltrim(string_base<charT> s, const string_base<charT>& trim) {
-		size_t trLen = trim.length();
+	static string_base<charT> ltrim(const string_base<charT>& s, const string_base<charT>& trim) {
+		return toString<charT>(s, ltrimView<charT>(s, trim));
+	}
 
-		while (s.length() >= trLen && s.find(trim) == 0)
-			s.erase(0, trLen);
+	template<class charT>
+	static string_base<charT> rtrim(const string_base<charT>& s, const string_base<charT>& trim) {
+		return toString<charT>(s, rtrimView<charT>(s, trim));
+	}
+
+	// same as 'trim'/'ltrim'/'rtrim', but return a view of 's' rather than a copy
+	template<class charT>
+	static StrView<charT> trimView(StrView<charT> s, StrView<charT> trim) {
+		return rtrimView<charT>(ltrimView<charT>(s, trim), trim);
+	}
+
+	template<class charT>
+	static StrView<charT> ltrimView(StrView<charT> s, StrView<charT> trim) {
+		if (trim.empty()) return s;
+
+		while (s.startsWith(trim))
+			s = s.substr(trim.length());
 
 		return s;
 	}
 
 	template<class charT>
-	static string_base<charT> rtrim(string_base<charT> s, const string_base<charT>& trim) {
-		size_t trLen = trim.length();
+	static StrView<charT> rtrimView(StrView<charT> s, StrView<charT> trim) {
+		if (trim.empty()) return s;
 
-		while (s.length() >= trLen && s.rfind(trim) == s.length() - trLen)
-			s.erase(s.length() - trLen);
+		while (s.endsWith(trim))
+			s = s.substr(0, s.length() - trim.length());
 
 		return s;
 	}
@@ -81,23 +792,8 @@ public:
 	static vector<string_base<charT>> split(
 		const string_base<charT>& str, const charT delim, bool trimWs = false)
 	{
-		static const string_base<charT> _space = getSpace<charT>();
 		vector<string_base<charT>> splits{};
-		string_base<charT> subStr;
-
-		for (charT ch : str) {
-			if (ch == delim) {
-				if (trimWs) subStr = trim<charT>(subStr, _space);
-				splits.push_back(subStr);
-				subStr.clear();
-			}
-			else {
-				subStr += ch;
-			}
-		}
-
-		if (trimWs) subStr = trim<charT>(subStr, _space);
-		splits.push_back(subStr);
+		for (StrView<charT> part : splitView<charT>(str, delim, trimWs)) splits.push_back(part.str());
 		return splits;
 	}
 
@@ -105,71 +801,68 @@ public:
 	static vector<string_base<charT>> split(
 		const string_base<charT>& str, const string_base<charT>& delim, bool trimWs = false)
 	{
-		static const string_base<charT> _space = getSpace<charT>();
-		vector<string_base<charT>> splits;
-		size_t start = 0, end = str.find(delim);
-		string_base<charT> subStr;
-
-		while (end != string::npos) {
-			subStr = str.substr(start, end - start);
-			if (trimWs) subStr = trim<charT>(subStr, _space);
-			splits.push_back(subStr);
+		vector<string_base<charT>> splits{};
+		for (StrView<charT> part : splitView<charT>(str, delim, trimWs)) splits.push_back(part.str());
+		return splits;
+	}
 
-			start = end + delim.length();
-			end = str.find(delim, start);
-		}
+	// same as 'split', but the parts are found one at a time while iterating, as views of 'str'
+	// (ex: for (StrView<char> part : StrHelper::splitView<char>(str, ','))); 'str' must outlive the iteration
+	template<class charT>
+	static StrSplitView<charT> splitView(StrView<charT> str, const charT delim, bool trimWs = false) {
+		return StrSplitView<charT>(str, delim, trimWs);
+	}
 
-		subStr = str.substr(start);
-		if (trimWs) subStr = trim<charT>(subStr, _space);
-		splits.push_back(subStr);
-		return splits;
+	template<class charT>
+	static StrSplitView<charT> splitView(StrView<charT> str, StrView<charT> delim, bool trimWs = false) {
+		return StrSplitView<charT>(str, delim, trimWs);
 	}
 
 	template<class charT>
-	static string_base<charT> format(string_base<charT> str,
-		const vector<string_base<charT>> pars, const size_t startIndex = 0,
+	static string_base<charT> format(const string_base<charT>& str,
+		const vector<string_base<charT>>& pars, const size_t startIndex = 0,
 		const pair<string_base<charT>, string_base<charT>>& phWrapper = getDefaultPlaceholderWrapper<charT>())
 	{
-		string_base<charT> placeholder;
-
-		for (size_t i = 0, j = i + startIndex; i < pars.size(); i++, j++) {
-			placeholder = createPlaceholder<charT>(j, phWrapper);
-			str = replace<charT>(str, placeholder, pars[i]);
-		}
-
-		return str;
+		// to render the same template repeatedly, a 'StrTemplate' can be kept instead
+		return StrTemplate<charT>(str, {}, phWrapper).render(pars, startIndex);
 	}
 
+	// invalid UTF-8 sequences are converted to U+FFFD
 	static wstring convertToW(const string& str) {
-		int count = MultiByteToWideChar(CP_UTF8, 0, str.c_str(), str.length(), NULL, 0);
-		wstring wstr(count, 0);
-		MultiByteToWideChar(CP_UTF8, 0, str.c_str(), str.length(), &wstr[0], count);
+		wstring wstr;
+		Utf8Transcoder::toWide(str.c_str(), str.length(), wstr);
 		return wstr;
 	}
 
+	// unpaired surrogates are converted to U+FFFD
 	static string convertFromW(const wstring& wstr) {
-		int count = WideCharToMultiByte(CP_UTF8, 0, wstr.c_str(), wstr.length(), NULL, 0, NULL, NULL);
-		string str(count, 0);
-		WideCharToMultiByte(CP_UTF8, 0, wstr.c_str(), -1, &str[0], count, NULL, NULL);
+		string str;
+		Utf8Transcoder::fromWide(wstr.c_str(), wstr.length(), str);
 		return str;
 	}
 
-private:
-	template<class charT>
-	static string_base<charT> getSpace() {
-		static const string_base<charT> _space(1, (charT)32); // " "
-		return _space;
+	// same as 'convertToW'/'convertFromW', but fail (returning false) on invalid input
+	static bool tryConvertToW(const string& str, wstring& wstr) {
+		return Utf8Transcoder::toWide(str.c_str(), str.length(), wstr, true);
+	}
+
+	static bool tryConvertFromW(const wstring& wstr, string& str) {
+		return Utf8Transcoder::fromWide(wstr.c_str(), wstr.length(), str, true);
 	}
 
+	static bool isValidUtf8(const string& str) {
+		return Utf8Transcoder::isValidUtf8(str.c_str(), str.length());
+	}
+
+private:
 	template<class charT>
 	static string_base<charT> getBlank() {
 		return string_base<charT>();
 	}
 
+	// 'view' is a part of 's', which is returned as is if the view covers all of it
 	template<class charT>
-	static string_base<charT> createPlaceholder(size_t i, 
-		const pair<string_base<charT>, string_base<charT>>& phWrapper)
-	{
-		return phWrapper.first + _Integral_to_string<charT>(i) + phWrapper.second;
+	static string_base<charT> toString(const string_base<charT>& s, StrView<charT> view) {
+		return view.length() == s.length() ? s : view.str();
 	}
 };
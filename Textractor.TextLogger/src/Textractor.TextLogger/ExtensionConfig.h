@@ -13,10 +13,10 @@ struct ExtensionConfig {
 	enum FilterMode { Disabled = 0, Blacklist, Whitelist };
 
 	bool disabled;
-	wstring logFilePathTemplate; // {0}: process name; {1}: thread key; {2}: thread name
+	wstring logFilePathTemplate; // {0}/{process}: process name; {1}/{threadKey}: thread key; {2}/{threadName}: thread name
 	bool activeThreadOnly;
 	ConsoleClipboardMode skipConsoleAndClipboard;
-	wstring msgTemplate; // {0}: sentence; {1}: process name; {2}: thread key; {3}: thread name; {4}: current date time
+	wstring msgTemplate; // {0}/{sentence}: sentence; {1}/{process}: process name; {2}/{threadKey}: thread key; {3}/{threadName}: thread name; {4}/{datetime}: current date time
 	bool onlyThreadNameAsKey;
 	FilterMode threadKeyFilterMode;
 	wstring threadKeyFilterList;
@@ -1,10 +1,12 @@
 #pragma once
 
 #include "_Libraries/datetime.h"
+#include "_Libraries/Locker.h"
 #include "_Libraries/strhelper.h"
 #include "Extension.h"
 #include "ExtensionConfig.h"
 #include "ProcessNameRetriever.h"
+#include <memory>
 #include <string>
 using namespace std;
 
@@ -20,6 +22,8 @@ public:
 };
 
 
+// The path/message templates are parsed once, and parsed again only when they change in the config.
+// Besides their indexes, placeholders can be given by name (ex: "{process}" instead of "{0}" in the path template).
 class DefaultLoggerTextHandler : public LoggerTextHandler {
 public:
 	DefaultLoggerTextHandler(const ProcessNameRetriever& procNameRetriever) 
@@ -28,74 +32,68 @@ public:
 	wstring getLogFilePath(const wstring& threadKey,
 		SentenceInfoWrapper& sentInfoWrapper, const ExtensionConfig& config) const override
 	{
-		static const wstring PROCESS_NAME_PLACEHOLDER = L"{0}";
-		static const wstring THREAD_KEY_PLACEHOLDER = L"{1}";
-		static const wstring THREAD_NAME_PLACEHOLDER = L"{2}";
+		shared_ptr<const StrTemplate<wchar_t>> pathTemplate = getOrSetTemplate(
+			_logFilePathTemplate, config.logFilePathTemplate, LOG_FILE_PATH_NAMES);
 
 		wstring processName = getProcessName(sentInfoWrapper);
 		wstring threadName = sentInfoWrapper.getThreadName();
-		
-		wstring logFilePath = config.logFilePathTemplate;
-		logFilePath = replace(logFilePath, PROCESS_NAME_PLACEHOLDER, processName);
-		logFilePath = replace(logFilePath, THREAD_KEY_PLACEHOLDER, threadKey);
-		logFilePath = replace(logFilePath, THREAD_NAME_PLACEHOLDER, threadName);
 
-		return logFilePath;
+		return pathTemplate->render({ processName, threadKey, threadName });
 	}
 
 	wstring createLogMsg(const wstring& sentence, const wstring& threadKey,
 		SentenceInfoWrapper& sentInfoWrapper, const ExtensionConfig& config) const override
 	{
 		static const wstring SENTENCE_PLACEHOLDER = L"{0}";
-		static const wstring PROC_NAME_PLACEHOLDER = L"{1}";
-		static const wstring THREAD_KEY_PLACEHOLDER = L"{2}";
-		static const wstring THREAD_NAME_PLACEHOLDER = L"{3}";
-		static const wstring DATETIME_PLACEHOLDER = L"{4}";
+		enum MsgValue { Sentence = 0, ProcName, ThreadKey, ThreadName, DateTime };
 
-		wstring msg = config.msgTemplate;
-		if (msg.empty()) msg = SENTENCE_PLACEHOLDER;
+		wstring msgTemplateStr = config.msgTemplate;
+		if (msgTemplateStr.empty()) msgTemplateStr = SENTENCE_PLACEHOLDER;
+		shared_ptr<const StrTemplate<wchar_t>> msgTemplate = getOrSetTemplate(_msgTemplate, msgTemplateStr, MSG_NAMES);
 
-		if (found(msg, PROC_NAME_PLACEHOLDER)) {
-			wstring procName = getProcessName(sentInfoWrapper);
-			msg = replace(msg, PROC_NAME_PLACEHOLDER, procName);
-		}
-		if (found(msg, THREAD_KEY_PLACEHOLDER)) {
-			msg = replace(msg, THREAD_KEY_PLACEHOLDER, threadKey);
-		}
-		if (found(msg, THREAD_NAME_PLACEHOLDER)) {
-			wstring threadName = sentInfoWrapper.getThreadName();
-			msg = replace(msg, THREAD_NAME_PLACEHOLDER, threadName);
+		// only the values used by the template are retrieved
+		vector<wstring> values(MSG_NAMES.size());
+		values[Sentence] = sentence;
+		values[ThreadKey] = threadKey;
+
+		if (msgTemplate->hasPlaceholder(ProcName)) {
+			values[ProcName] = getProcessName(sentInfoWrapper);
 		}
-		if (found(msg, DATETIME_PLACEHOLDER)) {
-			wstring currDateTime = StrHelper::convertToW(getCurrentDateTime());
-			msg = replace(msg, DATETIME_PLACEHOLDER, currDateTime);
+		if (msgTemplate->hasPlaceholder(ThreadName)) {
+			values[ThreadName] = sentInfoWrapper.getThreadName();
 		}
-		if (found(msg, SENTENCE_PLACEHOLDER)) {
-			msg = replace(msg, SENTENCE_PLACEHOLDER, sentence);
+		if (msgTemplate->hasPlaceholder(DateTime)) {
+			values[DateTime] = StrHelper::convertToW(getCurrentDateTime());
 		}
 
-		return msg;
+		return msgTemplate->render(values);
 	}
 private:
+	const vector<wstring> LOG_FILE_PATH_NAMES = { L"process", L"threadKey", L"threadName" };
+	const vector<wstring> MSG_NAMES = { L"sentence", L"process", L"threadKey", L"threadName", L"datetime" };
 	const ProcessNameRetriever& _procNameRetriever;
+	mutable BasicLocker _templateLocker;
+	mutable shared_ptr<const StrTemplate<wchar_t>> _logFilePathTemplate = nullptr;
+	mutable shared_ptr<const StrTemplate<wchar_t>> _msgTemplate = nullptr;
 
-	wstring getProcessName(SentenceInfoWrapper& sentInfoWrapper) const {
-		DWORD pid = sentInfoWrapper.getProcessIdD();
-		return _procNameRetriever.getProcessName(pid);
-	}
+	shared_ptr<const StrTemplate<wchar_t>> getOrSetTemplate(shared_ptr<const StrTemplate<wchar_t>>& cachedTemplate,
+		const wstring& templateStr, const vector<wstring>& names) const
+	{
+		shared_ptr<const StrTemplate<wchar_t>> strTemplate = nullptr;
 
-	wstring replace(wstring str, const wstring& target, const wstring& replacement) const {
-		size_t startPos = 0;
+		_templateLocker.lock([&cachedTemplate, &templateStr, &names, &strTemplate]() {
+			if (cachedTemplate == nullptr || cachedTemplate->getTemplate() != templateStr) {
+				cachedTemplate = make_shared<const StrTemplate<wchar_t>>(templateStr, names);
+			}
 
-		while ((startPos = str.find(target, startPos)) != wstring::npos) {
-			str.replace(startPos, target.length(), replacement);
-			startPos += replacement.length();
-		}
+			strTemplate = cachedTemplate;
+		});
 
-		return str;
+		return strTemplate;
 	}
 
-	bool found(const wstring& str, const wstring& subStr) const {
-		return str.find(subStr) != wstring::npos;
+	wstring getProcessName(SentenceInfoWrapper& sentInfoWrapper) const {
+		DWORD pid = sentInfoWrapper.getProcessIdD();
+		return _procNameRetriever.getProcessName(pid);
 	}
 };
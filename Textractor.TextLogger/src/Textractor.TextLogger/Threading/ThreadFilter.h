@@ -1,5 +1,6 @@
 #pragma once
 
+#include "../_Libraries/strhelper.h"
 #include "../Extension.h"
 #include "../ExtensionConfig.h"
 #include "ThreadKeyGenerator.h"
@@ -67,12 +68,10 @@ private:
 
 	bool isInList(const wstring& list, const wstring& subStr, const wstring& delim) const {
 		if (subStr.length() > list.length()) return false;
-		wstring searchStr = subStr + delim;
-		size_t index = list.find(searchStr);
-		if (index != wstring::npos) return true;
 
-		index = list.rfind(subStr);
-		if (index == list.length() - subStr.length()) return true;
+		for (StrView<wchar_t> item : StrHelper::splitView<wchar_t>(list, delim)) {
+			if (item == subStr) return true;
+		}
 
 		return false;
 	}
@@ -0,0 +1,221 @@
+
+#pragma once
+#include "../_Libraries/bloomfilter.h"
+#include "../_Libraries/Locker.h"
+#include "TextMapCache.h"
+#include <atomic>
+
+
+struct BloomFilterStats {
+	uint64_t definiteMisses;
+	uint64_t passedLookups;
+	uint64_t falsePositives;
+	// share of the lookups for absent keys which the filter did not catch
+	double observedFpRate;
+	double estimatedFpRate;
+	size_t keyCount;
+	size_t capacity;
+};
+
+
+// Keeps a counting Bloom filter over the keys of 'mainCache', so that lookups for keys which are definitely absent
+// are answered without touching 'mainCache' at all (ex: a chain of caches, or a file-backed cache).
+// The filter is built from 'mainCache' on construction, and is rebuilt once it holds more keys than it was sized for,
+// with room for twice the keys actually in 'mainCache'. Overwrites made through this cache don't add to the key count.
+// Changes made to 'mainCache' directly (rather than through this cache) must be reported via 'addKey',
+// or followed by 'invalidate' and 'rebuild'; the filter is bypassed in between.
+class BloomFilterTextMapCache : public TextMapCache {
+public:
+	BloomFilterTextMapCache(TextMapCache& mainCache, const TextFormatter& formatter,
+		size_t expectedCount = 65536, double targetFpRate = 0.01) : _mainCache(mainCache), _formatter(formatter),
+			_targetFpRate(targetFpRate), _filter(expectedCount, targetFpRate)
+	{
+		rebuild(expectedCount);
+	}
+
+	bool keyExists(const wstring& key) const override {
+		return !readFromCache(key).empty();
+	}
+
+	wstring readFromCache(const wstring& key) const override {
+		uint64_t keyHash = getKeyHash(key);
+		bool bypassed = false;
+
+		bool mightContain = _locker.lockB([this, keyHash, &bypassed]() {
+			bypassed = _bypass;
+			return bypassed || _filter.mightContain(keyHash);
+		});
+
+		if (!mightContain) {
+			_definiteMisses++;
+			return L"";
+		}
+
+		wstring value = _mainCache.readFromCache(key);
+		if (bypassed) return value;
+
+		_passedLookups++;
+		if (value.empty()) _falsePositives++;
+		return value;
+	}
+
+	unordered_map<wstring, wstring> readAllFromCache() const override {
+		return _mainCache.readAllFromCache();
+	}
+
+	void writeToCache(const wstring& key, const wstring& value) override {
+		uint64_t keyHash = getKeyHash(key);
+		bool rebuildNeeded = false;
+
+		// the key is added first, so a concurrent lookup never misses a value which is already in 'mainCache'
+		_writeLocker.lock([this, &key, &value, keyHash, &rebuildNeeded]() {
+			if (isNewKey(key, keyHash)) rebuildNeeded = addKeyHash(keyHash);
+			_mainCache.writeToCache(key, value);
+		});
+
+		if (rebuildNeeded) rebuild();
+	}
+
+	void writeAllToCache(const unordered_map<wstring, wstring> cache, bool reload = false) override {
+		bool rebuildNeeded = false;
+
+		_writeLocker.lock([this, &cache, reload, &rebuildNeeded]() {
+			if (reload) {
+				invalidate();
+				rebuildNeeded = true;
+			}
+			else {
+				for (const auto& textPair : cache) {
+					uint64_t keyHash = getKeyHash(textPair.first);
+					if (isNewKey(textPair.first, keyHash) && addKeyHash(keyHash)) rebuildNeeded = true;
+				}
+			}
+
+			_mainCache.writeAllToCache(cache, reload);
+		});
+
+		if (rebuildNeeded) rebuild();
+	}
+
+	void removeFromCache(const wstring& key) override {
+		// only keys which were actually present are removed from the filter, so no other key's counters are lost
+		bool existed = _mainCache.keyExists(key);
+		_mainCache.removeFromCache(key);
+		if (!existed) return;
+
+		uint64_t keyHash = getKeyHash(key);
+		_locker.lock([this, keyHash]() {
+			_filter.remove(keyHash);
+		});
+	}
+
+	void clearCache() override {
+		_writeLocker.lock([this]() {
+			_mainCache.clearCache();
+
+			_locker.lock([this]() {
+				_filter.clear();
+				_pendingKeyHashes.clear();
+			});
+		});
+	}
+
+	// records a key added to 'mainCache' without going through this cache.
+	// This never reads 'mainCache' (it may be called while 'mainCache' is locked), so if the filter is full,
+	// it only grows on the next write made through this cache.
+	void addKey(const wstring& key) {
+		addKeyHash(getKeyHash(key));
+	}
+
+	// lookups go straight to 'mainCache' until the next 'rebuild' (ex: while 'mainCache' is being reloaded)
+	void invalidate() {
+		_locker.lock([this]() {
+			_bypass = true;
+		});
+	}
+
+	void rebuild() {
+		rebuild(getCapacity());
+	}
+
+	BloomFilterStats getStats() const {
+		BloomFilterStats stats{};
+		stats.definiteMisses = _definiteMisses;
+		stats.passedLookups = _passedLookups;
+		stats.falsePositives = _falsePositives;
+
+		uint64_t absentLookups = stats.definiteMisses + stats.falsePositives;
+		stats.observedFpRate = absentLookups > 0 ? static_cast<double>(stats.falsePositives) / absentLookups : 0.0;
+
+		_locker.lock([this, &stats]() {
+			stats.estimatedFpRate = _filter.getEstimatedFpRate();
+			stats.keyCount = _filter.getCount();
+			stats.capacity = _filter.getCapacity();
+		});
+
+		return stats;
+	}
+private:
+	TextMapCache& _mainCache;
+	const TextFormatter& _formatter;
+	const double _targetFpRate;
+	mutable BasicLocker _locker;
+	BasicLocker _writeLocker;
+	CountingBloomFilter _filter;
+	bool _bypass = true;
+	bool _rebuilding = false;
+	vector<uint64_t> _pendingKeyHashes{};
+	mutable atomic<uint64_t> _definiteMisses{ 0 };
+	mutable atomic<uint64_t> _passedLookups{ 0 };
+	mutable atomic<uint64_t> _falsePositives{ 0 };
+
+	size_t getCapacity() const {
+		size_t capacity = 0;
+		_locker.lock([this, &capacity]() { capacity = _filter.getCapacity(); });
+		return capacity;
+	}
+
+	// returns whether the filter is full, and is to be rebuilt once the key is in 'mainCache'
+	bool addKeyHash(uint64_t keyHash) {
+		return _locker.lockB([this, keyHash]() {
+			_filter.add(keyHash);
+			if (_rebuilding) _pendingKeyHashes.push_back(keyHash);
+			return _filter.getCount() > _filter.getCapacity();
+		});
+	}
+
+	// 'mainCache' is only read for keys the filter already might contain (an overwrite, or a false positive)
+	bool isNewKey(const wstring& key, uint64_t keyHash) const {
+		bool mightContain = _locker.lockB([this, keyHash]() { return _filter.mightContain(keyHash); });
+		return !mightContain || !_mainCache.keyExists(key);
+	}
+
+	uint64_t getKeyHash(const wstring& key) const {
+		return CountingBloomFilter::hashKey(_formatter.format(key));
+	}
+
+	// writes through this cache wait for the rebuild, so none can be half done (key added, value not yet written)
+	// while 'mainCache' is read; keys reported via 'addKey' meanwhile are carried over to the new filter.
+	// The capacity is sized from the keys actually in 'mainCache', so a count inflated by keys reported twice
+	// (ex: overwrites via 'addKey') is corrected without the filter growing.
+	void rebuild(size_t minCapacity) {
+		_writeLocker.lock([this, minCapacity]() {
+			_locker.lock([this]() {
+				_rebuilding = true;
+				_pendingKeyHashes.clear();
+			});
+
+			unordered_map<wstring, wstring> cache = _mainCache.readAllFromCache();
+			CountingBloomFilter filter(max<size_t>(minCapacity, cache.size() * 2), _targetFpRate);
+			for (const auto& textPair : cache) filter.add(getKeyHash(textPair.first));
+
+			_locker.lock([this, &filter]() {
+				for (uint64_t keyHash : _pendingKeyHashes) filter.add(keyHash);
+				_filter = move(filter);
+				_pendingKeyHashes.clear();
+				_rebuilding = false;
+				_bypass = false;
+			});
+		});
+	}
+};
@@ -0,0 +1,252 @@
+
+#pragma once
+#include "../_Libraries/Locker.h"
+#include "TextMapCache.h"
+#include <functional>
+#include <list>
+
+
+struct CacheStats {
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+	size_t entryCount;
+	uint64_t byteSize;
+};
+
+
+// Provides the keys of a cache ordered by how recently they were used (most recent first).
+class CacheRecencySource {
+public:
+	virtual ~CacheRecencySource() { }
+	virtual vector<wstring> getKeysByRecency() const = 0;
+};
+
+
+// Accepts entries loaded ahead of being read (ex: prefetched). Unlike reads/writes, checking for and warming entries
+// leaves the recency and stats of existing entries untouched.
+class CacheWarmTarget {
+public:
+	virtual ~CacheWarmTarget() { }
+	virtual bool isWarm(const wstring& key) const = 0;
+	// does nothing if the key is already present
+	virtual void warmEntry(const wstring& key, const wstring& value) = 0;
+};
+
+
+// In-memory cache bounded by a byte budget, evicting by segmented LRU (SLRU):
+// new entries start in a 'probation' segment, and are promoted to a 'protected' segment once read again.
+// Entries are evicted from the probation segment first, so a burst of one-off lookups/writes (ex: skimming through
+// a long scene once) cannot flush out entries that are read repeatedly.
+// Entry sizes account for the actual key/value byte sizes, plus a fixed per-entry bookkeeping overhead.
+class BoundedMemoryTextMapCache : public TextMapCache, public CacheRecencySource, public CacheWarmTarget {
+public:
+	BoundedMemoryTextMapCache(const TextFormatter& formatter, const function<uint64_t()>& byteBudgetGetter,
+		double protectedRatio = 0.8) : _formatter(formatter), _byteBudgetGetter(byteBudgetGetter),
+			_protectedRatio(protectedRatio) { }
+	BoundedMemoryTextMapCache(const TextFormatter& formatter, uint64_t byteBudget, double protectedRatio = 0.8)
+		: BoundedMemoryTextMapCache(formatter, [byteBudget]() { return byteBudget; }, protectedRatio) { }
+
+	bool keyExists(const wstring& key) const override {
+		return !readFromCache(key).empty();
+	}
+
+	wstring readFromCache(const wstring& key) const override {
+		wstring formattedKey = _formatter.format(key);
+
+		return _locker.lockWS([this, &formattedKey]() {
+			auto it = _entries.find(formattedKey);
+			if (it == _entries.end()) {
+				_misses++;
+				return wstring(L"");
+			}
+
+			_hits++;
+			promote(it->second);
+			return it->second->value;
+		});
+	}
+
+	unordered_map<wstring, wstring> readAllFromCache() const override {
+		unordered_map<wstring, wstring> cache{};
+
+		_locker.lock([this, &cache]() {
+			for (const auto& entry : _entries) cache[entry.first] = entry.second->value;
+		});
+
+		return cache;
+	}
+
+	void writeToCache(const wstring& key, const wstring& value) override {
+		wstring formattedKey = _formatter.format(key);
+		wstring formattedValue = _formatter.format(value);
+
+		_locker.lock([this, &formattedKey, &formattedValue]() {
+			writeToCacheBase(formattedKey, formattedValue);
+			evictOverBudget();
+		});
+	}
+
+	void writeAllToCache(const unordered_map<wstring, wstring> cache, bool reload = false) override {
+		_locker.lock([this, &cache, reload]() {
+			if (reload) clearCacheBase();
+
+			for (const auto& textPair : cache) {
+				writeToCacheBase(_formatter.format(textPair.first), _formatter.format(textPair.second));
+			}
+
+			evictOverBudget();
+		});
+	}
+
+	void removeFromCache(const wstring& key) override {
+		wstring formattedKey = _formatter.format(key);
+
+		_locker.lock([this, &formattedKey]() {
+			auto it = _entries.find(formattedKey);
+			if (it != _entries.end()) removeEntry(it->second);
+		});
+	}
+
+	void clearCache() override {
+		_locker.lock([this]() {
+			clearCacheBase();
+		});
+	}
+
+	vector<wstring> getKeysByRecency() const override {
+		vector<wstring> keys{};
+
+		_locker.lock([this, &keys]() {
+			keys.reserve(_entries.size());
+			for (const Entry& entry : _protected) keys.push_back(entry.key);
+			for (const Entry& entry : _probation) keys.push_back(entry.key);
+		});
+
+		return keys;
+	}
+
+	bool isWarm(const wstring& key) const override {
+		wstring formattedKey = _formatter.format(key);
+
+		return _locker.lockB([this, &formattedKey]() {
+			return _entries.find(formattedKey) != _entries.end();
+		});
+	}
+
+	// warmed entries start in the probation segment, like written ones
+	void warmEntry(const wstring& key, const wstring& value) override {
+		wstring formattedKey = _formatter.format(key);
+		wstring formattedValue = _formatter.format(value);
+		if (formattedValue.empty()) return;
+
+		_locker.lock([this, &formattedKey, &formattedValue]() {
+			if (_entries.find(formattedKey) != _entries.end()) return;
+			writeToCacheBase(formattedKey, formattedValue);
+			evictOverBudget();
+		});
+	}
+
+	CacheStats getStats() const {
+		CacheStats stats{};
+
+		_locker.lock([this, &stats]() {
+			stats.hits = _hits;
+			stats.misses = _misses;
+			stats.evictions = _evictions;
+			stats.entryCount = _entries.size();
+			stats.byteSize = _probationBytes + _protectedBytes;
+		});
+
+		return stats;
+	}
+private:
+	struct Entry {
+		wstring key;
+		wstring value;
+		uint64_t byteSize;
+		bool isProtected;
+	};
+
+	typedef list<Entry>::iterator EntryIterator;
+
+	// approximates the list node, map node, and string headers kept per entry
+	const uint64_t _entryOverheadBytes = 128;
+	const TextFormatter& _formatter;
+	const function<uint64_t()> _byteBudgetGetter;
+	const double _protectedRatio;
+	mutable BasicLocker _locker;
+	mutable list<Entry> _probation{};
+	mutable list<Entry> _protected{};
+	mutable unordered_map<wstring, EntryIterator> _entries{};
+	mutable uint64_t _probationBytes = 0;
+	mutable uint64_t _protectedBytes = 0;
+	mutable uint64_t _hits = 0;
+	mutable uint64_t _misses = 0;
+	uint64_t _evictions = 0;
+
+	void writeToCacheBase(const wstring& key, const wstring& value) {
+		auto it = _entries.find(key);
+		if (it != _entries.end()) removeEntry(it->second);
+
+		// the key is held by both the entry and the lookup map
+		uint64_t byteSize = ((key.length() * 2) + value.length()) * sizeof(wchar_t) + _entryOverheadBytes;
+		_probation.push_front(Entry{ key, value, byteSize, false });
+		_probationBytes += byteSize;
+		_entries[key] = _probation.begin();
+	}
+
+	void promote(EntryIterator entry) const {
+		if (entry->isProtected) {
+			_protected.splice(_protected.begin(), _protected, entry);
+			return;
+		}
+
+		_protected.splice(_protected.begin(), _probation, entry);
+		entry->isProtected = true;
+		_probationBytes -= entry->byteSize;
+		_protectedBytes += entry->byteSize;
+
+		// the least recently used protected entries get another chance in the probation segment
+		uint64_t protectedBudget = static_cast<uint64_t>(_byteBudgetGetter() * _protectedRatio);
+
+		while (_protectedBytes > protectedBudget && _protected.size() > 1) {
+			EntryIterator demoted = prev(_protected.end());
+			_probation.splice(_probation.begin(), _protected, demoted);
+			demoted->isProtected = false;
+			_protectedBytes -= demoted->byteSize;
+			_probationBytes += demoted->byteSize;
+		}
+	}
+
+	void evictOverBudget() {
+		uint64_t byteBudget = _byteBudgetGetter();
+
+		while (_probationBytes + _protectedBytes > byteBudget && !_entries.empty()) {
+			EntryIterator victim = !_probation.empty() ? prev(_probation.end()) : prev(_protected.end());
+			removeEntry(victim);
+			_evictions++;
+		}
+	}
+
+	void removeEntry(EntryIterator entry) {
+		_entries.erase(entry->key);
+
+		if (entry->isProtected) {
+			_protectedBytes -= entry->byteSize;
+			_protected.erase(entry);
+		}
+		else {
+			_probationBytes -= entry->byteSize;
+			_probation.erase(entry);
+		}
+	}
+
+	void clearCacheBase() {
+		_entries.clear();
+		_probation.clear();
+		_protected.clear();
+		_probationBytes = 0;
+		_protectedBytes = 0;
+	}
+};
@@ -0,0 +1,160 @@
+
+#pragma once
+#include "TextMapCache.h"
+#include "CacheLineFormatter.h"
+#include "../File/FileInspector.h"
+#include "../File/FileReader.h"
+#include <algorithm>
+#include <exception>
+#include <fstream>
+#include <limits>
+#include <thread>
+
+
+// Loads all entries of a cache file, where the last line for a key wins, and a line with an empty value
+// (a tombstone) removes the key.
+class CacheFileLoader {
+public:
+	virtual ~CacheFileLoader() { }
+	virtual unordered_map<wstring, wstring> loadFile(const string& filePath) const = 0;
+
+	void loadFileInto(const string& filePath, TextMapCache& targetCache, bool reload = true) const {
+		targetCache.writeAllToCache(loadFile(filePath), reload);
+	}
+};
+
+
+// Splits the cache file into byte ranges aligned to line starts, and parses/converts each range on its own thread.
+// Each range is reduced to its own map (keeping tombstones), and the maps are then merged in file order,
+// so the last line for a key still wins. Files smaller than 'minChunkBytes' are loaded on the calling thread.
+class ParallelCacheFileLoader : public CacheFileLoader {
+public:
+	ParallelCacheFileLoader(FileReader& fileReader, const FileInspector& fileInspector,
+		const CacheLineFormatter& lineFormatter, size_t maxThreadCount = 0, uint64_t minChunkBytes = 1048576)
+		: _fileReader(fileReader), _fileInspector(fileInspector), _lineFormatter(lineFormatter),
+			_maxThreadCount(maxThreadCount > 0 ? maxThreadCount : max<size_t>(thread::hardware_concurrency(), 1)),
+			_minChunkBytes(max<uint64_t>(minChunkBytes, 1)) { }
+
+	unordered_map<wstring, wstring> loadFile(const string& filePath) const override {
+		uint64_t fileSize = _fileInspector.getFileSize(filePath);
+		vector<uint64_t> boundaries = getChunkBoundaries(filePath, fileSize);
+		vector<unordered_map<wstring, wstring>> chunkCaches(boundaries.size() - 1);
+		vector<exception_ptr> exceptions(chunkCaches.size(), nullptr);
+		vector<thread> threads{};
+
+		for (size_t i = 1; i < chunkCaches.size(); i++) {
+			threads.push_back(thread([this, &filePath, &boundaries, &chunkCaches, &exceptions, i]() {
+				loadChunk(filePath, boundaries[i], boundaries[i + 1], chunkCaches[i], exceptions[i]);
+			}));
+		}
+
+		// the calling thread takes the first chunk
+		loadChunk(filePath, boundaries[0], boundaries[1], chunkCaches[0], exceptions[0]);
+		for (thread& t : threads) t.join();
+
+		for (const exception_ptr& e : exceptions) {
+			if (e != nullptr) rethrow_exception(e);
+		}
+
+		loadUnterminatedLine(filePath, boundaries.back(), fileSize, chunkCaches.back());
+		return mergeChunkCaches(chunkCaches);
+	}
+private:
+	FileReader& _fileReader;
+	const FileInspector& _fileInspector;
+	const CacheLineFormatter& _lineFormatter;
+	const size_t _maxThreadCount;
+	const uint64_t _minChunkBytes;
+
+	// the first boundary is 0 and the last is the end of the last complete line; all others are line starts
+	vector<uint64_t> getChunkBoundaries(const string& filePath, uint64_t fileSize) const {
+		size_t chunkCount = static_cast<size_t>(min<uint64_t>(_maxThreadCount, max<uint64_t>(fileSize / _minChunkBytes, 1)));
+		vector<uint64_t> boundaries{ 0 };
+
+		for (size_t i = 1; i < chunkCount; i++) {
+			uint64_t boundary = findLineStart(filePath, fileSize / chunkCount * i, fileSize);
+			if (boundary > boundaries.back() && boundary < fileSize) boundaries.push_back(boundary);
+		}
+
+		boundaries.push_back(findLastLineEnd(filePath, fileSize));
+		if (boundaries.back() < boundaries[boundaries.size() - 2]) boundaries.back() = boundaries[boundaries.size() - 2];
+		return boundaries;
+	}
+
+	// returns the offset of the first line starting at or after 'offset'
+	uint64_t findLineStart(const string& filePath, uint64_t offset, uint64_t fileSize) const {
+		if (offset == 0) return 0;
+
+		ifstream f(filePath, ios_base::in | ios_base::binary);
+		f.seekg(offset - 1, ios_base::beg);
+		f.ignore(numeric_limits<streamsize>::max(), '\n');
+
+		streamoff lineStart = f.tellg();
+		return f && lineStart > 0 ? static_cast<uint64_t>(lineStart) : fileSize;
+	}
+
+	uint64_t findLastLineEnd(const string& filePath, uint64_t fileSize) const {
+		const uint64_t tailLength = 4096;
+		ifstream f(filePath, ios_base::in | ios_base::binary);
+
+		for (uint64_t end = fileSize; end > 0;) {
+			uint64_t start = end > tailLength ? end - tailLength : 0;
+			string tail(static_cast<size_t>(end - start), '\0');
+			f.seekg(start, ios_base::beg);
+			if (!f.read(&tail[0], tail.length())) return 0;
+
+			size_t lineBreak = tail.rfind('\n');
+			if (lineBreak != string::npos) return start + lineBreak + 1;
+			end = start;
+		}
+
+		return 0;
+	}
+
+	void loadChunk(const string& filePath, uint64_t startOffset, uint64_t endOffset,
+		unordered_map<wstring, wstring>& chunkCache, exception_ptr& exception) const
+	{
+		try {
+			_fileReader.readLines(filePath, startOffset, endOffset, [this, &chunkCache](const string& line) {
+				pair<wstring, wstring> textPair = _lineFormatter.importFormat(line);
+				chunkCache[move(textPair.first)] = move(textPair.second);
+			});
+		}
+		catch (...) {
+			exception = current_exception();
+		}
+	}
+
+	// a last line missing its line break (ex: written by hand) is still loaded, same as a sequential read would
+	void loadUnterminatedLine(const string& filePath, uint64_t startOffset,
+		uint64_t fileSize, unordered_map<wstring, wstring>& chunkCache) const
+	{
+		if (startOffset >= fileSize) return;
+
+		ifstream f(filePath, ios_base::in | ios_base::binary);
+		f.seekg(startOffset, ios_base::beg);
+
+		string line;
+		if (!getline(f, line) || line.empty()) return;
+		if (line.back() == '\r') line.pop_back();
+
+		pair<wstring, wstring> textPair = _lineFormatter.importFormat(line);
+		chunkCache[move(textPair.first)] = move(textPair.second);
+	}
+
+	// chunk maps are applied in file order, so later lines (including tombstones) override earlier ones
+	static unordered_map<wstring, wstring> mergeChunkCaches(vector<unordered_map<wstring, wstring>>& chunkCaches) {
+		unordered_map<wstring, wstring> cache = move(chunkCaches[0]);
+
+		for (size_t i = 1; i < chunkCaches.size(); i++) {
+			for (auto& textPair : chunkCaches[i]) cache[textPair.first] = move(textPair.second);
+		}
+
+		for (auto it = cache.begin(); it != cache.end();) {
+			if (it->second.empty()) it = cache.erase(it);
+			else it++;
+		}
+
+		return cache;
+	}
+};
@@ -0,0 +1,173 @@
+
+#pragma once
+#include "../_Libraries/strhelper.h"
+#include "../File/Writer/FileWriter.h"
+#include "CacheRecordFramer.h"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <windows.h>
+
+
+// Repairs the end of a cache file left torn by a crash/forced exit in the middle of an append.
+class CacheFileRecoverer {
+public:
+	virtual ~CacheFileRecoverer() { }
+	// returns the number of bytes cut off the end of the file
+	virtual uint64_t recoverFile(const string& filePath) = 0;
+};
+
+
+class NoCacheFileRecoverer : public CacheFileRecoverer {
+public:
+	uint64_t recoverFile(const string& filePath) override {
+		return 0;
+	}
+};
+
+
+// Cuts the file at the end of its last intact line. Lines after it are the torn tail:
+// corrupt records, lines holding zero bytes (written in place of the data), and a last line missing its line break.
+// A last line which is a valid record only missing its line break is kept, and gets the line break instead.
+// Corrupt lines followed by intact ones are left alone (they are skipped when read), so only the end of the file is read,
+// which keeps this cheap enough to run on every startup.
+class TailCacheFileRecoverer : public CacheFileRecoverer {
+public:
+	TailCacheFileRecoverer(FileWriter& fileWriter) : _fileWriter(fileWriter) { }
+
+	uint64_t recoverFile(const string& filePath) override {
+		uint64_t cutLength = 0;
+		// any handle the writer keeps open would write past the new end of file
+		_fileWriter.closeFile(filePath);
+
+		withFileHandle(filePath, [this, &cutLength](HANDLE hFile) {
+			uint64_t fileSize = getFileSize(hFile);
+			bool terminateLastLine = false;
+			uint64_t intactEnd = findIntactEnd(hFile, fileSize, terminateLastLine);
+
+			if (terminateLastLine) {
+				appendLineBreak(hFile, intactEnd);
+			}
+			else if (intactEnd < fileSize) {
+				setFilePointer(hFile, intactEnd);
+				if (!SetEndOfFile(hFile)) throwError("SetEndOfFile");
+				cutLength = fileSize - intactEnd;
+			}
+		});
+
+		return cutLength;
+	}
+private:
+	static constexpr uint64_t INITIAL_TAIL_LENGTH = 65536;
+	FileWriter& _fileWriter;
+
+	// reads a growing tail of the file, until it holds an intact line (or the whole file)
+	uint64_t findIntactEnd(HANDLE hFile, uint64_t fileSize, bool& terminateLastLine) {
+		for (uint64_t tailLength = INITIAL_TAIL_LENGTH; ; tailLength *= 2) {
+			uint64_t start = fileSize > tailLength ? fileSize - tailLength : 0;
+			string tail = readRange(hFile, start, fileSize);
+			uint64_t intactEnd = 0;
+
+			if (findIntactEnd(tail, start == 0, intactEnd, terminateLastLine)) return start + intactEnd;
+		}
+	}
+
+	// scans the lines of 'tail' backwards; returns false if the scan reached the start of 'tail'
+	// without finding an intact line, and 'tail' does not start at the start of the file
+	static bool findIntactEnd(const string& tail, bool atFileStart, uint64_t& intactEnd, bool& terminateLastLine) {
+		size_t lineEnd = tail.length();
+		bool terminated = lineEnd > 0 && tail[lineEnd - 1] == '\n';
+		if (terminated) lineEnd--;
+
+		while (true) {
+			size_t lineBreak = lineEnd > 0 ? tail.rfind('\n', lineEnd - 1) : string::npos;
+			if (lineBreak == string::npos && !atFileStart) return false;
+			size_t lineStart = lineBreak != string::npos ? lineBreak + 1 : 0;
+
+			if (isIntact(tail.c_str() + lineStart, lineEnd - lineStart, terminated)) {
+				intactEnd = terminated ? lineEnd + 1 : lineEnd;
+				terminateLastLine = !terminated;
+				return true;
+			}
+
+			if (lineBreak == string::npos) {
+				intactEnd = 0;
+				terminateLastLine = false;
+				return true;
+			}
+
+			lineEnd = lineBreak;
+			terminated = true;
+		}
+	}
+
+	static bool isIntact(const char* line, size_t length, bool terminated) {
+		if (length > 0 && line[length - 1] == '\r') length--;
+		if (memchr(line, '\0', length) != nullptr) return false;
+
+		size_t payloadLength;
+		CacheRecordFramer::RecordState state = CacheRecordFramer::check(line, length, payloadLength);
+		// an unframed last line missing its line break can't be told apart from a torn record
+		return terminated ? state != CacheRecordFramer::Corrupt : state == CacheRecordFramer::Valid;
+	}
+
+	string readRange(HANDLE hFile, uint64_t startOffset, uint64_t endOffset) {
+		string buffer(static_cast<size_t>(endOffset - startOffset), '\0');
+		size_t readTotal = 0;
+		setFilePointer(hFile, startOffset);
+
+		while (readTotal < buffer.length()) {
+			DWORD readCount = 0;
+			DWORD toRead = static_cast<DWORD>(min<size_t>(buffer.length() - readTotal, MAXDWORD));
+			if (!ReadFile(hFile, &buffer[readTotal], toRead, &readCount, NULL)) throwError("ReadFile");
+			if (readCount == 0) break;
+			readTotal += readCount;
+		}
+
+		buffer.resize(readTotal);
+		return buffer;
+	}
+
+	void appendLineBreak(HANDLE hFile, uint64_t offset) {
+		DWORD writtenCount = 0;
+		setFilePointer(hFile, offset);
+		if (!WriteFile(hFile, "\n", 1, &writtenCount, NULL) || writtenCount != 1) throwError("WriteFile");
+	}
+
+	void setFilePointer(HANDLE hFile, uint64_t offset) {
+		LARGE_INTEGER distance;
+		distance.QuadPart = static_cast<LONGLONG>(offset);
+		if (!SetFilePointerEx(hFile, distance, NULL, FILE_BEGIN)) throwError("SetFilePointerEx");
+	}
+
+	uint64_t getFileSize(HANDLE hFile) {
+		LARGE_INTEGER fileSize;
+		return GetFileSizeEx(hFile, &fileSize) ? static_cast<uint64_t>(fileSize.QuadPart) : 0;
+	}
+
+	// a missing file has nothing to recover
+	void withFileHandle(const string& filePath, const function<void(HANDLE)>& action) {
+		HANDLE hFile = CreateFile(StrHelper::convertToW(filePath).c_str(), GENERIC_READ | GENERIC_WRITE,
+			FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+		if (hFile == INVALID_HANDLE_VALUE) {
+			DWORD errCode = GetLastError();
+			if (errCode == ERROR_FILE_NOT_FOUND) return;
+			throw runtime_error("Unable to open file \"" + filePath + "\" for recovery. ErrCode: " + to_string(errCode));
+		}
+
+		try {
+			action(hFile);
+			CloseHandle(hFile);
+		}
+		catch (const exception&) {
+			CloseHandle(hFile);
+			throw;
+		}
+	}
+
+	void throwError(const string& funcName) {
+		throw runtime_error("'" + funcName + "' failed while recovering cache file. ErrCode: " + to_string(GetLastError()));
+	}
+};
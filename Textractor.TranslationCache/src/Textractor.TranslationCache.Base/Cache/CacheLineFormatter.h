@@ -0,0 +1,88 @@
+
+#pragma once
+#include "../_Libraries/strhelper.h"
+#include "../TextFormatter.h"
+#include "../TextMapper.h"
+#include "CacheRecordFramer.h"
+#include <unordered_map>
+
+
+// Converts key/value pairs to and from the single-line UTF-8 format used by the cache file.
+// Lines that fail their record check (see CacheRecordFramer) are imported as an empty key/value pair.
+class CacheLineFormatter {
+public:
+	virtual ~CacheLineFormatter() { }
+	virtual string exportFormat(const wstring& key, const wstring& value) const = 0;
+	// the bytes that a line for 'key' starts with (the key and the delimiter)
+	virtual string exportKeyPrefix(const wstring& key) const = 0;
+	virtual vector<string> exportFormat(const unordered_map<wstring, wstring>& cache) const = 0;
+	virtual pair<wstring, wstring> importFormat(const string& line) const = 0;
+	// same as 'importFormat', but the key/value are left as UTF-8 (no conversion to UTF-16)
+	virtual pair<string, string> importFormatUtf8(const string& line) const = 0;
+};
+
+
+class DefaultCacheLineFormatter : public CacheLineFormatter {
+public:
+	DefaultCacheLineFormatter(const TextFormatter& formatter, const TextMapper& textMapper)
+		: _formatter(formatter), _textMapper(textMapper) { }
+
+	string exportFormat(const wstring& key, const wstring& value) const override {
+		wstring fullText = _textMapper.merge(_formatter.format(key), value);
+		return CacheRecordFramer::frame(exportFormat(fullText));
+	}
+
+	string exportKeyPrefix(const wstring& key) const override {
+		return exportFormat(_textMapper.merge(_formatter.format(key), L""));
+	}
+
+	vector<string> exportFormat(const unordered_map<wstring, wstring>& cache) const override {
+		vector<string> lines{};
+
+		for (const auto& item : cache) {
+			lines.push_back(exportFormat(item.first, item.second));
+		}
+
+		return lines;
+	}
+
+	pair<wstring, wstring> importFormat(const string& line) const override {
+		size_t payloadLength;
+		if (CacheRecordFramer::check(line, payloadLength) == CacheRecordFramer::Corrupt) return pair<wstring, wstring>();
+
+		wstring wText = importFormat(StrHelper::convertToW(line.substr(0, payloadLength)));
+		return _textMapper.split(wText);
+	}
+
+	pair<string, string> importFormatUtf8(const string& line) const override {
+		size_t payloadLength;
+		if (CacheRecordFramer::check(line, payloadLength) == CacheRecordFramer::Corrupt) return pair<string, string>();
+		string text = line.substr(0, payloadLength);
+
+		// the escape sequences are plain ASCII, so they can be replaced on the UTF-8 bytes
+		return _textMapper.splitUtf8(StrHelper::replace<char>(text, _utf8Unescapes));
+	}
+private:
+	const TextFormatter& _formatter;
+	const TextMapper& _textMapper;
+	const StrReplaceSet<wchar_t> _escapes = StrReplaceSet<wchar_t>({
+		pair<wstring, wstring>(L"\r", L"\\r"),
+		pair<wstring, wstring>(L"\n", L"\\n"),
+	});
+	const StrReplaceSet<wchar_t> _unescapes = StrReplaceSet<wchar_t>({
+		pair<wstring, wstring>(L"\\r", L"\r"),
+		pair<wstring, wstring>(L"\\n", L"\n"),
+	});
+	const StrReplaceSet<char> _utf8Unescapes = StrReplaceSet<char>({
+		pair<string, string>("\\r", "\r"),
+		pair<string, string>("\\n", "\n"),
+	});
+
+	wstring importFormat(const wstring& text) const {
+		return StrHelper::replace<wchar_t>(text, _unescapes);
+	}
+
+	string exportFormat(const wstring& text) const {
+		return StrHelper::convertFromW(StrHelper::replace<wchar_t>(text, _escapes));
+	}
+};
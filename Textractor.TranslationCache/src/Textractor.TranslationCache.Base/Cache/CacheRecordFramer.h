@@ -0,0 +1,62 @@
+
+#pragma once
+#include "../_Libraries/crc32c.h"
+#include <cstdio>
+#include <string>
+using namespace std;
+
+
+// Cache lines are written as records framed with a trailer holding the length and CRC-32C of the rest of the line:
+// "<payload>\t#<length: 8 hex digits><crc: 8 hex digits>"
+// so that a line left torn/garbled by a crash in the middle of an append can be told apart from a valid one.
+// Lines without a trailer (written by older versions, or edited by hand) are accepted as they are, unverified.
+class CacheRecordFramer {
+public:
+	enum RecordState { Unframed = 0, Valid, Corrupt };
+
+	static string frame(const string& payload) {
+		char trailer[TRAILER_LENGTH + 1];
+		snprintf(trailer, sizeof(trailer), "\t#%08x%08x",
+			static_cast<uint32_t>(payload.length()), Crc32c::compute(payload));
+
+		return payload + trailer;
+	}
+
+	// 'payloadLength' is set to the length of the line without its trailer (the whole line, if it has no trailer)
+	static RecordState check(const char* line, size_t lineLength, size_t& payloadLength) {
+		payloadLength = lineLength;
+		if (lineLength < TRAILER_LENGTH) return RecordState::Unframed;
+
+		const char* trailer = line + lineLength - TRAILER_LENGTH;
+		uint32_t length = 0, crc = 0;
+		if (trailer[0] != '\t' || trailer[1] != '#') return RecordState::Unframed;
+		if (!parseHex(trailer + 2, length) || !parseHex(trailer + 10, crc)) return RecordState::Unframed;
+
+		payloadLength = lineLength - TRAILER_LENGTH;
+		if (length != payloadLength) return RecordState::Corrupt;
+		return Crc32c::compute(line, payloadLength) == crc ? RecordState::Valid : RecordState::Corrupt;
+	}
+
+	static RecordState check(const string& line, size_t& payloadLength) {
+		return check(line.c_str(), line.length(), payloadLength);
+	}
+private:
+	static constexpr size_t TRAILER_LENGTH = 18;
+
+	static bool parseHex(const char* digits, uint32_t& value) {
+		value = 0;
+
+		for (int i = 0; i < 8; i++) {
+			char ch = digits[i];
+			uint32_t digit;
+
+			if (ch >= '0' && ch <= '9') digit = ch - '0';
+			else if (ch >= 'a' && ch <= 'f') digit = ch - 'a' + 10;
+			else return false;
+
+			value = (value << 4) | digit;
+		}
+
+		return true;
+	}
+};
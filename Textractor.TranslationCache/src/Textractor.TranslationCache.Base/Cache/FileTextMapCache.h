@@ -2,51 +2,74 @@
 #pragma once
 #include "../_Libraries/Locker.h"
 #include "TextMapCache.h"
+#include "CacheFileLoader.h"
+#include "CacheLineFormatter.h"
 #include "../File/FileDeleter.h"
+#include "../File/FileInspector.h"
 #include "../File/FileReader.h"
+#include "../File/FileRenamer.h"
 #include "../File/Writer/FileWriter.h"
-
-
+#include <atomic>
+#include <thread>
+#include <unordered_set>
+
+
+// Append-only log of cache lines; the last line for a key wins.
+// Removals append a tombstone line (the key with an empty value) rather than rewriting the file.
+// Once tombstones make up a large enough share of the lines, the file is compacted on a background thread:
+// live lines are written to a new file, which then atomically replaces the cache file.
+// Reads and writes keep using the current file while compaction runs.
+// Writes may be buffered by the file writer, so it is flushed before the file is read.
+// Lookups scan the file from its end, stopping at the newest line of the key.
 class FileTextMapCache : public TextMapCache {
 public:
 	FileTextMapCache(FileWriter& fileWriter, FileReader& fileReader, FileDeleter& fileDeleter, 
-		const TextFormatter& formatter, const TextMapper& textMapper, const function<string()>& cacheFilePathGetter)
-		: _fileWriter(fileWriter), _fileReader(fileReader), _fileDeleter(fileDeleter), _formatter(formatter),
-			_textMapper(textMapper), _cacheFilePathGetter(cacheFilePathGetter) { }
+		FileRenamer& fileRenamer, const FileInspector& fileInspector, const TextFormatter& formatter,
+		const TextMapper& textMapper, const function<string()>& cacheFilePathGetter, double compactionRatio = 0.25)
+		: _fileWriter(fileWriter), _fileReader(fileReader), _fileDeleter(fileDeleter), _fileRenamer(fileRenamer),
+			_fileInspector(fileInspector), _formatter(formatter), _lineFormatter(formatter, textMapper),
+			_fileLoader(fileReader, fileInspector, _lineFormatter), _cacheFilePathGetter(cacheFilePathGetter),
+			_compactionRatio(compactionRatio) { }
 	FileTextMapCache(FileWriter& fileWriter, FileReader& fileReader, FileDeleter& fileDeleter,
-		const TextFormatter& formatter, const TextMapper& textMapper, const string& cacheFilePath)
-		: FileTextMapCache(fileWriter, fileReader, fileDeleter, formatter, textMapper, 
-			[cacheFilePath]() { return cacheFilePath; }) { }
+		FileRenamer& fileRenamer, const FileInspector& fileInspector, const TextFormatter& formatter,
+		const TextMapper& textMapper, const string& cacheFilePath, double compactionRatio = 0.25)
+		: FileTextMapCache(fileWriter, fileReader, fileDeleter, fileRenamer, fileInspector, formatter, textMapper, 
+			[cacheFilePath]() { return cacheFilePath; }, compactionRatio) { }
+
+	~FileTextMapCache() {
+		joinCompactionThread();
+	}
 
 	bool keyExists(const wstring& key) const override {
 		return !readFromCache(key).empty();
 	}
 
 	wstring readFromCache(const wstring& key) const override {
-		wstring formattedKey = _formatter.format(key);
+		string formattedKey = StrHelper::convertFromW(_formatter.format(key));
 		string filePath = _cacheFilePathGetter();
-		pair<wstring, wstring> textPair;
+		string value = "";
 		_writeLocker.waitForUnlock();
+		_fileWriter.flushFile(filePath);
 
-		string line = _fileReader.readLine(filePath, [this, &formattedKey, &textPair](const string& line) {
-			textPair = importFormatToPair(line);
-			return textPair.first == formattedKey;
+		// later lines (including tombstones) override earlier ones, so the first match from the end is the live one.
+		// Keys are compared as UTF-8, so only the value that is returned gets converted.
+		_fileReader.readLineReversed(filePath, [this, &formattedKey, &value](const string& line) {
+			pair<string, string> textPair = importFormatToUtf8Pair(line);
+			if (textPair.first != formattedKey) return false;
+
+			value = move(textPair.second);
+			return true;
 		});
 
-		return !line.empty() ? textPair.second : L"";
+		return StrHelper::convertToW(value);
 	}
 
 	unordered_map<wstring, wstring> readAllFromCache() const override {
 		string filePath = _cacheFilePathGetter();
-		unordered_map<wstring, wstring> cache{};
 		_writeLocker.waitForUnlock();
+		_fileWriter.flushFile(filePath);
 
-		_fileReader.readLines(filePath, [this, &cache](const string& line) {
-			pair<wstring, wstring> textPair = importFormatToPair(line);
-			cache[textPair.first] = textPair.second;
-		});
-
-		return cache;
+		return _fileLoader.loadFile(filePath);
 	}
 
 	void writeToCache(const wstring& key, const wstring& value) override {
@@ -55,6 +78,7 @@ public:
 
 		_writeLocker.lock([this, &filePath, &output]() {
 			appendToFile(filePath, output);
+			trackAppendedLines(filePath, 1, 0);
 		});
 	}
 
@@ -63,8 +87,14 @@ public:
 		vector<string> lines = exportFormat(cache);
 
 		_writeLocker.lock([this, &filePath, &lines, reload]() {
-			if (reload) writeToFile(filePath, lines);
-			else appendToFile(filePath, lines);
+			if (reload) {
+				writeToFile(filePath, lines);
+				resetLogStats(filePath, lines.size(), 0);
+			}
+			else {
+				appendToFile(filePath, lines);
+				trackAppendedLines(filePath, lines.size(), 0);
+			}
 		});
 	}
 
@@ -72,90 +102,219 @@ public:
 		string filePath = _cacheFilePathGetter();
 		wstring formattedKey = _formatter.format(key);
 
-		_writeLocker.lock([this, &filePath, &formattedKey]() {
-			deleteFile(filePath);
+		string tombstone = exportFormat(formattedKey, L"");
 
-			_fileReader.readLines(filePath, [this, &filePath, &formattedKey](const string& line) {
-				pair<wstring, wstring> textPair = importFormatToPair(line);
-				if (formattedKey == textPair.first) return;
-				appendToFile(filePath, line);
-			});
+		bool compact = _writeLocker.lockB([this, &filePath, &tombstone]() {
+			loadLogStats(filePath);
+			appendToFile(filePath, tombstone);
+			trackAppendedLines(filePath, 1, 1);
+			return compactionNeeded();
+		});
+
+		if (compact) startCompaction(filePath);
+	}
+
+	// waits for a running compaction, and keeps new ones from starting (ex: before the cache file is truncated)
+	void stopCompaction() {
+		_compactionLocker.lock([this]() {
+			_compactionStopped = true;
+			joinCompactionThread();
 		});
 	}
 
 	void clearCache() override {
 		string cacheFilePath = _cacheFilePathGetter();
+		joinCompactionThread();
 
 		_writeLocker.lock([this, &cacheFilePath]() {
+			_fileWriter.closeFile(cacheFilePath);
 			deleteFile(cacheFilePath);
+			resetLogStats(cacheFilePath, 0, 0);
 		});
 	}
 private:
+	struct LogStats {
+		string filePath;
+		bool loaded = false;
+		size_t lineCount = 0;
+		size_t tombstoneCount = 0;
+	};
+
+	const size_t _minCompactionTombstones = 16;
 	const function<string()> _cacheFilePathGetter;
 	FileWriter& _fileWriter;
 	FileReader& _fileReader;
 	FileDeleter& _fileDeleter;
+	FileRenamer& _fileRenamer;
+	const FileInspector& _fileInspector;
 	const TextFormatter& _formatter;
-	const TextMapper& _textMapper;
+	const DefaultCacheLineFormatter _lineFormatter;
+	const ParallelCacheFileLoader _fileLoader;
+	const double _compactionRatio;
 	mutable BasicLocker _writeLocker;
-	const vector<pair<wstring, wstring>> _charMappings = {
-		pair<wstring, wstring>(L"\r", L"\\r"),
-		pair<wstring, wstring>(L"\n", L"\\n"),
-	};
+	LogStats _logStats;
+	BasicLocker _compactionLocker;
+	thread _compactionThread;
+	atomic<bool> _compacting{ false };
+	bool _compactionStopped = false;
 
-	void writeToFile(const string& filePath, const vector<string>& lines) {
-		_fileWriter.writeToFile(filePath, lines);
+
+	// *** TOMBSTONE TRACKING
+
+	void loadLogStats(const string& filePath) {
+		if (_logStats.loaded && _logStats.filePath == filePath) return;
+		size_t lineCount = 0, tombstoneCount = 0;
+		_fileWriter.flushFile(filePath);
+
+		_fileReader.readLines(filePath, [this, &lineCount, &tombstoneCount](const string& line) {
+			lineCount++;
+			if (importFormatToUtf8Pair(line).second.empty()) tombstoneCount++;
+		});
+
+		resetLogStats(filePath, lineCount, tombstoneCount);
 	}
 
-	void appendToFile(const string& filePath, const string& text) {
-		_fileWriter.appendToFile(filePath, text);
+	void resetLogStats(const string& filePath, size_t lineCount, size_t tombstoneCount) {
+		_logStats.filePath = filePath;
+		_logStats.loaded = true;
+		_logStats.lineCount = lineCount;
+		_logStats.tombstoneCount = tombstoneCount;
 	}
 
-	void appendToFile(const string& filePath, const vector<string>& lines) {
-		_fileWriter.appendToFile(filePath, lines);
+	void trackAppendedLines(const string& filePath, size_t lineCount, size_t tombstoneCount) {
+		// stats are only kept for the last file a removal was made in; other files get scanned on their first removal
+		if (!_logStats.loaded || _logStats.filePath != filePath) return;
+		_logStats.lineCount += lineCount;
+		_logStats.tombstoneCount += tombstoneCount;
 	}
 
-	void deleteFile(const string& filePath) {
-		_fileDeleter.deleteFile(filePath);
+	bool compactionNeeded() const {
+		if (_compacting || _logStats.tombstoneCount < _minCompactionTombstones) return false;
+		return _logStats.tombstoneCount >= _logStats.lineCount * _compactionRatio;
 	}
 
-	pair<wstring, wstring> importFormatToPair(string text) const {
-		return importFormatToPair(StrHelper::convertToW(text));
+
+	// *** COMPACTION
+
+	void startCompaction(const string& filePath) {
+		_compactionLocker.tryLock([this, &filePath]() {
+			if (_compacting || _compactionStopped) return;
+			joinCompactionThread();
+			_compacting = true;
+
+			_compactionThread = thread([this, filePath]() {
+				compactFile(filePath);
+				_compacting = false;
+			});
+		});
 	}
 
-	pair<wstring, wstring> importFormatToPair(wstring text) const {
-		wstring wText = importFormat(text);
-		return _textMapper.split(wText);
+	void joinCompactionThread() {
+		if (_compactionThread.joinable()) _compactionThread.join();
 	}
 
-	wstring importFormat(wstring text) const {
-		for (const pair<wstring, wstring>& mapping : _charMappings) {
-			text = StrHelper::replace<wchar_t>(text, mapping.second, mapping.first);
-		}
+	void compactFile(const string& filePath) {
+		string tempFilePath = filePath + ".compact.tmp";
+
+		try {
+			// lines appended up to this point are compacted without holding the write lock
+			uint64_t endOffset = 0;
+			_writeLocker.lock([this, &filePath, &endOffset]() {
+				_fileWriter.flushFile(filePath);
+				endOffset = _fileInspector.getFileSize(filePath);
+			});
 
-		return text;
+			size_t liveLineCount = 0;
+			uint64_t compactedSize = writeLiveLines(filePath, tempFilePath, endOffset, liveLineCount);
+
+			_writeLocker.lock([this, &filePath, &tempFilePath, compactedSize, liveLineCount]() {
+				swapCompactedFile(filePath, tempFilePath, compactedSize, liveLineCount);
+			});
+		}
+		catch (const exception&) {
+			// compaction is an optimization only; the uncompacted log remains valid as is
+			_fileDeleter.deleteFile(tempFilePath);
+		}
 	}
 
-	vector<string> exportFormat(const unordered_map<wstring, wstring> cache) const {
+	// returns the offset right after the last line that was compacted
+	uint64_t writeLiveLines(const string& filePath, const string& tempFilePath, uint64_t endOffset, size_t& liveLineCount) {
 		vector<string> lines{};
+		unordered_map<string, size_t> keyIndexes{};
+
+		uint64_t compactedSize = _fileReader.readLines(filePath, 0, endOffset,
+			[this, &lines, &keyIndexes](const string& line) {
+				pair<string, string> textPair = importFormatToUtf8Pair(line);
+				auto it = keyIndexes.find(textPair.first);
+
+				// blank out superseded lines rather than erasing them, to keep the original line order
+				if (it != keyIndexes.end()) lines[it->second].clear();
+				if (textPair.second.empty()) {
+					keyIndexes.erase(textPair.first);
+					return;
+				}
+
+				keyIndexes[textPair.first] = lines.size();
+				lines.push_back(line);
+			});
+
+		vector<string> liveLines{};
+		liveLines.reserve(keyIndexes.size());
+		for (string& line : lines) if (!line.empty()) liveLines.push_back(move(line));
 
-		for (const auto& item : cache) {
-			lines.push_back(exportFormat(item.first, item.second));
+		_fileWriter.writeToFile(tempFilePath, liveLines);
+		_fileWriter.closeFile(tempFilePath);
+		liveLineCount = liveLines.size();
+		return compactedSize;
+	}
+
+	// carries over lines appended while compacting, then replaces the cache file with the compacted one
+	void swapCompactedFile(const string& filePath, const string& tempFilePath, uint64_t compactedSize, size_t liveLineCount) {
+		vector<string> tailLines{};
+		size_t tailTombstoneCount = 0;
+		_fileWriter.flushFile(filePath);
+
+		_fileReader.readLines(filePath, compactedSize, _fileInspector.getFileSize(filePath),
+			[this, &tailLines, &tailTombstoneCount](const string& line) {
+				if (importFormatToUtf8Pair(line).second.empty()) tailTombstoneCount++;
+				tailLines.push_back(line);
+			});
+
+		if (!tailLines.empty()) {
+			_fileWriter.appendToFile(tempFilePath, tailLines);
+			_fileWriter.closeFile(tempFilePath);
 		}
 
-		return lines;
+		_fileWriter.closeFile(filePath);
+		_fileRenamer.renameFile(tempFilePath, filePath);
+		resetLogStats(filePath, liveLineCount + tailLines.size(), tailTombstoneCount);
 	}
 
-	string exportFormat(const wstring& key, const wstring& value) const {
-		wstring fullText = _textMapper.merge(_formatter.format(key), value);
-		return exportFormat(fullText);
+	void writeToFile(const string& filePath, const vector<string>& lines) {
+		_fileWriter.writeToFile(filePath, lines);
 	}
 
-	string exportFormat(wstring text) const {
-		for (const pair<wstring, wstring>& mapping : _charMappings) {
-			text = StrHelper::replace<wchar_t>(text, mapping.first, mapping.second);
-		}
+	void appendToFile(const string& filePath, const string& text) {
+		_fileWriter.appendToFile(filePath, text);
+	}
 
-		return StrHelper::convertFromW(text);
+	void appendToFile(const string& filePath, const vector<string>& lines) {
+		_fileWriter.appendToFile(filePath, lines);
+	}
+
+	void deleteFile(const string& filePath) {
+		_fileDeleter.deleteFile(filePath);
+	}
+
+	pair<string, string> importFormatToUtf8Pair(const string& line) const {
+		return _lineFormatter.importFormatUtf8(line);
+	}
+
+	vector<string> exportFormat(const unordered_map<wstring, wstring>& cache) const {
+		return _lineFormatter.exportFormat(cache);
+	}
+
+	string exportFormat(const wstring& key, const wstring& value) const {
+		return _lineFormatter.exportFormat(key, value);
 	}
 };
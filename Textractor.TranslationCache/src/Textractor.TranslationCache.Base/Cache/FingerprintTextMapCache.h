@@ -0,0 +1,161 @@
+
+#pragma once
+#include "../_Libraries/Locker.h"
+#include "TextMapCache.h"
+#include <atomic>
+#include <thread>
+#include <unordered_set>
+
+
+// Tags every value with the fingerprint of the translation pipeline that produced it (see 'PipelineFingerprint' config),
+// so that changing the pipeline (ex: model, prompt) doesn't require deleting the cache to stop serving old translations.
+// Values are stored in 'mainCache' as "<value>\x1F<fingerprint>"; an empty fingerprint stores values as they are,
+// so values written before a fingerprint was configured count as having an empty fingerprint.
+// Lookups only return values with the current fingerprint, unless fallback is enabled, in which case a value with
+// another fingerprint is returned as well. A new translation for a key replaces its mismatched value.
+class FingerprintTextMapCache : public TextMapCache {
+public:
+	FingerprintTextMapCache(TextMapCache& mainCache, const TextFormatter& formatter,
+		const function<wstring()>& fingerprintGetter, const function<bool()>& fallbackGetter)
+		: _mainCache(mainCache), _formatter(formatter), _fingerprintGetter(fingerprintGetter),
+			_fallbackGetter(fallbackGetter) { }
+
+	~FingerprintTextMapCache() {
+		stopPurge();
+	}
+
+	bool keyExists(const wstring& key) const override {
+		return !readFromCache(key).empty();
+	}
+
+	wstring readFromCache(const wstring& key) const override {
+		return matchValue(_mainCache.readFromCache(key), getFingerprint(), _fallbackGetter());
+	}
+
+	unordered_map<wstring, wstring> readAllFromCache() const override {
+		unordered_map<wstring, wstring> cache = _mainCache.readAllFromCache();
+		wstring fingerprint = getFingerprint();
+		bool fallback = _fallbackGetter();
+
+		for (auto it = cache.begin(); it != cache.end();) {
+			it->second = matchValue(it->second, fingerprint, fallback);
+			if (it->second.empty()) it = cache.erase(it);
+			else it++;
+		}
+
+		return cache;
+	}
+
+	void writeToCache(const wstring& key, const wstring& value) override {
+		wstring taggedValue = tagValue(value, getFingerprint());
+
+		_locker.lock([this, &key, &taggedValue]() {
+			_mainCache.writeToCache(key, taggedValue);
+			if (_purging) _keysWrittenDuringPurge.insert(_formatter.format(key));
+		});
+	}
+
+	void writeAllToCache(const unordered_map<wstring, wstring> cache, bool reload = false) override {
+		unordered_map<wstring, wstring> taggedCache{};
+		wstring fingerprint = getFingerprint();
+		for (const auto& textPair : cache) taggedCache[textPair.first] = tagValue(textPair.second, fingerprint);
+
+		_locker.lock([this, &taggedCache, reload]() {
+			_mainCache.writeAllToCache(taggedCache, reload);
+			if (!_purging) return;
+
+			for (const auto& textPair : taggedCache) _keysWrittenDuringPurge.insert(_formatter.format(textPair.first));
+		});
+	}
+
+	void removeFromCache(const wstring& key) override {
+		_mainCache.removeFromCache(key);
+	}
+
+	void clearCache() override {
+		_mainCache.clearCache();
+	}
+
+	// Removes the values with another fingerprint from 'mainCache' on a background thread
+	// (for a file cache, this leaves removal tombstones, which eventually get compacted away).
+	// Does nothing if fallback is enabled, since mismatched values are still in use then.
+	void startPurge() {
+		if (_fallbackGetter() || _purgeThread.joinable()) return;
+
+		_stopPurge = false;
+		_locker.lock([this]() {
+			_purging = true;
+			_keysWrittenDuringPurge.clear();
+		});
+
+		_purgeThread = thread([this]() {
+			purgeMismatched();
+		});
+	}
+
+	// stops a running purge, and waits for it to end
+	void stopPurge() {
+		_stopPurge = true;
+		if (_purgeThread.joinable()) _purgeThread.join();
+	}
+private:
+	const wchar_t FINGERPRINT_SEPARATOR = L'\x1F';
+	TextMapCache& _mainCache;
+	const TextFormatter& _formatter;
+	const function<wstring()> _fingerprintGetter;
+	const function<bool()> _fallbackGetter;
+	BasicLocker _locker;
+	bool _purging = false;
+	unordered_set<wstring> _keysWrittenDuringPurge{};
+	atomic<bool> _stopPurge{ false };
+	thread _purgeThread;
+
+	wstring getFingerprint() const {
+		return _formatter.format(_fingerprintGetter());
+	}
+
+	// empty values mean 'no value' to every cache, so they are never tagged
+	wstring tagValue(const wstring& value, const wstring& fingerprint) const {
+		wstring formattedValue = _formatter.format(value);
+		if (formattedValue.empty() || fingerprint.empty()) return formattedValue;
+		return formattedValue + FINGERPRINT_SEPARATOR + fingerprint;
+	}
+
+	pair<wstring, wstring> untagValue(const wstring& taggedValue) const {
+		size_t separatorIndex = taggedValue.rfind(FINGERPRINT_SEPARATOR);
+		if (separatorIndex == wstring::npos) return pair<wstring, wstring>(taggedValue, L"");
+		return pair<wstring, wstring>(taggedValue.substr(0, separatorIndex), taggedValue.substr(separatorIndex + 1));
+	}
+
+	wstring matchValue(const wstring& taggedValue, const wstring& fingerprint, bool fallback) const {
+		pair<wstring, wstring> valuePair = untagValue(taggedValue);
+		return fallback || valuePair.second == fingerprint ? valuePair.first : L"";
+	}
+
+	// keys written since the purge started already hold a value with the current fingerprint, so they are skipped
+	void purgeMismatched() {
+		try {
+			unordered_map<wstring, wstring> cache = _mainCache.readAllFromCache();
+			wstring fingerprint = getFingerprint();
+
+			for (const auto& textPair : cache) {
+				if (_stopPurge) break;
+				if (untagValue(textPair.second).second == fingerprint) continue;
+
+				_locker.lock([this, &textPair]() {
+					if (_keysWrittenDuringPurge.find(textPair.first) == _keysWrittenDuringPurge.end()) {
+						_mainCache.removeFromCache(textPair.first);
+					}
+				});
+			}
+		}
+		catch (const exception&) {
+			// purging is an optimization only; mismatched values are never served either way
+		}
+
+		_locker.lock([this]() {
+			_purging = false;
+			_keysWrittenDuringPurge.clear();
+		});
+	}
+};
@@ -0,0 +1,434 @@
+
+#pragma once
+#include "../_Libraries/Locker.h"
+#include "../_Libraries/hashhelper.h"
+#include "TextMapCache.h"
+#include "CacheLineFormatter.h"
+#include "../File/FileDeleter.h"
+#include "../File/FileInspector.h"
+#include "../File/FileMapper.h"
+#include "../File/FileRenamer.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <unordered_set>
+
+
+// Read-only cache over a cache file, meant for the Read module.
+// The cache file is compiled into a binary sidecar ("<cacheFilePath>.snap" or ".2.snap"), holding the raw cache lines
+// plus a table of (key hash -> line offset) sorted by hash. The sidecar is memory-mapped, and lookups binary search
+// the table and compare key bytes in place, so nothing is copied/converted out of the mapping until a value is returned.
+// Keys are compared in their formatted form (ex: trimmed), like the other caches: a line whose key isn't already
+// formatted (ex: edited by hand) gets its formatted key stored next to it when compiled.
+// The sidecar is reused across startups for as long as the cache file is only appended to, with the lines appended
+// since it was compiled merged into the overlay; it is recompiled once they grow past a quarter of it (and 1 MB),
+// or if the cache file was rewritten (ex: truncated).
+// The sidecar is compiled under whichever of the two names isn't currently mapped, since a mapped file can't be
+// replaced; the other one is deleted once the new one is swapped in.
+// Writes and removals made after loading are kept in an in-memory overlay on top of the snapshot.
+// Lines appended to the cache file after loading can be merged into the overlay via 'syncWithSource',
+// which remembers the last byte offset consumed from the cache file.
+class MappedSnapshotTextMapCache : public TextMapCache {
+public:
+	enum SourceChange { Unchanged = 0, Appended, Rewritten };
+
+	MappedSnapshotTextMapCache(FileMapper& fileMapper, FileRenamer& fileRenamer, FileDeleter& fileDeleter,
+		const FileInspector& fileInspector, const TextFormatter& formatter, const TextMapper& textMapper) 
+		: _fileMapper(fileMapper), _fileRenamer(fileRenamer), _fileDeleter(fileDeleter), _fileInspector(fileInspector), 
+			_formatter(formatter), _lineFormatter(formatter, textMapper), _delimBytes(_lineFormatter.exportKeyPrefix(L"")) { }
+
+	// Maps the snapshot sidecar (compiling it first if it is missing or out of date), resets the overlay,
+	// and merges the lines appended since the sidecar was compiled into it.
+	// Everything up to the swap happens outside of the lock, so lookups keep being served by the current snapshot
+	// until the new one is swapped in, and the current snapshot is kept if anything fails.
+	void loadSnapshot(const string& cacheFilePath) {
+		string mappedFilePath = _locker.lock([this]() { return _snapshot != nullptr ? _snapshot->filePath : string(); });
+		unique_ptr<Snapshot> snapshot = mapNewestSnapshot(cacheFilePath);
+
+		if (snapshot == nullptr || isTooFarBehind(cacheFilePath, *snapshot)) {
+			string snapshotFilePath = getSnapshotFilePath(cacheFilePath, mappedFilePath == getSnapshotFilePath(cacheFilePath, 0));
+			string tempFilePath = getTempSnapshotFilePath(cacheFilePath);
+			snapshot = nullptr;
+
+			if (compileSnapshot(cacheFilePath, tempFilePath)) {
+				_fileRenamer.renameFile(tempFilePath, snapshotFilePath);
+				snapshot = mapSnapshot(cacheFilePath, snapshotFilePath);
+			}
+		}
+
+		string staleFilePath = snapshot != nullptr 
+			? getSnapshotFilePath(cacheFilePath, snapshot->filePath == getSnapshotFilePath(cacheFilePath, 0)) : "";
+
+		_locker.lock([this, &cacheFilePath, &snapshot]() {
+			swapSnapshot(cacheFilePath, move(snapshot));
+			syncWithSourceBase(nullptr);
+		});
+
+		// left alone if still mapped elsewhere (ex: by another instance)
+		if (!staleFilePath.empty()) _fileDeleter.deleteFile(staleFilePath);
+	}
+
+	// Merges any lines appended to the cache file since the last load/sync into the overlay,
+	// calling 'mergedKeyAction' (if any) with the key of each merged line.
+	// Returns 'Rewritten' if the cache file was truncated or rewritten, in which case a full reload is needed.
+	SourceChange syncWithSource(const function<void(const wstring& key)>& mergedKeyAction = nullptr) {
+		return static_cast<SourceChange>(_locker.lockI([this, &mergedKeyAction]() {
+			return syncWithSourceBase(mergedKeyAction);
+		}));
+	}
+
+	bool keyExists(const wstring& key) const override {
+		return !readFromCache(key).empty();
+	}
+
+	wstring readFromCache(const wstring& key) const override {
+		wstring formattedKey = _formatter.format(key);
+
+		return _locker.lockWS([this, &formattedKey]() {
+			return readFromCacheBase(formattedKey);
+		});
+	}
+
+	unordered_map<wstring, wstring> readAllFromCache() const override {
+		unordered_map<wstring, wstring> cache{};
+
+		_locker.lock([this, &cache]() {
+			if (_snapshot != nullptr) {
+				// entries of equal hash keep their file order, so later lines overwrite earlier ones
+				for (uint64_t i = 0; i < _snapshot->entryCount; i++) {
+					pair<wstring, wstring> textPair = importLine(_snapshot->entries[i]);
+					cache[textPair.first] = textPair.second;
+				}
+			}
+
+			for (const wstring& key : _removedKeys) cache.erase(key);
+			for (const auto& textPair : _overlay) cache[textPair.first] = textPair.second;
+		});
+
+		// empty values are removal tombstones
+		for (auto it = cache.begin(); it != cache.end();) {
+			if (it->second.empty()) it = cache.erase(it);
+			else it++;
+		}
+
+		return cache;
+	}
+
+	void writeToCache(const wstring& key, const wstring& value) override {
+		wstring formattedKey = _formatter.format(key);
+		wstring formattedValue = _formatter.format(value);
+
+		_locker.lock([this, &formattedKey, &formattedValue]() {
+			writeToOverlay(formattedKey, formattedValue);
+		});
+	}
+
+	void writeAllToCache(const unordered_map<wstring, wstring> cache, bool reload = false) override {
+		_locker.lock([this, &cache, reload]() {
+			if (reload) clearCacheBase();
+
+			for (const auto& textPair : cache) {
+				writeToOverlay(_formatter.format(textPair.first), _formatter.format(textPair.second));
+			}
+		});
+	}
+
+	void removeFromCache(const wstring& key) override {
+		wstring formattedKey = _formatter.format(key);
+
+		_locker.lock([this, &formattedKey]() {
+			_overlay.erase(formattedKey);
+			if (findEntry(formattedKey) != nullptr) _removedKeys.insert(formattedKey);
+		});
+	}
+
+	void clearCache() override {
+		_locker.lock([this]() {
+			clearCacheBase();
+		});
+	}
+private:
+	struct SnapshotHeader {
+		char magic[8];
+		uint64_t sourceSize;
+		uint64_t sourceTailHash;
+		uint64_t entryCount;
+		uint64_t tableOffset;
+	};
+
+	struct SnapshotEntry {
+		uint64_t keyHash;
+		uint64_t lineOffset;
+		// the key bytes to compare; the start of the line itself, unless the line's key isn't formatted
+		uint64_t keyOffset;
+		uint32_t lineLength;
+		uint32_t keyLength;
+	};
+
+	struct Snapshot {
+		string filePath;
+		shared_ptr<MappedFileView> view;
+		const SnapshotEntry* entries;
+		uint64_t entryCount;
+		uint64_t sourceSize;
+		uint64_t sourceTailHash;
+	};
+
+	const string _snapshotMagic = "TCSNAP02";
+	const uint64_t _minRecompileBytes = 1024 * 1024;
+	FileMapper& _fileMapper;
+	FileRenamer& _fileRenamer;
+	FileDeleter& _fileDeleter;
+	const FileInspector& _fileInspector;
+	const TextFormatter& _formatter;
+	const DefaultCacheLineFormatter _lineFormatter;
+	const string _delimBytes;
+	mutable BasicLocker _locker;
+	unique_ptr<Snapshot> _snapshot = nullptr;
+	unordered_map<wstring, wstring> _overlay{};
+	unordered_set<wstring> _removedKeys{};
+	string _sourceFilePath;
+	uint64_t _sourceSize = 0;
+	uint64_t _sourceTailHash = HashHelper::FNV_OFFSET_BASIS;
+
+	wstring readFromCacheBase(const wstring& formattedKey) const {
+		auto it = _overlay.find(formattedKey);
+		if (it != _overlay.end()) return it->second;
+		if (_removedKeys.find(formattedKey) != _removedKeys.end()) return L"";
+
+		const SnapshotEntry* entry = findEntry(formattedKey);
+		return entry != nullptr ? importLine(*entry).second : L"";
+	}
+
+	void writeToOverlay(const wstring& formattedKey, const wstring& formattedValue) {
+		_removedKeys.erase(formattedKey);
+		_overlay[formattedKey] = formattedValue;
+	}
+
+	void clearCacheBase() {
+		_snapshot = nullptr;
+		_overlay.clear();
+		_removedKeys.clear();
+	}
+
+	void swapSnapshot(const string& cacheFilePath, unique_ptr<Snapshot> snapshot) {
+		_snapshot = move(snapshot);
+		_overlay.clear();
+		_removedKeys.clear();
+
+		_sourceFilePath = cacheFilePath;
+		_sourceSize = _snapshot != nullptr ? _snapshot->sourceSize : 0;
+		_sourceTailHash = _snapshot != nullptr ? _snapshot->sourceTailHash : HashHelper::FNV_OFFSET_BASIS;
+	}
+
+
+	// *** SOURCE TAIL FOLLOWING
+
+	SourceChange syncWithSourceBase(const function<void(const wstring& key)>& mergedKeyAction) {
+		if (_sourceFilePath.empty()) return SourceChange::Unchanged;
+
+		uint64_t sourceSize = _fileInspector.getFileSize(_sourceFilePath);
+		if (sourceSize == _sourceSize) return SourceChange::Unchanged;
+		if (sourceSize < _sourceSize) return SourceChange::Rewritten;
+		if (_fileInspector.getTailHash(_sourceFilePath, _sourceSize) != _sourceTailHash) return SourceChange::Rewritten;
+
+		_sourceSize = readAppendedLines(_sourceFilePath, _sourceSize, mergedKeyAction);
+		_sourceTailHash = _fileInspector.getTailHash(_sourceFilePath, _sourceSize);
+		return SourceChange::Appended;
+	}
+
+	// returns the offset right after the last complete (newline-terminated) line
+	uint64_t readAppendedLines(const string& cacheFilePath, uint64_t startOffset,
+		const function<void(const wstring& key)>& mergedKeyAction)
+	{
+		ifstream f(cacheFilePath, ios_base::in | ios_base::binary);
+		if (!f.is_open()) return startOffset;
+		f.seekg(startOffset, ios_base::beg);
+
+		uint64_t offset = startOffset;
+		string line;
+
+		while (getline(f, line)) {
+			if (f.eof()) break; // partially written line; picked up on a later sync
+			offset += line.length() + 1;
+			if (!line.empty() && line.back() == '\r') line.pop_back();
+			if (line.find(_delimBytes) == string::npos) continue;
+
+			pair<wstring, wstring> textPair = _lineFormatter.importFormat(line);
+			writeToOverlay(textPair.first, textPair.second);
+			if (mergedKeyAction) mergedKeyAction(textPair.first);
+		}
+
+		return offset;
+	}
+
+
+	// *** SNAPSHOT LOOKUP
+
+	const SnapshotEntry* findEntry(const wstring& formattedKey) const {
+		if (_snapshot == nullptr) return nullptr;
+		string keyBytes = getKeyBytes(formattedKey);
+		uint64_t keyHash = HashHelper::fnv1a(keyBytes);
+
+		const SnapshotEntry* first = _snapshot->entries;
+		const SnapshotEntry* last = first + _snapshot->entryCount;
+		first = lower_bound(first, last, keyHash,
+			[](const SnapshotEntry& entry, uint64_t hash) { return entry.keyHash < hash; });
+		last = upper_bound(first, last, keyHash,
+			[](uint64_t hash, const SnapshotEntry& entry) { return hash < entry.keyHash; });
+
+		// search backwards, so the latest line for a key wins
+		while (last != first) {
+			--last;
+			if (keyMatches(*last, keyBytes)) return last;
+		}
+
+		return nullptr;
+	}
+
+	bool keyMatches(const SnapshotEntry& entry, const string& keyBytes) const {
+		if (entry.keyLength != keyBytes.length()) return false;
+		return memcmp(_snapshot->view->data() + entry.keyOffset, keyBytes.c_str(), keyBytes.length()) == 0;
+	}
+
+	// the key exactly as it appears at the start of a cache line
+	string getKeyBytes(const wstring& formattedKey) const {
+		string keyBytes = _lineFormatter.exportKeyPrefix(formattedKey);
+		keyBytes.erase(keyBytes.length() - _delimBytes.length());
+		return keyBytes;
+	}
+
+	pair<wstring, wstring> importLine(const SnapshotEntry& entry) const {
+		string line(getLineData(entry), entry.lineLength);
+		return _lineFormatter.importFormat(line);
+	}
+
+	const char* getLineData(const SnapshotEntry& entry) const {
+		return _snapshot->view->data() + entry.lineOffset;
+	}
+
+
+	// *** SNAPSHOT CREATION
+
+	// of the two sidecars, the one compiled from the most of the cache file
+	unique_ptr<Snapshot> mapNewestSnapshot(const string& cacheFilePath) const {
+		unique_ptr<Snapshot> snapshot = mapSnapshot(cacheFilePath, getSnapshotFilePath(cacheFilePath, 0));
+		unique_ptr<Snapshot> otherSnapshot = mapSnapshot(cacheFilePath, getSnapshotFilePath(cacheFilePath, 1));
+
+		if (snapshot == nullptr || (otherSnapshot != nullptr && otherSnapshot->sourceSize > snapshot->sourceSize))
+			return otherSnapshot;
+		return snapshot;
+	}
+
+	// the appended lines are held in the overlay (memory) until the sidecar is recompiled
+	bool isTooFarBehind(const string& cacheFilePath, const Snapshot& snapshot) const {
+		uint64_t appendedBytes = _fileInspector.getFileSize(cacheFilePath) - snapshot.sourceSize;
+		return appendedBytes > max<uint64_t>(_minRecompileBytes, snapshot.sourceSize / 4);
+	}
+
+	// returns nullptr if the sidecar does not exist, is invalid, or the cache file is no longer
+	// what it was compiled from followed by appended lines
+	unique_ptr<Snapshot> mapSnapshot(const string& cacheFilePath, const string& snapshotFilePath) const {
+		shared_ptr<MappedFileView> view = _fileMapper.mapFile(snapshotFilePath);
+		if (view == nullptr || view->size() < sizeof(SnapshotHeader)) return nullptr;
+
+		const SnapshotHeader* header = reinterpret_cast<const SnapshotHeader*>(view->data());
+		if (memcmp(header->magic, _snapshotMagic.c_str(), sizeof(header->magic)) != 0) return nullptr;
+		if (header->tableOffset + header->entryCount * sizeof(SnapshotEntry) > view->size()) return nullptr;
+		if (header->sourceSize > _fileInspector.getFileSize(cacheFilePath)) return nullptr;
+		if (header->sourceTailHash != _fileInspector.getTailHash(cacheFilePath, header->sourceSize)) return nullptr;
+
+		unique_ptr<Snapshot> snapshot = make_unique<Snapshot>();
+		snapshot->filePath = snapshotFilePath;
+		snapshot->view = view;
+		snapshot->entries = reinterpret_cast<const SnapshotEntry*>(view->data() + header->tableOffset);
+		snapshot->entryCount = header->entryCount;
+		snapshot->sourceSize = header->sourceSize;
+		snapshot->sourceTailHash = header->sourceTailHash;
+		return snapshot;
+	}
+
+	// layout: header | raw cache lines (each preceded by its formatted key, if that differs) | padding | entry table (sorted by key hash)
+	bool compileSnapshot(const string& cacheFilePath, const string& destFilePath) const {
+		ifstream src(cacheFilePath, ios_base::in | ios_base::binary);
+		if (!src.is_open()) return false;
+
+		ofstream dest(destFilePath, ios_base::out | ios_base::trunc | ios_base::binary);
+		if (!dest.is_open()) return false;
+
+		SnapshotHeader header{};
+		dest.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+		vector<SnapshotEntry> entries{};
+		uint64_t srcOffset = 0, destOffset = sizeof(header);
+		string line;
+
+		while (getline(src, line)) {
+			if (src.eof()) break; // partially written line
+			srcOffset += line.length() + 1;
+			if (!line.empty() && line.back() == '\r') line.pop_back();
+
+			size_t delimIndex = line.find(_delimBytes);
+			if (delimIndex == string::npos) continue;
+
+			string keyBytes;
+			uint64_t keyOffset = destOffset;
+
+			if (!getFormattedKeyBytes(line, delimIndex, keyBytes)) {
+				if (keyBytes.empty()) continue;
+
+				dest.write(keyBytes.c_str(), keyBytes.length());
+				destOffset += keyBytes.length();
+			}
+
+			uint64_t keyLength = keyBytes.empty() ? delimIndex : keyBytes.length();
+			uint64_t keyHash = keyBytes.empty() ? HashHelper::fnv1a(line.c_str(), delimIndex) : HashHelper::fnv1a(keyBytes);
+
+			entries.push_back(SnapshotEntry{ keyHash, destOffset, keyBytes.empty() ? destOffset : keyOffset,
+				static_cast<uint32_t>(line.length()), static_cast<uint32_t>(keyLength) });
+			dest.write(line.c_str(), line.length());
+			destOffset += line.length();
+		}
+
+		for (; destOffset % alignof(SnapshotEntry) != 0; destOffset++) dest.put('\0');
+		stable_sort(entries.begin(), entries.end(),
+			[](const SnapshotEntry& e1, const SnapshotEntry& e2) { return e1.keyHash < e2.keyHash; });
+		if (!entries.empty()) {
+			dest.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(SnapshotEntry));
+		}
+
+		memcpy(header.magic, _snapshotMagic.c_str(), sizeof(header.magic));
+		header.sourceSize = srcOffset;
+		header.sourceTailHash = _fileInspector.getTailHash(cacheFilePath, srcOffset);
+		header.entryCount = entries.size();
+		header.tableOffset = destOffset;
+		dest.seekp(0, ios_base::beg);
+		dest.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		dest.close();
+		return !dest.fail();
+	}
+
+	// Returns true if the line's key (its first 'delimIndex' bytes) is already formatted, as most are.
+	// Otherwise, 'keyBytes' is set to the key as a lookup of it would produce it (empty if the line has no valid key).
+	bool getFormattedKeyBytes(const string& line, size_t delimIndex, string& keyBytes) const {
+		// escape sequences and whitespace are the only things the formatting of a key could change (cheap check first)
+		string rawKey = line.substr(0, delimIndex);
+		bool plain = rawKey.find('\\') == string::npos && rawKey.find('\r') == string::npos;
+		if (plain && _formatter.formatUtf8(rawKey) == rawKey) return true;
+
+		wstring key = _lineFormatter.importFormat(line).first;
+		keyBytes = key.empty() ? "" : getKeyBytes(key);
+		if (keyBytes != rawKey) return false;
+
+		keyBytes.clear();
+		return true;
+	}
+
+	static string getSnapshotFilePath(const string& cacheFilePath, bool second) {
+		return cacheFilePath + (second ? ".2.snap" : ".snap");
+	}
+
+	static string getTempSnapshotFilePath(const string& cacheFilePath) {
+		return cacheFilePath + ".snap.tmp";
+	}
+};
@@ -12,32 +12,33 @@ public:
 
 	bool keyExists(const wstring& key) const override {
 		wstring formattedKey = _formatter.format(key);
-		_writeLocker.waitForUnlock();
-		return isInCache(formattedKey);
+		return _locker.lockShared([this, &formattedKey]() { return isInCache(formattedKey); });
 	}
 
 	wstring readFromCache(const wstring& key) const override {
 		wstring formattedKey = _formatter.format(key);
-		_writeLocker.waitForUnlock();
-		return isInCache(formattedKey) ? _cache.at(formattedKey) : L"";
+
+		return _locker.lockShared([this, &formattedKey]() {
+			auto it = _cache.find(formattedKey);
+			return it != _cache.end() ? it->second : L"";
+		});
 	}
 
 	unordered_map<wstring, wstring> readAllFromCache() const override {
-		_writeLocker.waitForUnlock();
-		return _cache;
+		return _locker.lockShared([this]() { return _cache; });
 	}
 
 	void writeToCache(const wstring& key, const wstring& value) override {
 		wstring formattedKey = _formatter.format(key);
 		wstring formattedValue = _formatter.format(value);
 
-		_writeLocker.lock([this, &formattedKey, formattedValue]() {
+		_locker.lock([this, &formattedKey, formattedValue]() {
 			writeToCacheBase(formattedKey, formattedValue);
 		});
 	}
 
 	void writeAllToCache(const unordered_map<wstring, wstring> cache, bool reload = false) override {
-		_writeLocker.lock([this, &cache, reload]() {
+		_locker.lock([this, &cache, reload]() {
 			if (reload) _cache.clear();
 
 			for (const auto& textPair : cache) {
@@ -49,20 +50,21 @@ public:
 	void removeFromCache(const wstring& key) override {
 		wstring formattedKey = _formatter.format(key);
 
-		_writeLocker.lock([this, &formattedKey]() {
+		_locker.lock([this, &formattedKey]() {
 			removeFromCacheBase(formattedKey);
 		});
 	}
 
 	void clearCache() override {
-		_writeLocker.lock([this]() {
+		_locker.lock([this]() {
 			_cache.clear();
 		});
 	}
 private:
 	const TextFormatter& _formatter;
 	unordered_map<wstring, wstring> _cache;
-	mutable BasicLocker _writeLocker;
+	// reads lock shared, writes exclusive
+	mutable SharedLocker _locker;
 
 	bool isInCache(const wstring& key) const {
 		return _cache.find(key) != _cache.end();
@@ -0,0 +1,249 @@
+
+#pragma once
+#include "../_Libraries/hashhelper.h"
+#include "../_Libraries/Locker.h"
+#include "BoundedMemoryTextMapCache.h"
+#include "CacheLineFormatter.h"
+#include "../File/FileInspector.h"
+#include "../File/FileReader.h"
+#include "../File/FileTruncater.h"
+#include <windows.h>
+
+
+// Trims a cache file down to its size limit, choosing which lines to keep by how recently their keys were used,
+// rather than purely by line order. Lines of recently used keys are kept first (most recent first),
+// then any remaining room is filled with the newest other lines. Kept lines retain their original order.
+// A line too large for the room left is skipped, and smaller lines after it may still be kept.
+// Lines superseded by a later line for the same key, as well as removal tombstones, are always dropped.
+// The file is streamed twice (once to pick the lines, once to move the kept ones up within the file, which is
+// then shortened), so only a key hash and a length per line are held in memory, not the lines themselves.
+// The file is rewritten in place rather than replaced, since the Write module keeps it open to append to it
+// (see 'StreamingFileTruncater'); a file in use without sharing writes is skipped, to be truncated next time.
+class RecencyCacheFileTruncater : public FileTruncater {
+public:
+	RecencyCacheFileTruncater(FileReader& fileReader, const FileInspector& fileInspector, 
+		const CacheLineFormatter& lineFormatter, const CacheRecencySource& recencySource, 
+		const function<uint64_t()>& sizeLimitBytesGetter) : _fileReader(fileReader), _fileInspector(fileInspector), 
+			_lineFormatter(lineFormatter), _recencySource(recencySource), _sizeLimitBytesGetter(sizeLimitBytesGetter) { }
+
+	void truncateFile(const string& filePath) override {
+		_lockerMap.getOrCreateLocker(filePath).lock([this, &filePath]() {
+			truncateFileBase(filePath);
+		});
+	}
+private:
+	// lines of keys sharing a hash are treated as lines of one key; the older of them is then dropped like a
+	// superseded line (only a cache miss, and unlikely with 64-bit hashes)
+	struct LineInfo {
+		uint64_t keyHash;
+		uint32_t length;
+	};
+
+	static const DWORD CHUNK_SIZE = 65536;
+	DefaultLockerMap<string> _lockerMap;
+	FileReader& _fileReader;
+	const FileInspector& _fileInspector;
+	const CacheLineFormatter& _lineFormatter;
+	const CacheRecencySource& _recencySource;
+	const function<uint64_t()> _sizeLimitBytesGetter;
+
+	void truncateFileBase(const string& filePath) {
+		uint64_t sizeLimitBytes = _sizeLimitBytesGetter();
+		uint64_t fileSize = _fileInspector.getFileSize(filePath);
+		if (fileSize < sizeLimitBytes) return;
+
+		vector<LineInfo> lines{};
+		unordered_map<uint64_t, size_t> lastLineIndexes{};
+		uint64_t endOffset = scanLines(filePath, fileSize, lines, lastLineIndexes);
+
+		vector<bool> keep = pickLines(lines, lastLineIndexes, sizeLimitBytes);
+		rewriteWithKeptLines(filePath, endOffset, keep);
+	}
+
+	// maps each key hash to the index of its last line (the one in effect), skipping keys whose last line is a tombstone;
+	// returns the offset right after the last line scanned
+	uint64_t scanLines(const string& filePath, uint64_t endOffset, 
+		vector<LineInfo>& lines, unordered_map<uint64_t, size_t>& lastLineIndexes) const 
+	{
+		return _fileReader.readLines(filePath, 0, endOffset, [this, &lines, &lastLineIndexes](const string& line) {
+			pair<wstring, wstring> textPair = _lineFormatter.importFormat(line);
+			uint64_t keyHash = hashKey(textPair.first);
+
+			if (!textPair.second.empty()) lastLineIndexes[keyHash] = lines.size();
+			else lastLineIndexes.erase(keyHash);
+			lines.push_back(LineInfo{ keyHash, static_cast<uint32_t>(line.length()) });
+		});
+	}
+
+	vector<bool> pickLines(const vector<LineInfo>& lines, 
+		const unordered_map<uint64_t, size_t>& lastLineIndexes, uint64_t sizeLimitBytes) const 
+	{
+		vector<bool> keep(lines.size(), false);
+		uint64_t keptBytes = 0;
+
+		auto budgetExhausted = [&keptBytes, sizeLimitBytes]() { return keptBytes + 1 >= sizeLimitBytes; };
+
+		auto tryKeep = [&lines, &keep, &keptBytes, sizeLimitBytes](size_t i) {
+			uint64_t lineBytes = lines[i].length + 1;
+			if (keep[i] || keptBytes + lineBytes >= sizeLimitBytes) return;
+
+			keep[i] = true;
+			keptBytes += lineBytes;
+		};
+
+		for (const wstring& key : _recencySource.getKeysByRecency()) {
+			if (budgetExhausted()) break;
+			auto it = lastLineIndexes.find(hashKey(key));
+			if (it != lastLineIndexes.end()) tryKeep(it->second);
+		}
+
+		for (size_t i = lines.size(); i > 0 && !budgetExhausted(); i--) {
+			if (isLiveLine(lastLineIndexes, lines[i - 1].keyHash, i - 1)) tryKeep(i - 1);
+		}
+
+		return keep;
+	}
+
+	// lines appended after the scan (ex: by the Write module) are carried over as they are,
+	// including those appended while they are being moved
+	void rewriteWithKeptLines(const string& filePath, uint64_t endOffset, const vector<bool>& keep) {
+		vector<char> buffer(CHUNK_SIZE), keptBuffer{};
+
+		withFileHandle(filePath, [this, endOffset, &keep, &buffer, &keptBuffer](HANDLE hFile) {
+			uint64_t keptEnd = moveKeptLines(hFile, endOffset, keep, buffer, keptBuffer);
+			uint64_t copiedEnd = endOffset, fileSize = getFileSize(hFile);
+
+			while (copiedEnd < fileSize) {
+				copyRange(hFile, copiedEnd, fileSize, keptEnd + (copiedEnd - endOffset), buffer);
+				copiedEnd = fileSize;
+				fileSize = getFileSize(hFile);
+			}
+
+			setFilePointer(hFile, keptEnd + (copiedEnd - endOffset));
+
+			if (!SetEndOfFile(hFile)) {
+				throw runtime_error("Failed to shorten file while truncating it. ErrCode: " + to_string(GetLastError()));
+			}
+		});
+	}
+
+	// lines are counted by their line breaks, as 'scanLines' read them; the kept bytes of a chunk are only written
+	// after the chunk is read, and never past it, so no unread bytes are overwritten; returns the end of the kept lines
+	uint64_t moveKeptLines(HANDLE hFile, uint64_t endOffset, const vector<bool>& keep, 
+		vector<char>& buffer, vector<char>& keptBuffer) 
+	{
+		uint64_t readOffset = 0, keptEnd = 0;
+		size_t i = 0;
+
+		while (readOffset < endOffset) {
+			DWORD readCount = readChunk(hFile, readOffset, endOffset, buffer);
+			if (readCount == 0) break;
+
+			const char* data = buffer.data();
+			const char* chunkEnd = data + readCount;
+			keptBuffer.clear();
+
+			while (data < chunkEnd) {
+				const char* lineBreak = static_cast<const char*>(memchr(data, '\n', chunkEnd - data));
+				const char* partEnd = lineBreak != nullptr ? lineBreak + 1 : chunkEnd;
+
+				if (i < keep.size() && keep[i]) keptBuffer.insert(keptBuffer.end(), data, partEnd);
+				if (lineBreak != nullptr) i++;
+				data = partEnd;
+			}
+
+			// until a line is dropped, the kept lines are already where they belong
+			if (keptEnd != readOffset || keptBuffer.size() != readCount) writeAt(hFile, keptEnd, keptBuffer);
+			keptEnd += keptBuffer.size();
+			readOffset += readCount;
+		}
+
+		return keptEnd;
+	}
+
+	// the destination always trails the source, so a forward copy never overwrites unread bytes
+	void copyRange(HANDLE hFile, uint64_t startOffset, uint64_t endOffset, uint64_t destOffset, vector<char>& buffer) {
+		for (uint64_t offset = startOffset; offset < endOffset;) {
+			DWORD readCount = readChunk(hFile, offset, endOffset, buffer);
+			if (readCount == 0) break;
+
+			buffer.resize(readCount);
+			writeAt(hFile, destOffset, buffer);
+			buffer.resize(CHUNK_SIZE);
+			offset += readCount;
+			destOffset += readCount;
+		}
+	}
+
+	DWORD readChunk(HANDLE hFile, uint64_t offset, uint64_t endOffset, vector<char>& buffer) {
+		DWORD toRead = static_cast<DWORD>(min<uint64_t>(CHUNK_SIZE, endOffset - offset));
+		DWORD readCount = 0;
+		setFilePointer(hFile, offset);
+
+		if (!ReadFile(hFile, buffer.data(), toRead, &readCount, NULL)) {
+			throw runtime_error("Failed to read file while truncating it. ErrCode: " + to_string(GetLastError()));
+		}
+
+		return readCount;
+	}
+
+	void writeAt(HANDLE hFile, uint64_t offset, const vector<char>& data) {
+		const char* remainingData = data.data();
+		DWORD remaining = static_cast<DWORD>(data.size());
+		DWORD writtenCount = 0;
+		setFilePointer(hFile, offset);
+
+		while (remaining > 0) {
+			if (!WriteFile(hFile, remainingData, remaining, &writtenCount, NULL)) {
+				throw runtime_error("Failed to write file while truncating it. ErrCode: " + to_string(GetLastError()));
+			}
+
+			remainingData += writtenCount;
+			remaining -= writtenCount;
+		}
+	}
+
+	void setFilePointer(HANDLE hFile, uint64_t offset) {
+		LARGE_INTEGER distance;
+		distance.QuadPart = static_cast<LONGLONG>(offset);
+
+		if (!SetFilePointerEx(hFile, distance, NULL, FILE_BEGIN)) {
+			throw runtime_error("Failed to seek file while truncating it. ErrCode: " + to_string(GetLastError()));
+		}
+	}
+
+	uint64_t getFileSize(HANDLE hFile) {
+		LARGE_INTEGER fileSize;
+		return GetFileSizeEx(hFile, &fileSize) ? static_cast<uint64_t>(fileSize.QuadPart) : 0;
+	}
+
+	// a missing or unshared file is skipped, otherwise failing to open it throws
+	void withFileHandle(const string& filePath, const function<void(HANDLE)>& action) {
+		HANDLE hFile = CreateFile(StrHelper::convertToW(filePath).c_str(), GENERIC_READ | GENERIC_WRITE,
+			FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+		if (hFile == INVALID_HANDLE_VALUE) {
+			DWORD errCode = GetLastError();
+			if (errCode == ERROR_FILE_NOT_FOUND || errCode == ERROR_SHARING_VIOLATION) return;
+			throw runtime_error("Unable to open file \"" + filePath + "\" for truncation. ErrCode: " + to_string(errCode));
+		}
+
+		try {
+			action(hFile);
+			CloseHandle(hFile);
+		}
+		catch (const exception&) {
+			CloseHandle(hFile);
+			throw;
+		}
+	}
+
+	static bool isLiveLine(const unordered_map<uint64_t, size_t>& lastLineIndexes, uint64_t keyHash, size_t i) {
+		auto it = lastLineIndexes.find(keyHash);
+		return it != lastLineIndexes.end() && it->second == i;
+	}
+
+	static uint64_t hashKey(const wstring& key) {
+		return HashHelper::fnv1a(reinterpret_cast<const char*>(key.c_str()), key.length() * sizeof(wchar_t));
+	}
+};
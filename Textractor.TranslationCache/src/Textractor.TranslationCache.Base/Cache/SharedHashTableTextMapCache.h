@@ -0,0 +1,88 @@
+
+#pragma once
+#include "../_Libraries/Locker.h"
+#include "TextMapCache.h"
+#include "../SharedMemory/SharedHashTable.h"
+#include "../SharedMemory/SharedMemoryRegion.h"
+#include <atomic>
+
+
+// Keeps all entries in one named shared memory region (see 'SharedHashTable'), rather than one mapping per key.
+// Values are variable-length, and lookups do not open/close any handles.
+// The region is created/opened on first use, so that any failure surfaces when the cache is actually used.
+class SharedHashTableTextMapCache : public TextMapCache, public AtomicTextMapCache {
+public:
+	SharedHashTableTextMapCache(const TextFormatter& formatter, SharedMemoryRegionManager& regionManager,
+		const wstring& regionIdentifier, uint32_t slotCount = 1024, uint32_t slabChars = 262144)
+		: _formatter(formatter), _regionManager(regionManager), _regionIdentifier(regionIdentifier),
+			_slotCount(slotCount), _slabChars(slabChars) { }
+
+	bool keyExists(const wstring& key) const override {
+		return !readFromCache(key).empty();
+	}
+
+	wstring readFromCache(const wstring& key) const override {
+		return getTable().read(_formatter.format(key));
+	}
+
+	unordered_map<wstring, wstring> readAllFromCache() const override {
+		unordered_map<wstring, wstring> cache = getTable().readAll();
+
+		for (auto it = cache.begin(); it != cache.end();) {
+			if (it->second.empty()) it = cache.erase(it);
+			else it++;
+		}
+
+		return cache;
+	}
+
+	void writeToCache(const wstring& key, const wstring& value) override {
+		getTable().write(_formatter.format(key), value);
+	}
+
+	void writeAllToCache(const unordered_map<wstring, wstring> cache, bool reload = false) override {
+		SharedHashTable& table = getTable();
+		if (reload) table.clear();
+
+		for (const auto& keyVal : cache) {
+			table.write(_formatter.format(keyVal.first), keyVal.second);
+		}
+	}
+
+	void removeFromCache(const wstring& key) override {
+		getTable().remove(_formatter.format(key));
+	}
+
+	void clearCache() override {
+		getTable().clear();
+	}
+
+	bool compareAndWrite(const wstring& key, const wstring& expectedValue, const wstring& value) override {
+		return getTable().compareAndWrite(_formatter.format(key), expectedValue, value);
+	}
+private:
+	mutable BasicLocker _tableLocker;
+	const TextFormatter& _formatter;
+	SharedMemoryRegionManager& _regionManager;
+	const wstring _regionIdentifier;
+	const uint32_t _slotCount;
+	const uint32_t _slabChars;
+	mutable unique_ptr<SharedHashTable> _table = nullptr;
+	mutable atomic<SharedHashTable*> _tablePtr{ nullptr };
+
+	SharedHashTable& getTable() const {
+		SharedHashTable* table = _tablePtr.load(memory_order_acquire);
+		if (table != nullptr) return *table;
+
+		_tableLocker.lock([this]() {
+			if (_table != nullptr) return;
+
+			size_t regionSize = SharedHashTable::getRegionSize(_slotCount, _slabChars);
+			shared_ptr<SharedMemoryRegion> region = _regionManager.createOrOpenRegion(_regionIdentifier, regionSize);
+			_table = make_unique<SharedHashTable>(region, _slotCount, _slabChars);
+			_tablePtr.store(_table.get(), memory_order_release);
+		});
+
+		return *_table;
+	}
+};
@@ -27,6 +27,15 @@ public:
 	virtual ~TextMapCache() { }
 };
 
+// Implemented by caches which can check and replace a value in one atomic step (ex: caches shared between modules).
+class AtomicTextMapCache {
+public:
+	virtual ~AtomicTextMapCache() { }
+	// writes 'value' (or removes the key, if 'value' is empty) only if the key currently holds 'expectedValue'
+	// (an empty 'expectedValue' meaning the key is absent); returns whether it did
+	virtual bool compareAndWrite(const wstring& key, const wstring& expectedValue, const wstring& value) = 0;
+};
+
 
 class NoTextMapCache : public TextMapCache {
 public:
@@ -189,3 +198,52 @@ public:
 private:
 	vector<reference_wrapper<TextMapCache>> _caches;
 };
+
+
+// Reads from 'frontCache' first, falling back to 'backCache'; values found in 'backCache' are copied into 'frontCache'.
+// Writes are applied to both caches.
+class ReadThroughTextMapCache : public TextMapCache {
+public:
+	ReadThroughTextMapCache(TextMapCache& frontCache, TextMapCache& backCache)
+		: _frontCache(frontCache), _backCache(backCache) { }
+
+	bool keyExists(const wstring& key) const override {
+		return !readFromCache(key).empty();
+	}
+
+	wstring readFromCache(const wstring& key) const override {
+		wstring value = _frontCache.readFromCache(key);
+		if (!value.empty()) return value;
+
+		value = _backCache.readFromCache(key);
+		if (!value.empty()) _frontCache.writeToCache(key, value);
+		return value;
+	}
+
+	unordered_map<wstring, wstring> readAllFromCache() const override {
+		return _backCache.readAllFromCache();
+	}
+
+	void writeToCache(const wstring& key, const wstring& value) override {
+		_backCache.writeToCache(key, value);
+		_frontCache.writeToCache(key, value);
+	}
+
+	void writeAllToCache(const unordered_map<wstring, wstring> cache, bool reload = false) override {
+		_backCache.writeAllToCache(cache, reload);
+		_frontCache.writeAllToCache(cache, reload);
+	}
+
+	void removeFromCache(const wstring& key) override {
+		_backCache.removeFromCache(key);
+		_frontCache.removeFromCache(key);
+	}
+
+	void clearCache() override {
+		_backCache.clearCache();
+		_frontCache.clearCache();
+	}
+private:
+	TextMapCache& _frontCache;
+	TextMapCache& _backCache;
+};
@@ -3,6 +3,9 @@
 #include "Extension.h"
 #include "ExtensionConfig.h"
 #include "ExtExecRequirements.h"
+#include "KeyCanonicalizer.h"
+#include "TextInFlightTable.h"
+#include "TextPrefetcher.h"
 #include "TextTempStore.h"
 #include "Cache/TextMapCache.h"
 
@@ -20,10 +23,11 @@ public:
 
 class DefaultCacheManager : public CacheManager {
 public:
-	DefaultCacheManager(TextMapCache& cache, TextTempStore& tempStore, 
-		const TextMapper& textractorTextMapper, const ExtExecRequirements& execRequirements,
-		const bool updateCacheFromTempStoreBeforeRead) : _cache(cache), _tempStore(tempStore), 
-			_textractorTextMapper(textractorTextMapper), _execRequirements(execRequirements), 
+	DefaultCacheManager(TextMapCache& cache, TextTempStore& tempStore, TextInFlightTable& inFlightTable,
+		TextPrefetcher& prefetcher, const TextMapper& textractorTextMapper, const KeyCanonicalizer& keyCanonicalizer, 
+		const ExtExecRequirements& execRequirements, const bool updateCacheFromTempStoreBeforeRead) 
+		: _cache(cache), _tempStore(tempStore), _inFlightTable(inFlightTable), _prefetcher(prefetcher), 
+			_textractorTextMapper(textractorTextMapper), _keyCanonicalizer(keyCanonicalizer), _execRequirements(execRequirements), 
 			_updateCacheFromTempStoreBeforeRead(updateCacheFromTempStoreBeforeRead) { }
 
 	wstring readCacheAndStoreTemp(wstring& sentence,
@@ -36,12 +40,22 @@ public:
 		if (_updateCacheFromTempStoreBeforeRead) {
 			pair<wstring, wstring> mappingToCache = _tempStore.fromStore(sentInfoWrapper);
 			if (validMapping(mappingToCache)) {
-				_cache.writeToCache(mappingToCache.first, mappingToCache.second);
+				_cache.writeToCache(_keyCanonicalizer.canonicalize(mappingToCache.first, config), mappingToCache.second);
 				_tempStore.clearStore(sentInfoWrapper);
 			}
 		}
 
-		wstring transText = _cache.readFromCache(sentence);
+		// the temp store keeps the original sentence, since that's what gets displayed along with the translation
+		wstring cacheKey = _keyCanonicalizer.canonicalize(sentence, config);
+		wstring transText = _cache.readFromCache(cacheKey);
+
+		// the same sentence may already be getting translated (ex: a hook firing twice), in which case that translation is reused
+		if (transText.empty()) {
+			transText = _inFlightTable.claimOrWait(cacheKey);
+			if (!transText.empty()) _cache.writeToCache(cacheKey, transText);
+		}
+
+		_prefetcher.onLookup(sentInfoWrapper, cacheKey, !transText.empty());
 		if (transText.empty()) return sentence;
 
 		_tempStore.toStore(sentInfoWrapper, sentence, transText);
@@ -51,9 +65,15 @@ public:
 	wstring writeCacheOrLoadTemp(wstring& sentence,
 		SentenceInfoWrapper& sentInfoWrapper, const ExtensionConfig& config) override
 	{
-		if (!_execRequirements.meetsRequirements(sentInfoWrapper, config, false)) return sentence;
+		if (!_execRequirements.meetsRequirements(sentInfoWrapper, config, false)) {
+			// the translation isn't taken in, so a claim on its sentence would only hold up the repeats until it expires
+			releaseClaim(_textractorTextMapper.split(sentence).first, config);
+			return sentence;
+		}
+
 		pair<wstring, wstring> textMapping = _tempStore.fromStore(sentInfoWrapper);
 
+		// the reader found the translation, so it made no claim
 		if (validMapping(textMapping)) {
 			sentence = _textractorTextMapper.merge(textMapping.first, textMapping.second);
 			if (config.debugMode) sentence = L"FROM CACHE:\n" + sentence;
@@ -63,11 +83,21 @@ public:
 		}
 
 		textMapping = _textractorTextMapper.split(sentence);
+		wstring cacheKey = _keyCanonicalizer.canonicalize(textMapping.first, config);
 
-		if (shouldWriteToCache(config, textMapping)) {
-			_cache.writeToCache(textMapping.first, textMapping.second);
-			_tempStore.toStore(sentInfoWrapper, textMapping.first, textMapping.second);
+		try {
+			if (shouldWriteToCache(config, textMapping)) {
+				_cache.writeToCache(cacheKey, textMapping.second);
+				_tempStore.toStore(sentInfoWrapper, textMapping.first, textMapping.second);
+			}
+		}
+		catch (const exception&) {
+			// the translation is still good for the repeats waiting on it
+			_inFlightTable.complete(cacheKey, textMapping.second);
+			throw;
 		}
+
+		_inFlightTable.complete(cacheKey, textMapping.second);
 		
 		return sentence;
 	}
@@ -83,10 +113,18 @@ private:
 
 	TextMapCache& _cache;
 	TextTempStore& _tempStore;
+	TextInFlightTable& _inFlightTable;
+	TextPrefetcher& _prefetcher;
 	const TextMapper& _textractorTextMapper;
+	const KeyCanonicalizer& _keyCanonicalizer;
 	const ExtExecRequirements& _execRequirements;
 	const bool _updateCacheFromTempStoreBeforeRead;
 
+	// an empty translation releases the claim
+	void releaseClaim(const wstring& sentence, const ExtensionConfig& config) {
+		_inFlightTable.complete(_keyCanonicalizer.canonicalize(sentence, config), L"");
+	}
+
 	bool validMapping(const pair<wstring, wstring>& mapping) {
 		return !mapping.first.empty() && !mapping.second.empty();
 	}
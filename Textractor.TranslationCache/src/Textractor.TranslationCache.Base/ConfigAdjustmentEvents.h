@@ -2,7 +2,14 @@
 #pragma once
 #include "_Libraries/Locker.h"
 #include "Cache/TextMapCache.h"
+#include "Cache/BloomFilterTextMapCache.h"
+#include "Cache/MappedSnapshotTextMapCache.h"
+#include "CacheFilePathFormatter.h"
 #include "ExtensionConfig.h"
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <thread>
 
 
 class ConfigAdjustmentEvents {
@@ -45,3 +52,100 @@ private:
 		_destCache.writeAllToCache(srcCacheMap, true);
 	}
 };
+
+
+// Remaps the snapshot cache whenever the configured cache file path changes.
+// Follows the tail of the cache file, merging lines appended by the Write module into the snapshot cache.
+// The cache file is checked at most once every 'syncIntervalMs', so most sentences don't touch the disk.
+// A full snapshot reload only happens on a cache file path change, or if the cache file was truncated/rewritten;
+// it runs on a background thread, and lookups keep using the current snapshot until the new one is swapped in.
+// 'keyFilter' is the key filter in front of the snapshot cache; merged keys are added to it, and it is rebuilt on reload.
+// 'derivedCache' holds entries copied from the snapshot cache (ex: a front cache); merged keys are removed from it,
+// so it doesn't keep serving the values they replaced, and it is cleared on reload.
+class SnapshotReadConfigAdjustmentEvents : public ConfigAdjustmentEvents {
+public:
+	SnapshotReadConfigAdjustmentEvents(MappedSnapshotTextMapCache& cache, BloomFilterTextMapCache& keyFilter,
+		TextMapCache& derivedCache, CacheFilePathFormatter& pathFormatter, const wstring& currCacheFilePath,
+		uint32_t syncIntervalMs = 1000) : _cache(cache), _keyFilter(keyFilter), _derivedCache(derivedCache), 
+			_pathFormatter(pathFormatter), _currCacheFilePath(currCacheFilePath), _syncIntervalMs(syncIntervalMs) { }
+
+	// a reload failure is dropped here, since an exception leaving the destructor would terminate Textractor
+	~SnapshotReadConfigAdjustmentEvents() {
+		if (_reloadThread.joinable()) _reloadThread.join();
+	}
+
+	void applyConfigAdjustments(const ExtensionConfig& config) override {
+		// if another thread is already checking the cache file, there is nothing left for this one to do
+		_locker.tryLock([this, &config]() {
+			if (_reloading) return;
+			joinReloadThread();
+
+			if (config.cacheFilePath != _currCacheFilePath) {
+				_currCacheFilePath = config.cacheFilePath;
+				startReload();
+			}
+			else if (isSyncDue() && _cache.syncWithSource([this](const wstring& key) { mergeKey(key); })
+				== MappedSnapshotTextMapCache::Rewritten)
+			{
+				startReload();
+			}
+		});
+	}
+private:
+	BasicLocker _locker;
+	wstring _currCacheFilePath;
+	MappedSnapshotTextMapCache& _cache;
+	BloomFilterTextMapCache& _keyFilter;
+	TextMapCache& _derivedCache;
+	CacheFilePathFormatter& _pathFormatter;
+	const uint64_t _syncIntervalMs;
+	uint64_t _lastSyncMs = 0;
+	thread _reloadThread;
+	atomic<bool> _reloading{ false };
+	exception_ptr _reloadException = nullptr;
+
+	bool isSyncDue() {
+		uint64_t nowMs = static_cast<uint64_t>(chrono::duration_cast<chrono::milliseconds>(
+			chrono::steady_clock::now().time_since_epoch()).count());
+		if (_lastSyncMs != 0 && nowMs - _lastSyncMs < _syncIntervalMs) return false;
+
+		_lastSyncMs = nowMs;
+		return true;
+	}
+
+	void mergeKey(const wstring& key) {
+		_keyFilter.addKey(key);
+		_derivedCache.removeFromCache(key);
+	}
+
+	void startReload() {
+		string cacheFilePath = _pathFormatter.format(_currCacheFilePath);
+		_reloading = true;
+
+		_reloadThread = thread([this, cacheFilePath]() {
+			try {
+				// the filter is bypassed from before the new snapshot is swapped in, until it is rebuilt from it
+				_keyFilter.invalidate();
+				_cache.loadSnapshot(cacheFilePath);
+				_keyFilter.rebuild();
+				_derivedCache.clearCache();
+			}
+			catch (...) {
+				_reloadException = current_exception();
+			}
+
+			_reloading = false;
+		});
+	}
+
+	void joinReloadThread() {
+		if (_reloadThread.joinable()) _reloadThread.join();
+
+		// surface background reload failures on the calling (sentence processing) thread
+		if (_reloadException != nullptr) {
+			exception_ptr reloadException = _reloadException;
+			_reloadException = nullptr;
+			rethrow_exception(reloadException);
+		}
+	}
+};
@@ -18,6 +18,11 @@ const wstring THREAD_KEY_FILTER_MODE_KEY = L"ThreadKeyFilterMode";
 const wstring THREAD_KEY_FILTER_LIST_KEY = L"ThreadKeyFilterList";
 const wstring THREAD_KEY_FILTER_LIST_DELIM_KEY = L"ThreadKeyFilterListDelim";
 const wstring DEBUG_MODE_KEY = L"DebugMode";
+const wstring CACHE_MEMORY_LIMIT_MB_KEY = L"CacheMemoryLimitMb";
+const wstring PIPELINE_FINGERPRINT_KEY = L"PipelineFingerprint";
+const wstring PIPELINE_FINGERPRINT_FALLBACK_KEY = L"PipelineFingerprintFallback";
+const wstring KEY_FOLDING_KEY = L"KeyFolding";
+const wstring KEY_STRIP_RULES_KEY = L"KeyStripRules";
 
 
 // *** PUBLIC
@@ -31,6 +36,11 @@ void IniConfigRetriever::saveConfig(const ExtensionConfig& config, bool override
 	auto ini = unique_ptr<IniContents>(_iniHandler.readIni());
 	bool changed = false;
 
+	changed |= setValue(*ini, KEY_STRIP_RULES_KEY, config.keyStripRules, overrideIfExists);
+	changed |= setValue(*ini, KEY_FOLDING_KEY, config.keyFolding, overrideIfExists);
+	changed |= setValue(*ini, PIPELINE_FINGERPRINT_FALLBACK_KEY, config.pipelineFingerprintFallback, overrideIfExists);
+	changed |= setValue(*ini, PIPELINE_FINGERPRINT_KEY, config.pipelineFingerprint, overrideIfExists);
+	changed |= setValue(*ini, CACHE_MEMORY_LIMIT_MB_KEY, config.cacheMemoryLimitMb, overrideIfExists);
 	changed |= setValue(*ini, DEBUG_MODE_KEY, config.debugMode, overrideIfExists);
 	changed |= setValue(*ini, THREAD_KEY_FILTER_LIST_DELIM_KEY, config.threadKeyFilterListDelim, overrideIfExists);
 	changed |= setValue(*ini, THREAD_KEY_FILTER_LIST_KEY, config.threadKeyFilterList, overrideIfExists);
@@ -66,7 +76,12 @@ ExtensionConfig IniConfigRetriever::getConfig(bool saveDefaultConfigIfNotExist)
 		getValOrDef<FilterMode>(*ini, THREAD_KEY_FILTER_MODE_KEY, defaultConfig.threadKeyFilterMode),
 		getValOrDef(*ini, THREAD_KEY_FILTER_LIST_KEY, defaultConfig.threadKeyFilterList),
 		getValOrDef(*ini, THREAD_KEY_FILTER_LIST_DELIM_KEY, defaultConfig.threadKeyFilterListDelim),
-		getValOrDef(*ini, DEBUG_MODE_KEY, defaultConfig.debugMode)
+		getValOrDef(*ini, DEBUG_MODE_KEY, defaultConfig.debugMode),
+		getValOrDef(*ini, CACHE_MEMORY_LIMIT_MB_KEY, defaultConfig.cacheMemoryLimitMb),
+		getValOrDef(*ini, PIPELINE_FINGERPRINT_KEY, defaultConfig.pipelineFingerprint),
+		getValOrDef(*ini, PIPELINE_FINGERPRINT_FALLBACK_KEY, defaultConfig.pipelineFingerprintFallback),
+		getValOrDef(*ini, KEY_FOLDING_KEY, defaultConfig.keyFolding),
+		getValOrDef(*ini, KEY_STRIP_RULES_KEY, defaultConfig.keyStripRules)
 	);
 
 	return config;
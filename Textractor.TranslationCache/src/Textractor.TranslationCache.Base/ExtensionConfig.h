@@ -26,25 +26,34 @@ struct ExtensionConfig {
 	wstring threadKeyFilterList;
 	wstring threadKeyFilterListDelim;
 	bool debugMode;
+	double cacheMemoryLimitMb;
+	wstring pipelineFingerprint;
+	bool pipelineFingerprintFallback;
+	bool keyFolding;
+	wstring keyStripRules;
 
 	ExtensionConfig(DisabledMode disabledMode_, const wstring& cacheFilePath_, SkippingStrategy skippingStrategy_,
 		bool activeThreadOnly_, ConsoleClipboardMode skipConsoleAndClipboard_, 
 		double cacheFileLimitMb_, int cacheLineLengthLimit_, bool clearCacheOnUnload_, 
 		FilterMode threadKeyFilterMode_, const wstring& threadKeyFilterList_, 
-		const wstring& threadKeyFilterListDelim_, bool debugMode_)
+		const wstring& threadKeyFilterListDelim_, bool debugMode_, double cacheMemoryLimitMb_,
+		const wstring& pipelineFingerprint_, bool pipelineFingerprintFallback_, 
+		bool keyFolding_, const wstring& keyStripRules_)
 		: disabledMode(disabledMode_), cacheFilePath(cacheFilePath_), skippingStrategy(skippingStrategy_),
 			activeThreadOnly(activeThreadOnly_), skipConsoleAndClipboard(skipConsoleAndClipboard_), 
 			cacheFileLimitMb(cacheFileLimitMb_), cacheLineLengthLimit(cacheLineLengthLimit_), 
 			clearCacheOnUnload(clearCacheOnUnload_), threadKeyFilterMode(threadKeyFilterMode_), 
 			threadKeyFilterList(threadKeyFilterList_), threadKeyFilterListDelim(threadKeyFilterListDelim_), 
-			debugMode(debugMode_) { }
+			debugMode(debugMode_), cacheMemoryLimitMb(cacheMemoryLimitMb_), 
+			pipelineFingerprint(pipelineFingerprint_), pipelineFingerprintFallback(pipelineFingerprintFallback_), 
+			keyFolding(keyFolding_), keyStripRules(keyStripRules_) { }
 };
 
 static const ExtensionConfig DefaultConfig = ExtensionConfig(
 	ExtensionConfig::DisabledMode::DisableNone, L"", 
 	ExtensionConfig::SkippingStrategy::SendZeroWidthSpace, true, 
 	ExtensionConfig::ConsoleClipboardMode::SkipAll, 16.0, 500,
-	false, ExtensionConfig::FilterMode::Disabled, L"", L"|", false
+	false, ExtensionConfig::FilterMode::Disabled, L"", L"|", false, 8.0, L"", false, false, L""
 );
 
 
@@ -4,13 +4,27 @@
 #include "../Textractor.TranslationCache.Base/_Libraries/winmsg.h"
 #include "../Textractor.TranslationCache.Base/Extension.h"
 #include "../Textractor.TranslationCache.Base/CacheManager.h"
+#include "../Textractor.TranslationCache.Base/Cache/BloomFilterTextMapCache.h"
+#include "../Textractor.TranslationCache.Base/Cache/BoundedMemoryTextMapCache.h"
+#include "../Textractor.TranslationCache.Base/Cache/CacheFileRecoverer.h"
 #include "../Textractor.TranslationCache.Base/Cache/FileTextMapCache.h"
+#include "../Textractor.TranslationCache.Base/Cache/FingerprintTextMapCache.h"
+#include "../Textractor.TranslationCache.Base/Cache/MappedSnapshotTextMapCache.h"
 #include "../Textractor.TranslationCache.Base/Cache/MemoryTextMapCache.h"
-#include "../Textractor.TranslationCache.Base/Cache/SharedMemTextMapCache.h"
+#include "../Textractor.TranslationCache.Base/Cache/RecencyCacheFileTruncater.h"
+#include "../Textractor.TranslationCache.Base/Cache/SharedHashTableTextMapCache.h"
+#include "../Textractor.TranslationCache.Base/File/FileInspector.h"
+#include "../Textractor.TranslationCache.Base/File/FileMapper.h"
+#include "../Textractor.TranslationCache.Base/File/FileRenamer.h"
 #include "../Textractor.TranslationCache.Base/File/FileTruncater.h"
+#include "../Textractor.TranslationCache.Base/File/MappedFileReader.h"
 #include "../Textractor.TranslationCache.Base/File/Writer/WinApiFileWriter.h"
+#include "../Textractor.TranslationCache.Base/File/Writer/WriteBehindFileWriter.h"
 #include "../Textractor.TranslationCache.Base/CacheFilePathFormatter.h"
 #include "../Textractor.TranslationCache.Base/ConfigAdjustmentEvents.h"
+#include "../Textractor.TranslationCache.Base/KeyCanonicalizer.h"
+#include "../Textractor.TranslationCache.Base/TextInFlightTable.h"
+#include "../Textractor.TranslationCache.Base/TextPrefetcher.h"
 #include <memory>
 
 
@@ -45,44 +59,101 @@ public:
 		_cacheFilePathFormatter = make_unique<DefaultCacheFilePathFormatter>(_iniSection);
 		
 		_fileDeleter = make_unique<CRemoveFileDeleter>();
-		_fileReader = make_unique<FstreamFileReader>();
-		_fileWriter = make_unique<PersistentWinApiFileWriter>();
+		_baseFileWriter = make_unique<PersistentWinApiFileWriter>();
+		// cache lines are appended by a background thread, so translated text is not held up by file I/O
+		if (!readMode) _fileWriter = make_unique<WriteBehindFileWriter>(*_baseFileWriter);
+		_fileInspector = make_unique<FstreamFileInspector>();
+		_fileMapper = make_unique<WinApiFileMapper>();
+		_fileReader = make_unique<MappedFileReader>(*_fileMapper);
+		_fileRenamer = make_unique<WinApiFileRenamer>();
 
-		_fileTruncater = make_unique<DefaultFileTruncater>(*_fileReader, *_fileWriter,
-			[this]() { return static_cast<long long>(getConfig().cacheFileLimitMb * 1024 * 1024); });
+		_cacheLineFormatter = make_unique<DefaultCacheLineFormatter>(*_formatter, *_cacheTextMapper);
+		function<uint64_t()> fileLimitGetter = 
+			[this]() { return static_cast<uint64_t>(getConfig().cacheFileLimitMb * 1024 * 1024); };
+
+		if (!readMode) {
+			_cacheFileRecoverer = make_unique<TailCacheFileRecoverer>(*_baseFileWriter);
+			_fileTruncater = make_unique<StreamingFileTruncater>(fileLimitGetter);
+		}
+		else {
+			// recently read entries are tracked, so that they are kept when the cache file gets truncated
+			_hotCache = make_unique<BoundedMemoryTextMapCache>(*_formatter,
+				[this]() { return static_cast<uint64_t>(getConfig().cacheMemoryLimitMb * 1024 * 1024); });
+			_fileTruncater = make_unique<RecencyCacheFileTruncater>(*_fileReader, *_fileInspector, 
+				*_cacheLineFormatter, *_hotCache, fileLimitGetter);
+		}
+
+		// a torn tail (from a crash mid-append) is cut off before anything reads/appends to the cache file.
+		// only the Write module does it, since only it appends: to the Read module, an append in progress looks torn
+		if (!readMode) recoverCacheFile(config);
 		truncateCacheFile(config);
 
 		if (!readMode) {
 			_configAdjustEvents = make_unique<NoConfigAdjustmentEvents>();
-			_mainCache = unique_ptr<FileTextMapCache>(createFileTextMapCache());
+			auto logCache = unique_ptr<FileTextMapCache>(createFileTextMapCache());
+			_logCache = logCache.get();
+			_mainCache = move(logCache);
+			_prefetcher = make_unique<NoTextPrefetcher>();
 		}
 		else {
-			auto& fileCache = _depsCacheMap["file"] = shared_ptr<FileTextMapCache>(createFileTextMapCache());
-			unordered_map<wstring, wstring> fileCacheMap = fileCache->readAllFromCache();
-			_mainCache = make_unique<MemoryTextMapCache>(*_formatter, fileCacheMap);
+			// cache file contents are mapped from a snapshot rather than copied into memory
+			auto snapshotCache = make_unique<MappedSnapshotTextMapCache>(
+				*_fileMapper, *_fileRenamer, *_fileDeleter, *_fileInspector, *_formatter, *_cacheTextMapper);
+			snapshotCache->loadSnapshot(_cacheFilePathFormatter->format(config.cacheFilePath));
+			// most sentences on a new playthrough are misses, which the key filter answers without a snapshot lookup
+			auto keyFilterCache = make_unique<BloomFilterTextMapCache>(*snapshotCache, *_formatter);
 			
-			_configAdjustEvents = make_unique<DefaultReadConfigAdjustmentEvents>(*fileCache, *_mainCache);
+			_configAdjustEvents = make_unique<SnapshotReadConfigAdjustmentEvents>(*snapshotCache, 
+				*keyFilterCache, *_hotCache, *_cacheFilePathFormatter, config.cacheFilePath);
+			_fileCache = move(snapshotCache);
+			_keyFilterCache = move(keyFilterCache);
+			_mainCache = make_unique<ReadThroughTextMapCache>(*_hotCache, *_keyFilterCache);
+			// text usually comes up in the same order, so the lines expected next are loaded into memory ahead of time
+			_prefetcher = make_unique<SuccessorTextPrefetcher>(*_hotCache, *_keyFilterCache, *_formatter);
 		}
+
+		// translations from another pipeline (see 'PipelineFingerprint' config) are treated as misses
+		_fingerprintCache = make_unique<FingerprintTextMapCache>(*_mainCache, *_formatter,
+			[this]() { return getConfig().pipelineFingerprint; },
+			[this]() { return getConfig().pipelineFingerprintFallback; });
+		if (!readMode) _fingerprintCache->startPurge();
 		
-		_sharedMemManager = make_unique<WinApiNamedSharedMemoryManager>();
-		_tempStoreCache = make_unique<SharedMemTextMapCache>(*_formatter, *_sharedMemManager, false);
+		_sharedMemRegionManager = make_unique<WinApiSharedMemoryRegionManager>();
+		_tempStoreCache = make_unique<SharedHashTableTextMapCache>(
+			*_formatter, *_sharedMemRegionManager, L"Textractor-TransCache-TEMP-TABLE");
 		_tempStore = make_unique<MapCacheTextTempStore>(
 			*_tempStoreCache, *_cacheTextMapper, L"Textractor-TransCache-TEMP");
+		// shared by both modules, so the writer can hand a translation over to repeats of the sentence waiting in the reader
+		_inFlightCache = make_unique<SharedHashTableTextMapCache>(
+			*_formatter, *_sharedMemRegionManager, L"Textractor-TransCache-INFLIGHT-TABLE");
+		_inFlightTable = make_unique<MapCacheTextInFlightTable>(*_inFlightCache, *_inFlightCache);
+		// the writer completes the claims, so the reader only makes them while the writer's heartbeat is there
+		if (!readMode) _inFlightTable->startMaintenance();
 		
 		_threadKeyGenerator = make_unique<DefaultThreadKeyGenerator>();
 		_threadTracker = make_unique<MapThreadTracker>();
 		_threadFilter = make_unique<DefaultThreadFilter>(*_threadKeyGenerator, *_threadTracker);
 		
 		_execRequirements = make_unique<DefaultExtExecRequirements>(*_threadFilter);
+		_keyCanonicalizer = make_unique<DefaultKeyCanonicalizer>();
 		_cacheManager = make_unique<DefaultCacheManager>( 
-			*_mainCache, *_tempStore, *_textractorTextMapper, *_execRequirements, true);
+			*_fingerprintCache, *_tempStore, *_inFlightTable, *_prefetcher,
+			*_textractorTextMapper, *_keyCanonicalizer, *_execRequirements, true);
 	}
 
 	~DefaultExtensionDepsContainer() {
-		_depsCacheMap.clear();
+		if (_disabled) return;
+		_fingerprintCache->stopPurge();
+		_inFlightTable->stopMaintenance();
+		// a compaction swapping in its file would undo (or be undone by) the truncation
+		if (_logCache != nullptr) _logCache->stopCompaction();
 
-		ExtensionConfig config = getConfig();
-		truncateCacheFile(config);
+		// an exception leaving the destructor would terminate Textractor; the file is truncated next time instead
+		try {
+			ExtensionConfig config = getConfig();
+			truncateCacheFile(config);
+		}
+		catch (const exception&) { }
 	}
 
 	bool isDisabled() override {
@@ -121,16 +192,29 @@ private:
 
 	unique_ptr<FileDeleter> _fileDeleter = nullptr;
 	unique_ptr<FileReader> _fileReader = nullptr;
+	unique_ptr<FileWriter> _baseFileWriter = nullptr;
 	unique_ptr<FileWriter> _fileWriter = nullptr;
 	unique_ptr<FileTruncater> _fileTruncater = nullptr;
+	unique_ptr<CacheFileRecoverer> _cacheFileRecoverer = nullptr;
+	unique_ptr<FileInspector> _fileInspector = nullptr;
+	unique_ptr<FileMapper> _fileMapper = nullptr;
+	unique_ptr<FileRenamer> _fileRenamer = nullptr;
+	unique_ptr<CacheLineFormatter> _cacheLineFormatter = nullptr;
 
 	unique_ptr<CacheFilePathFormatter> _cacheFilePathFormatter = nullptr;
-	unordered_map<string, shared_ptr<TextMapCache>> _depsCacheMap{};
+	unique_ptr<BoundedMemoryTextMapCache> _hotCache = nullptr;
+	unique_ptr<TextMapCache> _fileCache = nullptr;
+	unique_ptr<TextMapCache> _keyFilterCache = nullptr;
 	unique_ptr<TextMapCache> _mainCache = nullptr;
+	FileTextMapCache* _logCache = nullptr;
+	unique_ptr<FingerprintTextMapCache> _fingerprintCache = nullptr;
+	unique_ptr<TextPrefetcher> _prefetcher = nullptr;
 
-	unique_ptr<SharedMemoryManager> _sharedMemManager = nullptr;
+	unique_ptr<SharedMemoryRegionManager> _sharedMemRegionManager = nullptr;
 	unique_ptr<TextMapCache> _tempStoreCache = nullptr;
 	unique_ptr<TextTempStore> _tempStore = nullptr;
+	unique_ptr<SharedHashTableTextMapCache> _inFlightCache = nullptr;
+	unique_ptr<TextInFlightTable> _inFlightTable = nullptr;
 
 	unique_ptr<ThreadKeyGenerator> _threadKeyGenerator = nullptr;
 	unique_ptr<ThreadTracker> _threadTracker = nullptr;
@@ -138,6 +222,7 @@ private:
 
 	unique_ptr<ConfigAdjustmentEvents> _configAdjustEvents = nullptr;
 	unique_ptr<ExtExecRequirements> _execRequirements = nullptr;
+	unique_ptr<KeyCanonicalizer> _keyCanonicalizer = nullptr;
 	unique_ptr<CacheManager> _cacheManager = nullptr;
 
 	wstring getIniSectionName(string moduleName, const string& moduleSuffix) {
@@ -158,13 +243,20 @@ private:
 	}
 
 	FileTextMapCache* createFileTextMapCache() {
-		return new FileTextMapCache(*_fileWriter, *_fileReader, 
-			*_fileDeleter, *_formatter, *_cacheTextMapper,
+		return new FileTextMapCache(*_fileWriter, *_fileReader, *_fileDeleter, 
+			*_fileRenamer, *_fileInspector, *_formatter, *_cacheTextMapper,
 			[this]() { return _cacheFilePathFormatter->format(getConfig().cacheFilePath); }
 		);
 	}
 
+	void recoverCacheFile(const ExtensionConfig config) {
+		string cacheFilePath = _cacheFilePathFormatter->format(config.cacheFilePath);
+		_cacheFileRecoverer->recoverFile(cacheFilePath);
+	}
+
 	void truncateCacheFile(const ExtensionConfig config) {
-		_fileTruncater->truncateFile(StrHelper::convertFromW(config.cacheFilePath));
+		string cacheFilePath = _cacheFilePathFormatter->format(config.cacheFilePath);
+		if (_fileWriter != nullptr) _fileWriter->flushFile(cacheFilePath);
+		_fileTruncater->truncateFile(cacheFilePath);
 	}
 };
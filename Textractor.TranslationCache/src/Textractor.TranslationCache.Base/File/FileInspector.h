@@ -0,0 +1,41 @@
+
+#pragma once
+#include "../_Libraries/hashhelper.h"
+#include <fstream>
+#include <string>
+using namespace std;
+
+
+class FileInspector {
+public:
+	virtual ~FileInspector() { }
+	virtual uint64_t getFileSize(const string& filePath) const = 0;
+	// hashes the last few bytes before 'endOffset', to cheaply detect if a file's content was rewritten
+	virtual uint64_t getTailHash(const string& filePath, uint64_t endOffset) const = 0;
+};
+
+
+class FstreamFileInspector : public FileInspector {
+public:
+	uint64_t getFileSize(const string& filePath) const override {
+		ifstream f(filePath, ios_base::in | ios_base::binary | ios_base::ate);
+		if (!f.is_open()) return 0;
+
+		streamoff size = f.tellg();
+		return size > 0 ? static_cast<uint64_t>(size) : 0;
+	}
+
+	uint64_t getTailHash(const string& filePath, uint64_t endOffset) const override {
+		uint64_t length = endOffset < TAIL_LENGTH ? endOffset : TAIL_LENGTH;
+		if (length == 0) return HashHelper::FNV_OFFSET_BASIS;
+
+		ifstream f(filePath, ios_base::in | ios_base::binary);
+		string tail(static_cast<size_t>(length), '\0');
+		f.seekg(endOffset - length, ios_base::beg);
+		if (!f.read(&tail[0], length)) return 0;
+
+		return HashHelper::fnv1a(tail);
+	}
+private:
+	static constexpr uint64_t TAIL_LENGTH = 64;
+};
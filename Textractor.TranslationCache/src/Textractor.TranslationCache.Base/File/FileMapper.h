@@ -0,0 +1,85 @@
+
+#pragma once
+#include "../_Libraries/strhelper.h"
+#include <memory>
+#include <string>
+#include <windows.h>
+using namespace std;
+
+
+// Read-only view of a memory-mapped file; the mapping is released once the view is destroyed.
+class MappedFileView {
+public:
+	virtual ~MappedFileView() { }
+	virtual const char* data() const = 0;
+	virtual uint64_t size() const = 0;
+};
+
+
+class FileMapper {
+public:
+	virtual ~FileMapper() { }
+	// returns nullptr if the file does not exist or is empty
+	virtual shared_ptr<MappedFileView> mapFile(const string& filePath) = 0;
+};
+
+
+class WinApiMappedFileView : public MappedFileView {
+public:
+	WinApiMappedFileView(HANDLE hFile, HANDLE hMapFile, LPVOID mapView, uint64_t size)
+		: _hFile(hFile), _hMapFile(hMapFile), _mapView(mapView), _size(size) { }
+
+	virtual ~WinApiMappedFileView() {
+		if (_mapView != NULL) UnmapViewOfFile(_mapView);
+		if (_hMapFile != NULL) CloseHandle(_hMapFile);
+		if (_hFile != INVALID_HANDLE_VALUE) CloseHandle(_hFile);
+	}
+
+	const char* data() const override {
+		return static_cast<const char*>(_mapView);
+	}
+
+	uint64_t size() const override {
+		return _size;
+	}
+private:
+	HANDLE _hFile;
+	HANDLE _hMapFile;
+	LPVOID _mapView;
+	const uint64_t _size;
+};
+
+
+class WinApiFileMapper : public FileMapper {
+public:
+	shared_ptr<MappedFileView> mapFile(const string& filePath) override {
+		HANDLE hFile = CreateFile(StrHelper::convertToW(filePath).c_str(), GENERIC_READ,
+			FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (hFile == INVALID_HANDLE_VALUE) return nullptr;
+
+		LARGE_INTEGER fileSize{};
+		if (!GetFileSizeEx(hFile, &fileSize) || fileSize.QuadPart <= 0) {
+			CloseHandle(hFile);
+			return nullptr;
+		}
+
+		HANDLE hMapFile = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (hMapFile == NULL) {
+			CloseHandle(hFile);
+			throw runtime_error(getErrorMessage("CreateFileMapping", filePath));
+		}
+
+		LPVOID mapView = MapViewOfFile(hMapFile, FILE_MAP_READ, 0, 0, 0);
+		if (mapView == NULL) {
+			CloseHandle(hMapFile);
+			CloseHandle(hFile);
+			throw runtime_error(getErrorMessage("MapViewOfFile", filePath));
+		}
+
+		return make_shared<WinApiMappedFileView>(hFile, hMapFile, mapView, static_cast<uint64_t>(fileSize.QuadPart));
+	}
+private:
+	string getErrorMessage(const string& funcName, const string& filePath) {
+		return "'" + funcName + "' failed to map file \"" + filePath + "\"; ErrCode: " + to_string(GetLastError());
+	}
+};
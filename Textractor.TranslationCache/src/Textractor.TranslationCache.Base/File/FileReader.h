@@ -1,5 +1,6 @@
 
 #pragma once
+#include <algorithm>
 #include <fstream>
 #include <functional>
 #include <sstream>
@@ -13,8 +14,14 @@ public:
 	virtual bool fileExists(const string& filePath) = 0;
 	virtual vector<string> readLines(const string& filePath) = 0;
 	virtual void readLines(const string& filePath, const function<void(const string& line)>& lineAction) = 0;
+	// reads the complete (newline-terminated) lines within the byte range [startOffset, endOffset),
+	// and returns the offset right after the last line read
+	virtual uint64_t readLines(const string& filePath, uint64_t startOffset, uint64_t endOffset,
+		const function<void(const string& line)>& lineAction) = 0;
 	virtual string readLine(const string& filePath, size_t i) = 0;
 	virtual string readLine(const string& filePath, const function<bool(const string& line)> condition) = 0;
+	// same as 'readLine', but goes through the lines from the end of the file, so it finds the last line meeting 'condition'
+	virtual string readLineReversed(const string& filePath, const function<bool(const string& line)> condition) = 0;
 	virtual string readAll(const string& filePath) = 0;
 };
 
@@ -24,8 +31,11 @@ public:
 	bool fileExists(const string& filePath) override { return false; }
 	vector<string> readLines(const string& filePath) override { return vector<string>{}; };
 	void readLines(const string& filePath, const function<void(const string& line)>& lineAction) override { }
+	uint64_t readLines(const string& filePath, uint64_t startOffset, uint64_t endOffset,
+		const function<void(const string& line)>& lineAction) override { return startOffset; }
 	string readLine(const string& filePath, size_t i) override { return ""; }
 	string readLine(const string& filePath, const function<bool(const string& line)> condition) override { return ""; }
+	string readLineReversed(const string& filePath, const function<bool(const string& line)> condition) override { return ""; }
 	string readAll(const string& filePath) override { return ""; }
 };
 
@@ -50,6 +60,28 @@ public:
 		});
 	}
 
+	uint64_t readLines(const string& filePath, uint64_t startOffset, uint64_t endOffset,
+		const function<void(const string& line)>& lineAction) override
+	{
+		ifstream f(filePath, ios_base::in | ios_base::binary);
+		if (!fileExists(f)) return startOffset;
+		f.seekg(startOffset, ios_base::beg);
+
+		uint64_t offset = startOffset;
+		string line;
+
+		while (offset < endOffset && getline(f, line)) {
+			if (f.eof()) break; // partially written line
+			if (offset + line.length() + 1 > endOffset) break;
+			offset += line.length() + 1;
+
+			if (!line.empty() && line.back() == '\r') line.pop_back();
+			lineAction(line);
+		}
+
+		return offset;
+	}
+
 	string readLine(const string& filePath, size_t i) override {
 		size_t currI = 0;
 
@@ -61,15 +93,52 @@ public:
 	string readLine(const string& filePath, const function<bool(const string& line)> condition) override {
 		ifstream f(filePath, ios_base::in);
 		if (!fileExists(f)) return "";
-		char* line = new char[MAX_LENGTH];
+		// one buffer is reused for every line, so a full scan only allocates when a longer line comes up
+		string line;
 
-		while (f.getline(line, MAX_LENGTH)) {
+		while (getline(f, line)) {
 			if (condition(line)) return line;
 		}
 
 		return "";
 	}
 
+	// the file is read backwards in chunks; a line spanning chunks is put together before it is checked
+	string readLineReversed(const string& filePath, const function<bool(const string& line)> condition) override {
+		ifstream f(filePath, ios_base::in | ios_base::binary);
+		if (!fileExists(f)) return "";
+
+		f.seekg(0, ios_base::end);
+		uint64_t offset = static_cast<uint64_t>(f.tellg());
+		string chunk(_reverseChunkSize, '\0');
+		string lineTail;
+		string line;
+		bool lastLine = true;
+
+		while (offset > 0) {
+			size_t chunkSize = static_cast<size_t>(min<uint64_t>(offset, _reverseChunkSize));
+			offset -= chunkSize;
+			f.seekg(offset, ios_base::beg);
+			if (!f.read(&chunk[0], chunkSize)) return "";
+
+			size_t lineEnd = chunkSize;
+			for (size_t i = chunkSize; i-- > 0;) {
+				if (chunk[i] != '\n') continue;
+
+				line.assign(chunk, i + 1, lineEnd - i - 1);
+				line += lineTail;
+				lineTail.clear();
+				lineEnd = i;
+
+				if (checkReversedLine(line, lastLine, condition)) return line;
+			}
+
+			lineTail.insert(0, chunk, 0, lineEnd);
+		}
+
+		return checkReversedLine(lineTail, lastLine, condition) ? lineTail : "";
+	}
+
 	string readAll(const string& filePath) override {
 		ifstream f(filePath, ios_base::in);
 		if (!fileExists(f)) return "";
@@ -79,9 +148,19 @@ public:
 		return buffer.str();
 	}
 private:
-	static const int MAX_LENGTH = 524288;
+	const size_t _reverseChunkSize = 64 * 1024;
 
 	bool fileExists(const ifstream& f) const {
 		return f.good();
 	}
+
+	// the (empty) text after the final line break is not a line, as with the forward reads
+	static bool checkReversedLine(string& line, bool& lastLine, const function<bool(const string& line)>& condition) {
+		bool skip = lastLine && line.empty();
+		lastLine = false;
+		if (skip) return false;
+
+		if (!line.empty() && line.back() == '\r') line.pop_back();
+		return condition(line);
+	}
 };
@@ -0,0 +1,28 @@
+
+#pragma once
+#include "../_Libraries/strhelper.h"
+#include <string>
+#include <windows.h>
+using namespace std;
+
+
+class FileRenamer {
+public:
+	virtual ~FileRenamer() { }
+	// atomically replaces 'destFilePath' (if it exists) with 'srcFilePath'
+	virtual void renameFile(const string& srcFilePath, const string& destFilePath) = 0;
+};
+
+
+class WinApiFileRenamer : public FileRenamer {
+public:
+	void renameFile(const string& srcFilePath, const string& destFilePath) override {
+		BOOL success = MoveFileEx(StrHelper::convertToW(srcFilePath).c_str(),
+			StrHelper::convertToW(destFilePath).c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+
+		if (!success) {
+			throw runtime_error("Unable to move file \"" + srcFilePath + "\" to \"" 
+				+ destFilePath + "\". ErrCode: " + to_string(GetLastError()));
+		}
+	}
+};
@@ -1,11 +1,14 @@
 
 #pragma once
+#include <algorithm>
 #include <fstream>
 #include <functional>
 #include <string>
 #include <unordered_set>
 #include <vector>
+#include <windows.h>
 #include "../_Libraries/Locker.h"
+#include "../_Libraries/strhelper.h"
 #include "FileReader.h"
 #include "Writer/FileWriter.h"
 using namespace std;
@@ -51,10 +54,10 @@ private:
 		if (fileSizeBytes < _sizeLimitBytesGetter()) return;
 
 		double sizeRatio = getSizeRatio(fileSizeBytes);
-		pair<vector<string>, long> contents = readAllLines(filePath);
-		vector<string> lines = contents.first;
+		long linesTotalLength = 0;
+		vector<string> lines = readAllLines(filePath, linesTotalLength);
 
-		size_t startIndex = getTruncStartIndex(lines, contents.second, sizeRatio);
+		size_t startIndex = getTruncStartIndex(lines, linesTotalLength, sizeRatio);
 		_fileWriter.writeToFile(filePath, lines, startIndex);
 	}
 
@@ -62,9 +65,10 @@ private:
 		HANDLE hFile = getFileHandle(StrHelper::convertToW(filePath).c_str());
 		if (hFile == INVALID_HANDLE_VALUE) return 0;
 
-		DWORD fileSize = GetFileSize(hFile, NULL);
+		LARGE_INTEGER fileSize;
+		BOOL success = GetFileSizeEx(hFile, &fileSize);
 		CloseHandle(hFile);
-		return static_cast<uint64_t>(fileSize);
+		return success ? static_cast<uint64_t>(fileSize.QuadPart) : 0;
 	}
 
 	HANDLE getFileHandle(const wchar_t* filePath) {
@@ -88,15 +92,164 @@ private:
 		return index;
 	}
 
-	pair<vector<string>, long> readAllLines(const string& filePath) {
+	vector<string> readAllLines(const string& filePath, long& length) {
 		vector<string> lines{};
-		long length = 0;
 		
 		_fileReader.readLines(filePath, [&lines, &length](const string& line) {
 			lines.push_back(line);
 			length += line.length();
 		});
 
-		return pair<vector<string>, long>(lines, length);
+		return lines;
+	}
+};
+
+
+// Truncates a file without loading it into memory. The cut point is found by seeking to the size limit
+// from the end of the file, then moving forward to the start of the next line.
+// The kept tail is then copied in fixed-size chunks to the start of the file itself, which is then shortened.
+// The file is never replaced, since the other module keeps it open (without sharing deletion) to append to it:
+// its appends go to the current end of the file, so they land after the kept tail. Lines appended while the tail
+// is copied are copied too. A file which is in use without sharing writes is skipped, to be truncated next time.
+// A failure midway leaves the file partially shifted.
+// There is no hole-punching mode: NTFS can only deallocate a range of a sparse file, without moving what follows it,
+// so the file would keep its offsets and size, and every reader would have to skip the zeroed head.
+class StreamingFileTruncater : public FileTruncater {
+public:
+	StreamingFileTruncater(const function<uint64_t()>& sizeLimitBytesGetter) : _sizeLimitBytesGetter(sizeLimitBytesGetter) { }
+	StreamingFileTruncater(const uint64_t sizeLimitBytes) 
+		: StreamingFileTruncater([sizeLimitBytes]() { return sizeLimitBytes; }) { }
+
+	void truncateFile(const string& filePath) override {
+		_lockerMap.getOrCreateLocker(filePath).lock([this, &filePath]() {
+			truncateFileBase(filePath);
+		});
+	}
+private:
+	static const DWORD CHUNK_SIZE = 65536;
+	DefaultLockerMap<string> _lockerMap;
+	const function<uint64_t()> _sizeLimitBytesGetter;
+
+	// each call has its own buffer, since calls for different files run concurrently (they only share a lock per file)
+	void truncateFileBase(const string& filePath) {
+		uint64_t sizeLimitBytes = _sizeLimitBytesGetter();
+		vector<char> buffer(CHUNK_SIZE);
+
+		withFileHandle(filePath, GENERIC_READ | GENERIC_WRITE, OPEN_EXISTING, 
+			[this, sizeLimitBytes, &buffer](HANDLE hFile) {
+				uint64_t fileSize = getFileSize(hFile);
+				if (fileSize < sizeLimitBytes) return;
+
+				uint64_t cutOffset = findCutOffset(hFile, fileSize - sizeLimitBytes, fileSize, buffer);
+				if (cutOffset > 0) shiftToStart(hFile, cutOffset, fileSize, buffer);
+			});
+	}
+
+	// returns the offset of the first line starting at or after 'minOffset'
+	uint64_t findCutOffset(HANDLE hFile, uint64_t minOffset, uint64_t fileSize, vector<char>& buffer) {
+		if (minOffset == 0) return 0;
+		uint64_t offset = minOffset - 1;
+
+		while (offset < fileSize) {
+			DWORD readCount = readChunk(hFile, offset, fileSize, buffer);
+			const char* lineEnd = static_cast<const char*>(memchr(buffer.data(), '\n', readCount));
+			if (lineEnd != nullptr) return offset + (lineEnd - buffer.data()) + 1;
+
+			offset += readCount;
+		}
+
+		return fileSize;
+	}
+
+	void shiftToStart(HANDLE hFile, uint64_t cutOffset, uint64_t fileSize, vector<char>& buffer) {
+		// the destination always trails the source, so a forward copy never overwrites unread bytes
+		uint64_t copiedEnd = cutOffset;
+
+		while (copiedEnd < fileSize) {
+			copyRange(hFile, copiedEnd, fileSize, hFile, copiedEnd - cutOffset, buffer);
+			copiedEnd = fileSize;
+			fileSize = getFileSize(hFile);
+		}
+
+		setFilePointer(hFile, copiedEnd - cutOffset);
+
+		if (!SetEndOfFile(hFile)) {
+			throw runtime_error("Failed to shorten file while truncating it. ErrCode: " + to_string(GetLastError()));
+		}
+	}
+
+	void copyRange(HANDLE hSrcFile, uint64_t startOffset, uint64_t endOffset, 
+		HANDLE hDestFile, uint64_t destOffset, vector<char>& buffer) 
+	{
+		for (uint64_t offset = startOffset; offset < endOffset;) {
+			DWORD readCount = readChunk(hSrcFile, offset, endOffset, buffer);
+			if (readCount == 0) break;
+
+			setFilePointer(hDestFile, destOffset);
+			writeChunk(hDestFile, buffer, readCount);
+			offset += readCount;
+			destOffset += readCount;
+		}
+	}
+
+	DWORD readChunk(HANDLE hFile, uint64_t offset, uint64_t endOffset, vector<char>& buffer) {
+		DWORD toRead = static_cast<DWORD>(min<uint64_t>(CHUNK_SIZE, endOffset - offset));
+		DWORD readCount = 0;
+		setFilePointer(hFile, offset);
+
+		if (!ReadFile(hFile, buffer.data(), toRead, &readCount, NULL)) {
+			throw runtime_error("Failed to read file while truncating it. ErrCode: " + to_string(GetLastError()));
+		}
+
+		return readCount;
+	}
+
+	void writeChunk(HANDLE hFile, const vector<char>& buffer, DWORD length) {
+		const char* data = buffer.data();
+		DWORD writtenCount = 0;
+
+		while (length > 0) {
+			if (!WriteFile(hFile, data, length, &writtenCount, NULL)) {
+				throw runtime_error("Failed to write file while truncating it. ErrCode: " + to_string(GetLastError()));
+			}
+
+			data += writtenCount;
+			length -= writtenCount;
+		}
+	}
+
+	void setFilePointer(HANDLE hFile, uint64_t offset) {
+		LARGE_INTEGER distance;
+		distance.QuadPart = static_cast<LONGLONG>(offset);
+
+		if (!SetFilePointerEx(hFile, distance, NULL, FILE_BEGIN)) {
+			throw runtime_error("Failed to seek file while truncating it. ErrCode: " + to_string(GetLastError()));
+		}
+	}
+
+	uint64_t getFileSize(HANDLE hFile) {
+		LARGE_INTEGER fileSize;
+		return GetFileSizeEx(hFile, &fileSize) ? static_cast<uint64_t>(fileSize.QuadPart) : 0;
+	}
+
+	// a missing or unshared file is skipped, otherwise failing to open it throws
+	void withFileHandle(const string& filePath, DWORD access, DWORD creation, const function<void(HANDLE)>& action) {
+		HANDLE hFile = CreateFile(StrHelper::convertToW(filePath).c_str(), access,
+			FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, creation, FILE_ATTRIBUTE_NORMAL, NULL);
+
+		if (hFile == INVALID_HANDLE_VALUE) {
+			DWORD errCode = GetLastError();
+			if (errCode == ERROR_FILE_NOT_FOUND || errCode == ERROR_SHARING_VIOLATION) return;
+			throw runtime_error("Unable to open file \"" + filePath + "\" for truncation. ErrCode: " + to_string(errCode));
+		}
+
+		try {
+			action(hFile);
+			CloseHandle(hFile);
+		}
+		catch (const exception&) {
+			CloseHandle(hFile);
+			throw;
+		}
 	}
 };
@@ -0,0 +1,99 @@
+#pragma once
+#include "FileMapper.h"
+#include "FileReader.h"
+#include <cstring>
+
+
+// Scans lines straight out of a memory-mapped view of the file, rather than through a stream.
+// Every line of a scan is copied into the same reused buffer, so a scan allocates nothing per line
+// (only when a line is longer than any before it). Line breaks are handled as the text mode stream reader does
+// ("\r\n" and "\n" both end a line), and a last line without a line break is still read,
+// except by the byte range 'readLines', which only reads complete lines.
+class MappedFileReader : public FstreamFileReader {
+public:
+	MappedFileReader(FileMapper& fileMapper) : _fileMapper(fileMapper) { }
+
+	using FstreamFileReader::readLines;
+	using FstreamFileReader::readLine;
+
+	uint64_t readLines(const string& filePath, uint64_t startOffset, uint64_t endOffset,
+		const function<void(const string& line)>& lineAction) override
+	{
+		shared_ptr<MappedFileView> view = _fileMapper.mapFile(filePath);
+		if (view == nullptr) return startOffset;
+
+		string lineBuffer;
+		return scanLines(*view, startOffset, endOffset, false, lineBuffer, [&lineAction](const string& line) {
+			lineAction(line);
+			return false;
+		});
+	}
+
+	string readLine(const string& filePath, const function<bool(const string& line)> condition) override {
+		shared_ptr<MappedFileView> view = _fileMapper.mapFile(filePath);
+		if (view == nullptr) return "";
+
+		string lineBuffer;
+		bool found = false;
+
+		scanLines(*view, 0, view->size(), true, lineBuffer, [&condition, &found](const string& line) {
+			found = condition(line);
+			return found;
+		});
+
+		return found ? lineBuffer : "";
+	}
+
+	string readLineReversed(const string& filePath, const function<bool(const string& line)> condition) override {
+		shared_ptr<MappedFileView> view = _fileMapper.mapFile(filePath);
+		if (view == nullptr || view->size() == 0) return "";
+
+		const char* data = view->data();
+		size_t lineEnd = static_cast<size_t>(view->size());
+		// the (empty) text after the final line break is not a line
+		if (lineEnd > 0 && data[lineEnd - 1] == '\n') lineEnd--;
+		string line;
+
+		for (size_t i = lineEnd + 1; i-- > 0;) {
+			if (i > 0 && data[i - 1] != '\n') continue;
+
+			size_t lineLength = lineEnd - i;
+			if (lineLength > 0 && data[i + lineLength - 1] == '\r') lineLength--;
+			line.assign(data + i, lineLength);
+			if (condition(line)) return line;
+
+			if (i == 0) break;
+			lineEnd = i - 1;
+		}
+
+		return "";
+	}
+private:
+	FileMapper& _fileMapper;
+
+	// calls 'lineAction' for each line in [startOffset, endOffset) until it returns true,
+	// and returns the offset right after the last line scanned
+	static uint64_t scanLines(const MappedFileView& view, uint64_t startOffset, uint64_t endOffset,
+		bool readUnterminated, string& line, const function<bool(const string& line)>& lineAction)
+	{
+		const char* data = view.data();
+		uint64_t end = min<uint64_t>(endOffset, view.size());
+		uint64_t offset = startOffset;
+
+		while (offset < end) {
+			const char* lineStart = data + offset;
+			size_t remaining = static_cast<size_t>(end - offset);
+			const char* lineBreak = static_cast<const char*>(memchr(lineStart, '\n', remaining));
+			if (lineBreak == nullptr && !readUnterminated) break;
+
+			size_t lineLength = lineBreak != nullptr ? static_cast<size_t>(lineBreak - lineStart) : remaining;
+			offset += lineBreak != nullptr ? lineLength + 1 : lineLength;
+			if (lineLength > 0 && lineStart[lineLength - 1] == '\r') lineLength--;
+
+			line.assign(lineStart, lineLength);
+			if (lineAction(line)) break;
+		}
+
+		return offset;
+	}
+};
@@ -12,6 +12,10 @@ public:
 	virtual void writeToFile(const string& filePath, const vector<string>& lines, size_t startIndex = 0) = 0;
 	virtual void appendToFile(const string& filePath, const string& text) = 0;
 	virtual void appendToFile(const string& filePath, const vector<string>& lines, size_t startIndex = 0) = 0;
+	// releases any handle kept open for the file, so it can be deleted/replaced
+	virtual void closeFile(const string& filePath) = 0;
+	// blocks until all writes issued for the file so far are handed to the OS (and written to disk, if 'toDisk')
+	virtual void flushFile(const string& filePath, bool toDisk = false) = 0;
 };
 
 
@@ -21,5 +25,7 @@ public:
 	void writeToFile(const string& filePath, const vector<string>& lines, size_t startIndex = 0) override { }
 	void appendToFile(const string& filePath, const string& text) override { }
 	void appendToFile(const string& filePath, const vector<string>& lines, size_t startIndex = 0) override { }
+	void closeFile(const string& filePath) override { }
+	void flushFile(const string& filePath, bool toDisk = false) override { }
 };
 
@@ -1,88 +1,70 @@
 
 #pragma once
 #include "FileWriter.h"
-#include <atomic>
+#include <condition_variable>
 #include <functional>
+#include <mutex>
 #include <thread>
-#include <windows.h>
 
 
+// Performs each write on its own detached thread. For many small writes, prefer 'WriteBehindFileWriter'.
 class FireAndForgetFileWriter : public FileWriter {
 public:
 	FireAndForgetFileWriter(FileWriter& mainWriter) : _mainWriter(mainWriter) { }
 
 	~FireAndForgetFileWriter() {
 		// ensure all ongoing write activity is done before deallocating
-		_destrCalled = true;
-		waitForAllActionsDone(100, 5000);
+		waitForAllActionsDone();
 	}
 
 	void writeToFile(const string& filePath, const string& text) override {
-		thread([this, filePath, text]() { writeToFileBase(filePath, text); }).detach();
+		startAction([this, filePath, text]() { _mainWriter.writeToFile(filePath, text); });
 	}
 
 	void writeToFile(const string& filePath, const vector<string>& lines, size_t startIndex = 0) override {
-		thread([this, filePath, lines, startIndex]() {
-			writeToFileBase(filePath, lines, startIndex); }).detach();
+		startAction([this, filePath, lines, startIndex]() { _mainWriter.writeToFile(filePath, lines, startIndex); });
 	}
 
 	void appendToFile(const string& filePath, const string& text) override {
-		thread([this, filePath, text]() { appendToFileBase(filePath, text); }).detach();
+		startAction([this, filePath, text]() { _mainWriter.appendToFile(filePath, text); });
 	}
 
 	void appendToFile(const string& filePath, const vector<string>& lines, size_t startIndex = 0) override {
-		thread([this, filePath, lines, startIndex]() {
-			appendToFileBase(filePath, lines, startIndex); }).detach();
-	}
-private:
-	atomic<size_t> _activeCount = 0;
-	atomic_bool _destrCalled = false;
-	FileWriter& _mainWriter;
-
-	void writeToFileBase(const string& filePath, const string& text) {
-		trackAction([this, &filePath, &text]() {
-			_mainWriter.writeToFile(filePath, text);
-		});
+		startAction([this, filePath, lines, startIndex]() { _mainWriter.appendToFile(filePath, lines, startIndex); });
 	}
 
-	void writeToFileBase(const string& filePath, const vector<string>& lines, size_t startIndex = 0) {
-		trackAction([this, &filePath, &lines, startIndex]() {
-			_mainWriter.writeToFile(filePath, lines, startIndex);
-		});
+	void closeFile(const string& filePath) override {
+		_mainWriter.closeFile(filePath);
 	}
 
-	void appendToFileBase(const string& filePath, const string& text) {
-		trackAction([this, &filePath, &text]() {
-			_mainWriter.appendToFile(filePath, text);
-		});
+	void flushFile(const string& filePath, bool toDisk = false) override {
+		waitForAllActionsDone();
+		_mainWriter.flushFile(filePath, toDisk);
 	}
+private:
+	mutex _mtx;
+	condition_variable _doneCv;
+	size_t _activeCount = 0;
+	FileWriter& _mainWriter;
 
-	void appendToFileBase(const string& filePath, const vector<string>& lines, size_t startIndex = 0) {
-		trackAction([this, &filePath, &lines, startIndex]() {
-			_mainWriter.appendToFile(filePath, lines, startIndex);
-		});
-	}
+	void startAction(const function<void()>& action) {
+		// counted before the thread starts, so a wait issued right after this call includes it
+		{
+			lock_guard<mutex> lock(_mtx);
+			_activeCount++;
+		}
 
-	void trackAction(const function<void()>& action) {
-		if (_destrCalled) return;
-		_activeCount++;
+		thread([this, action]() {
+			try { action(); }
+			catch (const exception&) { }
 
-		try {
-			action();
-			_activeCount--;
-		}
-		catch (const exception&) {
-			_activeCount--;
-			throw;
-		}
+			lock_guard<mutex> lock(_mtx);
+			if (--_activeCount == 0) _doneCv.notify_all();
+		}).detach();
 	}
 
-	void waitForAllActionsDone(DWORD intervalMs, DWORD maxWaitMs) {
-		DWORD waitMs = 0;
-
-		while (_activeCount > 0 && waitMs < maxWaitMs) {
-			Sleep(intervalMs);
-			waitMs += intervalMs;
-		}
+	void waitForAllActionsDone() {
+		unique_lock<mutex> lock(_mtx);
+		_doneCv.wait(lock, [this]() { return _activeCount == 0; });
 	}
 };
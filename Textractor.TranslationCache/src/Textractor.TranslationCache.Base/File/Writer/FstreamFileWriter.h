@@ -26,12 +26,26 @@ public:
 	void appendToFile(const string& filePath, const vector<string>& lines, size_t startIndex = 0) override {
 		writeToFileThreadSafe(filePath, lines, true, startIndex);
 	}
+
+	void closeFile(const string& filePath) override {
+		_lockerMap.getOrCreateLocker(filePath).lock([this, &filePath]() {
+			closeFileBase(filePath);
+		});
+	}
+
+	void flushFile(const string& filePath, bool toDisk = false) override {
+		_lockerMap.getOrCreateLocker(filePath).lock([this, &filePath, toDisk]() {
+			flushFileBase(filePath, toDisk);
+		});
+	}
 protected:
 	DefaultLockerMap<string> _lockerMap;
 
 	virtual void writeToFileBase(const string& filePath, const string& text, bool append) = 0;
 	virtual void writeToFileBase(const string& filePath, 
 		const vector<string>& lines, bool append, size_t startIndex = 0) = 0;
+	virtual void closeFileBase(const string& filePath) { }
+	virtual void flushFileBase(const string& filePath, bool toDisk) { }
 
 	void writeToFileThreadSafe(const string& filePath, const string& text, bool append) {
 		_lockerMap.getOrCreateLocker(filePath).lock([this, &filePath, &text, append]() {
@@ -56,7 +70,7 @@ protected:
 		f << flush;
 	}
 
-	virtual ios_base::open_mode getOpenMode(bool append) {
+	virtual ios_base::openmode getOpenMode(bool append) {
 		return append ? ios_base::app : ios_base::out;
 	}
 };
@@ -101,6 +115,17 @@ protected:
 		ofstream& f = getOrCreateStream(filePath, FstreamFileWriterBase::getOpenMode(append));
 		FstreamFileWriterBase::writeToFile(f, filePath, lines, startIndex);
 	}
+
+	void closeFileBase(const string& filePath) override {
+		_fileMap.erase(filePath);
+		_fileModeMap.erase(filePath);
+	}
+
+	// streams cannot be synced to disk, so 'toDisk' only goes as far as the OS
+	void flushFileBase(const string& filePath, bool toDisk) override {
+		auto it = _fileMap.find(filePath);
+		if (it != _fileMap.end()) it->second->flush();
+	}
 private:
 	unordered_map<string, unique_ptr<ofstream>> _fileMap;
 	unordered_map<string, int> _fileModeMap;
@@ -113,7 +138,7 @@ private:
 	}
 
 	void addStream(const string& filePath, const int mode) {
-		_fileMap[filePath] = make_unique<ofstream>(filePath, mode);
+		_fileMap[filePath] = make_unique<ofstream>(filePath, static_cast<ios_base::openmode>(mode));
 		_fileModeMap[filePath] = mode;
 	}
 };
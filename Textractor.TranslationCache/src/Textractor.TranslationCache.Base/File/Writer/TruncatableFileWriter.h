@@ -36,6 +36,14 @@ public:
 			_truncater.truncateFile(filePath);
 		});
 	}
+
+	void closeFile(const string& filePath) override {
+		_mainWriter.closeFile(filePath);
+	}
+
+	void flushFile(const string& filePath, bool toDisk = false) override {
+		_mainWriter.flushFile(filePath, toDisk);
+	}
 private:
 	DefaultLockerMap<string> _lockerMap;
 	FileWriter& _mainWriter;
@@ -26,12 +26,26 @@ public:
 	void appendToFile(const string& filePath, const vector<string>& lines, size_t startIndex = 0) override {
 		writeToFileThreadSafe(filePath, lines, true, startIndex);
 	}
+
+	void closeFile(const string& filePath) override {
+		_lockerMap.getOrCreateLocker(filePath).lock([this, &filePath]() {
+			closeFileBase(filePath);
+		});
+	}
+
+	void flushFile(const string& filePath, bool toDisk = false) override {
+		_lockerMap.getOrCreateLocker(filePath).lock([this, &filePath, toDisk]() {
+			flushFileBase(filePath, toDisk);
+		});
+	}
 protected:
 	DefaultLockerMap<string> _lockerMap;
 
 	virtual void writeToFileBase(const string& filePath, const string& text, bool append) = 0;
 	virtual void writeToFileBase(const string& filePath,
 		const vector<string>& lines, bool append, size_t startIndex = 0) = 0;
+	virtual void closeFileBase(const string& filePath) { }
+	virtual void flushFileBase(const string& filePath, bool toDisk) { }
 
 	void writeToFileThreadSafe(const string& filePath, const string& text, bool append) {
 		_lockerMap.getOrCreateLocker(filePath).lock([this, &filePath, &text, append]() {
@@ -142,6 +156,25 @@ protected:
 		HANDLE f = getOrCreateStream(filePath, append);
 		WinApiFileWriterBase::writeToFile(f, filePath, lines, startIndex);
 	}
+
+	void closeFileBase(const string& filePath) override {
+		auto it = _fileMap.find(filePath);
+		if (it == _fileMap.end()) return;
+
+		CloseHandle(it->second);
+		_fileMap.erase(it);
+		_fileModeMap.erase(filePath);
+	}
+
+	// 'WriteFile' is unbuffered on the process side, so only writing through to disk needs any work
+	void flushFileBase(const string& filePath, bool toDisk) override {
+		auto it = _fileMap.find(filePath);
+		if (!toDisk || it == _fileMap.end()) return;
+
+		if (!FlushFileBuffers(it->second)) {
+			throw runtime_error("Failed to flush file \"" + filePath + "\" to disk. ErrCode: " + to_string(GetLastError()));
+		}
+	}
 private:
 	unordered_map<string, HANDLE> _fileMap;
 	unordered_map<string, bool> _fileModeMap;
@@ -0,0 +1,225 @@
+
+#pragma once
+#include "FileWriter.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+
+// Queues writes, and performs them on a single background thread, so callers don't wait on file I/O.
+// The writer thread commits queued writes in batches: once a write is queued, it waits up to 'flushIntervalMs'
+// for more to join the batch (or until the batch holds 'maxBatchLines' lines), then coalesces each file's
+// appends in the batch into one append. Writes to the same file keep their order.
+// The queue holds up to 'maxQueuedLines' lines; past that, callers wait for the writer thread to catch up.
+// 'flushFile', 'closeFile' and the destructor wait until everything queued before them has been written.
+// Errors raised by the main writer are rethrown by the next call to 'flushFile'/'closeFile'.
+class WriteBehindFileWriter : public FileWriter {
+public:
+	// what is done after each batch, for each file it wrote to
+	enum Durability { None = 0, Flush, Sync };
+
+	WriteBehindFileWriter(FileWriter& mainWriter, uint32_t flushIntervalMs = 50, size_t maxBatchLines = 512,
+		Durability durability = Durability::None, size_t maxQueuedLines = 8192) : _mainWriter(mainWriter),
+			_flushInterval(flushIntervalMs), _maxBatchLines(maxBatchLines > 0 ? maxBatchLines : 1),
+			_durability(durability), _maxQueuedLines(maxQueuedLines > 0 ? maxQueuedLines : 1)
+	{
+		_writerThread = thread([this]() { runWriter(); });
+	}
+
+	~WriteBehindFileWriter() {
+		{
+			lock_guard<mutex> lock(_mtx);
+			_stopping = true;
+		}
+
+		_workCv.notify_one();
+		if (_writerThread.joinable()) _writerThread.join();
+	}
+
+	void writeToFile(const string& filePath, const string& text) override {
+		enqueue(false, filePath, vector<string>{ text });
+	}
+
+	void writeToFile(const string& filePath, const vector<string>& lines, size_t startIndex = 0) override {
+		enqueue(false, filePath, copyLines(lines, startIndex));
+	}
+
+	void appendToFile(const string& filePath, const string& text) override {
+		enqueue(true, filePath, vector<string>{ text });
+	}
+
+	void appendToFile(const string& filePath, const vector<string>& lines, size_t startIndex = 0) override {
+		if (startIndex >= lines.size()) return;
+		enqueue(true, filePath, copyLines(lines, startIndex));
+	}
+
+	void closeFile(const string& filePath) override {
+		waitForQueuedWrites();
+		_mainWriter.closeFile(filePath);
+	}
+
+	void flushFile(const string& filePath, bool toDisk = false) override {
+		waitForQueuedWrites();
+		_mainWriter.flushFile(filePath, toDisk);
+	}
+private:
+	struct QueuedWrite {
+		bool append;
+		string filePath;
+		vector<string> lines;
+	};
+
+	FileWriter& _mainWriter;
+	const chrono::milliseconds _flushInterval;
+	const size_t _maxBatchLines;
+	const Durability _durability;
+	const size_t _maxQueuedLines;
+
+	mutex _mtx;
+	condition_variable _workCv;
+	condition_variable _doneCv;
+	deque<QueuedWrite> _queue{};
+	size_t _queuedLines = 0;
+	uint64_t _queuedCount = 0;
+	uint64_t _doneCount = 0;
+	size_t _flushWaiters = 0;
+	bool _stopping = false;
+	exception_ptr _error = nullptr;
+	thread _writerThread;
+
+	static vector<string> copyLines(const vector<string>& lines, size_t startIndex) {
+		if (startIndex >= lines.size()) return vector<string>{};
+		return vector<string>(lines.begin() + startIndex, lines.end());
+	}
+
+	static size_t getLineCount(const QueuedWrite& write) {
+		// a write with no lines still truncates the file, so it counts towards the limits as well
+		return write.lines.empty() ? 1 : write.lines.size();
+	}
+
+	void enqueue(bool append, const string& filePath, vector<string>&& lines) {
+		QueuedWrite write{ append, filePath, move(lines) };
+		size_t lineCount = getLineCount(write);
+
+		{
+			unique_lock<mutex> lock(_mtx);
+			_doneCv.wait(lock, [this]() { return _queuedLines < _maxQueuedLines; });
+
+			_queue.push_back(move(write));
+			_queuedLines += lineCount;
+			_queuedCount++;
+		}
+
+		_workCv.notify_one();
+	}
+
+	void waitForQueuedWrites() {
+		exception_ptr error = nullptr;
+
+		{
+			unique_lock<mutex> lock(_mtx);
+			uint64_t targetCount = _queuedCount;
+
+			_flushWaiters++;
+			_workCv.notify_one();
+			_doneCv.wait(lock, [this, targetCount]() { return _doneCount >= targetCount; });
+			_flushWaiters--;
+
+			error = _error;
+			_error = nullptr;
+		}
+
+		if (error) rethrow_exception(error);
+	}
+
+	void runWriter() {
+		unique_lock<mutex> lock(_mtx);
+
+		while (true) {
+			_workCv.wait(lock, [this]() { return _stopping || !_queue.empty(); });
+			if (_queue.empty()) return;
+
+			// the batching delay is cut short when anyone is waiting on the writer thread (including a full queue)
+			_workCv.wait_for(lock, _flushInterval, [this]() { return _stopping || _flushWaiters > 0
+				|| _queuedLines >= _maxBatchLines || _queuedLines >= _maxQueuedLines; });
+
+			vector<QueuedWrite> batch = takeBatch();
+			_doneCv.notify_all();
+
+			lock.unlock();
+			writeBatch(batch);
+			lock.lock();
+
+			_doneCount += batch.size();
+			_doneCv.notify_all();
+		}
+	}
+
+	vector<QueuedWrite> takeBatch() {
+		vector<QueuedWrite> batch{};
+		size_t batchLines = 0;
+
+		while (!_queue.empty() && (batch.empty() || batchLines < _maxBatchLines)) {
+			size_t lineCount = getLineCount(_queue.front());
+			batchLines += lineCount;
+			_queuedLines -= lineCount;
+
+			batch.push_back(move(_queue.front()));
+			_queue.pop_front();
+		}
+
+		return batch;
+	}
+
+	void writeBatch(vector<QueuedWrite>& batch) {
+		unordered_map<string, vector<string>> pendingAppends{};
+		unordered_set<string> writtenFiles{};
+
+		for (QueuedWrite& write : batch) {
+			writtenFiles.insert(write.filePath);
+
+			if (write.append) {
+				vector<string>& pending = pendingAppends[write.filePath];
+				pending.insert(pending.end(), make_move_iterator(write.lines.begin()), make_move_iterator(write.lines.end()));
+				continue;
+			}
+
+			// an overwrite replaces the file, so appends queued before it are written first to keep the order
+			commitAppends(pendingAppends, write.filePath);
+			performWrite([this, &write]() { _mainWriter.writeToFile(write.filePath, write.lines); });
+		}
+
+		for (auto& pending : pendingAppends) commitAppends(pendingAppends, pending.first);
+		if (_durability == Durability::None) return;
+
+		for (const string& filePath : writtenFiles) {
+			performWrite([this, &filePath]() { _mainWriter.flushFile(filePath, _durability == Durability::Sync); });
+		}
+	}
+
+	void commitAppends(unordered_map<string, vector<string>>& pendingAppends, const string& filePath) {
+		auto it = pendingAppends.find(filePath);
+		if (it == pendingAppends.end() || it->second.empty()) return;
+
+		performWrite([this, &it]() { _mainWriter.appendToFile(it->first, it->second); });
+		it->second.clear();
+	}
+
+	void performWrite(const function<void()>& action) {
+		try {
+			action();
+		}
+		catch (const exception&) {
+			// the first error is kept, and the rest of the batch is still written
+			lock_guard<mutex> lock(_mtx);
+			if (!_error) _error = current_exception();
+		}
+	}
+};
@@ -0,0 +1,233 @@
+
+#pragma once
+#include "_Libraries/strhelper.h"
+#include "ExtensionConfig.h"
+#include "TextFormatter.h"
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+
+// Rewrites a key into a canonical form, so that lines which only differ in ways that don't change their meaning
+// (ex: full-width vs half-width characters, control characters inserted by a hook) share one cache entry.
+class KeyCanonicalizer {
+public:
+	virtual ~KeyCanonicalizer() { }
+	virtual wstring canonicalize(const wstring& key, const ExtensionConfig& config) const = 0;
+};
+
+
+class NoKeyCanonicalizer : public KeyCanonicalizer {
+public:
+	wstring canonicalize(const wstring& key, const ExtensionConfig& config) const override {
+		return key;
+	}
+};
+
+
+// Canonicalizes a key in a single pass over its characters, applying (at each position) the first of:
+// - strip rules ('KeyStripRules' config, separated by '|'): a rule "<open>*<close>" removes the text from <open>
+//   to the next <close> (ex: "《*》" removes ruby/furigana readings), any other rule removes each occurrence of its text.
+//   Rules are matched against the original text.
+// - folding ('KeyFolding' config), an NFKC-style folding of the characters common in game text:
+//   full-width ASCII and the ideographic space become half-width, half-width katakana become full-width
+//   (combining a following voiced sound mark), runs of ellipses ('…', '‥', or 2+ of '.'/'・') become a single '…',
+//   and control and zero-width characters are dropped.
+// A key which would be left empty is kept as it is.
+class DefaultKeyCanonicalizer : public KeyCanonicalizer {
+public:
+	wstring canonicalize(const wstring& key, const ExtensionConfig& config) const override {
+		vector<StripRule> stripRules = parseStripRules(config.keyStripRules);
+		if (!config.keyFolding && stripRules.empty()) return key;
+
+		wstring canonicalKey;
+		canonicalKey.reserve(key.length());
+		size_t i = 0;
+
+		while (i < key.length()) {
+			size_t stripLength = matchStripRule(key, i, stripRules);
+			if (stripLength > 0) i += stripLength;
+			else if (config.keyFolding) i += foldChar(key, i, canonicalKey);
+			else canonicalKey += key[i++];
+		}
+
+		return canonicalKey.empty() ? key : canonicalKey;
+	}
+private:
+	struct StripRule {
+		wstring open;
+		wstring close;
+		bool enclosing;
+	};
+
+	static constexpr wchar_t STRIP_RULE_DELIM = L'|';
+	static constexpr wchar_t ENCLOSING_WILDCARD = L'*';
+	static constexpr wchar_t ELLIPSIS = L'\x2026';
+
+	static vector<StripRule> parseStripRules(const wstring& rulesStr) {
+		vector<StripRule> rules{};
+		if (rulesStr.empty()) return rules;
+
+		for (StrView<wchar_t> ruleStr : StrHelper::splitView<wchar_t>(rulesStr, STRIP_RULE_DELIM)) {
+			size_t wildcardIndex = ruleStr.find(ENCLOSING_WILDCARD);
+			bool enclosing = wildcardIndex != wstring::npos && wildcardIndex > 0 && wildcardIndex < ruleStr.length() - 1;
+
+			if (enclosing) rules.push_back(StripRule{
+				ruleStr.substr(0, wildcardIndex).str(), ruleStr.substr(wildcardIndex + 1).str(), true });
+			else if (!ruleStr.empty()) rules.push_back(StripRule{ ruleStr.str(), L"", false });
+		}
+
+		return rules;
+	}
+
+	// returns the number of characters to strip at 'index' (0 if no rule matches)
+	static size_t matchStripRule(const wstring& key, size_t index, const vector<StripRule>& rules) {
+		for (const StripRule& rule : rules) {
+			if (key.compare(index, rule.open.length(), rule.open) != 0) continue;
+			if (!rule.enclosing) return rule.open.length();
+
+			size_t closeIndex = key.find(rule.close, index + rule.open.length());
+			if (closeIndex != wstring::npos) return closeIndex + rule.close.length() - index;
+		}
+
+		return 0;
+	}
+
+	// appends the folded form of the character(s) at 'index', and returns the number of characters consumed
+	static size_t foldChar(const wstring& key, size_t index, wstring& output) {
+		wchar_t ch = key[index];
+
+		size_t ellipsisLength = getEllipsisRunLength(key, index);
+		if (ellipsisLength > 0) {
+			output += ELLIPSIS;
+			return ellipsisLength;
+		}
+
+		if (isIgnorable(ch)) return 1;
+
+		if (ch >= L'\xFF01' && ch <= L'\xFF5E') output += static_cast<wchar_t>(ch - 0xFEE0);
+		else if (ch == L'\x3000') output += L' ';
+		else if (ch >= L'\xFF61' && ch <= L'\xFF9F') return foldHalfWidthKana(key, index, output);
+		else output += ch;
+
+		return 1;
+	}
+
+	static bool isIgnorable(wchar_t ch) {
+		return ch < L'\x20' || (ch >= L'\x7F' && ch <= L'\x9F') || (ch >= L'\x200B' && ch <= L'\x200D')
+			|| ch == L'\x2060' || ch == L'\xFEFF';
+	}
+
+	static bool isDot(wchar_t ch) {
+		// includes the half-width and full-width forms
+		return ch == L'.' || ch == L'\xFF0E' || ch == L'\x30FB' || ch == L'\xFF65';
+	}
+
+	static size_t getEllipsisRunLength(const wstring& key, size_t index) {
+		size_t length = 0, dotCount = 0;
+
+		for (size_t i = index; i < key.length(); i++) {
+			if (key[i] == ELLIPSIS || key[i] == L'\x2025') dotCount += 2;
+			else if (isDot(key[i])) dotCount++;
+			else break;
+			length++;
+		}
+
+		return dotCount >= 2 ? length : 0;
+	}
+
+	static size_t foldHalfWidthKana(const wstring& key, size_t index, wstring& output) {
+		// full-width forms of U+FF61 - U+FF9F
+		static const wchar_t fullWidthKana[] = {
+			L'\x3002', L'\x300C', L'\x300D', L'\x3001', L'\x30FB', L'\x30F2', L'\x30A1', L'\x30A3',
+			L'\x30A5', L'\x30A7', L'\x30A9', L'\x30E3', L'\x30E5', L'\x30E7', L'\x30C3', L'\x30FC',
+			L'\x30A2', L'\x30A4', L'\x30A6', L'\x30A8', L'\x30AA', L'\x30AB', L'\x30AD', L'\x30AF',
+			L'\x30B1', L'\x30B3', L'\x30B5', L'\x30B7', L'\x30B9', L'\x30BB', L'\x30BD', L'\x30BF',
+			L'\x30C1', L'\x30C4', L'\x30C6', L'\x30C8', L'\x30CA', L'\x30CB', L'\x30CC', L'\x30CD',
+			L'\x30CE', L'\x30CF', L'\x30D2', L'\x30D5', L'\x30D8', L'\x30DB', L'\x30DE', L'\x30DF',
+			L'\x30E0', L'\x30E1', L'\x30E2', L'\x30E4', L'\x30E6', L'\x30E8', L'\x30E9', L'\x30EA',
+			L'\x30EB', L'\x30EC', L'\x30ED', L'\x30EF', L'\x30F3', L'\x3099', L'\x309A'
+		};
+
+		wchar_t kana = fullWidthKana[key[index] - L'\xFF61'];
+		wchar_t mark = index + 1 < key.length() ? key[index + 1] : L'\0';
+		wchar_t combined = L'\0';
+
+		if (mark == L'\xFF9E') combined = combineVoicedMark(kana);
+		else if (mark == L'\xFF9F') combined = combineSemiVoicedMark(kana);
+
+		output += combined != L'\0' ? combined : kana;
+		return combined != L'\0' ? 2 : 1;
+	}
+
+	// the voiced form of each kana from 'ka' to 'to' and from 'ha' to 'ho' directly follows it
+	static wchar_t combineVoicedMark(wchar_t kana) {
+		if (kana == L'\x30A6') return L'\x30F4';
+		if (kana >= L'\x30AB' && kana <= L'\x30C1' && (kana - L'\x30AB') % 2 == 0) return kana + 1;
+		if (kana == L'\x30C4' || kana == L'\x30C6' || kana == L'\x30C8') return kana + 1;
+		if (kana >= L'\x30CF' && kana <= L'\x30DB' && (kana - L'\x30CF') % 3 == 0) return kana + 1;
+		return L'\0';
+	}
+
+	static wchar_t combineSemiVoicedMark(wchar_t kana) {
+		if (kana >= L'\x30CF' && kana <= L'\x30DB' && (kana - L'\x30CF') % 3 == 0) return kana + 2;
+		return L'\0';
+	}
+};
+
+
+// How the entries of a cache would collapse into shared entries under a canonicalization (see the KeyReport tool).
+// Canonical keys are formatted like the cache formats the keys written to it.
+class KeyCollapseReport {
+public:
+	KeyCollapseReport(const unordered_map<wstring, wstring>& cache, const KeyCanonicalizer& keyCanonicalizer,
+		const TextFormatter& formatter, const ExtensionConfig& config) : _entryCount(cache.size())
+	{
+		for (const auto& textPair : cache) {
+			wstring canonicalKey = formatter.format(keyCanonicalizer.canonicalize(textPair.first, config));
+			if (canonicalKey != textPair.first) _changedCount++;
+			_groups[canonicalKey].push_back(textPair.first);
+		}
+	}
+
+	size_t getEntryCount() const {
+		return _entryCount;
+	}
+
+	size_t getChangedCount() const {
+		return _changedCount;
+	}
+
+	size_t getCanonicalKeyCount() const {
+		return _groups.size();
+	}
+
+	// the entries which would be dropped, all but one of each canonical key
+	size_t getCollapsedCount() const {
+		return _entryCount - _groups.size();
+	}
+
+	// the canonical keys shared by 2+ entries, largest group first (then by canonical key), each with its sorted keys
+	vector<pair<wstring, vector<wstring>>> getCollapsedGroups() const {
+		vector<pair<wstring, vector<wstring>>> collapsedGroups{};
+
+		for (const auto& group : _groups) {
+			if (group.second.size() < 2) continue;
+			collapsedGroups.push_back(group);
+			sort(collapsedGroups.back().second.begin(), collapsedGroups.back().second.end());
+		}
+
+		sort(collapsedGroups.begin(), collapsedGroups.end(), [](const auto& a, const auto& b) {
+			if (a.second.size() != b.second.size()) return a.second.size() > b.second.size();
+			return a.first < b.first;
+		});
+
+		return collapsedGroups;
+	}
+private:
+	size_t _entryCount;
+	size_t _changedCount = 0;
+	unordered_map<wstring, vector<wstring>> _groups{};
+};
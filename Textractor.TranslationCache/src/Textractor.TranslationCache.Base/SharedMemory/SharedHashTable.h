@@ -0,0 +1,544 @@
+
+#pragma once
+#include "../_Libraries/hashhelper.h"
+#include "SharedMemoryRegion.h"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <cwchar>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <windows.h>
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#endif
+
+
+// Open-addressing (linear probing) hash table of wstring key/value pairs, laid out in a single shared memory region:
+// header | slots | slab. Each slot owns a block of the slab holding its key followed by its value (as UTF-16).
+// Writers from any module/process mapping the region are serialized by a spin lock stored in the header, which holds
+// the id of the process holding it. A process which dies holding it (or while setting the table up) would leave
+// every other process spinning, so a holder is checked for every '_ownerCheckIntervalMs' of waiting, and the lock is
+// taken over from a dead one (a reused process id only delays this until that process exits).
+// Readers take no lock: each slot has a sequence counter which is odd while the slot is being written,
+// and the header has a generation counter which is odd while the whole table is being rebuilt (seqlock);
+// readers copy what they need through relaxed atomic loads, and retry if either counter changed in the meantime.
+class SharedHashTable {
+public:
+	SharedHashTable(shared_ptr<SharedMemoryRegion> region, uint32_t slotCount, uint32_t slabChars) 
+		: _region(region), _processId(getProcessId()) 
+	{
+		initTable(slotCount, slabChars);
+	}
+
+	static size_t getRegionSize(uint32_t slotCount, uint32_t slabChars) {
+		return sizeof(TableHeader) + (sizeof(TableSlot) * slotCount) + (sizeof(wchar_t) * slabChars);
+	}
+
+	wstring read(const wstring& key) const {
+		uint64_t keyHash = hashKey(key);
+		wstring value;
+
+		// a slot left odd by a writer which died is only repaired by the next writer, so a reader which keeps
+		// failing takes the lock itself (waiting for a live writer, or taking over from a dead one)
+		for (uint32_t attempt = 1; !tryRead(key, keyHash, value); attempt++) {
+			if (attempt % _readAttemptsBeforeLock == 0) lockWriters([]() { });
+			else this_thread::yield();
+		}
+
+		return value;
+	}
+
+	unordered_map<wstring, wstring> readAll() const {
+		unordered_map<wstring, wstring> entries{};
+
+		lockWriters([this, &entries]() {
+			for (uint32_t i = 0; i < _header->slotCount; i++) {
+				const TableSlot& slot = _slots[i];
+				if (slot.state.load(memory_order_relaxed) == SlotState::Used) entries[getSlotKey(slot)] = getSlotValue(slot);
+			}
+		});
+
+		return entries;
+	}
+
+	void write(const wstring& key, const wstring& value) {
+		uint64_t keyHash = hashKey(key);
+
+		lockWriters([this, &key, &value, keyHash]() {
+			writeBase(key, value, keyHash);
+		});
+	}
+
+	void remove(const wstring& key) {
+		uint64_t keyHash = hashKey(key);
+
+		lockWriters([this, &key, keyHash]() {
+			removeBase(key, keyHash);
+		});
+	}
+
+	// writes 'value' (or removes the key, if 'value' is empty) only if the key currently holds 'expectedValue'
+	// (an empty 'expectedValue' meaning the key is absent); returns whether it did
+	bool compareAndWrite(const wstring& key, const wstring& expectedValue, const wstring& value) {
+		uint64_t keyHash = hashKey(key);
+		bool written = false;
+
+		lockWriters([this, &key, &expectedValue, &value, keyHash, &written]() {
+			TableSlot* slot = findUsedSlot(key, keyHash);
+			wstring currentValue = slot != nullptr ? getSlotValue(*slot) : L"";
+			if (currentValue != expectedValue) return;
+
+			if (value.empty()) removeBase(key, keyHash);
+			else writeBase(key, value, keyHash);
+			written = true;
+		});
+
+		return written;
+	}
+
+	void clear() {
+		lockWriters([this]() {
+			rebuildTable(vector<pair<wstring, wstring>>{});
+		});
+	}
+private:
+	enum SlotState : uint32_t { Empty = 0, Used, Deleted };
+	// in between, the init state holds the id of the process setting the table up (no process has this id)
+	enum InitState : uint32_t { Uninitialized = 0, Ready = 0xFFFFFFFF };
+
+	// 'writeLock' holds the id of the process holding it, or 0
+	struct TableHeader {
+		char magic[8];
+		atomic<uint32_t> initState;
+		atomic<uint32_t> writeLock;
+		atomic<uint32_t> generation;
+		uint32_t slotCount;
+		uint32_t slabChars;
+		uint32_t slabUsed;
+		uint32_t liveCount;
+		uint32_t deletedCount;
+	};
+
+	// every field is read by readers while a writer may be changing it, hence atomic
+	struct TableSlot {
+		atomic<uint32_t> sequence;
+		atomic<uint32_t> state;
+		atomic<uint64_t> keyHash;
+		atomic<uint32_t> blockOffset;
+		atomic<uint32_t> blockCapacity;
+		atomic<uint32_t> keyLength;
+		atomic<uint32_t> valueLength;
+	};
+
+	typedef atomic<wchar_t> SlabChar;
+	static_assert(sizeof(SlabChar) == sizeof(wchar_t), "The slab is laid out as plain wchar_t.");
+
+	// how long a lock holder is waited for before checking that its process is still alive
+	struct OwnerWait {
+		uint32_t owner;
+		chrono::steady_clock::time_point since;
+	};
+
+	const string _tableMagic = "TCSHT002";
+	const uint32_t _blockAlignChars = 32;
+	const uint32_t _ownerCheckIntervalMs = 500;
+	const uint32_t _readAttemptsBeforeLock = 1024;
+	shared_ptr<SharedMemoryRegion> _region;
+	// a table is only used by the process which opened it
+	const uint32_t _processId;
+	TableHeader* _header = nullptr;
+	TableSlot* _slots = nullptr;
+	SlabChar* _slab = nullptr;
+
+
+	// *** INITIALIZATION
+
+	void initTable(uint32_t slotCount, uint32_t slabChars) {
+		if (_region->size() < sizeof(TableHeader)) throw runtime_error("Shared memory region is too small for a hash table.");
+		_header = static_cast<TableHeader*>(_region->data());
+
+		// the region is zero-filled on creation; whoever moves it out of 'Uninitialized' first sets it up,
+		// unless it dies doing so, in which case whoever notices takes over
+		uint32_t state = InitState::Uninitialized;
+		OwnerWait wait{};
+
+		while (!_header->initState.compare_exchange_weak(state, _processId, memory_order_acquire)) {
+			if (state == InitState::Ready) break;
+
+			if (state != InitState::Uninitialized && isOwnerDead(state, wait)
+				&& _header->initState.compare_exchange_strong(state, _processId, memory_order_acquire)) break;
+
+			state = InitState::Uninitialized;
+			this_thread::yield();
+		}
+
+		if (state != InitState::Ready) {
+			memcpy(_header->magic, _tableMagic.c_str(), sizeof(_header->magic));
+			_header->slotCount = slotCount;
+			_header->slabChars = slabChars;
+			_header->initState.store(InitState::Ready, memory_order_release);
+		}
+
+		// an existing table keeps its own dimensions
+		if (memcmp(_header->magic, _tableMagic.c_str(), sizeof(_header->magic)) != 0
+			|| _region->size() < getRegionSize(_header->slotCount, _header->slabChars))
+		{
+			throw runtime_error("Shared memory region does not hold a valid hash table.");
+		}
+
+		_slots = reinterpret_cast<TableSlot*>(_header + 1);
+		_slab = reinterpret_cast<SlabChar*>(_slots + _header->slotCount);
+	}
+
+
+	// *** READING
+
+	// returns false if the read overlapped with a write, and needs to be retried
+	bool tryRead(const wstring& key, uint64_t keyHash, wstring& value) const {
+		uint32_t generation = _header->generation.load(memory_order_acquire);
+		if (generation & 1) return false;
+
+		value = L"";
+		uint32_t slotCount = _header->slotCount;
+
+		for (uint32_t i = 0; i < slotCount; i++) {
+			const TableSlot& slot = _slots[(keyHash + i) % slotCount];
+			uint32_t sequence = slot.sequence.load(memory_order_acquire);
+			if (sequence & 1) return false;
+
+			uint32_t state = slot.state.load(memory_order_relaxed);
+			if (state == SlotState::Empty) break;
+			uint32_t keyLength = slot.keyLength.load(memory_order_relaxed);
+			if (state != SlotState::Used || slot.keyHash.load(memory_order_relaxed) != keyHash || keyLength != key.length())
+				continue;
+
+			uint32_t blockOffset = slot.blockOffset.load(memory_order_relaxed);
+			uint32_t valueLength = slot.valueLength.load(memory_order_relaxed);
+			if (!blockInBounds(blockOffset, keyLength + valueLength)) return false;
+
+			bool keyMatches = slabEquals(blockOffset, key);
+			if (keyMatches) readSlab(blockOffset + keyLength, valueLength, value);
+
+			atomic_thread_fence(memory_order_acquire);
+			if (slot.sequence.load(memory_order_relaxed) != sequence) return false;
+			if (keyMatches) break;
+			value = L"";
+		}
+
+		atomic_thread_fence(memory_order_acquire);
+		return _header->generation.load(memory_order_relaxed) == generation;
+	}
+
+	bool blockInBounds(uint32_t blockOffset, uint32_t length) const {
+		return blockOffset <= _header->slabChars && length <= _header->slabChars - blockOffset;
+	}
+
+	bool slabEquals(uint32_t offset, const wstring& text) const {
+		for (size_t i = 0; i < text.length(); i++) {
+			if (_slab[offset + i].load(memory_order_relaxed) != text[i]) return false;
+		}
+
+		return true;
+	}
+
+	void readSlab(uint32_t offset, uint32_t length, wstring& text) const {
+		text.resize(length);
+		for (uint32_t i = 0; i < length; i++) text[i] = _slab[offset + i].load(memory_order_relaxed);
+	}
+
+
+	// *** WRITING (writer lock held)
+
+	void writeBase(const wstring& key, const wstring& value, uint64_t keyHash) {
+		uint32_t length = static_cast<uint32_t>(key.length() + value.length());
+		if (length > _header->slabChars) throw runtime_error("Entry is too large for the shared memory hash table.");
+
+		TableSlot* slot = findUsedSlot(key, keyHash);
+		bool isNew = slot == nullptr;
+
+		if (isNew) {
+			// deleted slots lengthen probe chains, so they are cleared out once the table gets crowded
+			if (_header->deletedCount > 0 && _header->liveCount + _header->deletedCount >= _header->slotCount * 3 / 4)
+				rebuildTable(readAllBase());
+			slot = findFreeSlot(keyHash);
+			if (slot == nullptr) throw runtime_error("Shared memory hash table is full.");
+		}
+
+		uint32_t blockOffset = slot->blockOffset.load(memory_order_relaxed);
+		uint32_t blockCapacity = slot->blockCapacity.load(memory_order_relaxed);
+
+		if (length > blockCapacity) {
+			blockCapacity = alignBlockLength(length);
+			if (!allocateBlock(blockCapacity, blockOffset)) {
+				// rebuilding moves every slot, so the entry is written as part of the rebuild
+				vector<pair<wstring, wstring>> entries = readAllBase();
+				if (!isNew) removeEntry(entries, key);
+				entries.push_back(pair<wstring, wstring>(key, value));
+				rebuildTable(entries);
+				return;
+			}
+		}
+
+		if (isNew && slot->state.load(memory_order_relaxed) == SlotState::Deleted) _header->deletedCount--;
+		if (isNew) _header->liveCount++;
+		writeSlot(*slot, key, value, keyHash, blockOffset, blockCapacity);
+	}
+
+	void removeBase(const wstring& key, uint64_t keyHash) {
+		TableSlot* slot = findUsedSlot(key, keyHash);
+		if (slot == nullptr) return;
+
+		beginSlotWrite(*slot);
+		slot->state.store(SlotState::Deleted, memory_order_relaxed);
+		endSlotWrite(*slot);
+
+		_header->liveCount--;
+		_header->deletedCount++;
+	}
+
+	void writeSlot(TableSlot& slot, const wstring& key, const wstring& value,
+		uint64_t keyHash, uint32_t blockOffset, uint32_t blockCapacity)
+	{
+		beginSlotWrite(slot);
+		writeSlab(blockOffset, key);
+		writeSlab(blockOffset + static_cast<uint32_t>(key.length()), value);
+		slot.keyHash.store(keyHash, memory_order_relaxed);
+		slot.blockOffset.store(blockOffset, memory_order_relaxed);
+		slot.blockCapacity.store(blockCapacity, memory_order_relaxed);
+		slot.keyLength.store(static_cast<uint32_t>(key.length()), memory_order_relaxed);
+		slot.valueLength.store(static_cast<uint32_t>(value.length()), memory_order_relaxed);
+		slot.state.store(SlotState::Used, memory_order_relaxed);
+		endSlotWrite(slot);
+	}
+
+	void writeSlab(uint32_t offset, const wstring& text) {
+		for (size_t i = 0; i < text.length(); i++) _slab[offset + i].store(text[i], memory_order_relaxed);
+	}
+
+	void beginSlotWrite(TableSlot& slot) {
+		slot.sequence.fetch_add(1, memory_order_relaxed);
+		atomic_thread_fence(memory_order_release);
+	}
+
+	void endSlotWrite(TableSlot& slot) {
+		slot.sequence.fetch_add(1, memory_order_release);
+	}
+
+	bool allocateBlock(uint32_t length, uint32_t& blockOffset) {
+		if (length > _header->slabChars - _header->slabUsed) return false;
+		blockOffset = _header->slabUsed;
+		_header->slabUsed += length;
+		return true;
+	}
+
+	uint32_t alignBlockLength(uint32_t length) const {
+		uint32_t aligned = ((length / _blockAlignChars) + 1) * _blockAlignChars;
+		return aligned <= _header->slabChars ? aligned : length;
+	}
+
+	// rewrites every slot and the slab from scratch, dropping deleted slots and abandoned slab blocks.
+	// Entries which would not fit are turned down before anything is touched, so the table is left as it was.
+	void rebuildTable(const vector<pair<wstring, wstring>>& entries) {
+		if (!entriesFit(entries)) throw runtime_error("Shared memory hash table is full.");
+
+		_header->generation.fetch_add(1, memory_order_relaxed);
+		atomic_thread_fence(memory_order_release);
+
+		emptySlots();
+
+		for (const auto& entry : entries) {
+			uint64_t keyHash = hashKey(entry.first);
+			uint32_t length = static_cast<uint32_t>(entry.first.length() + entry.second.length());
+			uint32_t blockOffset = 0;
+			TableSlot* slot = findFreeSlot(keyHash);
+			allocateBlock(length, blockOffset);
+			writeSlot(*slot, entry.first, entry.second, keyHash, blockOffset, length);
+			_header->liveCount++;
+		}
+
+		_header->generation.fetch_add(1, memory_order_release);
+	}
+
+	// needs the generation to be odd
+	void emptySlots() const {
+		for (uint32_t i = 0; i < _header->slotCount; i++) {
+			TableSlot& slot = _slots[i];
+			slot.state.store(SlotState::Empty, memory_order_relaxed);
+			slot.blockOffset.store(0, memory_order_relaxed);
+			slot.blockCapacity.store(0, memory_order_relaxed);
+		}
+
+		_header->slabUsed = 0;
+		_header->liveCount = 0;
+		_header->deletedCount = 0;
+	}
+
+	// rebuilt entries take up an unaligned block each, and find a slot as long as there are enough of them
+	bool entriesFit(const vector<pair<wstring, wstring>>& entries) const {
+		if (entries.size() > _header->slotCount) return false;
+		uint64_t totalLength = 0;
+
+		for (const auto& entry : entries) totalLength += entry.first.length() + entry.second.length();
+		return totalLength <= _header->slabChars;
+	}
+
+	vector<pair<wstring, wstring>> readAllBase() const {
+		vector<pair<wstring, wstring>> entries{};
+
+		for (uint32_t i = 0; i < _header->slotCount; i++) {
+			const TableSlot& slot = _slots[i];
+			if (slot.state.load(memory_order_relaxed) == SlotState::Used)
+				entries.push_back(pair<wstring, wstring>(getSlotKey(slot), getSlotValue(slot)));
+		}
+
+		return entries;
+	}
+
+	static void removeEntry(vector<pair<wstring, wstring>>& entries, const wstring& key) {
+		for (auto it = entries.begin(); it != entries.end(); it++) {
+			if (it->first != key) continue;
+			entries.erase(it);
+			return;
+		}
+	}
+
+
+	// *** SLOT LOOKUP (writer lock held)
+
+	TableSlot* findUsedSlot(const wstring& key, uint64_t keyHash) const {
+		uint32_t slotCount = _header->slotCount;
+
+		for (uint32_t i = 0; i < slotCount; i++) {
+			TableSlot& slot = _slots[(keyHash + i) % slotCount];
+			uint32_t state = slot.state.load(memory_order_relaxed);
+			if (state == SlotState::Empty) return nullptr;
+			if (state == SlotState::Used && slot.keyHash.load(memory_order_relaxed) == keyHash
+				&& slot.keyLength.load(memory_order_relaxed) == key.length()
+				&& slabEquals(slot.blockOffset.load(memory_order_relaxed), key)) return &slot;
+		}
+
+		return nullptr;
+	}
+
+	TableSlot* findFreeSlot(uint64_t keyHash) const {
+		uint32_t slotCount = _header->slotCount;
+
+		for (uint32_t i = 0; i < slotCount; i++) {
+			TableSlot& slot = _slots[(keyHash + i) % slotCount];
+			if (slot.state.load(memory_order_relaxed) != SlotState::Used) return &slot;
+		}
+
+		return nullptr;
+	}
+
+	wstring getSlotKey(const TableSlot& slot) const {
+		wstring key;
+		readSlab(slot.blockOffset.load(memory_order_relaxed), slot.keyLength.load(memory_order_relaxed), key);
+		return key;
+	}
+
+	wstring getSlotValue(const TableSlot& slot) const {
+		wstring value;
+		uint32_t keyLength = slot.keyLength.load(memory_order_relaxed);
+		readSlab(slot.blockOffset.load(memory_order_relaxed) + keyLength, slot.valueLength.load(memory_order_relaxed), value);
+		return value;
+	}
+
+
+	// *** WRITER LOCK
+
+	void lockWriters(const function<void()>& action) const {
+		uint32_t owner = 0;
+		OwnerWait wait{};
+		bool tookOver = false;
+
+		while (!_header->writeLock.compare_exchange_weak(owner, _processId, memory_order_acquire)) {
+			if (owner != 0 && isOwnerDead(owner, wait)
+				&& _header->writeLock.compare_exchange_strong(owner, _processId, memory_order_acquire))
+			{
+				tookOver = true;
+				break;
+			}
+
+			owner = 0;
+			this_thread::yield();
+		}
+
+		if (tookOver) repairAbandonedTable();
+
+		try {
+			action();
+			_header->writeLock.store(0, memory_order_release);
+		}
+		catch (const exception&) {
+			_header->writeLock.store(0, memory_order_release);
+			throw;
+		}
+	}
+
+	// the dead writer may have left a slot, or the whole table, half-written (its counter odd); which entries are
+	// intact is then unknown, so the table is emptied (it only holds data which can be recomputed)
+	void repairAbandonedTable() const {
+		bool rebuilding = (_header->generation.load(memory_order_relaxed) & 1) != 0, torn = rebuilding;
+		for (uint32_t i = 0; i < _header->slotCount && !torn; i++) torn = (_slots[i].sequence.load(memory_order_relaxed) & 1) != 0;
+		if (!torn) return;
+
+		if (!rebuilding) _header->generation.fetch_add(1, memory_order_relaxed);
+		atomic_thread_fence(memory_order_release);
+		emptySlots();
+
+		for (uint32_t i = 0; i < _header->slotCount; i++) {
+			TableSlot& slot = _slots[i];
+			if (slot.sequence.load(memory_order_relaxed) & 1) slot.sequence.fetch_add(1, memory_order_release);
+		}
+
+		_header->generation.fetch_add(1, memory_order_release);
+	}
+
+	// the owner is only checked once it has held on for a whole interval, and then once per interval
+	bool isOwnerDead(uint32_t owner, OwnerWait& wait) const {
+		auto now = chrono::steady_clock::now();
+
+		if (owner != wait.owner) {
+			wait.owner = owner;
+			wait.since = now;
+			return false;
+		}
+
+		if (now - wait.since < chrono::milliseconds(_ownerCheckIntervalMs)) return false;
+		wait.since = now;
+		return !isProcessAlive(owner);
+	}
+
+	static uint32_t getProcessId() {
+#ifdef _WIN32
+		return GetCurrentProcessId();
+#else
+		return static_cast<uint32_t>(getpid());
+#endif
+	}
+
+	// a process which can't be opened for lack of rights still exists
+	static bool isProcessAlive(uint32_t processId) {
+#ifdef _WIN32
+		HANDLE hProcess = OpenProcess(SYNCHRONIZE, FALSE, processId);
+		if (hProcess == NULL) return GetLastError() == ERROR_ACCESS_DENIED;
+
+		bool alive = WaitForSingleObject(hProcess, 0) == WAIT_TIMEOUT;
+		CloseHandle(hProcess);
+		return alive;
+#else
+		return kill(static_cast<pid_t>(processId), 0) == 0 || errno == EPERM;
+#endif
+	}
+
+	static uint64_t hashKey(const wstring& key) {
+		return HashHelper::fnv1a(reinterpret_cast<const char*>(key.c_str()), key.length() * sizeof(wchar_t));
+	}
+};
@@ -0,0 +1,197 @@
+
+#pragma once
+#include "../_Libraries/strhelper.h"
+#include <memory>
+#include <string>
+#include <windows.h>
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#endif
+using namespace std;
+
+
+// A raw block of named shared memory, zero-filled when first created.
+class SharedMemoryRegion {
+public:
+	virtual ~SharedMemoryRegion() { }
+	virtual void* data() const = 0;
+	virtual size_t size() const = 0;
+};
+
+
+class SharedMemoryRegionManager {
+public:
+	virtual ~SharedMemoryRegionManager() { }
+	// if the region already exists, it is opened as is (its size is kept, even if it differs from 'size')
+	virtual shared_ptr<SharedMemoryRegion> createOrOpenRegion(const wstring& identifier, size_t size) = 0;
+};
+
+
+class WinApiSharedMemoryRegion : public SharedMemoryRegion {
+public:
+	WinApiSharedMemoryRegion(HANDLE hMapFile, LPVOID mapView, size_t size)
+		: _hMapFile(hMapFile), _mapView(mapView), _size(size) { }
+
+	virtual ~WinApiSharedMemoryRegion() {
+		if (_mapView != NULL) UnmapViewOfFile(_mapView);
+		if (_hMapFile != nullptr && _hMapFile != INVALID_HANDLE_VALUE) CloseHandle(_hMapFile);
+	}
+
+	void* data() const override {
+		return _mapView;
+	}
+
+	size_t size() const override {
+		return _size;
+	}
+private:
+	HANDLE _hMapFile;
+	LPVOID _mapView;
+	const size_t _size;
+};
+
+
+class WinApiSharedMemoryRegionManager : public SharedMemoryRegionManager {
+public:
+	shared_ptr<SharedMemoryRegion> createOrOpenRegion(const wstring& identifier, size_t size) override {
+		wstring mapName = _namePrefix + identifier;
+		HANDLE hMapFile = createOrOpenNamedMemMapping(mapName, size);
+		LPVOID mapView = MapViewOfFile(hMapFile, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+
+		if (mapView == NULL) {
+			string errMsg = "'MapViewOfFile' failed to map view of named shared memory region for name: "
+				+ StrHelper::convertFromW(mapName) + "; ErrCode: " + to_string(GetLastError());
+
+			CloseHandle(hMapFile);
+			throw runtime_error(errMsg);
+		}
+
+		return make_shared<WinApiSharedMemoryRegion>(hMapFile, mapView, getRegionSize(mapView));
+	}
+private:
+	const wstring _namePrefix = L"Local\\";
+
+	HANDLE createOrOpenNamedMemMapping(const wstring& mapName, size_t size) {
+		uint64_t size64 = static_cast<uint64_t>(size);
+
+		// opens the existing mapping instead, if one with this name already exists
+		HANDLE hMapFile = CreateFileMapping(
+			INVALID_HANDLE_VALUE,					// Use paging file
+			NULL,									// Default security
+			PAGE_READWRITE,							// Read/write access
+			static_cast<DWORD>(size64 >> 32),		// Maximum object size (high-order DWORD)
+			static_cast<DWORD>(size64),				// Maximum object size (low-order DWORD)
+			mapName.c_str()							// Name of the mapping object
+		);
+
+		if (hMapFile == nullptr || hMapFile == INVALID_HANDLE_VALUE) {
+			string errMsg = "'CreateFileMapping' failed to create named shared memory region for name: "
+				+ StrHelper::convertFromW(mapName) + "; ErrCode: " + to_string(GetLastError());
+
+			throw runtime_error(errMsg);
+		}
+
+		return hMapFile;
+	}
+
+	size_t getRegionSize(LPVOID mapView) {
+		MEMORY_BASIC_INFORMATION info{};
+		if (VirtualQuery(mapView, &info, sizeof(info)) == 0) return 0;
+		return info.RegionSize;
+	}
+};
+
+
+#ifndef _WIN32
+class PosixSharedMemoryRegion : public SharedMemoryRegion {
+public:
+	PosixSharedMemoryRegion(void* mapView, size_t size) : _mapView(mapView), _size(size) { }
+
+	virtual ~PosixSharedMemoryRegion() {
+		if (_mapView != MAP_FAILED) munmap(_mapView, _size);
+	}
+
+	void* data() const override {
+		return _mapView;
+	}
+
+	size_t size() const override {
+		return _size;
+	}
+private:
+	void* _mapView;
+	const size_t _size;
+};
+
+
+// Named regions through 'shm_open'. Unlike Windows mappings, a region outlives the processes using it,
+// until 'removeRegion' is called for it.
+class PosixSharedMemoryRegionManager : public SharedMemoryRegionManager {
+public:
+	PosixSharedMemoryRegionManager(const string& namePrefix = "/Textractor-") : _namePrefix(namePrefix) { }
+
+	shared_ptr<SharedMemoryRegion> createOrOpenRegion(const wstring& identifier, size_t size) override {
+		string mapName = getMapName(identifier);
+		int fd = shm_open(mapName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+
+		if (fd >= 0) {
+			// a newly created region is zero-filled by 'ftruncate'
+			if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+				close(fd);
+				shm_unlink(mapName.c_str());
+				throw runtime_error(getErrorMessage("ftruncate", mapName));
+			}
+		}
+		else if (errno == EEXIST) {
+			fd = openExistingRegion(mapName, size);
+		}
+		else {
+			throw runtime_error(getErrorMessage("shm_open", mapName));
+		}
+
+		void* mapView = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+		if (mapView == MAP_FAILED) throw runtime_error(getErrorMessage("mmap", mapName));
+
+		return make_shared<PosixSharedMemoryRegion>(mapView, size);
+	}
+
+	void removeRegion(const wstring& identifier) {
+		shm_unlink(getMapName(identifier).c_str());
+	}
+private:
+	const string _namePrefix;
+
+	// the creator may not have sized the region yet; the existing size is kept, as with Windows mappings
+	int openExistingRegion(const string& mapName, size_t& size) {
+		int fd = shm_open(mapName.c_str(), O_RDWR, 0600);
+		if (fd < 0) throw runtime_error(getErrorMessage("shm_open", mapName));
+
+		struct stat info{};
+		for (int i = 0; i < 1000 && fstat(fd, &info) == 0 && info.st_size == 0; i++) this_thread::yield();
+
+		if (info.st_size == 0) {
+			close(fd);
+			throw runtime_error("Named shared memory region was never sized: " + mapName);
+		}
+
+		size = static_cast<size_t>(info.st_size);
+		return fd;
+	}
+
+	string getMapName(const wstring& identifier) const {
+		string name = StrHelper::convertFromW(identifier);
+		for (char& c : name) if (c == '/' || c == '\\') c = '_';
+		return _namePrefix + name;
+	}
+
+	static string getErrorMessage(const string& functionName, const string& mapName) {
+		return "'" + functionName + "' failed for named shared memory region: " + mapName + "; ErrCode: " + to_string(errno);
+	}
+};
+#endif
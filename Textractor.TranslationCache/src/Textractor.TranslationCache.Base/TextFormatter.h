@@ -9,22 +9,39 @@ class TextFormatter {
 public:
 	virtual ~TextFormatter() { }
 	virtual wstring format(wstring text) const = 0;
+
+	// same as 'format', for UTF-8 text (ex: a line read from a cache file); the default converts to UTF-16 and back,
+	// so formatters that can work on the UTF-8 bytes directly should override it
+	virtual string formatUtf8(string text) const {
+		return StrHelper::convertFromW(format(StrHelper::convertToW(text)));
+	}
 };
 
 
 class DefaultTextFormatter : public TextFormatter {
 public:
 	wstring format(wstring text) const override {
-		return trimWS(text);
+		return trimWS<wchar_t>(move(text), _wsStrs);
+	}
+
+	string formatUtf8(string text) const override {
+		return trimWS<char>(move(text), _utf8WsStrs);
 	}
 private:
 	const vector<wstring> _wsStrs = { L" ", L"　", L"\r", L"\n", L"\t" };
+	// UTF-8 is self-synchronizing, so trimming the encoded sequences gives the same result as trimming the characters
+	const vector<string> _utf8WsStrs = { " ", "\xE3\x80\x80", "\r", "\n", "\t" };
+
+	// trimmed as a view, so that only the result is copied (and only if anything was trimmed); 'text' is moved in and out
+	template<class charT>
+	static string_base<charT> trimWS(string_base<charT> text, const vector<string_base<charT>>& wsStrs) {
+		StrView<charT> trimmed(text);
 
-	wstring trimWS(wstring text) const {
-		for (const wstring& ws : _wsStrs) {
-			text = StrHelper::trim<wchar_t>(text, ws);
+		for (const string_base<charT>& ws : wsStrs) {
+			trimmed = StrHelper::trimView<charT>(trimmed, ws);
 		}
 
-		return text;
+		if (trimmed.length() == text.length()) return text;
+		return trimmed.str();
 	}
 };
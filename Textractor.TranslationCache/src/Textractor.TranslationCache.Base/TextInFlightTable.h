@@ -0,0 +1,310 @@
+
+#pragma once
+#include "Cache/TextMapCache.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+
+// Marks the keys currently being translated, so that a sentence repeated while its translation is still underway
+// (ex: a hook firing twice) waits for and reuses that translation, rather than being translated a second time.
+class TextInFlightTable {
+public:
+	virtual ~TextInFlightTable() { }
+	// Called on a cache miss. Claims 'key' and returns an empty string if no translation of it is underway;
+	// otherwise waits for that translation, and returns it.
+	virtual wstring claimOrWait(const wstring& key) = 0;
+	// The translation of a claimed key is done (an empty 'value' releases the claim, without a translation).
+	virtual void complete(const wstring& key, const wstring& value) = 0;
+	// Called by the module completing the claims, for as long as it is there to complete them
+	virtual void startMaintenance() = 0;
+	virtual void stopMaintenance() = 0;
+};
+
+
+class NoTextInFlightTable : public TextInFlightTable {
+public:
+	wstring claimOrWait(const wstring& key) override {
+		return L"";
+	}
+
+	void complete(const wstring& key, const wstring& value) override { }
+	void startMaintenance() override { }
+	void stopMaintenance() override { }
+};
+
+
+// Keeps the table in a map cache shared between modules (ex: a shared memory cache), holding for each key:
+// "P<claim time>" while it is being translated, then "D<completion time>\x1F<translation>" for 'completedTtlMs',
+// so that a repeat arriving right after the translation (before it reaches the reader's cache) reuses it as well.
+// The module completing the claims keeps a heartbeat in the table (along with the recent claim-to-completion time),
+// and prunes the entries it completed once expired, every 'maintenanceIntervalMs', from its maintenance thread.
+// Reading the whole table holds up the other module's claims, so claims which were never completed are only swept
+// every FULL_SWEEP_INTERVALS maintenance runs (until then, they are taken over by the next sentence once expired).
+// While that heartbeat is missing, nothing is claimed or waited for, and leftover claims are released.
+// A repeat waits for about one round trip (capped at 'maxWaitMs', kept short since it holds up the text thread)
+// after the claim, then gets translated itself.
+// A claim older than 'claimTimeoutMs' is considered abandoned (ex: the sentence never reached the writer),
+// and is taken over by the next sentence.
+class MapCacheTextInFlightTable : public TextInFlightTable {
+public:
+	MapCacheTextInFlightTable(TextMapCache& cache, AtomicTextMapCache& atomicCache,
+		uint32_t claimTimeoutMs = 10000, uint32_t completedTtlMs = 5000, uint32_t pollIntervalMs = 20,
+		uint32_t maintenanceIntervalMs = 1000, uint32_t maxWaitMs = 500) : _cache(cache), _atomicCache(atomicCache),
+			_claimTimeoutMs(claimTimeoutMs), _completedTtlMs(completedTtlMs), _pollInterval(pollIntervalMs),
+			_maintenanceInterval(maintenanceIntervalMs), _maxWaitMs(maxWaitMs) { }
+
+	~MapCacheTextInFlightTable() {
+		stopMaintenance();
+	}
+
+	wstring claimOrWait(const wstring& key) override {
+		try {
+			uint64_t waitLimitMs = 0;
+			if (readWriterState(waitLimitMs)) return claimOrWaitBase(key, waitLimitMs);
+
+			releaseClaim(key);
+			return L"";
+		}
+		catch (const exception&) {
+			// the table only saves duplicate translations, so the sentence is simply translated if it fails
+			return L"";
+		}
+	}
+
+	void complete(const wstring& key, const wstring& value) override {
+		try {
+			wstring rawEntry = _cache.readFromCache(key);
+			if (rawEntry.empty()) return;
+
+			Entry entry = parseEntry(rawEntry);
+			if (entry.completed) return;
+
+			uint64_t nowMs = getTimeMs();
+			wstring completedEntry = value.empty() ? L"" : createEntry(COMPLETED_PREFIX, nowMs, value);
+			if (_atomicCache.compareAndWrite(key, rawEntry, completedEntry) && !value.empty()) {
+				recordRoundTrip(nowMs > entry.timeMs ? nowMs - entry.timeMs : 0);
+				recordCompletion(key, nowMs);
+			}
+		}
+		catch (const exception&) { }
+	}
+
+	void startMaintenance() override {
+		if (_maintenanceThread.joinable()) return;
+
+		_stopMaintenance = false;
+		writeHeartbeat();
+		_maintenanceThread = thread([this]() { runMaintenance(); });
+	}
+
+	// the heartbeat is removed, so that the other module stops claiming at once
+	void stopMaintenance() override {
+		{
+			lock_guard<mutex> lock(_maintenanceMtx);
+			_stopMaintenance = true;
+		}
+
+		_maintenanceCv.notify_one();
+		if (!_maintenanceThread.joinable()) return;
+		_maintenanceThread.join();
+
+		try {
+			_cache.removeFromCache(WRITER_KEY);
+		}
+		catch (const exception&) { }
+	}
+private:
+	struct Entry {
+		bool completed;
+		uint64_t timeMs;
+		wstring value;
+	};
+
+	const wchar_t CLAIMED_PREFIX = L'P';
+	const wchar_t COMPLETED_PREFIX = L'D';
+	const wchar_t WRITER_PREFIX = L'W';
+	const wchar_t VALUE_SEPARATOR = L'\x1F';
+	const uint32_t FULL_SWEEP_INTERVALS = 60;
+	// past this, the oldest completions are left to the full sweep
+	const size_t MAX_TRACKED_COMPLETIONS = 4096;
+	// can't come from a sentence, since keys are trimmed and the separator is not whitespace
+	const wstring WRITER_KEY = L"\x1F" L"WRITER";
+	TextMapCache& _cache;
+	AtomicTextMapCache& _atomicCache;
+	const uint64_t _claimTimeoutMs;
+	const uint64_t _completedTtlMs;
+	const chrono::milliseconds _pollInterval;
+	const chrono::milliseconds _maintenanceInterval;
+	const uint64_t _maxWaitMs;
+	// smoothed claim-to-completion time seen by the writer (0 until the first completion)
+	atomic<uint64_t> _roundTripMs{ 0 };
+	mutex _maintenanceMtx;
+	condition_variable _maintenanceCv;
+	bool _stopMaintenance = false;
+	thread _maintenanceThread;
+	uint32_t _maintenanceCount = 0;
+	// the keys this module completed, oldest first
+	mutex _completionsMtx;
+	deque<pair<wstring, uint64_t>> _completions{};
+
+	wstring claimOrWaitBase(const wstring& key, uint64_t waitLimitMs) {
+		while (true) {
+			wstring rawEntry = _cache.readFromCache(key);
+			Entry entry = parseEntry(rawEntry);
+			uint64_t nowMs = getTimeMs();
+
+			if (rawEntry.empty() || isExpired(entry, nowMs)) {
+				// another sentence may claim the key in between, in which case it gets checked again
+				wstring claimEntry = createEntry(CLAIMED_PREFIX, nowMs, L"");
+				if (_atomicCache.compareAndWrite(key, rawEntry, claimEntry)) return L"";
+			}
+			else if (entry.completed) {
+				return entry.value;
+			}
+			else if (nowMs - min<uint64_t>(nowMs, entry.timeMs) >= waitLimitMs) {
+				// the translation is late, so the sentence is translated again rather than holding up the text thread;
+				// the claim is left alone, and gets completed by whichever translation arrives first
+				return L"";
+			}
+			else {
+				this_thread::sleep_for(_pollInterval);
+			}
+		}
+	}
+
+	// Whether the writer is there to complete claims, and how long to wait for it to complete one
+	bool readWriterState(uint64_t& waitLimitMs) {
+		Entry heartbeat = parseEntry(_cache.readFromCache(WRITER_KEY));
+		uint64_t nowMs = getTimeMs();
+		if (heartbeat.timeMs == 0 || nowMs - min<uint64_t>(nowMs, heartbeat.timeMs) >= 3 * getMaintenanceIntervalMs())
+			return false;
+
+		uint64_t roundTripMs = 0;
+		try {
+			roundTripMs = stoull(heartbeat.value);
+		}
+		catch (const exception&) { }
+
+		waitLimitMs = roundTripMs > 0 ? min<uint64_t>(_maxWaitMs, roundTripMs + roundTripMs / 2) : _maxWaitMs;
+		return true;
+	}
+
+	// with no writer, a claim (this module's, or one left over) would only hold up the repeats of its sentence
+	void releaseClaim(const wstring& key) {
+		wstring rawEntry = _cache.readFromCache(key);
+		if (!rawEntry.empty() && !parseEntry(rawEntry).completed) _atomicCache.compareAndWrite(key, rawEntry, L"");
+	}
+
+	void recordRoundTrip(uint64_t roundTripMs) {
+		uint64_t previousMs = _roundTripMs.load();
+		_roundTripMs = previousMs == 0 ? max<uint64_t>(roundTripMs, 1) : (previousMs * 3 + roundTripMs) / 4;
+	}
+
+	void runMaintenance() {
+		unique_lock<mutex> lock(_maintenanceMtx);
+
+		while (!_maintenanceCv.wait_for(lock, _maintenanceInterval, [this]() { return _stopMaintenance; })) {
+			lock.unlock();
+
+			try {
+				writeHeartbeat();
+				pruneExpired();
+			}
+			catch (const exception&) { }
+
+			lock.lock();
+		}
+	}
+
+	void writeHeartbeat() {
+		try {
+			_cache.writeToCache(WRITER_KEY, createEntry(WRITER_PREFIX, getTimeMs(), to_wstring(_roundTripMs.load())));
+		}
+		catch (const exception&) { }
+	}
+
+	void recordCompletion(const wstring& key, uint64_t completionMs) {
+		lock_guard<mutex> lock(_completionsMtx);
+		_completions.push_back(pair<wstring, uint64_t>(key, completionMs));
+		if (_completions.size() > MAX_TRACKED_COMPLETIONS) _completions.pop_front();
+	}
+
+	vector<wstring> takeExpiredCompletions(uint64_t nowMs) {
+		vector<wstring> keys{};
+		lock_guard<mutex> lock(_completionsMtx);
+
+		while (!_completions.empty() && nowMs - min<uint64_t>(nowMs, _completions.front().second) >= _completedTtlMs) {
+			keys.push_back(move(_completions.front().first));
+			_completions.pop_front();
+		}
+
+		return keys;
+	}
+
+	void pruneExpired() {
+		uint64_t nowMs = getTimeMs();
+
+		for (const wstring& key : takeExpiredCompletions(nowMs)) {
+			pruneEntry(key, _cache.readFromCache(key), nowMs);
+		}
+
+		if (++_maintenanceCount % FULL_SWEEP_INTERVALS != 0) return;
+
+		for (const auto& rawEntry : _cache.readAllFromCache()) {
+			if (rawEntry.first != WRITER_KEY) pruneEntry(rawEntry.first, rawEntry.second, nowMs);
+		}
+	}
+
+	// the entry may have been claimed again since, in which case it is left alone
+	void pruneEntry(const wstring& key, const wstring& rawEntry, uint64_t nowMs) {
+		if (!rawEntry.empty() && isExpired(parseEntry(rawEntry), nowMs)) _atomicCache.compareAndWrite(key, rawEntry, L"");
+	}
+
+	uint64_t getMaintenanceIntervalMs() const {
+		return static_cast<uint64_t>(_maintenanceInterval.count());
+	}
+
+	bool isExpired(const Entry& entry, uint64_t nowMs) const {
+		uint64_t ageMs = nowMs > entry.timeMs ? nowMs - entry.timeMs : 0;
+		return ageMs >= (entry.completed ? _completedTtlMs : _claimTimeoutMs);
+	}
+
+	wstring createEntry(wchar_t prefix, uint64_t timeMs, const wstring& value) const {
+		wstring entry = prefix + to_wstring(timeMs);
+		return prefix != CLAIMED_PREFIX ? entry + VALUE_SEPARATOR + value : entry;
+	}
+
+	// an unreadable entry is treated as a claim from long ago, so it gets taken over
+	Entry parseEntry(const wstring& rawEntry) const {
+		Entry entry{ false, 0, L"" };
+		if (rawEntry.length() < 2) return entry;
+
+		size_t separatorIndex = rawEntry.find(VALUE_SEPARATOR);
+		wstring timeStr = rawEntry.substr(1, separatorIndex != wstring::npos ? separatorIndex - 1 : wstring::npos);
+
+		try {
+			entry.timeMs = stoull(timeStr);
+		}
+		catch (const exception&) {
+			return entry;
+		}
+
+		if (separatorIndex != wstring::npos) {
+			entry.completed = rawEntry[0] == COMPLETED_PREFIX;
+			entry.value = rawEntry.substr(separatorIndex + 1);
+		}
+
+		return entry;
+	}
+
+	static uint64_t getTimeMs() {
+		return static_cast<uint64_t>(chrono::duration_cast<chrono::milliseconds>(
+			chrono::steady_clock::now().time_since_epoch()).count());
+	}
+};
@@ -8,6 +8,17 @@ public:
 	virtual ~TextMapper() { }
 	virtual wstring merge(const wstring& text1, const wstring& text2) const = 0;
 	virtual pair<wstring, wstring> split(wstring text) const = 0;
+
+	// same as 'merge'/'split', for UTF-8 text; the defaults convert to UTF-16 and back,
+	// so mappers that can work on the UTF-8 bytes directly should override them
+	virtual string mergeUtf8(const string& text1, const string& text2) const {
+		return StrHelper::convertFromW(merge(StrHelper::convertToW(text1), StrHelper::convertToW(text2)));
+	}
+
+	virtual pair<string, string> splitUtf8(const string& text) const {
+		pair<wstring, wstring> textPair = split(StrHelper::convertToW(text));
+		return pair<string, string>(StrHelper::convertFromW(textPair.first), StrHelper::convertFromW(textPair.second));
+	}
 };
 
 
@@ -20,11 +31,13 @@ public:
 	}
 
 	pair<wstring, wstring> split(wstring text) const override {
-		vector<wstring> splitStrs = StrHelper::split<wchar_t>(text, ZERO_WIDTH_SPACE);
-		if (splitStrs.size() < 2) return pair<wstring, wstring>(text, L"");
+		// the first and last parts, without copying the ones in between
+		size_t firstDelimIndex = text.find(ZERO_WIDTH_SPACE);
+		if (firstDelimIndex == wstring::npos) return pair<wstring, wstring>(text, L"");
+		size_t lastDelimIndex = text.rfind(ZERO_WIDTH_SPACE);
 
-		wstring str1 = _formatter.format(splitStrs[0]);
-		wstring str2 = _formatter.format(splitStrs.back());
+		wstring str1 = _formatter.format(text.substr(0, firstDelimIndex));
+		wstring str2 = _formatter.format(text.substr(lastDelimIndex + 1));
 		return pair<wstring, wstring>(str1, str2);
 	}
 private:
@@ -37,7 +50,7 @@ private:
 class DelimTextMapper : public TextMapper {
 public:
 	DelimTextMapper(const TextFormatter& formatter, const wstring& delim) 
-		: _formatter(formatter), _delim(delim) { }
+		: _formatter(formatter), _delim(delim), _utf8Delim(StrHelper::convertFromW(delim)) { }
 	DelimTextMapper(const TextFormatter& formatter) : DelimTextMapper(formatter, _defaultDelim) { }
 
 	wstring merge(const wstring& text1, const wstring& text2) const override {
@@ -48,10 +61,24 @@ public:
 		pair<wstring, wstring> textPair = splitToPair(text, _delim);
 		return textPair;
 	}
+
+	string mergeUtf8(const string& text1, const string& text2) const override {
+		return _formatter.formatUtf8(text1) + _utf8Delim + _formatter.formatUtf8(text2);
+	}
+
+	pair<string, string> splitUtf8(const string& text) const override {
+		size_t delimIndex = text.find(_utf8Delim);
+		if (delimIndex == string::npos) return pair<string, string>(text, "");
+
+		string str1 = _formatter.formatUtf8(text.substr(0, delimIndex));
+		string str2 = _formatter.formatUtf8(text.substr(delimIndex + _utf8Delim.length()));
+		return pair<string, string>(str1, str2);
+	}
 private:
 	const wstring _defaultDelim = L"|~|";
 	const TextFormatter& _formatter;
 	const wstring _delim;
+	const string _utf8Delim;
 
 
 	pair<wstring, wstring> splitToPair(const wstring& text, const wstring& delim) const {
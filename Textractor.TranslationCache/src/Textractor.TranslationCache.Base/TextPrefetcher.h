@@ -0,0 +1,166 @@
+
+#pragma once
+#include "_Libraries/Locker.h"
+#include "Extension.h"
+#include "Cache/BoundedMemoryTextMapCache.h"
+#include "Cache/TextMapCache.h"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+
+// Learns the order in which text is looked up, to load the text predicted to come next before it's looked up.
+class TextPrefetcher {
+public:
+	virtual ~TextPrefetcher() { }
+	// 'key' was looked up on the thread of 'sentInfoWrapper'; 'hit' is whether it had a cached value
+	virtual void onLookup(SentenceInfoWrapper& sentInfoWrapper, const wstring& key, bool hit) = 0;
+};
+
+
+class NoTextPrefetcher : public TextPrefetcher {
+public:
+	void onLookup(SentenceInfoWrapper& sentInfoWrapper, const wstring& key, bool hit) override { }
+};
+
+
+// Remembers, for each key, the key which most often followed it on the same thread (using a majority vote:
+// a different successor has to outnumber the current one before replacing it, so a one-off detour doesn't break the chain).
+// After a hit, follows the chain of successors up to 'prefetchDepth' keys ahead, and loads the ones which are not yet
+// in 'warmTarget' from 'sourceCache', on a background thread.
+// Up to 'maxTrackedKeys' keys are remembered; past that, what was learned is dropped and learning starts over.
+class SuccessorTextPrefetcher : public TextPrefetcher {
+public:
+	SuccessorTextPrefetcher(CacheWarmTarget& warmTarget, const TextMapCache& sourceCache,
+		const TextFormatter& formatter, size_t prefetchDepth = 3, size_t maxTrackedKeys = 65536)
+		: _warmTarget(warmTarget), _sourceCache(sourceCache), _formatter(formatter),
+			_prefetchDepth(prefetchDepth), _maxTrackedKeys(maxTrackedKeys)
+	{
+		_prefetchThread = thread([this]() { runPrefetcher(); });
+	}
+
+	~SuccessorTextPrefetcher() {
+		{
+			lock_guard<mutex> lock(_mtx);
+			_stopping = true;
+		}
+
+		_workCv.notify_one();
+		if (_prefetchThread.joinable()) _prefetchThread.join();
+	}
+
+	void onLookup(SentenceInfoWrapper& sentInfoWrapper, const wstring& key, bool hit) override {
+		wstring formattedKey = _formatter.format(key);
+		wstring threadNumber = sentInfoWrapper.getThreadNumberW();
+		if (formattedKey.empty()) return;
+
+		vector<wstring> predictedKeys{};
+
+		_locker.lock([this, &formattedKey, &threadNumber, hit, &predictedKeys]() {
+			wstring& lastKey = _lastKeys[threadNumber];
+			if (!lastKey.empty() && lastKey != formattedKey) recordSuccessor(lastKey, formattedKey);
+			lastKey = formattedKey;
+
+			if (hit) predictedKeys = getPredictedKeys(formattedKey);
+		});
+
+		if (!predictedKeys.empty()) enqueue(predictedKeys);
+	}
+private:
+	struct Successor {
+		wstring key;
+		uint32_t votes;
+	};
+
+	const uint32_t MAX_VOTES = 8;
+	const size_t MAX_QUEUED_KEYS = 64;
+	CacheWarmTarget& _warmTarget;
+	const TextMapCache& _sourceCache;
+	const TextFormatter& _formatter;
+	const size_t _prefetchDepth;
+	const size_t _maxTrackedKeys;
+
+	BasicLocker _locker;
+	unordered_map<wstring, Successor> _successors{};
+	unordered_map<wstring, wstring> _lastKeys{};
+
+	mutex _mtx;
+	condition_variable _workCv;
+	deque<wstring> _queue{};
+	bool _stopping = false;
+	thread _prefetchThread;
+
+	void recordSuccessor(const wstring& key, const wstring& nextKey) {
+		auto it = _successors.find(key);
+
+		if (it == _successors.end()) {
+			if (_successors.size() >= _maxTrackedKeys) _successors.clear();
+			_successors[key] = Successor{ nextKey, 1 };
+			return;
+		}
+
+		Successor& successor = it->second;
+		if (successor.key == nextKey) successor.votes = min<uint32_t>(successor.votes + 1, MAX_VOTES);
+		else if (successor.votes > 1) successor.votes--;
+		else successor = Successor{ nextKey, 1 };
+	}
+
+	vector<wstring> getPredictedKeys(const wstring& key) const {
+		vector<wstring> predictedKeys{};
+		unordered_set<wstring> visitedKeys{ key };
+		wstring currentKey = key;
+
+		while (predictedKeys.size() < _prefetchDepth) {
+			auto it = _successors.find(currentKey);
+			if (it == _successors.end() || !visitedKeys.insert(it->second.key).second) break;
+
+			currentKey = it->second.key;
+			predictedKeys.push_back(currentKey);
+		}
+
+		return predictedKeys;
+	}
+
+	// the oldest predictions are dropped if the prefetcher falls behind, since that text has likely been read by then
+	void enqueue(const vector<wstring>& keys) {
+		{
+			lock_guard<mutex> lock(_mtx);
+			for (const wstring& key : keys) _queue.push_back(key);
+			while (_queue.size() > MAX_QUEUED_KEYS) _queue.pop_front();
+		}
+
+		_workCv.notify_one();
+	}
+
+	void runPrefetcher() {
+		while (true) {
+			wstring key;
+
+			{
+				unique_lock<mutex> lock(_mtx);
+				_workCv.wait(lock, [this]() { return _stopping || !_queue.empty(); });
+				if (_stopping) return;
+
+				key = move(_queue.front());
+				_queue.pop_front();
+			}
+
+			prefetch(key);
+		}
+	}
+
+	void prefetch(const wstring& key) {
+		try {
+			if (_warmTarget.isWarm(key)) return;
+
+			wstring value = _sourceCache.readFromCache(key);
+			if (!value.empty()) _warmTarget.warmEntry(key, value);
+		}
+		catch (const exception&) {
+			// prefetching is an optimization only; the text is looked up as usual once it comes up
+		}
+	}
+};
@@ -0,0 +1,113 @@
+
+#pragma once
+#include "hashhelper.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+using namespace std;
+
+
+// Bloom filter with 8-bit counters instead of bits, so that entries can be removed as well as added.
+// Sized for 'expectedCount' entries at a false positive rate of 'targetFpRate'.
+// Counters saturate rather than overflow; a saturated counter is never decremented again.
+// Removing an entry that was never added can cause false negatives, so callers must only remove what they added.
+class CountingBloomFilter {
+public:
+	CountingBloomFilter(size_t expectedCount, double targetFpRate) {
+		double count = static_cast<double>(max<size_t>(expectedCount, 1));
+		double fpRate = min<double>(max<double>(targetFpRate, 0.0001), 0.5);
+		double ln2 = log(2.0);
+
+		size_t counterCount = static_cast<size_t>(ceil(-count * log(fpRate) / (ln2 * ln2)));
+		_counters = vector<uint8_t>(max<size_t>(counterCount, 64), 0);
+		_hashCount = static_cast<uint32_t>(min<double>(max<double>(round(_counters.size() / count * ln2), 1.0), 16.0));
+		_capacity = max<size_t>(expectedCount, 1);
+	}
+
+	// hashes a key into the 64-bit value expected by the other methods (stable across 32/64-bit builds)
+	static uint64_t hashKey(const wstring& key) {
+		return HashHelper::fnv1a(reinterpret_cast<const char*>(key.c_str()), key.length() * sizeof(wchar_t));
+	}
+
+	void add(uint64_t keyHash) {
+		forEachCounter(keyHash, [](uint8_t& counter) {
+			if (counter < UINT8_MAX) counter++;
+		});
+
+		_count++;
+	}
+
+	void remove(uint64_t keyHash) {
+		forEachCounter(keyHash, [](uint8_t& counter) {
+			if (counter > 0 && counter < UINT8_MAX) counter--;
+		});
+
+		if (_count > 0) _count--;
+	}
+
+	bool mightContain(uint64_t keyHash) const {
+		bool found = true;
+
+		forEachCounter(keyHash, [&found](const uint8_t& counter) {
+			if (counter == 0) found = false;
+		});
+
+		return found;
+	}
+
+	void clear() {
+		fill(_counters.begin(), _counters.end(), static_cast<uint8_t>(0));
+		_count = 0;
+	}
+
+	size_t getCount() const {
+		return _count;
+	}
+
+	size_t getCapacity() const {
+		return _capacity;
+	}
+
+	// false positive rate expected from the current entry count: (1 - e^(-kn/m))^k
+	double getEstimatedFpRate() const {
+		double exponent = -static_cast<double>(_hashCount) * _count / _counters.size();
+		return pow(1.0 - exp(exponent), _hashCount);
+	}
+private:
+	vector<uint8_t> _counters;
+	uint32_t _hashCount;
+	size_t _capacity;
+	size_t _count = 0;
+
+	// double hashing: the i-th counter index is (h1 + i * h2) mod m, with both halves derived from one 64-bit hash
+	template<typename TCounters, typename TAction>
+	static void forEachCounter(TCounters& counters, uint32_t hashCount, uint64_t keyHash, TAction action) {
+		uint64_t h1 = keyHash;
+		uint64_t h2 = mix(keyHash) | 1;
+
+		for (uint32_t i = 0; i < hashCount; i++) {
+			action(counters[static_cast<size_t>((h1 + i * h2) % counters.size())]);
+		}
+	}
+
+	template<typename TAction>
+	void forEachCounter(uint64_t keyHash, TAction action) {
+		forEachCounter(_counters, _hashCount, keyHash, action);
+	}
+
+	template<typename TAction>
+	void forEachCounter(uint64_t keyHash, TAction action) const {
+		forEachCounter(_counters, _hashCount, keyHash, action);
+	}
+
+	// splitmix64 finalizer
+	static uint64_t mix(uint64_t x) {
+		x ^= x >> 30;
+		x *= 0xbf58476d1ce4e5b9ULL;
+		x ^= x >> 27;
+		x *= 0x94d049bb133111ebULL;
+		return x ^ (x >> 31);
+	}
+};
@@ -0,0 +1,113 @@
+
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <nmmintrin.h>
+#define CRC32C_HARDWARE_AVAILABLE
+#define CRC32C_TARGET_SSE42
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <nmmintrin.h>
+#define CRC32C_HARDWARE_AVAILABLE
+// the rest of the file is built without SSE4.2, which is only used once the CPU is known to support it
+#define CRC32C_TARGET_SSE42 __attribute__((target("sse4.2")))
+#endif
+using namespace std;
+
+
+// CRC-32C (Castagnoli polynomial). Uses the SSE4.2 'crc32' instruction when the CPU supports it
+// (checked once, at runtime), and a lookup table otherwise; both give the same results.
+class Crc32c {
+public:
+	static uint32_t compute(const char* data, size_t length, uint32_t crc = 0) {
+#ifdef CRC32C_HARDWARE_AVAILABLE
+		if (isHardwareSupported()) return computeHardware(data, length, crc);
+#endif
+
+		return computeSoftware(data, length, crc);
+	}
+
+	static uint32_t compute(const string& bytes) {
+		return compute(bytes.c_str(), bytes.length());
+	}
+
+	// each path on its own (ex: to check one against the other)
+	static uint32_t computeSoftware(const char* data, size_t length, uint32_t crc = 0) {
+		return ~updateSoftware(data, length, ~crc);
+	}
+
+#ifdef CRC32C_HARDWARE_AVAILABLE
+	static bool isHardwareSupported() {
+		static const bool supported = []() {
+#ifdef _MSC_VER
+			int cpuInfo[4] = { 0 };
+			__cpuid(cpuInfo, 1);
+			return (cpuInfo[2] & (1 << 20)) != 0; // ECX bit 20: SSE4.2
+#else
+			return __builtin_cpu_supports("sse4.2") != 0;
+#endif
+		}();
+
+		return supported;
+	}
+
+	// only to be called if 'isHardwareSupported'
+	static uint32_t computeHardware(const char* data, size_t length, uint32_t crc = 0) {
+		return ~updateHardware(data, length, ~crc);
+	}
+#endif
+private:
+	static constexpr uint32_t POLYNOMIAL = 0x82F63B78; // reversed 0x1EDC6F41
+
+	static uint32_t updateSoftware(const char* data, size_t length, uint32_t crc) {
+		static const vector<uint32_t> table = createTable();
+
+		for (size_t i = 0; i < length; i++) {
+			crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+		}
+
+		return crc;
+	}
+
+	static vector<uint32_t> createTable() {
+		vector<uint32_t> table(256);
+
+		for (uint32_t i = 0; i < table.size(); i++) {
+			uint32_t crc = i;
+			for (int bit = 0; bit < 8; bit++) crc = (crc & 1) ? (crc >> 1) ^ POLYNOMIAL : crc >> 1;
+			table[i] = crc;
+		}
+
+		return table;
+	}
+
+#ifdef CRC32C_HARDWARE_AVAILABLE
+	CRC32C_TARGET_SSE42 static uint32_t updateHardware(const char* data, size_t length, uint32_t crc) {
+#if defined(_M_X64) || defined(__x86_64__)
+		uint64_t crc64 = crc;
+		for (; length >= sizeof(uint64_t); data += sizeof(uint64_t), length -= sizeof(uint64_t)) {
+			uint64_t word;
+			memcpy(&word, data, sizeof(word));
+			crc64 = _mm_crc32_u64(crc64, word);
+		}
+
+		crc = static_cast<uint32_t>(crc64);
+#else
+		for (; length >= sizeof(uint32_t); data += sizeof(uint32_t), length -= sizeof(uint32_t)) {
+			uint32_t word;
+			memcpy(&word, data, sizeof(word));
+			crc = _mm_crc32_u32(crc, word);
+		}
+#endif
+
+		for (; length > 0; data++, length--) {
+			crc = _mm_crc32_u8(crc, static_cast<unsigned char>(*data));
+		}
+
+		return crc;
+	}
+#endif
+};
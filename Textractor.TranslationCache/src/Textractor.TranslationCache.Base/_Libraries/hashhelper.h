@@ -0,0 +1,26 @@
+
+#pragma once
+#include <cstdint>
+#include <string>
+using namespace std;
+
+
+class HashHelper {
+public:
+	static constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+	static constexpr uint64_t FNV_PRIME = 1099511628211ULL;
+
+	// 64-bit FNV-1a; unlike std::hash, results are stable across builds/runs, so they are safe to persist.
+	static uint64_t fnv1a(const char* data, size_t length, uint64_t hash = FNV_OFFSET_BASIS) {
+		for (size_t i = 0; i < length; i++) {
+			hash ^= static_cast<unsigned char>(data[i]);
+			hash *= FNV_PRIME;
+		}
+
+		return hash;
+	}
+
+	static uint64_t fnv1a(const string& bytes) {
+		return fnv1a(bytes.c_str(), bytes.length());
+	}
+};
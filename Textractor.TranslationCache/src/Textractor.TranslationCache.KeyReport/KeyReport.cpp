@@ -0,0 +1,93 @@
+#include "../Textractor.TranslationCache.Base/Cache/CacheFileLoader.h"
+#include "../Textractor.TranslationCache.Base/Cache/CacheLineFormatter.h"
+#include "../Textractor.TranslationCache.Base/File/FileInspector.h"
+#include "../Textractor.TranslationCache.Base/File/FileReader.h"
+#include "../Textractor.TranslationCache.Base/KeyCanonicalizer.h"
+#include "../Textractor.TranslationCache.Base/TextFormatter.h"
+#include "../Textractor.TranslationCache.Base/TextMapper.h"
+#include <iostream>
+#include <windows.h>
+
+/*
+	Replays an existing cache file through the key canonicalization (see 'KeyFolding' and 'KeyStripRules' configs),
+	and reports how many of its entries would collapse into a shared entry.
+	Usage: Textractor.TranslationCache.KeyReport.exe <cache file path> [strip rules] [--no-folding]
+*/
+
+const size_t MAX_LISTED_GROUPS = 10;
+const size_t MAX_LISTED_KEYS = 5;
+
+void printLine(const wstring& line = L"") {
+	cout << StrHelper::convertFromW(line) << endl;
+}
+
+wstring toPercent(size_t count, size_t total) {
+	double percent = total > 0 ? (count * 100.0) / total : 0.0;
+	wstring percentStr = to_wstring(percent);
+	return percentStr.substr(0, percentStr.find(L'.') + 3) + L"%";
+}
+
+void printGroups(const KeyCollapseReport& report) {
+	vector<pair<wstring, vector<wstring>>> collapsedGroups = report.getCollapsedGroups();
+	if (collapsedGroups.empty()) return;
+
+	printLine();
+	printLine(L"Largest collapsed groups:");
+
+	for (size_t i = 0; i < collapsedGroups.size() && i < MAX_LISTED_GROUPS; i++) {
+		const vector<wstring>& keys = collapsedGroups[i].second;
+		printLine(L"  [" + to_wstring(keys.size()) + L"] " + collapsedGroups[i].first);
+
+		for (size_t j = 0; j < keys.size() && j < MAX_LISTED_KEYS; j++) printLine(L"      " + keys[j]);
+		if (keys.size() > MAX_LISTED_KEYS) printLine(L"      ...");
+	}
+}
+
+int wmain(int argc, wchar_t* argv[]) {
+	SetConsoleOutputCP(CP_UTF8);
+
+	if (argc < 2) {
+		printLine(L"Usage: Textractor.TranslationCache.KeyReport.exe <cache file path> [strip rules] [--no-folding]");
+		return 1;
+	}
+
+	ExtensionConfig config = DefaultConfig;
+	config.keyFolding = true;
+
+	for (int i = 2; i < argc; i++) {
+		wstring arg = argv[i];
+		if (arg == L"--no-folding") config.keyFolding = false;
+		else config.keyStripRules = arg;
+	}
+
+	DefaultTextFormatter formatter;
+	DelimTextMapper cacheTextMapper(formatter);
+	DefaultCacheLineFormatter lineFormatter(formatter, cacheTextMapper);
+	FstreamFileReader fileReader;
+	FstreamFileInspector fileInspector;
+	ParallelCacheFileLoader fileLoader(fileReader, fileInspector, lineFormatter);
+	DefaultKeyCanonicalizer keyCanonicalizer;
+
+	string filePath = StrHelper::convertFromW(argv[1]);
+	unordered_map<wstring, wstring> cache;
+
+	try {
+		cache = fileLoader.loadFile(filePath);
+	}
+	catch (const exception& ex) {
+		cout << "Unable to load cache file \"" << filePath << "\": " << ex.what() << endl;
+		return 1;
+	}
+
+	KeyCollapseReport report(cache, keyCanonicalizer, formatter, config);
+	printLine(L"Folding: " + wstring(config.keyFolding ? L"on" : L"off") + L", strip rules: '" + config.keyStripRules + L"'");
+	printLine(L"Entries: " + to_wstring(report.getEntryCount()));
+	printLine(L"Entries changed by canonicalization: " + to_wstring(report.getChangedCount()) 
+		+ L" (" + toPercent(report.getChangedCount(), report.getEntryCount()) + L")");
+	printLine(L"Distinct canonical keys: " + to_wstring(report.getCanonicalKeyCount()));
+	printLine(L"Entries which would collapse: " + to_wstring(report.getCollapsedCount()) 
+		+ L" (" + toPercent(report.getCollapsedCount(), report.getEntryCount()) + L")");
+	printGroups(report);
+
+	return 0;
+}
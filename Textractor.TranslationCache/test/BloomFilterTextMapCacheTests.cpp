@@ -0,0 +1,87 @@
+#include "TestHelper.h"
+#include "Cache/BloomFilterTextMapCache.h"
+#include "Cache/MemoryTextMapCache.h"
+
+
+namespace {
+	// counts full reads, which the filter only makes when it is rebuilt
+	class CountingMemoryTextMapCache : public MemoryTextMapCache {
+	public:
+		using MemoryTextMapCache::MemoryTextMapCache;
+		mutable size_t readAllCount = 0;
+
+		unordered_map<wstring, wstring> readAllFromCache() const override {
+			readAllCount++;
+			return MemoryTextMapCache::readAllFromCache();
+		}
+	};
+
+	struct Fixture {
+		DefaultTextFormatter formatter;
+		CountingMemoryTextMapCache mainCache{ formatter };
+		BloomFilterTextMapCache cache{ mainCache, formatter, 64 };
+	};
+}
+
+
+TEST(answersAbsentKeysWithoutMainCache) {
+	Fixture fixture;
+	fixture.cache.writeToCache(L"a", L"A");
+
+	CHECK_EQ(wstring(L"A"), fixture.cache.readFromCache(L"a"));
+	for (int i = 0; i < 100; i++) fixture.cache.readFromCache(L"absent" + to_wstring(i));
+	CHECK(fixture.cache.getStats().definiteMisses > 90);
+}
+
+TEST(overwritesDoNotCountAsNewKeys) {
+	Fixture fixture;
+	size_t readAllsBefore = fixture.mainCache.readAllCount;
+
+	for (int i = 0; i < 10000; i++) {
+		fixture.cache.writeToCache(L"k" + to_wstring(i % 10), L"V" + to_wstring(i));
+		if (i % 100 == 0) fixture.cache.writeAllToCache(unordered_map<wstring, wstring>{ { L"k1", L"W" }, { L"k2", L"W" } });
+	}
+
+	BloomFilterStats stats = fixture.cache.getStats();
+	CHECK_EQ(size_t(10), stats.keyCount);
+	CHECK_EQ(size_t(64), stats.capacity);
+	CHECK_EQ(readAllsBefore, fixture.mainCache.readAllCount);
+	CHECK_EQ(wstring(L"V9999"), fixture.cache.readFromCache(L"k9"));
+}
+
+// keys reported twice through 'addKey' inflate the count until the next rebuild, which sizes from the real key count
+TEST(rebuildSizesFromRealKeyCount) {
+	Fixture fixture;
+	fixture.mainCache.writeToCache(L"a", L"A");
+	for (int i = 0; i < 200; i++) fixture.cache.addKey(L"a");
+	fixture.cache.writeToCache(L"b", L"B");
+
+	BloomFilterStats stats = fixture.cache.getStats();
+	CHECK_EQ(size_t(2), stats.keyCount);
+	CHECK_EQ(size_t(64), stats.capacity);
+	CHECK_EQ(wstring(L"A"), fixture.cache.readFromCache(L"a"));
+}
+
+TEST(growsWithNewKeys) {
+	Fixture fixture;
+	for (int i = 0; i < 1000; i++) fixture.cache.writeToCache(L"k" + to_wstring(i), L"V");
+
+	BloomFilterStats stats = fixture.cache.getStats();
+	CHECK_EQ(size_t(1000), stats.keyCount);
+	CHECK(stats.capacity >= 1000);
+	for (int i = 0; i < 1000; i++) CHECK_EQ(wstring(L"V"), fixture.cache.readFromCache(L"k" + to_wstring(i)));
+}
+
+TEST(removedKeysDoNotHideOthers) {
+	Fixture fixture;
+	for (int i = 0; i < 50; i++) fixture.cache.writeToCache(L"k" + to_wstring(i), L"V");
+	for (int i = 0; i < 50; i += 2) fixture.cache.removeFromCache(L"k" + to_wstring(i));
+	for (int i = 0; i < 50; i++) fixture.cache.writeToCache(L"k" + to_wstring(i), L"W");
+	for (int i = 0; i < 50; i += 3) fixture.cache.removeFromCache(L"k" + to_wstring(i));
+
+	for (int i = 0; i < 50; i++) CHECK_EQ(wstring(i % 3 == 0 ? L"" : L"W"), fixture.cache.readFromCache(L"k" + to_wstring(i)));
+	CHECK_EQ(size_t(33), fixture.cache.getStats().keyCount);
+}
+
+
+TEST_MAIN()
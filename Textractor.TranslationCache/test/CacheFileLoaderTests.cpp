@@ -0,0 +1,101 @@
+#include "TestHelper.h"
+#include "Cache/CacheFileLoader.h"
+#include "File/MappedFileReader.h"
+#include <random>
+
+
+namespace {
+	struct Fixture {
+		TempDir dir;
+		string filePath = dir.file("cache.txt");
+		WinApiFileMapper mapper;
+		MappedFileReader reader{ mapper };
+		FstreamFileInspector inspector;
+		DefaultTextFormatter formatter;
+		DelimTextMapper textMapper{ formatter };
+		DefaultCacheLineFormatter lineFormatter{ formatter, textMapper };
+
+		// what the loader is expected to match: every line applied in order, on one thread
+		unordered_map<wstring, wstring> loadSequentially() {
+			unordered_map<wstring, wstring> cache{};
+
+			reader.readLines(filePath, [this, &cache](const string& line) {
+				pair<wstring, wstring> textPair = lineFormatter.importFormat(line);
+				if (textPair.second.empty()) cache.erase(textPair.first);
+				else cache[textPair.first] = textPair.second;
+			});
+
+			return cache;
+		}
+
+		unordered_map<wstring, wstring> loadInParallel(size_t threadCount, uint64_t minChunkBytes) {
+			return ParallelCacheFileLoader(reader, inspector, lineFormatter, threadCount, minChunkBytes).loadFile(filePath);
+		}
+	};
+
+	// short lines over few keys, so that most keys are set, overwritten and removed across chunks
+	string makeRandomCacheFile(mt19937& random, const CacheLineFormatter& lineFormatter, size_t lineCount) {
+		string contents;
+
+		for (size_t i = 0; i < lineCount; i++) {
+			wstring key = L"k" + to_wstring(random() % 40);
+			wstring value = random() % 4 == 0 ? L"" : L"v" + to_wstring(i);
+			string line = random() % 3 == 0 ? StrHelper::convertFromW(key + L"|~|" + value) : lineFormatter.exportFormat(key, value);
+			contents += line + (random() % 5 == 0 ? "\r\n" : "\n");
+		}
+
+		return contents;
+	}
+}
+
+
+TEST(parallelLoadMatchesSequentialLoad) {
+	Fixture fixture;
+	mt19937 random(12);
+
+	for (int i = 0; i < 50; i++) {
+		string contents = makeRandomCacheFile(random, fixture.lineFormatter, 1 + random() % 400);
+		// half of the files end with a line missing its line break
+		if (i % 2 == 0) contents += "k" + to_string(random() % 40) + "|~|last";
+		writeTestFile(fixture.filePath, contents);
+
+		unordered_map<wstring, wstring> expected = fixture.loadSequentially();
+		bool matches = true;
+
+		for (size_t threadCount : { 1, 2, 3, 8 }) {
+			matches = matches && expected == fixture.loadInParallel(threadCount, 64 + random() % 256);
+		}
+
+		CHECK(matches);
+		if (!matches) break;
+	}
+}
+
+TEST(laterChunksWinAcrossBoundaries) {
+	Fixture fixture;
+	string filler;
+	for (int i = 0; i < 200; i++) filler += "filler" + to_string(i) + "|~|x\n";
+
+	// with 4 chunks of the file, each key's lines are a chunk or more apart
+	writeTestFile(fixture.filePath, "a|~|A1\nb|~|B1\nc|~|C1\n" + filler + "a|~|A2\nb|~|\n" + filler + "c|~|\n" + filler + "c|~|C2\n");
+	unordered_map<wstring, wstring> cache = fixture.loadInParallel(4, 64);
+
+	CHECK_EQ(wstring(L"A2"), cache[L"a"]);
+	CHECK(cache.find(L"b") == cache.end());
+	CHECK_EQ(wstring(L"C2"), cache[L"c"]);
+	CHECK(cache == fixture.loadSequentially());
+}
+
+TEST(emptyOrMissingFileLoadsEmpty) {
+	Fixture fixture;
+	CHECK(fixture.loadInParallel(4, 1).empty());
+
+	writeTestFile(fixture.filePath, "");
+	CHECK(fixture.loadInParallel(4, 1).empty());
+
+	writeTestFile(fixture.filePath, "a|~|A");
+	CHECK_EQ(wstring(L"A"), fixture.loadInParallel(4, 1)[L"a"]);
+}
+
+
+TEST_MAIN()
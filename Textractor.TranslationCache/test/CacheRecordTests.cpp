@@ -0,0 +1,191 @@
+#include "TestHelper.h"
+#include "_Libraries/crc32c.h"
+#include "Cache/CacheFileRecoverer.h"
+#include "Cache/CacheLineFormatter.h"
+#include <random>
+
+
+namespace {
+	// what the torn-tail tests start from: framed records, a legacy line, and a corrupt line followed by an intact one
+	struct Fixture {
+		TempDir dir;
+		string filePath = dir.file("cache.txt");
+		NoFileWriter writer;
+		TailCacheFileRecoverer recoverer{ writer };
+		DefaultTextFormatter formatter;
+		DelimTextMapper textMapper{ formatter };
+		DefaultCacheLineFormatter lineFormatter{ formatter, textMapper };
+		string intactContents;
+
+		Fixture() {
+			string corruptLine = lineFormatter.exportFormat(L"c", L"C");
+			corruptLine[0] = 'x';
+
+			intactContents = lineFormatter.exportFormat(L"a", L"\x3042") + "\n" + "legacy|~|L\r\n"
+				+ corruptLine + "\n" + lineFormatter.exportFormat(L"b", L"B") + "\n";
+		}
+	};
+
+	// check values from RFC 3720 (iSCSI), B.4, and the usual "123456789" check
+	const vector<pair<string, uint32_t>> knownAnswers = {
+		{ "", 0x00000000 },
+		{ "a", 0xC1D04330 },
+		{ "123456789", 0xE3069283 },
+		{ "The quick brown fox jumps over the lazy dog", 0x22620404 },
+		{ string(32, '\0'), 0x8A9136AA },
+		{ string(32, '\xFF'), 0x62A8AB43 },
+		{ []() { string s; for (int i = 0; i < 32; i++) s += static_cast<char>(i); return s; }(), 0x46DD794E },
+		{ []() { string s; for (int i = 31; i >= 0; i--) s += static_cast<char>(i); return s; }(), 0x113FDB5C },
+	};
+}
+
+
+TEST(crc32cMatchesKnownAnswers) {
+	for (const auto& knownAnswer : knownAnswers) {
+		const string& data = knownAnswer.first;
+		CHECK_EQ(knownAnswer.second, Crc32c::compute(data));
+		CHECK_EQ(knownAnswer.second, Crc32c::computeSoftware(data.c_str(), data.length()));
+
+#ifdef CRC32C_HARDWARE_AVAILABLE
+		if (Crc32c::isHardwareSupported()) CHECK_EQ(knownAnswer.second, Crc32c::computeHardware(data.c_str(), data.length()));
+#endif
+	}
+
+#ifdef CRC32C_HARDWARE_AVAILABLE
+	if (!Crc32c::isHardwareSupported()) printf("  (no SSE4.2 on this CPU, only the lookup table was checked)\n");
+#endif
+}
+
+// both paths, over every length and alignment of the word-sized steps of the hardware path, and continued from a crc
+TEST(crc32cPathsAgree) {
+	mt19937 random(15);
+	string data(300, '\0');
+	for (char& ch : data) ch = static_cast<char>(random());
+
+	for (size_t offset = 0; offset < 8; offset++) {
+		for (size_t length = 0; offset + length <= data.length(); length++) {
+			const char* start = data.c_str() + offset;
+			uint32_t crc = Crc32c::computeSoftware(start, length);
+			size_t split = length / 3;
+			bool matches = Crc32c::compute(start, length) == crc
+				&& Crc32c::computeSoftware(start + split, length - split, Crc32c::computeSoftware(start, split)) == crc;
+
+#ifdef CRC32C_HARDWARE_AVAILABLE
+			if (Crc32c::isHardwareSupported()) {
+				matches = matches && Crc32c::computeHardware(start, length) == crc
+					&& Crc32c::computeHardware(start + split, length - split, Crc32c::computeHardware(start, split)) == crc;
+			}
+#endif
+
+			CHECK(matches);
+			if (!matches) return;
+		}
+	}
+}
+
+TEST(framedLinesRoundTrip) {
+	Fixture fixture;
+	vector<pair<wstring, wstring>> textPairs = { { L"a", L"A" }, { L"\x3042\x3044", L"\U0001F600 x" },
+		{ L"multi\nline", L"line\r\nbreak\tand tab" }, { L"k", L"" }, { L"|", L"\\" } };
+
+	for (const auto& textPair : textPairs) {
+		string line = fixture.lineFormatter.exportFormat(textPair.first, textPair.second);
+		size_t payloadLength;
+
+		CHECK(CacheRecordFramer::check(line, payloadLength) == CacheRecordFramer::Valid);
+		CHECK_EQ(line.length() - 18, payloadLength);
+		CHECK(line.find('\n') == string::npos);
+
+		pair<wstring, wstring> imported = fixture.lineFormatter.importFormat(line);
+		CHECK((imported == pair<wstring, wstring>(fixture.formatter.format(textPair.first), fixture.formatter.format(textPair.second))));
+		CHECK(fixture.lineFormatter.importFormatUtf8(line).first == StrHelper::convertFromW(imported.first));
+	}
+}
+
+// lines written by older versions (or by hand) have no trailer
+TEST(legacyLinesAreAccepted) {
+	Fixture fixture;
+	size_t payloadLength;
+
+	for (const string& line : { string("a|~|A"), string("a|~|A\t#"), string("a|~|A\t#0000000500000000x"),
+		string("a|~|A\t#00000005ABCDEF01") })
+	{
+		CHECK(CacheRecordFramer::check(line, payloadLength) == CacheRecordFramer::Unframed);
+		CHECK_EQ(line.length(), payloadLength);
+	}
+
+	CHECK((fixture.lineFormatter.importFormat("a |~| A") == pair<wstring, wstring>(L"a", L"A")));
+	CHECK((fixture.lineFormatter.importFormatUtf8("\xE3\x81\x82|~|B") == pair<string, string>("\xE3\x81\x82", "B")));
+}
+
+TEST(corruptTrailerIsRejected) {
+	Fixture fixture;
+	string line = fixture.lineFormatter.exportFormat(L"key", L"value");
+	size_t payloadLength;
+
+	// every single-bit flip of the payload, and each digit of the trailer replaced
+	for (size_t i = 0; i < line.length(); i++) {
+		for (int bit = 0; bit < 8; bit++) {
+			string corrupted = line;
+			if (i < line.length() - 16) corrupted[i] ^= static_cast<char>(1 << bit);
+			else corrupted[i] = corrupted[i] == '0' ? '1' : '0';
+
+			CacheRecordFramer::RecordState state = CacheRecordFramer::check(corrupted, payloadLength);
+			// a flip inside the "\t#" marker turns it into a legacy line, which no longer parses as the same pair
+			bool rejected = state == CacheRecordFramer::Corrupt || (i >= line.length() - 18 && i < line.length() - 16);
+			CHECK(rejected);
+			if (state == CacheRecordFramer::Corrupt) CHECK((fixture.lineFormatter.importFormat(corrupted) == pair<wstring, wstring>()));
+			if (!rejected) return;
+		}
+	}
+
+	// a torn record: its trailer is cut, or another line was appended in the middle of it
+	string torn = line.substr(0, line.length() - 5) + fixture.lineFormatter.exportFormat(L"next", L"line");
+	CHECK(CacheRecordFramer::check(torn, payloadLength) == CacheRecordFramer::Corrupt);
+}
+
+TEST(recoveryCutsTornTail) {
+	Fixture fixture;
+	string framed = fixture.lineFormatter.exportFormat(L"d", L"D");
+	string badCrc = framed;
+	badCrc.back() = badCrc.back() == '0' ? '1' : '0';
+	vector<pair<string, string>> tails = {
+		{ "", "" },
+		{ framed.substr(0, framed.length() / 2), "" },
+		{ badCrc + "\n", "" },
+		{ badCrc + "\n" + framed.substr(0, 3), "" },
+		{ string(40, '\0'), "" },
+		{ string(40, '\0') + "\n" + string(10, '\0'), "" },
+		{ "unterminated|~|legacy", "" },
+		{ framed + "\r\n" + framed.substr(0, 10), framed + "\r\n" },
+		// a record only missing its line break is kept, and gets one
+		{ framed, framed + "\n" },
+	};
+
+	for (const auto& tail : tails) {
+		writeTestFile(fixture.filePath, fixture.intactContents + tail.first);
+		uint64_t cutLength = fixture.recoverer.recoverFile(fixture.filePath);
+
+		CHECK(readTestFile(fixture.filePath) == fixture.intactContents + tail.second);
+		CHECK_EQ(tail.first.length() > tail.second.length() ? tail.first.length() - tail.second.length() : 0, size_t(cutLength));
+	}
+}
+
+// the tail read grows until it reaches an intact line, and a file with none is emptied
+TEST(recoveryReachesPastLongTornTail) {
+	Fixture fixture;
+	string garbage = string(200000, '\0') + "\n" + string(100000, 'y');
+
+	writeTestFile(fixture.filePath, fixture.intactContents + garbage);
+	CHECK_EQ(uint64_t(garbage.length()), fixture.recoverer.recoverFile(fixture.filePath));
+	CHECK(readTestFile(fixture.filePath) == fixture.intactContents);
+
+	writeTestFile(fixture.filePath, garbage);
+	fixture.recoverer.recoverFile(fixture.filePath);
+	CHECK(readTestFile(fixture.filePath).empty());
+
+	CHECK_EQ(uint64_t(0), fixture.recoverer.recoverFile(fixture.dir.file("none.txt")));
+}
+
+
+TEST_MAIN()
@@ -0,0 +1,146 @@
+#include "TestHelper.h"
+#include "ConfigAdjustmentEvents.h"
+#include "Cache/MemoryTextMapCache.h"
+#include "File/Writer/FstreamFileWriter.h"
+
+
+namespace {
+	// the default formatter builds Windows paths
+	class PlainCacheFilePathFormatter : public CacheFilePathFormatter {
+	public:
+		string format(wstring cacheFilePath) override { return StrHelper::convertFromW(cacheFilePath); }
+		string format(string cacheFilePath) override { return cacheFilePath; }
+	};
+
+	class FailingClearTextMapCache : public MemoryTextMapCache {
+	public:
+		FailingClearTextMapCache(const TextFormatter& formatter) : MemoryTextMapCache(formatter) { }
+
+		void clearCache() override {
+			throw runtime_error("clear failed");
+		}
+	};
+
+	struct Fixture {
+		TempDir dir;
+		string filePath = dir.file("cache.txt");
+		FstreamFileWriter writer;
+		WinApiFileMapper mapper;
+		WinApiFileRenamer renamer;
+		CRemoveFileDeleter deleter;
+		FstreamFileInspector inspector;
+		DefaultTextFormatter formatter;
+		DelimTextMapper textMapper{ formatter };
+		PlainCacheFilePathFormatter pathFormatter;
+		MappedSnapshotTextMapCache cache{ mapper, renamer, deleter, inspector, formatter, textMapper };
+		BloomFilterTextMapCache keyFilter{ cache, formatter };
+		MemoryTextMapCache derivedCache{ formatter };
+
+		Fixture() {
+			writer.writeToFile(filePath, vector<string>{ "a|~|A" });
+			cache.loadSnapshot(filePath);
+			keyFilter.rebuild();
+		}
+
+		ExtensionConfig getConfig() {
+			ExtensionConfig config = DefaultConfig;
+			config.cacheFilePath = StrHelper::convertToW(filePath);
+			return config;
+		}
+	};
+}
+
+
+TEST(checksCacheFileAtMostOncePerInterval) {
+	Fixture fixture;
+	SnapshotReadConfigAdjustmentEvents events(fixture.cache, fixture.keyFilter, fixture.derivedCache,
+		fixture.pathFormatter, StrHelper::convertToW(fixture.filePath), 300);
+	ExtensionConfig config = fixture.getConfig();
+
+	events.applyConfigAdjustments(config);
+	fixture.writer.appendToFile(fixture.filePath, "b|~|B");
+
+	for (int i = 0; i < 20; i++) events.applyConfigAdjustments(config);
+	CHECK_EQ(wstring(L""), fixture.keyFilter.readFromCache(L"b"));
+
+	this_thread::sleep_for(chrono::milliseconds(350));
+	events.applyConfigAdjustments(config);
+	CHECK_EQ(wstring(L"B"), fixture.keyFilter.readFromCache(L"b"));
+	CHECK_EQ(wstring(L"A"), fixture.keyFilter.readFromCache(L"a"));
+}
+
+TEST(pathChangeReloadsWithoutWaitingForInterval) {
+	Fixture fixture;
+	SnapshotReadConfigAdjustmentEvents events(fixture.cache, fixture.keyFilter, fixture.derivedCache,
+		fixture.pathFormatter, StrHelper::convertToW(fixture.filePath), 60000);
+	ExtensionConfig config = fixture.getConfig();
+	events.applyConfigAdjustments(config);
+
+	string otherFilePath = fixture.dir.file("other.txt");
+	fixture.writer.writeToFile(otherFilePath, vector<string>{ "z|~|Z" });
+	fixture.derivedCache.writeToCache(L"a", L"A");
+	config.cacheFilePath = StrHelper::convertToW(otherFilePath);
+	events.applyConfigAdjustments(config);
+
+	// the reload runs in the background, and is joined by the next call
+	events.applyConfigAdjustments(config);
+	for (int i = 0; i < 100 && fixture.keyFilter.readFromCache(L"z").empty(); i++) {
+		this_thread::sleep_for(chrono::milliseconds(10));
+		events.applyConfigAdjustments(config);
+	}
+
+	CHECK_EQ(wstring(L"Z"), fixture.keyFilter.readFromCache(L"z"));
+	CHECK_EQ(wstring(L""), fixture.keyFilter.readFromCache(L"a"));
+	CHECK(fixture.derivedCache.readAllFromCache().empty());
+}
+
+
+// a merged line replaces the value the derived cache copied, so the derived cache must not keep serving it
+TEST(mergedKeysAreRemovedFromDerivedCache) {
+	Fixture fixture;
+	SnapshotReadConfigAdjustmentEvents events(fixture.cache, fixture.keyFilter, fixture.derivedCache,
+		fixture.pathFormatter, StrHelper::convertToW(fixture.filePath), 0);
+	ExtensionConfig config = fixture.getConfig();
+	events.applyConfigAdjustments(config);
+
+	fixture.derivedCache.writeToCache(L"a", L"A");
+	fixture.derivedCache.writeToCache(L"c", L"C");
+	fixture.writer.appendToFile(fixture.filePath, "a|~|A2");
+	events.applyConfigAdjustments(config);
+
+	CHECK_EQ(wstring(L""), fixture.derivedCache.readFromCache(L"a"));
+	CHECK_EQ(wstring(L"C"), fixture.derivedCache.readFromCache(L"c"));
+	CHECK_EQ(wstring(L"A2"), fixture.keyFilter.readFromCache(L"a"));
+}
+
+// a failed reload is rethrown by the next call, but not by the destructor
+TEST(destructorDropsReloadFailure) {
+	Fixture fixture;
+	FailingClearTextMapCache failingCache{ fixture.formatter };
+	string otherFilePath = fixture.dir.file("other.txt");
+	fixture.writer.writeToFile(otherFilePath, vector<string>{ "z|~|Z" });
+	ExtensionConfig config = fixture.getConfig();
+	config.cacheFilePath = StrHelper::convertToW(otherFilePath);
+
+	{
+		SnapshotReadConfigAdjustmentEvents events(fixture.cache, fixture.keyFilter, failingCache,
+			fixture.pathFormatter, StrHelper::convertToW(fixture.filePath), 60000);
+		events.applyConfigAdjustments(config);
+		bool thrown = false;
+
+		for (int i = 0; i < 100 && !thrown; i++) {
+			this_thread::sleep_for(chrono::milliseconds(10));
+			try { events.applyConfigAdjustments(config); }
+			catch (const exception&) { thrown = true; }
+		}
+
+		CHECK(thrown);
+	}
+
+	SnapshotReadConfigAdjustmentEvents events(fixture.cache, fixture.keyFilter, failingCache,
+		fixture.pathFormatter, StrHelper::convertToW(fixture.filePath), 60000);
+	events.applyConfigAdjustments(config);
+}
+
+
+TEST_MAIN()
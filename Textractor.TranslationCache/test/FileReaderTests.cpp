@@ -0,0 +1,117 @@
+#include "TestHelper.h"
+#include "File/MappedFileReader.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+
+// every allocation of the test binary is counted, so that a scan which leaks shows up as live allocations left over
+static atomic<long> liveAllocationCount{ 0 };
+
+void* operator new(size_t size) {
+	void* memory = malloc(size > 0 ? size : 1);
+	if (memory == nullptr) throw bad_alloc();
+	liveAllocationCount++;
+	return memory;
+}
+
+void operator delete(void* memory) noexcept {
+	if (memory == nullptr) return;
+	liveAllocationCount--;
+	free(memory);
+}
+
+void operator delete(void* memory, size_t size) noexcept {
+	operator delete(memory);
+}
+
+
+namespace {
+	struct Fixture {
+		TempDir dir;
+		string filePath = dir.file("lines.txt");
+		WinApiFileMapper mapper;
+		FstreamFileReader streamReader;
+		MappedFileReader mappedReader{ mapper };
+		vector<FileReader*> readers{ &streamReader, &mappedReader };
+	};
+
+	vector<string> readReversed(FileReader& reader, const string& filePath) {
+		vector<string> lines{};
+		reader.readLineReversed(filePath, [&lines](const string& line) {
+			lines.push_back(line);
+			return false;
+		});
+		return lines;
+	}
+}
+
+
+TEST(readsLinesFromTheEnd) {
+	Fixture fixture;
+	writeTestFile(fixture.filePath, "a\nb\r\n\nc\n");
+
+	for (FileReader* reader : fixture.readers) {
+		CHECK(readReversed(*reader, fixture.filePath) == vector<string>({ "c", "", "b", "a" }));
+		CHECK_EQ(string("b"), reader->readLineReversed(fixture.filePath, [](const string& line) { return !line.empty() && line < "c"; }));
+		CHECK_EQ(string(""), reader->readLineReversed(fixture.filePath, [](const string& line) { return line == "z"; }));
+	}
+}
+
+TEST(readsUnterminatedLastLine) {
+	Fixture fixture;
+	writeTestFile(fixture.filePath, "a\nb");
+
+	for (FileReader* reader : fixture.readers) {
+		CHECK(readReversed(*reader, fixture.filePath) == vector<string>({ "b", "a" }));
+	}
+}
+
+TEST(putsTogetherLinesSpanningChunks) {
+	Fixture fixture;
+	vector<string> lines{ string(100000, 'x'), "short", string(70000, 'y') + "\xE3\x81\x82", string(65536, 'z') };
+	string text = "";
+	for (const string& line : lines) text += line + "\n";
+	writeTestFile(fixture.filePath, text);
+
+	for (FileReader* reader : fixture.readers) {
+		CHECK(readReversed(*reader, fixture.filePath) == vector<string>(lines.rbegin(), lines.rend()));
+	}
+}
+
+TEST(missingOrEmptyFileHasNoLines) {
+	Fixture fixture;
+	for (FileReader* reader : fixture.readers) CHECK(readReversed(*reader, fixture.filePath).empty());
+
+	writeTestFile(fixture.filePath, "");
+	for (FileReader* reader : fixture.readers) CHECK(readReversed(*reader, fixture.filePath).empty());
+}
+
+// the stream reader used to allocate (and never free) a 512 KB line buffer on every 'readLine' call
+TEST(repeatedScansLeaveNoAllocationsBehind) {
+	Fixture fixture;
+	string text = "";
+	for (int i = 0; i < 200; i++) text += "line " + to_string(i) + string(i, 'x') + "\n";
+	writeTestFile(fixture.filePath, text);
+
+	for (FileReader* reader : fixture.readers) {
+		// the first round sets up anything created once (ex: locale facets of the streams)
+		for (int round = 0; round < 2; round++) {
+			long liveBefore = liveAllocationCount;
+			size_t lineCount = 0;
+
+			for (int i = 0; i < 2000; i++) {
+				lineCount += reader->readLine(fixture.filePath, [](const string& line) { return line.compare(0, 8, "line 150") == 0; }).empty() ? 0 : 1;
+				lineCount += reader->readLineReversed(fixture.filePath, [](const string& line) { return line.compare(0, 6, "line 3") == 0; }).empty() ? 0 : 1;
+				reader->readLines(fixture.filePath, [&lineCount](const string& line) { lineCount++; });
+				reader->readLines(fixture.filePath, 0, text.length(), [&lineCount](const string& line) { lineCount++; });
+			}
+
+			CHECK_EQ(size_t(2000 * 402), lineCount);
+			if (round == 1) CHECK_EQ(liveBefore, liveAllocationCount.load());
+		}
+	}
+}
+
+
+TEST_MAIN()
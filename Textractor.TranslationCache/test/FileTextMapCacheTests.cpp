@@ -0,0 +1,100 @@
+#include "TestHelper.h"
+#include "Cache/FileTextMapCache.h"
+#include "File/MappedFileReader.h"
+#include "File/Writer/FstreamFileWriter.h"
+#include <algorithm>
+
+
+namespace {
+	struct Fixture {
+		TempDir dir;
+		string filePath = dir.file("cache.txt");
+		FstreamFileWriter writer;
+		WinApiFileMapper mapper;
+		MappedFileReader reader{ mapper };
+		CRemoveFileDeleter deleter;
+		WinApiFileRenamer renamer;
+		FstreamFileInspector inspector;
+		DefaultTextFormatter formatter;
+		DelimTextMapper textMapper{ formatter };
+
+		unique_ptr<FileTextMapCache> createCache() {
+			return make_unique<FileTextMapCache>(writer, reader, deleter, renamer, inspector, formatter, textMapper, filePath);
+		}
+	};
+}
+
+
+TEST(newestLineOfAKeyWins) {
+	Fixture fixture;
+	unique_ptr<FileTextMapCache> cache = fixture.createCache();
+
+	for (int i = 0; i < 5; i++) {
+		cache->writeToCache(L"a", L"A" + to_wstring(i));
+		cache->writeToCache(L" b", L"B" + to_wstring(i));
+	}
+
+	CHECK_EQ(wstring(L"A4"), cache->readFromCache(L"a"));
+	CHECK_EQ(wstring(L"B4"), cache->readFromCache(L"b"));
+	CHECK_EQ(wstring(L""), cache->readFromCache(L"c"));
+}
+
+TEST(tombstoneHidesEarlierLines) {
+	Fixture fixture;
+	unique_ptr<FileTextMapCache> cache = fixture.createCache();
+
+	cache->writeToCache(L"a", L"A");
+	cache->removeFromCache(L"a");
+	CHECK_EQ(wstring(L""), cache->readFromCache(L"a"));
+	CHECK(!cache->keyExists(L"a"));
+
+	cache->writeToCache(L"a", L"A2");
+	CHECK_EQ(wstring(L"A2"), cache->readFromCache(L"a"));
+}
+
+TEST(readsLinesAppendedByAnotherWriter) {
+	Fixture fixture;
+	unique_ptr<FileTextMapCache> cache = fixture.createCache();
+	cache->writeToCache(L"a", L"A");
+
+	fixture.writer.appendToFile(fixture.filePath, "ext|~|EXT");
+	CHECK_EQ(wstring(L"EXT"), cache->readFromCache(L"ext"));
+	CHECK_EQ(wstring(L"A"), cache->readFromCache(L"a"));
+}
+
+namespace {
+	size_t countLines(const string& filePath) {
+		string text = readTestFile(filePath);
+		return static_cast<size_t>(count(text.begin(), text.end(), '\n'));
+	}
+
+	void writeAndRemoveKeys(TextMapCache& cache, int keyCount) {
+		for (int i = 0; i < keyCount; i++) {
+			cache.writeToCache(to_wstring(i), L"V");
+			cache.removeFromCache(to_wstring(i));
+		}
+	}
+}
+
+TEST(compactsOnceTombstonesPileUp) {
+	Fixture fixture;
+	unique_ptr<FileTextMapCache> cache = fixture.createCache();
+	writeAndRemoveKeys(*cache, 40);
+	cache.reset();
+
+	CHECK(countLines(fixture.filePath) < 80);
+}
+
+// once stopped, removals no longer start a compaction, so the cache file can be rewritten by someone else
+TEST(noCompactionAfterStop) {
+	Fixture fixture;
+	unique_ptr<FileTextMapCache> cache = fixture.createCache();
+	cache->stopCompaction();
+	writeAndRemoveKeys(*cache, 40);
+	cache.reset();
+
+	CHECK_EQ(size_t(80), countLines(fixture.filePath));
+}
+
+
+TEST_MAIN()
@@ -0,0 +1,125 @@
+#include "TestHelper.h"
+#include "File/FileTruncater.h"
+#include "File/Writer/WinApiFileWriter.h"
+#include <thread>
+
+
+namespace {
+	struct Fixture {
+		TempDir dir;
+
+		// lines are "<fileTag>:<index>", padded so that every line is 'lineLength' bytes with its line break
+		string writeLines(const string& fileName, const string& fileTag, size_t lineCount, size_t lineLength) {
+			string text = "";
+			for (size_t i = 0; i < lineCount; i++) {
+				string line = fileTag + ":" + to_string(i);
+				text += line + string(lineLength - line.length() - 1, '.') + "\n";
+			}
+
+			string filePath = dir.file(fileName);
+			writeTestFile(filePath, text);
+			return filePath;
+		}
+	};
+
+	vector<string> splitLines(const string& text) {
+		vector<string> lines{};
+		istringstream stream(text);
+		string line;
+		while (getline(stream, line)) lines.push_back(line);
+		return lines;
+	}
+
+	// the file holds the last lines of the original file, in order, and nothing else
+	bool isTailOf(const string& text, const string& fileTag, size_t lineCount) {
+		vector<string> lines = splitLines(text);
+		if (lines.empty() || text.back() != '\n') return false;
+
+		for (size_t i = 0; i < lines.size(); i++) {
+			string prefix = fileTag + ":" + to_string(lineCount - lines.size() + i);
+			if (lines[i].compare(0, prefix.length(), prefix) != 0 || lines[i].find_first_not_of('.', prefix.length()) != string::npos)
+				return false;
+		}
+
+		return true;
+	}
+}
+
+
+TEST(keepsWholeLinesUnderTheLimit) {
+	Fixture fixture;
+	string filePath = fixture.writeLines("a.txt", "a", 100, 20);
+	StreamingFileTruncater truncater(555);
+	truncater.truncateFile(filePath);
+
+	string text = readTestFile(filePath);
+	CHECK_EQ(size_t(540), text.length());
+	CHECK(isTailOf(text, "a", 100));
+}
+
+TEST(leavesSmallAndMissingFilesAlone) {
+	Fixture fixture;
+	string filePath = fixture.writeLines("a.txt", "a", 10, 20);
+	StreamingFileTruncater truncater(1000);
+
+	truncater.truncateFile(filePath);
+	truncater.truncateFile(fixture.dir.file("none.txt"));
+	CHECK_EQ(size_t(200), readTestFile(filePath).length());
+}
+
+// files are locked one by one, so truncations of different files run at the same time through one truncater
+TEST(truncatesDifferentFilesConcurrently) {
+	Fixture fixture;
+	StreamingFileTruncater truncater(300000);
+	vector<string> filePaths{};
+	vector<thread> threads{};
+
+	for (int i = 0; i < 4; i++) filePaths.push_back(fixture.writeLines(to_string(i) + ".txt", "f" + to_string(i), 20000, 50));
+	for (int i = 0; i < 4; i++) threads.push_back(thread([&truncater, &filePaths, i]() { truncater.truncateFile(filePaths[i]); }));
+	for (thread& t : threads) t.join();
+
+	for (int i = 0; i < 4; i++) {
+		string text = readTestFile(filePaths[i]);
+		CHECK(text.length() <= 300000);
+		CHECK(isTailOf(text, "f" + to_string(i), 20000));
+	}
+}
+
+// the other module keeps the file open to append to it, without sharing deletion, so the file can't be replaced;
+// it is shortened in place, and the appends made through the open handle afterwards follow the kept tail
+TEST(truncatesFileKeptOpenByWriter) {
+	Fixture fixture;
+	string filePath = fixture.writeLines("a.txt", "a", 100, 20);
+	PersistentWinApiFileWriter writer;
+	writer.appendToFile(filePath, "a:100" + string(14, '.'));
+	CHECK(!MoveFileEx(StrHelper::convertToW(filePath).c_str(), StrHelper::convertToW(filePath + ".moved").c_str(), MOVEFILE_REPLACE_EXISTING));
+
+	StreamingFileTruncater truncater(555);
+	truncater.truncateFile(filePath);
+	CHECK_EQ(size_t(540), readTestFile(filePath).length());
+
+	writer.appendToFile(filePath, "a:101" + string(14, '.'));
+	string text = readTestFile(filePath);
+	CHECK_EQ(size_t(560), text.length());
+	CHECK(isTailOf(text, "a", 102));
+}
+
+// a file opened without sharing writes can't be truncated now, so it is left for next time
+TEST(skipsFileInUse) {
+	Fixture fixture;
+	string filePath = fixture.writeLines("a.txt", "a", 100, 20);
+	HANDLE hFile = CreateFile(StrHelper::convertToW(filePath).c_str(), GENERIC_READ, FILE_SHARE_READ,
+		NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	CHECK(hFile != INVALID_HANDLE_VALUE);
+
+	StreamingFileTruncater truncater(555);
+	truncater.truncateFile(filePath);
+	CHECK_EQ(size_t(2000), readTestFile(filePath).length());
+
+	CloseHandle(hFile);
+	truncater.truncateFile(filePath);
+	CHECK_EQ(size_t(540), readTestFile(filePath).length());
+}
+
+
+TEST_MAIN()
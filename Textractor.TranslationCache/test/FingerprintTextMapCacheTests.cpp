@@ -0,0 +1,166 @@
+#include "TestHelper.h"
+#include "Cache/FingerprintTextMapCache.h"
+#include "Cache/MemoryTextMapCache.h"
+#include <atomic>
+#include <thread>
+
+
+namespace {
+	// lets a test hold the purge between its full read and its removals
+	class GatedMemoryTextMapCache : public MemoryTextMapCache {
+	public:
+		using MemoryTextMapCache::MemoryTextMapCache;
+		mutable atomic<bool> gated{ false }, readAllEntered{ false };
+
+		unordered_map<wstring, wstring> readAllFromCache() const override {
+			unordered_map<wstring, wstring> cache = MemoryTextMapCache::readAllFromCache();
+			readAllEntered = true;
+			while (gated) this_thread::sleep_for(chrono::milliseconds(1));
+			return cache;
+		}
+	};
+
+	struct Fixture {
+		DefaultTextFormatter formatter;
+		GatedMemoryTextMapCache mainCache{ formatter };
+		wstring fingerprint = L"m1";
+		bool fallback = false;
+		FingerprintTextMapCache cache{ mainCache, formatter,
+			[this]() { return fingerprint; }, [this]() { return fallback; } };
+	};
+
+	// the purge has no completion signal, so this waits for what it is expected to remove
+	bool waitForRemoval(const TextMapCache& mainCache, const vector<wstring>& keys) {
+		for (int i = 0; i < 2000; i++) {
+			unordered_map<wstring, wstring> cache = mainCache.readAllFromCache();
+			bool removed = true;
+			for (const wstring& key : keys) removed = removed && cache.find(key) == cache.end();
+			if (removed) return true;
+			this_thread::sleep_for(chrono::milliseconds(1));
+		}
+
+		return false;
+	}
+}
+
+
+TEST(servesOnlyMatchingFingerprint) {
+	Fixture fixture;
+	fixture.cache.writeToCache(L"a", L" A ");
+
+	CHECK_EQ(wstring(L"A\x1Fm1"), fixture.mainCache.readFromCache(L"a"));
+	CHECK_EQ(wstring(L"A"), fixture.cache.readFromCache(L"a"));
+	CHECK(fixture.cache.keyExists(L"a"));
+
+	fixture.fingerprint = L"m2";
+	CHECK(fixture.cache.readFromCache(L"a").empty());
+	CHECK(!fixture.cache.keyExists(L"a"));
+	CHECK(fixture.cache.readAllFromCache().empty());
+
+	// a new translation replaces the mismatched one
+	fixture.cache.writeToCache(L"a", L"B");
+	CHECK_EQ(wstring(L"B\x1Fm2"), fixture.mainCache.readFromCache(L"a"));
+	CHECK_EQ(wstring(L"B"), fixture.cache.readFromCache(L"a"));
+}
+
+TEST(fallbackServesAnyFingerprint) {
+	Fixture fixture;
+	fixture.cache.writeAllToCache(unordered_map<wstring, wstring>{ { L"a", L"A" }, { L"b", L"B" } });
+	fixture.fingerprint = L"m2";
+	fixture.cache.writeToCache(L"c", L"C");
+	fixture.fallback = true;
+
+	CHECK_EQ(wstring(L"A"), fixture.cache.readFromCache(L"a"));
+	CHECK((fixture.cache.readAllFromCache() == unordered_map<wstring, wstring>{ { L"a", L"A" }, { L"b", L"B" }, { L"c", L"C" } }));
+
+	fixture.fallback = false;
+	CHECK((fixture.cache.readAllFromCache() == unordered_map<wstring, wstring>{ { L"c", L"C" } }));
+}
+
+// values written before a fingerprint was configured have an empty one, and an empty fingerprint writes untagged values
+TEST(untaggedValuesHaveEmptyFingerprint) {
+	Fixture fixture;
+	fixture.mainCache.writeToCache(L"old", L"O");
+
+	CHECK(fixture.cache.readFromCache(L"old").empty());
+
+	fixture.fingerprint = L"  ";
+	CHECK_EQ(wstring(L"O"), fixture.cache.readFromCache(L"old"));
+	fixture.cache.writeToCache(L"new", L"N");
+	CHECK_EQ(wstring(L"N"), fixture.mainCache.readFromCache(L"new"));
+
+	// the fingerprint is trimmed like keys/values are
+	fixture.fingerprint = L" m1\t";
+	fixture.cache.writeToCache(L"a", L"A");
+	fixture.fingerprint = L"m1";
+	CHECK_EQ(wstring(L"A"), fixture.cache.readFromCache(L"a"));
+}
+
+TEST(emptyValuesAreNotTagged) {
+	Fixture fixture;
+	fixture.cache.writeToCache(L"a", L" ");
+
+	CHECK(fixture.mainCache.readFromCache(L"a").empty());
+	CHECK(!fixture.cache.keyExists(L"a"));
+}
+
+// the value itself may hold the separator; only the last one ends it
+TEST(valuesMayHoldSeparator) {
+	Fixture fixture;
+	fixture.cache.writeToCache(L"a", L"x\x1Fy");
+
+	CHECK_EQ(wstring(L"x\x1Fy"), fixture.cache.readFromCache(L"a"));
+}
+
+TEST(purgeRemovesMismatchedValues) {
+	Fixture fixture;
+	fixture.mainCache.writeToCache(L"old", L"O");
+	fixture.cache.writeToCache(L"a", L"A");
+	fixture.fingerprint = L"m2";
+	fixture.cache.writeToCache(L"b", L"B");
+
+	fixture.cache.startPurge();
+	CHECK(waitForRemoval(fixture.mainCache, { L"old", L"a" }));
+	fixture.cache.stopPurge();
+
+	CHECK((fixture.mainCache.readAllFromCache() == unordered_map<wstring, wstring>{ { L"b", L"B\x1Fm2" } }));
+}
+
+// with fallback enabled, mismatched values are still served, so they are kept
+TEST(purgeSkippedWithFallback) {
+	Fixture fixture;
+	fixture.cache.writeToCache(L"a", L"A");
+	fixture.fingerprint = L"m2";
+	fixture.fallback = true;
+
+	fixture.cache.startPurge();
+	this_thread::sleep_for(chrono::milliseconds(20));
+	fixture.cache.stopPurge();
+
+	CHECK(!fixture.mainCache.readAllEntered);
+	CHECK_EQ(wstring(L"A\x1Fm1"), fixture.mainCache.readFromCache(L"a"));
+}
+
+// a key rewritten after the purge read the cache holds a current value, which the purge must not remove
+TEST(purgeKeepsKeysWrittenDuringIt) {
+	Fixture fixture;
+	fixture.cache.writeAllToCache(unordered_map<wstring, wstring>{ { L"a", L"A" }, { L"b", L"B" }, { L"c", L"C" } });
+	fixture.fingerprint = L"m2";
+	fixture.mainCache.gated = true;
+
+	fixture.cache.startPurge();
+	while (!fixture.mainCache.readAllEntered) this_thread::sleep_for(chrono::milliseconds(1));
+	fixture.cache.writeToCache(L" a ", L"A2");
+	fixture.cache.writeAllToCache(unordered_map<wstring, wstring>{ { L"b\n", L"B2" } });
+	fixture.mainCache.gated = false;
+
+	CHECK(waitForRemoval(fixture.mainCache, { L"c" }));
+	this_thread::sleep_for(chrono::milliseconds(20));
+	fixture.cache.stopPurge();
+
+	CHECK_EQ(wstring(L"A2"), fixture.cache.readFromCache(L"a"));
+	CHECK_EQ(wstring(L"B2"), fixture.cache.readFromCache(L"b"));
+}
+
+
+TEST_MAIN()
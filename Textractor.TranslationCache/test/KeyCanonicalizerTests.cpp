@@ -0,0 +1,195 @@
+#include "TestHelper.h"
+#include "KeyCanonicalizer.h"
+
+
+namespace {
+	ExtensionConfig makeConfig(bool keyFolding, const wstring& keyStripRules = L"") {
+		ExtensionConfig config = DefaultConfig;
+		config.keyFolding = keyFolding;
+		config.keyStripRules = keyStripRules;
+		return config;
+	}
+
+	// non-ASCII characters as their code points, for failure messages
+	string describe(const wstring& text) {
+		string description;
+
+		for (wchar_t ch : text) {
+			char codePoint[12];
+			snprintf(codePoint, sizeof(codePoint), "\\x%X", static_cast<unsigned int>(ch));
+			description += ch >= L'\x20' && ch < L'\x7F' ? string(1, static_cast<char>(ch)) : string(codePoint);
+		}
+
+		return description;
+	}
+
+	// each pair is a key and its expected canonical form
+	bool canonicalizesAll(const ExtensionConfig& config, const vector<pair<wstring, wstring>>& cases) {
+		DefaultKeyCanonicalizer keyCanonicalizer;
+		bool matches = true;
+
+		for (const auto& testCase : cases) {
+			wstring canonicalKey = keyCanonicalizer.canonicalize(testCase.first, config);
+			if (canonicalKey == testCase.second) continue;
+
+			reportTestFailure(__FILE__, __LINE__, "'" + describe(testCase.first) + "' became '"
+				+ describe(canonicalKey) + "', not '" + describe(testCase.second) + "'");
+			matches = false;
+		}
+
+		return matches;
+	}
+}
+
+
+// both options are off by default, so existing caches keep their keys
+TEST(keysKeptWithoutOptions) {
+	CHECK(!DefaultConfig.keyFolding);
+	CHECK(DefaultConfig.keyStripRules.empty());
+	CHECK(canonicalizesAll(DefaultConfig, { { L"\xFF21\x3000\xFF76\xFF9E\x200B...", L"\xFF21\x3000\xFF76\xFF9E\x200B..." } }));
+
+	NoKeyCanonicalizer noKeyCanonicalizer;
+	CHECK_EQ(wstring(L"\xFF21"), noKeyCanonicalizer.canonicalize(L"\xFF21", makeConfig(true, L"\xFF21")));
+}
+
+TEST(foldsFullWidthAscii) {
+	CHECK(canonicalizesAll(makeConfig(true), {
+		{ L"\xFF21\xFF22\xFF43\xFF11\xFF01", L"ABc1!" },
+		// the ends of the range, and the characters just outside it
+		{ L"\xFF01\xFF5E", L"!~" },
+		{ L"\xFF00\xFF5F", L"\xFF00\xFF5F" },
+		{ L"\x3000" L"a\x3000", L" a " },
+		{ L"\xFF08\x6F22\xFF09", L"(\x6F22)" },
+	}));
+}
+
+TEST(foldsHalfWidthKana) {
+	CHECK(canonicalizesAll(makeConfig(true), {
+		{ L"\xFF71\xFF72\xFF73", L"\x30A2\x30A4\x30A6" },
+		{ L"\xFF61\xFF62\xFF63\xFF64\xFF65", L"\x3002\x300C\x300D\x3001\x30FB" },
+		{ L"\xFF6F\xFF70\xFF9D\xFF66", L"\x30C3\x30FC\x30F3\x30F2" },
+		// voiced and semi-voiced marks combine with the kana they follow
+		{ L"\xFF76\xFF9E\xFF77\xFF9E\xFF78\xFF9E\xFF79\xFF9E\xFF7A\xFF9E\xFF7B\xFF9E\xFF7C\xFF9E\xFF7D\xFF9E\xFF7E\xFF9E\xFF7F\xFF9E",
+			L"\x30AC\x30AE\x30B0\x30B2\x30B4\x30B6\x30B8\x30BA\x30BC\x30BE" },
+		{ L"\xFF80\xFF9E\xFF81\xFF9E\xFF82\xFF9E\xFF83\xFF9E\xFF84\xFF9E\xFF73\xFF9E", L"\x30C0\x30C2\x30C5\x30C7\x30C9\x30F4" },
+		{ L"\xFF8A\xFF9E\xFF8B\xFF9E\xFF8C\xFF9E\xFF8D\xFF9E\xFF8E\xFF9E", L"\x30D0\x30D3\x30D6\x30D9\x30DC" },
+		{ L"\xFF8A\xFF9F\xFF8B\xFF9F\xFF8C\xFF9F\xFF8D\xFF9F\xFF8E\xFF9F", L"\x30D1\x30D4\x30D7\x30DA\x30DD" },
+		// and are kept (as the combining marks) where they can't combine
+		{ L"\xFF71\xFF9E\xFF76\xFF9F\xFF9E", L"\x30A2\x3099\x30AB\x309A\x3099" },
+		// full-width kana are left as they are
+		{ L"\x30AC\x30D1", L"\x30AC\x30D1" },
+	}));
+}
+
+TEST(foldsEllipses) {
+	CHECK(canonicalizesAll(makeConfig(true), {
+		{ L"\x2026", L"\x2026" },
+		{ L"a\x2026\x2026", L"a\x2026" },
+		{ L"a...", L"a\x2026" },
+		{ L"a..b", L"a\x2026" L"b" },
+		{ L"\x2025", L"\x2026" },
+		{ L"\x30FB\x30FB\x30FB", L"\x2026" },
+		{ L"\xFF0E\xFF0E\xFF65\xFF65", L"\x2026" },
+		{ L".\x2026\x30FB!", L"\x2026!" },
+		// a single dot is punctuation, not an ellipsis
+		{ L"a.b\x30FB" L"c", L"a.b\x30FB" L"c" },
+		{ L"\xFF0E", L"." },
+	}));
+}
+
+TEST(dropsControlAndZeroWidthChars) {
+	CHECK(canonicalizesAll(makeConfig(true), {
+		{ L"a\x01" L"b\r\nc\td\x1F" L"e", L"abcde" },
+		{ L"a\x7F" L"b\x85" L"c\x9F" L"d", L"abcd" },
+		{ L"a\x200B" L"b\x200C" L"c\x200D" L"d\x2060" L"e\xFEFF" L"f", L"abcdef" },
+		// neighbours of the dropped ranges are kept
+		{ L"\x20\xA0\x200A\x200E", L"\x20\xA0\x200A\x200E" },
+	}));
+}
+
+// a key which would be left empty is kept as it is
+TEST(emptyResultKeepsKey) {
+	CHECK(canonicalizesAll(makeConfig(true, L"\x300A*\x300B"), {
+		{ L"\x200B\x200B", L"\x200B\x200B" },
+		{ L"\x300A" L"a\x300B", L"\x300A" L"a\x300B" },
+		{ L"\x300A" L"a\x300B\x200B", L"\x300A" L"a\x300B\x200B" },
+	}));
+}
+
+TEST(stripsEnclosedText) {
+	CHECK(canonicalizesAll(makeConfig(false, L"\x300A*\x300B"), {
+		{ L"\x6F22\x5B57\x300A\x304B\x3093\x3058\x300B\x3067\x3059", L"\x6F22\x5B57\x3067\x3059" },
+		{ L"a\x300A" L"b\x300B" L"c\x300A" L"d\x300B", L"ac" },
+		// up to the first close, and an unclosed open is left as it is
+		{ L"a\x300A" L"b\x300B" L"c\x300B", L"ac\x300B" },
+		{ L"a\x300A" L"b", L"a\x300A" L"b" },
+		// folding is off, so nothing else changes
+		{ L"\xFF21\x300A" L"b\x300B\x200B", L"\xFF21\x200B" },
+	}));
+
+	// open/close may be several characters long
+	CHECK(canonicalizesAll(makeConfig(false, L"<ruby>*</ruby>"), { { L"a<ruby>b</ruby>c</ruby>", L"ac</ruby>" } }));
+}
+
+TEST(stripsLiteralText) {
+	CHECK(canonicalizesAll(makeConfig(false, L"\x266A|[SE]"), {
+		{ L"\x266A" L"a\x266A\x266A" L"b", L"ab" },
+		{ L"[SE]a[SE", L"a[SE" },
+	}));
+
+	// a wildcard at either end (or alone) is literal text, and empty rules are ignored
+	CHECK(canonicalizesAll(makeConfig(false, L"*b||a*|*"), {
+		{ L"x*by", L"xy" },
+		{ L"a*b", L"b" },
+		{ L"x*y", L"xy" },
+	}));
+}
+
+TEST(appliesFirstMatchingRule) {
+	CHECK(canonicalizesAll(makeConfig(false, L"\x300A*\x300B|\x300A"), {
+		{ L"a\x300A" L"b\x300B" L"c", L"ac" },
+		{ L"a\x300A" L"b", L"ab" },
+	}));
+}
+
+// rules are matched against the original text, before it is folded
+TEST(stripsBeforeFolding) {
+	CHECK(canonicalizesAll(makeConfig(true, L"(*)|\x300A*\x300B"), {
+		{ L"\xFF21(\xFF42)\x200B", L"A" },
+		{ L"a\xFF08" L"b\xFF09", L"a(b)" },
+		{ L"\xFF76\xFF9E\x300A\x304C\x300B\x2026\x2026", L"\x30AC\x2026" },
+	}));
+}
+
+TEST(reportCountsCollapsedEntries) {
+	DefaultTextFormatter formatter;
+	DefaultKeyCanonicalizer keyCanonicalizer;
+	unordered_map<wstring, wstring> cache = {
+		{ L"ABC", L"1" }, { L"\xFF21\xFF22\xFF23", L"2" },
+		{ L"\x30AC", L"3" }, { L"\xFF76\xFF9E", L"4" }, { L"\x30AC\x200B", L"5" },
+		// folded to "y ", which the cache would trim
+		{ L"y", L"6" }, { L"y\x3000\x01", L"7" },
+		{ L"z", L"8" },
+	};
+
+	KeyCollapseReport report(cache, keyCanonicalizer, formatter, makeConfig(true));
+	CHECK_EQ(size_t(8), report.getEntryCount());
+	CHECK_EQ(size_t(4), report.getChangedCount());
+	CHECK_EQ(size_t(4), report.getCanonicalKeyCount());
+	CHECK_EQ(size_t(4), report.getCollapsedCount());
+
+	vector<pair<wstring, vector<wstring>>> expectedGroups = {
+		{ L"\x30AC", { L"\x30AC", L"\x30AC\x200B", L"\xFF76\xFF9E" } },
+		{ L"ABC", { L"ABC", L"\xFF21\xFF22\xFF23" } },
+		{ L"y", { L"y", L"y\x3000\x01" } },
+	};
+	CHECK((report.getCollapsedGroups() == expectedGroups));
+
+	KeyCollapseReport unchangedReport(cache, keyCanonicalizer, formatter, makeConfig(false));
+	CHECK_EQ(size_t(0), unchangedReport.getChangedCount());
+	CHECK_EQ(size_t(0), unchangedReport.getCollapsedCount());
+	CHECK(unchangedReport.getCollapsedGroups().empty());
+}
+
+
+TEST_MAIN()
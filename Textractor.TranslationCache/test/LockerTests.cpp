@@ -0,0 +1,130 @@
+#include "TestHelper.h"
+#include "_Libraries/Locker.h"
+#include <atomic>
+#include <memory>
+#include <thread>
+
+
+namespace {
+	// holds 'locker' (through 'lockFn') on another thread, until 'release' is called
+	class LockHolder {
+	public:
+		template<class LockFn>
+		LockHolder(LockFn lockFn) {
+			_thread = thread([this, lockFn]() {
+				lockFn([this]() {
+					_held = true;
+					while (!_released) this_thread::yield();
+				});
+			});
+
+			while (!_held) this_thread::yield();
+		}
+
+		~LockHolder() {
+			release();
+		}
+
+		void release() {
+			_released = true;
+			if (_thread.joinable()) _thread.join();
+		}
+	private:
+		atomic<bool> _held{ false };
+		atomic<bool> _released{ false };
+		thread _thread;
+	};
+
+	// runs 'threadCount' threads which each lock 'iterations' times, and returns the most actions seen at once
+	template<class LockFn>
+	int runConcurrently(int threadCount, int iterations, LockFn lockFn) {
+		atomic<int> running{ 0 }, mostRunning{ 0 };
+		vector<thread> threads{};
+
+		for (int t = 0; t < threadCount; t++) {
+			threads.push_back(thread([&]() {
+				for (int i = 0; i < iterations; i++) {
+					lockFn([&]() {
+						int nowRunning = ++running;
+						int most = mostRunning;
+						while (nowRunning > most && !mostRunning.compare_exchange_weak(most, nowRunning)) { }
+						running--;
+					});
+				}
+			}));
+		}
+
+		for (thread& lockingThread : threads) lockingThread.join();
+		return mostRunning;
+	}
+}
+
+
+TEST(basicLockerRunsOneActionAtATime) {
+	BasicLocker locker;
+	CHECK_EQ(1, runConcurrently(8, 20000, [&locker](const function<void()>& action) { locker.lock(action); }));
+
+	LockHolder holder([&locker](const function<void()>& action) { locker.lock(action); });
+	CHECK(!locker.tryLock([]() { }));
+	holder.release();
+	CHECK(locker.tryLock([]() { }));
+}
+
+TEST(lockReturnsWhatActionReturns) {
+	BasicLocker basicLocker;
+	SemaphoreLocker semaphoreLocker;
+	SharedLocker sharedLocker;
+	Locker& locker = basicLocker;
+
+	unique_ptr<int> value = basicLocker.lock([]() { return unique_ptr<int>(new int(7)); });
+	CHECK_EQ(7, *value);
+	CHECK_EQ(wstring(L"ws"), locker.lockWS([]() { return wstring(L"ws"); }));
+	CHECK_EQ(3, semaphoreLocker.lock([]() { return 3; }));
+	CHECK_EQ(string("s"), sharedLocker.lockShared([]() { return string("s"); }));
+
+	int output = 0;
+	CHECK(locker.tryLockI([]() { return 5; }, output) && output == 5);
+}
+
+TEST(semaphoreLockerCapsConcurrentActions) {
+	SemaphoreLocker locker(3);
+	int mostRunning = runConcurrently(8, 5000, [&locker](const function<void()>& action) { locker.lock(action); });
+	CHECK(mostRunning >= 1 && mostRunning <= 3);
+
+	SemaphoreLocker oneLocker(1);
+	LockHolder holder([&oneLocker](const function<void()>& action) { oneLocker.lock(action); });
+	CHECK(!oneLocker.tryLock([]() { }));
+	holder.release();
+	oneLocker.waitForAllUnlocked();
+	CHECK(oneLocker.tryLock([]() { }));
+}
+
+// the count taken by an action which throws is given back
+TEST(semaphoreLockerReleasesOnThrow) {
+	SemaphoreLocker locker(1);
+
+	CHECK_THROWS(locker.lock([]() { throw runtime_error("action failed"); }));
+	CHECK(locker.tryLock([]() { }));
+}
+
+TEST(sharedLockerAllowsSharedOrExclusive) {
+	SharedLocker locker;
+
+	{
+		LockHolder reader([&locker](const function<void()>& action) { locker.lockShared(action); });
+		CHECK(locker.tryLockShared([]() { }));
+		CHECK(!locker.tryLock([]() { }));
+	}
+
+	{
+		LockHolder writer([&locker](const function<void()>& action) { locker.lock(action); });
+		CHECK(!locker.tryLockShared([]() { }));
+		CHECK(!locker.tryLock([]() { }));
+	}
+
+	CHECK_EQ(1, runConcurrently(4, 20000, [&locker](const function<void()>& action) { locker.lock(action); }));
+	CHECK(runConcurrently(4, 20000, [&locker](const function<void()>& action) { locker.lockShared(action); }) >= 1);
+}
+
+
+TEST_MAIN()
@@ -0,0 +1,152 @@
+#include "TestHelper.h"
+#include "Cache/MappedSnapshotTextMapCache.h"
+#include "File/Writer/FstreamFileWriter.h"
+
+
+namespace {
+	class SwitchableFileRenamer : public FileRenamer {
+	public:
+		bool failing = false;
+
+		void renameFile(const string& srcFilePath, const string& destFilePath) override {
+			if (failing) throw runtime_error("rename failed");
+			_renamer.renameFile(srcFilePath, destFilePath);
+		}
+	private:
+		WinApiFileRenamer _renamer;
+	};
+
+	struct Fixture {
+		TempDir dir;
+		string filePath = dir.file("cache.txt");
+		FstreamFileWriter writer;
+		WinApiFileMapper mapper;
+		SwitchableFileRenamer renamer;
+		CRemoveFileDeleter deleter;
+		FstreamFileInspector inspector;
+		DefaultTextFormatter formatter;
+		DelimTextMapper textMapper{ formatter };
+		MappedSnapshotTextMapCache cache{ mapper, renamer, deleter, inspector, formatter, textMapper };
+	};
+}
+
+
+TEST(readsLatestLineOfEachKey) {
+	Fixture fixture;
+	fixture.writer.writeToFile(fixture.filePath, vector<string>{ "a|~|A", "b\\nx|~|B", "a|~|A2", "junk" });
+	fixture.cache.loadSnapshot(fixture.filePath);
+
+	CHECK_EQ(wstring(L"A2"), fixture.cache.readFromCache(L"a"));
+	CHECK_EQ(wstring(L"B"), fixture.cache.readFromCache(L"b\nx"));
+	CHECK_EQ(wstring(L""), fixture.cache.readFromCache(L"zz"));
+	CHECK_EQ(size_t(2), fixture.cache.readAllFromCache().size());
+}
+
+TEST(overlayIsDroppedOnReload) {
+	Fixture fixture;
+	fixture.writer.writeToFile(fixture.filePath, vector<string>{ "a|~|A" });
+	fixture.cache.loadSnapshot(fixture.filePath);
+
+	fixture.cache.writeToCache(L"n", L"N");
+	fixture.cache.removeFromCache(L"a");
+	CHECK_EQ(wstring(L"N"), fixture.cache.readFromCache(L"n"));
+	CHECK_EQ(wstring(L""), fixture.cache.readFromCache(L"a"));
+
+	fixture.cache.loadSnapshot(fixture.filePath);
+	CHECK_EQ(wstring(L"A"), fixture.cache.readFromCache(L"a"));
+	CHECK_EQ(wstring(L""), fixture.cache.readFromCache(L"n"));
+}
+
+// lines edited by hand may have whitespace around their key, which lookups (and the other caches) trim
+TEST(matchesKeysWhichAreNotFormatted) {
+	Fixture fixture;
+	fixture.writer.writeToFile(fixture.filePath, vector<string>{
+		" a |~|A", "\tb|~|B", "c\xE3\x80\x80|~|C", "d|~|D", " d|~|D2", "\\n e|~|E", " |~|empty key" });
+
+	// compiled, then reused from the sidecar
+	for (int i = 0; i < 2; i++) {
+		fixture.cache.loadSnapshot(fixture.filePath);
+		CHECK_EQ(wstring(L"A"), fixture.cache.readFromCache(L"a"));
+		CHECK_EQ(wstring(L"A"), fixture.cache.readFromCache(L"  a"));
+		CHECK_EQ(wstring(L"B"), fixture.cache.readFromCache(L"b"));
+		CHECK_EQ(wstring(L"C"), fixture.cache.readFromCache(L"c"));
+		CHECK_EQ(wstring(L"D2"), fixture.cache.readFromCache(L"d"));
+		CHECK_EQ(wstring(L"E"), fixture.cache.readFromCache(L"e"));
+		CHECK(fixture.cache.readAllFromCache().count(L"a") == 1);
+	}
+}
+
+TEST(followsAppendedLines) {
+	Fixture fixture;
+	fixture.writer.writeToFile(fixture.filePath, vector<string>{ "a|~|A" });
+	fixture.cache.loadSnapshot(fixture.filePath);
+	CHECK(fixture.cache.syncWithSource() == MappedSnapshotTextMapCache::Unchanged);
+
+	fixture.writer.appendToFile(fixture.filePath, vector<string>{ "b|~|B", " a |~|A2" });
+	CHECK(fixture.cache.syncWithSource() == MappedSnapshotTextMapCache::Appended);
+	CHECK_EQ(wstring(L"B"), fixture.cache.readFromCache(L"b"));
+	CHECK_EQ(wstring(L"A2"), fixture.cache.readFromCache(L"a"));
+
+	// a partially written line is only picked up once complete
+	{ ofstream f(fixture.filePath, ios_base::app | ios_base::binary); f << "c|~|"; }
+	fixture.cache.syncWithSource();
+	CHECK_EQ(wstring(L""), fixture.cache.readFromCache(L"c"));
+	{ ofstream f(fixture.filePath, ios_base::app | ios_base::binary); f << "C\n"; }
+	fixture.cache.syncWithSource();
+	CHECK_EQ(wstring(L"C"), fixture.cache.readFromCache(L"c"));
+
+	fixture.writer.writeToFile(fixture.filePath, vector<string>{ "z|~|Z" });
+	CHECK(fixture.cache.syncWithSource() == MappedSnapshotTextMapCache::Rewritten);
+	fixture.cache.loadSnapshot(fixture.filePath);
+	CHECK_EQ(wstring(L"Z"), fixture.cache.readFromCache(L"z"));
+	CHECK_EQ(wstring(L""), fixture.cache.readFromCache(L"a"));
+}
+
+// the sidecar is only recompiled once the appended lines outgrow it, until then they are merged into the overlay
+TEST(reusesSidecarUntilTooFarBehind) {
+	Fixture fixture;
+	fixture.writer.writeToFile(fixture.filePath, vector<string>{ "a|~|A" });
+	fixture.cache.loadSnapshot(fixture.filePath);
+	string sidecar = readTestFile(fixture.filePath + ".snap");
+
+	fixture.writer.appendToFile(fixture.filePath, vector<string>{ "b|~|B", "a|~|A2" });
+	fixture.cache.loadSnapshot(fixture.filePath);
+	CHECK_EQ(wstring(L"A2"), fixture.cache.readFromCache(L"a"));
+	CHECK_EQ(wstring(L"B"), fixture.cache.readFromCache(L"b"));
+	CHECK(readTestFile(fixture.filePath + ".snap") == sidecar);
+	CHECK(!ifstream(fixture.filePath + ".2.snap").is_open());
+
+	// recompiled under the other name, since the current one is still mapped
+	fixture.writer.appendToFile(fixture.filePath, vector<string>(20000, "c|~|" + string(100, 'C')));
+	fixture.cache.loadSnapshot(fixture.filePath);
+	CHECK_EQ(wstring(L"A2"), fixture.cache.readFromCache(L"a"));
+	CHECK_EQ(size_t(100), fixture.cache.readFromCache(L"c").length());
+	CHECK(ifstream(fixture.filePath + ".2.snap").is_open());
+	CHECK(!ifstream(fixture.filePath + ".snap").is_open());
+}
+
+TEST(failedRecompileKeepsCurrentSnapshot) {
+	Fixture fixture;
+	fixture.writer.writeToFile(fixture.filePath, vector<string>{ "a|~|A" });
+	fixture.cache.loadSnapshot(fixture.filePath);
+
+	fixture.renamer.failing = true;
+	fixture.writer.writeToFile(fixture.filePath, vector<string>{ "z|~|Z" });
+	CHECK_THROWS(fixture.cache.loadSnapshot(fixture.filePath));
+	CHECK_EQ(wstring(L"A"), fixture.cache.readFromCache(L"a"));
+
+	fixture.renamer.failing = false;
+	fixture.cache.loadSnapshot(fixture.filePath);
+	CHECK_EQ(wstring(L"Z"), fixture.cache.readFromCache(L"z"));
+	CHECK_EQ(wstring(L""), fixture.cache.readFromCache(L"a"));
+}
+
+TEST(missingFileLoadsEmpty) {
+	Fixture fixture;
+	fixture.cache.loadSnapshot(fixture.dir.file("none.txt"));
+	CHECK_EQ(wstring(L""), fixture.cache.readFromCache(L"a"));
+	CHECK(fixture.cache.readAllFromCache().empty());
+}
+
+
+TEST_MAIN()
@@ -0,0 +1,144 @@
+#include "TestHelper.h"
+#include "Cache/RecencyCacheFileTruncater.h"
+#include "File/MappedFileReader.h"
+#include "File/Writer/FstreamFileWriter.h"
+#include "File/Writer/WinApiFileWriter.h"
+
+
+namespace {
+	class FixedRecencySource : public CacheRecencySource {
+	public:
+		vector<wstring> keys{};
+
+		vector<wstring> getKeysByRecency() const override {
+			return keys;
+		}
+	};
+
+	struct Fixture {
+		TempDir dir;
+		string filePath = dir.file("cache.txt");
+		FstreamFileWriter writer;
+		WinApiFileMapper mapper;
+		MappedFileReader reader{ mapper };
+		FstreamFileInspector inspector;
+		DefaultTextFormatter formatter;
+		DelimTextMapper textMapper{ formatter };
+		DefaultCacheLineFormatter lineFormatter{ formatter, textMapper };
+		FixedRecencySource recencySource;
+		uint64_t sizeLimitBytes = 0;
+		RecencyCacheFileTruncater truncater{ reader, inspector, lineFormatter, recencySource,
+			[this]() { return sizeLimitBytes; } };
+
+		void writeEntries(const vector<pair<wstring, wstring>>& entries) {
+			vector<string> lines{};
+			for (const auto& entry : entries) lines.push_back(lineFormatter.exportFormat(entry.first, entry.second));
+			writer.writeToFile(filePath, lines);
+		}
+
+		vector<pair<wstring, wstring>> readEntries() {
+			vector<pair<wstring, wstring>> entries{};
+			reader.readLines(filePath, [this, &entries](const string& line) { entries.push_back(lineFormatter.importFormat(line)); });
+			return entries;
+		}
+
+		uint64_t getLineBytes(const wstring& key, const wstring& value) {
+			return lineFormatter.exportFormat(key, value).length() + 1;
+		}
+	};
+
+	typedef vector<pair<wstring, wstring>> Entries;
+}
+
+
+TEST(keepsRecentKeysFirstInFileOrder) {
+	Fixture fixture;
+	fixture.writeEntries({ { L"a", L"A" }, { L"b", L"B" }, { L"c", L"C" }, { L"d", L"D" } });
+	fixture.recencySource.keys = { L"a", L"b" };
+	fixture.sizeLimitBytes = fixture.getLineBytes(L"a", L"A") * 3 + 1;
+	fixture.truncater.truncateFile(fixture.filePath);
+
+	// two recent lines, then the newest other line
+	CHECK(fixture.readEntries() == Entries({ { L"a", L"A" }, { L"b", L"B" }, { L"d", L"D" } }));
+	CHECK(fixture.inspector.getFileSize(fixture.filePath) < fixture.sizeLimitBytes);
+}
+
+// a recent entry too large for the room left doesn't keep smaller ones after it out
+TEST(skipsLinesTooLargeForTheRoomLeft) {
+	Fixture fixture;
+	wstring largeValue(200, L'x');
+	fixture.writeEntries({ { L"a", L"A" }, { L"big", largeValue }, { L"b", L"B" }, { L"c", L"C" }, { L"d", L"D" } });
+	fixture.recencySource.keys = { L"a", L"big", L"b" };
+	fixture.sizeLimitBytes = fixture.getLineBytes(L"a", L"A") * 3 + 1;
+	fixture.truncater.truncateFile(fixture.filePath);
+
+	CHECK(fixture.readEntries() == Entries({ { L"a", L"A" }, { L"b", L"B" }, { L"d", L"D" } }));
+}
+
+TEST(dropsSupersededLinesAndTombstones) {
+	Fixture fixture;
+	fixture.writeEntries({ { L"a", L"A" }, { L"b", L"B" }, { L"a", L"A2" }, { L"b", L"" }, { L"c", L"C" } });
+	fixture.recencySource.keys = { L"b", L"a" };
+	fixture.sizeLimitBytes = fixture.inspector.getFileSize(fixture.filePath);
+	fixture.truncater.truncateFile(fixture.filePath);
+
+	CHECK(fixture.readEntries() == Entries({ { L"a", L"A2" }, { L"c", L"C" } }));
+}
+
+TEST(leavesFilesUnderTheLimitAlone) {
+	Fixture fixture;
+	fixture.writeEntries({ { L"a", L"A" }, { L"a", L"A2" } });
+	fixture.sizeLimitBytes = fixture.inspector.getFileSize(fixture.filePath) + 1;
+	fixture.truncater.truncateFile(fixture.filePath);
+
+	CHECK_EQ(size_t(2), fixture.readEntries().size());
+}
+
+
+// the Write module keeps the file open to append to it, so it is rewritten in place: lines it appended after the scan
+// are kept, and its later appends follow the kept lines
+TEST(truncatesFileKeptOpenByWriteModule) {
+	Fixture fixture;
+	PersistentWinApiFileWriter writeModuleWriter;
+	fixture.writeEntries({ { L"a", L"A" }, { L"b", L"B" }, { L"c", L"C" }, { L"d", L"D" } });
+	writeModuleWriter.appendToFile(fixture.filePath, fixture.lineFormatter.exportFormat(L"e", L"E"));
+	fixture.recencySource.keys = { L"b" };
+	fixture.sizeLimitBytes = fixture.getLineBytes(L"a", L"A") * 3 + 1;
+	fixture.truncater.truncateFile(fixture.filePath);
+
+	CHECK(fixture.readEntries() == Entries({ { L"b", L"B" }, { L"d", L"D" }, { L"e", L"E" } }));
+	writeModuleWriter.appendToFile(fixture.filePath, fixture.lineFormatter.exportFormat(L"f", L"F"));
+	CHECK(fixture.readEntries() == Entries({ { L"b", L"B" }, { L"d", L"D" }, { L"e", L"E" }, { L"f", L"F" } }));
+}
+
+// lines longer than a copy chunk, dropped and kept ones, are moved whole
+TEST(movesLinesSpanningChunks) {
+	Fixture fixture;
+	wstring largeValue(100000, L'x');
+	fixture.writeEntries({ { L"a", largeValue }, { L"b", L"B" }, { L"c", largeValue + L"c" }, { L"d", L"D" } });
+	fixture.recencySource.keys = { L"c" };
+	fixture.sizeLimitBytes = fixture.getLineBytes(L"c", largeValue + L"c") + fixture.getLineBytes(L"d", L"D") + 1;
+	fixture.truncater.truncateFile(fixture.filePath);
+
+	CHECK(fixture.readEntries() == Entries({ { L"c", largeValue + L"c" }, { L"d", L"D" } }));
+}
+
+// a file opened without sharing writes can't be rewritten now, so it is left for next time
+TEST(skipsFileInUse) {
+	Fixture fixture;
+	fixture.writeEntries({ { L"a", L"A" }, { L"b", L"B" }, { L"c", L"C" } });
+	fixture.sizeLimitBytes = fixture.getLineBytes(L"a", L"A") + 1;
+	HANDLE hFile = CreateFile(StrHelper::convertToW(fixture.filePath).c_str(), GENERIC_READ, FILE_SHARE_READ,
+		NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	CHECK(hFile != INVALID_HANDLE_VALUE);
+
+	fixture.truncater.truncateFile(fixture.filePath);
+	CHECK_EQ(size_t(3), fixture.readEntries().size());
+
+	CloseHandle(hFile);
+	fixture.truncater.truncateFile(fixture.filePath);
+	CHECK(fixture.readEntries() == Entries({ { L"c", L"C" } }));
+}
+
+
+TEST_MAIN()
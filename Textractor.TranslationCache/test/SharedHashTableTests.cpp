@@ -0,0 +1,258 @@
+#include "TestHelper.h"
+#include "SharedMemory/SharedHashTable.h"
+#include <sys/wait.h>
+
+
+namespace {
+	// regions are named per test process, so that runs don't share (or leave behind) tables
+	struct Fixture {
+		PosixSharedMemoryRegionManager regionManager{ "/tc_test_" + to_string(getpid()) + "_" };
+		wstring identifier;
+
+		Fixture(const wstring& identifier) : identifier(identifier) {
+			regionManager.removeRegion(identifier);
+		}
+
+		~Fixture() {
+			regionManager.removeRegion(identifier);
+		}
+
+		shared_ptr<SharedMemoryRegion> openRegion(uint32_t slotCount, uint32_t slabChars) {
+			return regionManager.createOrOpenRegion(identifier, SharedHashTable::getRegionSize(slotCount, slabChars));
+		}
+
+		unique_ptr<SharedHashTable> openTable(uint32_t slotCount, uint32_t slabChars) {
+			return make_unique<SharedHashTable>(openRegion(slotCount, slabChars), slotCount, slabChars);
+		}
+	};
+
+	// a value names its key and repeats one character as many times as it says, so a torn read shows
+	wstring makeValue(const wstring& key, uint32_t n) {
+		return key + L"=" + to_wstring(n) + L":" + wstring(n % 50, static_cast<wchar_t>(L'a' + n % 26));
+	}
+
+	bool isValidValue(const wstring& key, const wstring& value) {
+		if (value.empty()) return true;
+		if (value.compare(0, key.length() + 1, key + L"=") != 0) return false;
+
+		size_t separatorIndex = value.find(L':', key.length() + 1);
+		if (separatorIndex == wstring::npos) return false;
+		uint32_t n = static_cast<uint32_t>(stoul(value.substr(key.length() + 1, separatorIndex - key.length() - 1)));
+		return value == makeValue(key, n);
+	}
+
+	wstring getKey(uint32_t i) {
+		return L"key" + to_wstring(i);
+	}
+
+	// runs 'action' in a child process, which exits with whether it succeeded
+	pid_t runChild(const function<bool()>& action) {
+		pid_t pid = fork();
+		if (pid != 0) return pid;
+
+		bool succeeded = false;
+		try {
+			succeeded = action();
+		}
+		catch (const exception& ex) {
+			fprintf(stderr, "  child %d: %s\n", getpid(), ex.what());
+		}
+
+		_exit(succeeded ? 0 : 1);
+	}
+
+	bool waitChild(pid_t pid) {
+		int status = 0;
+		return waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+	}
+
+	// the id of a process which has exited (and been reaped)
+	uint32_t getDeadProcessId() {
+		pid_t pid = runChild([]() { return true; });
+		waitChild(pid);
+		return static_cast<uint32_t>(pid);
+	}
+
+	// what a process leaves behind when it dies holding the writer lock / setting the table up / writing a slot;
+	// the header starts with an 8-byte magic, then the init state and the writer lock (4 bytes each)
+	struct RegionWords {
+		shared_ptr<SharedMemoryRegion> region;
+
+		atomic<uint32_t>& initState() { return headerWord(2); }
+		atomic<uint32_t>& writeLock() { return headerWord(3); }
+
+		// each slot starts with its sequence counter
+		atomic<uint32_t>& slotSequence(uint32_t i) {
+			size_t headerSize = SharedHashTable::getRegionSize(0, 0);
+			size_t slotSize = SharedHashTable::getRegionSize(1, 0) - headerSize;
+			return *reinterpret_cast<atomic<uint32_t>*>(static_cast<char*>(region->data()) + headerSize + slotSize * i);
+		}
+	private:
+		atomic<uint32_t>& headerWord(size_t i) {
+			return reinterpret_cast<atomic<uint32_t>*>(region->data())[i];
+		}
+	};
+}
+
+
+TEST(keepsEntriesWhenRebuildWouldNotFit) {
+	Fixture fixture(L"rebuild");
+	unique_ptr<SharedHashTable> table = fixture.openTable(8, 256);
+
+	for (uint32_t i = 0; i < 4; i++) table->write(getKey(i), wstring(45, L'v'));
+	CHECK_THROWS(table->write(getKey(4), wstring(100, L'x')));
+	CHECK_THROWS(table->write(getKey(0), wstring(250, L'x')));
+
+	for (uint32_t i = 0; i < 4; i++) CHECK_EQ(wstring(45, L'v'), table->read(getKey(i)));
+	CHECK_EQ(size_t(4), table->readAll().size());
+	CHECK_EQ(wstring(L""), table->read(getKey(4)));
+
+	// a rebuild which fits still goes through
+	table->write(getKey(4), wstring(30, L'y'));
+	CHECK_EQ(wstring(30, L'y'), table->read(getKey(4)));
+	CHECK_EQ(wstring(45, L'v'), table->read(getKey(3)));
+}
+
+TEST(regionIsSharedBetweenProcesses) {
+	Fixture fixture(L"shared");
+	unique_ptr<SharedHashTable> table = fixture.openTable(16, 1024);
+	table->write(L"parent", L"P");
+
+	pid_t pid = runChild([&fixture]() {
+		unique_ptr<SharedHashTable> childTable = fixture.openTable(16, 1024);
+		childTable->write(L"child", L"C");
+		return childTable->read(L"parent") == L"P";
+	});
+
+	CHECK(waitChild(pid));
+	CHECK_EQ(wstring(L"C"), table->read(L"child"));
+}
+
+// writers in several processes keep rewriting, resizing and removing entries in a small table (so slots move
+// around and the slab is rebuilt all the time), while readers in other processes check every value they see
+TEST(readersNeverSeeTornEntriesAcrossProcesses) {
+	Fixture fixture(L"stress");
+	const uint32_t slotCount = 64, slabChars = 4096, keyCount = 40;
+	unique_ptr<SharedHashTable> table = fixture.openTable(slotCount, slabChars);
+	auto deadline = chrono::steady_clock::now() + chrono::milliseconds(1500);
+	vector<pid_t> pids{};
+
+	for (uint32_t w = 0; w < 2; w++) {
+		pids.push_back(runChild([&fixture, w, deadline, slotCount, slabChars, keyCount]() {
+			unique_ptr<SharedHashTable> childTable = fixture.openTable(slotCount, slabChars);
+
+			for (uint32_t n = w; chrono::steady_clock::now() < deadline; n += 2) {
+				wstring key = getKey((n * 7) % keyCount);
+				if (n % 5 == 0) childTable->remove(key);
+				else childTable->write(key, makeValue(key, n));
+			}
+
+			return true;
+		}));
+	}
+
+	for (uint32_t r = 0; r < 3; r++) {
+		pids.push_back(runChild([&fixture, deadline, slotCount, slabChars, keyCount]() {
+			unique_ptr<SharedHashTable> childTable = fixture.openTable(slotCount, slabChars);
+			size_t nonEmptyReads = 0;
+
+			for (uint32_t i = 0; chrono::steady_clock::now() < deadline; i++) {
+				wstring key = getKey(i % keyCount);
+				wstring value = childTable->read(key);
+
+				if (!isValidValue(key, value)) {
+					fprintf(stderr, "  torn read for %ls: %ls\n", key.c_str(), value.c_str());
+					return false;
+				}
+
+				nonEmptyReads += !value.empty();
+			}
+
+			return nonEmptyReads > 0;
+		}));
+	}
+
+	for (pid_t pid : pids) CHECK(waitChild(pid));
+
+	unordered_map<wstring, wstring> entries = table->readAll();
+	CHECK(!entries.empty());
+	for (const auto& entry : entries) CHECK(isValidValue(entry.first, entry.second));
+}
+
+
+TEST(takesOverWriterLockOfDeadProcess) {
+	Fixture fixture(L"deadWriter");
+	unique_ptr<SharedHashTable> table = fixture.openTable(16, 1024);
+	table->write(L"a", L"A");
+	RegionWords words{ fixture.openRegion(16, 1024) };
+	words.writeLock() = getDeadProcessId();
+
+	auto start = chrono::steady_clock::now();
+	table->write(L"b", L"B");
+	CHECK(chrono::steady_clock::now() - start >= chrono::milliseconds(400));
+
+	// nothing was left half-written, so the entries are kept
+	CHECK_EQ(wstring(L"A"), table->read(L"a"));
+	CHECK_EQ(wstring(L"B"), table->read(L"b"));
+	CHECK_EQ(0u, words.writeLock().load());
+}
+
+TEST(takesOverSetupOfDeadProcess) {
+	Fixture fixture(L"deadInit");
+	RegionWords words{ fixture.openRegion(16, 1024) };
+	words.initState() = getDeadProcessId();
+
+	unique_ptr<SharedHashTable> table = fixture.openTable(16, 1024);
+	table->write(L"a", L"A");
+	CHECK_EQ(wstring(L"A"), table->read(L"a"));
+}
+
+// a reader stuck on a slot left odd by a dead writer takes the lock over, and the torn table is emptied
+TEST(readerRepairsSlotLeftOddByDeadWriter) {
+	Fixture fixture(L"tornSlot");
+	unique_ptr<SharedHashTable> table = fixture.openTable(1, 64);
+	table->write(L"a", L"A");
+	RegionWords words{ fixture.openRegion(1, 64) };
+	words.writeLock() = getDeadProcessId();
+	words.slotSequence(0)++;
+
+	CHECK_EQ(wstring(L""), table->read(L"a"));
+	CHECK(table->readAll().empty());
+	CHECK_EQ(0u, words.slotSequence(0).load() & 1);
+
+	table->write(L"a", L"A2");
+	CHECK_EQ(wstring(L"A2"), table->read(L"a"));
+}
+
+// writers killed at any point (often holding the lock, sometimes mid-write) don't keep other processes waiting,
+// and never leave torn entries behind
+TEST(writersKilledMidWriteDontBlockOthers) {
+	Fixture fixture(L"killed");
+	const uint32_t slotCount = 64, slabChars = 4096, keyCount = 40;
+	unique_ptr<SharedHashTable> table = fixture.openTable(slotCount, slabChars);
+
+	for (uint32_t k = 0; k < 5; k++) {
+		pid_t pid = runChild([&fixture, k, slotCount, slabChars, keyCount]() {
+			unique_ptr<SharedHashTable> childTable = fixture.openTable(slotCount, slabChars);
+
+			for (uint32_t n = k; ; n++) {
+				wstring key = getKey((n * 7) % keyCount);
+				if (n % 5 == 0) childTable->remove(key);
+				else childTable->write(key, makeValue(key, n));
+			}
+
+			return true;
+		});
+
+		this_thread::sleep_for(chrono::milliseconds(20 + k * 7));
+		kill(pid, SIGKILL);
+		waitChild(pid);
+
+		table->write(L"parent", to_wstring(k));
+		CHECK_EQ(to_wstring(k), table->read(L"parent"));
+		for (uint32_t i = 0; i < keyCount; i++) CHECK(isValidValue(getKey(i), table->read(getKey(i))));
+	}
+}
+
+
+TEST_MAIN()
@@ -0,0 +1,139 @@
+#include "TestHelper.h"
+#include "_Libraries/strhelper.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <random>
+
+
+// every allocation of the test binary is counted, so that a test can check how many allocations a call makes
+static atomic<size_t> allocationCount{ 0 };
+
+void* operator new(size_t size) {
+	void* memory = malloc(size > 0 ? size : 1);
+	if (memory == nullptr) throw bad_alloc();
+	allocationCount++;
+	return memory;
+}
+
+// not inlined, since a 'free' inlined into a caller looks (to the compiler) like a mismatch with the 'new' it called
+__attribute__((noinline)) void operator delete(void* memory) noexcept {
+	free(memory);
+}
+
+__attribute__((noinline)) void operator delete(void* memory, size_t size) noexcept {
+	free(memory);
+}
+
+
+namespace {
+	template<class Fn>
+	size_t countAllocations(Fn&& action) {
+		size_t countBefore = allocationCount;
+		action();
+		return allocationCount - countBefore;
+	}
+
+	// applies the pairs one after the other, each in one left-to-right pass (what chained 'replace' calls do)
+	wstring replaceChained(wstring str, const vector<pair<wstring, wstring>>& replacements) {
+		for (const auto& replacement : replacements) {
+			wstring output;
+			size_t copiedIndex = 0, targetIndex;
+
+			while ((targetIndex = str.find(replacement.first, copiedIndex)) != wstring::npos) {
+				output += str.substr(copiedIndex, targetIndex - copiedIndex) + replacement.second;
+				copiedIndex = targetIndex + replacement.first.length();
+			}
+
+			str = output + str.substr(copiedIndex);
+		}
+
+		return str;
+	}
+
+	wstring makeRandomText(mt19937& random, const wstring& alphabet, size_t maxLength) {
+		wstring text(random() % (maxLength + 1), L' ');
+		for (wchar_t& ch : text) ch = alphabet[random() % alphabet.length()];
+		return text;
+	}
+}
+
+
+TEST(replacesEveryOccurrence) {
+	CHECK_EQ(wstring(L"a-b-c"), StrHelper::replace<wchar_t>(L"a b c", L" ", L"-"));
+	CHECK_EQ(wstring(L"xyz"), StrHelper::replace<wchar_t>(L"xyz", L"q", L"-"));
+	CHECK_EQ(wstring(L""), StrHelper::replace<wchar_t>(L"", L"q", L"-"));
+	CHECK_EQ(wstring(L"aaa"), StrHelper::replace<wchar_t>(L"aaa", L"", L"-"));
+	CHECK_EQ(wstring(L"b"), StrHelper::replace<wchar_t>(L"aaaab", L"aa", L""));
+	CHECK_EQ(string("1\\r\\n2"), StrHelper::replace<char>("1\r\n2", { { "\r", "\\r" }, { "\n", "\\n" } }));
+}
+
+// the output is not searched again, so a replacement may contain its target (ex: escaping quotes)
+TEST(replacementMayContainTarget) {
+	CHECK_EQ(wstring(L"say \\\"hi\\\""), StrHelper::replace<wchar_t>(L"say \"hi\"", L"\"", L"\\\""));
+	CHECK_EQ(wstring(L"aaaa"), StrHelper::replace<wchar_t>(L"aa", L"a", L"aa"));
+	CHECK_EQ(wstring(L"\\\\n\\n"), StrHelper::replace<wchar_t>(L"\\n\n", { { L"\\", L"\\\\" }, { L"\n", L"\\n" } }));
+}
+
+TEST(longestTargetWinsAtSamePosition) {
+	StrReplaceSet<wchar_t> replaceSet({ { L"a", L"1" }, { L"ab", L"2" }, { L"abc", L"3" } });
+	CHECK_EQ(wstring(L"3 2 1 1c"), replaceSet.apply(L"abc ab a ac"));
+	CHECK_EQ(wstring(L"31"), replaceSet.apply(L"abca"));
+	CHECK_EQ(wstring(L"xyz"), StrReplaceSet<wchar_t>({ { L"", L"1" }, { L"", L"2" } }).apply(L"xyz"));
+}
+
+// targets whose characters aren't found in any replacement can't interact, so chaining gives the same result
+TEST(singlePassMatchesChainedReplaces) {
+	mt19937 random(7);
+	vector<pair<wstring, wstring>> replacements = {
+		{ L"\r", L"\\r" }, { L"\n", L"\\n" }, { L"\x3000" L"x", L"__" }, { L"yy", L"" } };
+	StrReplaceSet<wchar_t> replaceSet(replacements);
+
+	for (int i = 0; i < 20000; i++) {
+		wstring text = makeRandomText(random, L"\r\nxy\x3000" L"ab", 40);
+		wstring expected = replaceChained(text, replacements);
+		CHECK_EQ(expected, replaceSet.apply(text));
+		CHECK_EQ(expected, StrHelper::replace<wchar_t>(text, replacements));
+		if (expected != replaceSet.apply(text)) break;
+	}
+}
+
+
+TEST(rendersIndexedAndNamedPlaceholders) {
+	StrTemplate<wchar_t> strTemplate(L"[{2}] {name}: {0}{1}{0}", { L"", L"", L"", L"name" });
+	CHECK_EQ(wstring(L"[c] d: aba"), strTemplate.render({ L"a", L"b", L"c", L"d" }));
+	CHECK(strTemplate.hasPlaceholder(3) && strTemplate.hasPlaceholder(0) && !strTemplate.hasPlaceholder(4));
+
+	// placeholders without a value are kept, as are values without a placeholder
+	CHECK_EQ(wstring(L"[{2}] {name}: aba"), strTemplate.render({ L"a", L"b" }));
+	CHECK_EQ(wstring(L"x{0}y"), StrTemplate<wchar_t>(L"x{0}y").render({}));
+	CHECK_EQ(wstring(L"{0}-B-C"), StrTemplate<wchar_t>(L"{0}-{1}-{2}").render({ L"B", L"C" }, 1));
+}
+
+// a value is never searched for placeholders, unlike with chained replaces
+TEST(valuesAreInsertedAsIs) {
+	CHECK_EQ(wstring(L"{1} x"), StrTemplate<wchar_t>(L"{0} {1}").render({ L"{1}", L"x" }));
+	CHECK_EQ(wstring(L"{1}x"), StrHelper::format<wchar_t>(L"{0}{1}", { L"{1}", L"x" }));
+}
+
+TEST(keepsTextWhichIsNotAPlaceholder) {
+	wstring json = L"{\"model\": \"{0}\", \"messages\": [{\"content\": \"{1}\"}]}";
+	CHECK_EQ(wstring(L"{\"model\": \"m\", \"messages\": [{\"content\": \"c\"}]}"),
+		StrTemplate<wchar_t>(json).render({ L"m", L"c" }));
+	CHECK_EQ(wstring(L"{a}{x}{}{"), StrTemplate<wchar_t>(L"{a}{{0}}{}{").render({ L"x" }));
+	CHECK_EQ(wstring(L"{1234567890}"), StrTemplate<wchar_t>(L"{1234567890}").render({ L"x" }));
+	CHECK_EQ(wstring(L"(x) {0}"), StrHelper::format<wchar_t>(L"(<%0%>) {0}", { L"x" }, 0, { L"<%", L"%>" }));
+}
+
+TEST(renderAllocatesOnce) {
+	StrTemplate<wchar_t> strTemplate(L"[{4}] {1} ({2}:{3})\n{0}\n");
+	vector<wstring> values = { wstring(10000, L'\x3042'), L"game.exe", L"0:1:2", L"thread", L"2026-10-17 12:00:00" };
+	wstring output;
+
+	CHECK_EQ(size_t(1), countAllocations([&]() { output = strTemplate.render(values); }));
+	CHECK(output == L"[" + values[4] + L"] " + values[1] + L" (" + values[2] + L":" + values[3] + L")\n" + values[0] + L"\n");
+	CHECK_EQ(size_t(0), countAllocations([&]() { output = StrTemplate<wchar_t>(L"").render(values); }));
+}
+
+
+TEST_MAIN()
@@ -0,0 +1,254 @@
+#include "TestHelper.h"
+#include "_Libraries/strhelper.h"
+#include "TextFormatter.h"
+#include "TextMapper.h"
+#include "Threading/ThreadFilter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <random>
+
+
+// every allocation of the test binary is counted, so that a test can check how many allocations a call makes
+static atomic<size_t> allocationCount{ 0 };
+
+void* operator new(size_t size) {
+	void* memory = malloc(size > 0 ? size : 1);
+	if (memory == nullptr) throw bad_alloc();
+	allocationCount++;
+	return memory;
+}
+
+// not inlined, since a 'free' inlined into a caller looks (to the compiler) like a mismatch with the 'new' it called
+__attribute__((noinline)) void operator delete(void* memory) noexcept {
+	free(memory);
+}
+
+__attribute__((noinline)) void operator delete(void* memory, size_t size) noexcept {
+	free(memory);
+}
+
+
+namespace {
+	template<class Fn>
+	size_t countAllocations(Fn&& action) {
+		size_t countBefore = allocationCount;
+		action();
+		return allocationCount - countBefore;
+	}
+
+	// split and trim as they were before the view-based versions, to compare results and allocations with
+	wstring previousLtrim(wstring s, const wstring& trim) {
+		while (s.length() >= trim.length() && s.find(trim) == 0) s.erase(0, trim.length());
+		return s;
+	}
+
+	wstring previousRtrim(wstring s, const wstring& trim) {
+		while (s.length() >= trim.length() && s.rfind(trim) == s.length() - trim.length()) s.erase(s.length() - trim.length());
+		return s;
+	}
+
+	wstring previousTrim(wstring s, const wstring& trim) {
+		return previousRtrim(previousLtrim(s, trim), trim);
+	}
+
+	vector<wstring> previousSplit(const wstring& str, wchar_t delim, bool trimWs) {
+		vector<wstring> splits{};
+		wstring subStr;
+
+		for (wchar_t ch : str) {
+			if (ch == delim) {
+				if (trimWs) subStr = previousTrim(subStr, L" ");
+				splits.push_back(subStr);
+				subStr.clear();
+			}
+			else {
+				subStr += ch;
+			}
+		}
+
+		if (trimWs) subStr = previousTrim(subStr, L" ");
+		splits.push_back(subStr);
+		return splits;
+	}
+
+	vector<wstring> previousSplit(const wstring& str, const wstring& delim, bool trimWs) {
+		vector<wstring> splits;
+		size_t start = 0, end = str.find(delim);
+		wstring subStr;
+
+		while (end != wstring::npos) {
+			subStr = str.substr(start, end - start);
+			if (trimWs) subStr = previousTrim(subStr, L" ");
+			splits.push_back(subStr);
+
+			start = end + delim.length();
+			end = str.find(delim, start);
+		}
+
+		subStr = str.substr(start);
+		if (trimWs) subStr = previousTrim(subStr, L" ");
+		splits.push_back(subStr);
+		return splits;
+	}
+
+	wstring previousFormat(wstring text) {
+		for (const wchar_t* ws : { L" ", L"\x3000", L"\r", L"\n", L"\t" }) text = previousTrim(text, ws);
+		return text;
+	}
+
+	pair<wstring, wstring> previousMapperSplit(wstring text) {
+		vector<wstring> splitStrs = previousSplit(text, L'\x200b', false);
+		if (splitStrs.size() < 2) return pair<wstring, wstring>(text, L"");
+
+		wstring str1 = previousFormat(splitStrs[0]);
+		wstring str2 = previousFormat(splitStrs.back());
+		return pair<wstring, wstring>(str1, str2);
+	}
+
+	bool previousIsInList(const wstring& list, const wstring& subStr, const wstring& delim) {
+		if (subStr.length() > list.length()) return false;
+		if (list.find(subStr + delim) != wstring::npos) return true;
+		return list.rfind(subStr) == list.length() - subStr.length();
+	}
+
+	vector<wstring> toStrings(const StrSplitView<wchar_t>& splitView) {
+		vector<wstring> parts{};
+		for (StrView<wchar_t> part : splitView) parts.push_back(part.str());
+		return parts;
+	}
+
+	wstring makeRandomText(mt19937& random, const wstring& alphabet, size_t maxLength) {
+		wstring text(random() % (maxLength + 1), L' ');
+		for (wchar_t& ch : text) ch = alphabet[random() % alphabet.length()];
+		return text;
+	}
+
+	// a sentence as Textractor sends it, with the thread name the filter looks up
+	class TestSentence {
+	public:
+		TestSentence(const wstring& threadName) : _threadName(threadName), _infos{
+			{ "current select", 1 }, { "process id", 1234 }, { "text number", 3 },
+			{ "text name", reinterpret_cast<int64_t>(_threadName.c_str()) }, { nullptr, 0 } } { }
+
+		SentenceInfo getInfo() const {
+			return SentenceInfo{ _infos };
+		}
+	private:
+		const wstring _threadName;
+		const InfoForExtension _infos[5];
+	};
+
+	ExtensionConfig makeFilterConfig(ExtensionConfig::FilterMode filterMode, const wstring& filterList) {
+		ExtensionConfig config = DefaultConfig;
+		config.threadKeyFilterMode = filterMode;
+		config.threadKeyFilterList = filterList;
+		return config;
+	}
+}
+
+
+TEST(splitMatchesPreviousImplementation) {
+	mt19937 random(24);
+
+	for (int i = 0; i < 100000; i++) {
+		wstring text = makeRandomText(random, L"ab ,|\x3000", 30);
+		bool trimWs = random() % 2 == 0;
+		wstring delim = random() % 2 == 0 ? L"|" : L", ";
+
+		vector<wstring> expected = previousSplit(text, L',', trimWs);
+		CHECK(expected == StrHelper::split<wchar_t>(text, L',', trimWs));
+		CHECK(expected == toStrings(StrHelper::splitView<wchar_t>(text, L',', trimWs)));
+
+		expected = previousSplit(text, delim, trimWs);
+		bool matches = expected == StrHelper::split<wchar_t>(text, delim, trimWs)
+			&& expected == toStrings(StrHelper::splitView<wchar_t>(text, delim, trimWs));
+		CHECK(matches);
+		if (!matches) break;
+	}
+}
+
+TEST(trimMatchesPreviousImplementation) {
+	mt19937 random(25);
+
+	for (int i = 0; i < 100000; i++) {
+		wstring text = makeRandomText(random, L"ab \x3000", 20);
+		wstring trim = makeRandomText(random, L"ab \x3000", 2);
+		if (trim.empty()) continue;
+
+		bool matches = previousTrim(text, trim) == StrHelper::trim<wchar_t>(text, trim)
+			&& previousTrim(text, trim) == StrHelper::trimView<wchar_t>(text, trim).str()
+			&& previousLtrim(text, trim) == StrHelper::ltrimView<wchar_t>(text, trim).str()
+			&& previousRtrim(text, trim) == StrHelper::rtrimView<wchar_t>(text, trim).str();
+		CHECK(matches);
+		if (!matches) break;
+	}
+}
+
+// the previous versions never returned for these
+TEST(emptyDelimOrTrimKeepsString) {
+	CHECK(StrHelper::split<wchar_t>(L"a,b", L"") == vector<wstring>{ L"a,b" });
+	CHECK_EQ(wstring(L"  a  "), StrHelper::trim<wchar_t>(L"  a  ", L""));
+	CHECK(StrHelper::split<wchar_t>(L"", L',') == vector<wstring>{ L"" });
+}
+
+TEST(viewsDoNotAllocate) {
+	wstring text = L"  " + wstring(1000, L'\x3042') + L" , " + wstring(1000, L'x') + L" ,, end  ";
+	size_t partCount = 0, length = 0;
+	size_t expectedPartCount = StrHelper::split<wchar_t>(text, L',').size() + StrHelper::split<wchar_t>(text, L" ,").size();
+
+	CHECK_EQ(size_t(0), countAllocations([&]() {
+		for ([[maybe_unused]] StrView<wchar_t> part : StrHelper::splitView<wchar_t>(text, L',', true)) partCount++;
+		for ([[maybe_unused]] StrView<wchar_t> part : StrHelper::splitView<wchar_t>(text, L" ,")) partCount++;
+		length = StrHelper::trimView<wchar_t>(text, L" ").length();
+	}));
+	CHECK_EQ(expectedPartCount, partCount);
+	CHECK_EQ(text.length() - 4, length);
+}
+
+// what a sentence goes through in the formatter, the mapper and the thread filter, before and after
+TEST(perSentenceAllocations) {
+	DefaultTextFormatter formatter;
+	TextractorTextMapper mapper(formatter);
+	wstring original = L"\x3000" + wstring(200, L'\x3042') + L"\n", translation = wstring(300, L'x') + L" ";
+	wstring merged = original + L"\x200b\n" + translation;
+	wstring trimmed = wstring(200, L'\x3042');
+
+	size_t previousCount = countAllocations([&]() {
+		CHECK(previousFormat(original) == trimmed);
+		CHECK(previousFormat(trimmed) == trimmed);
+		CHECK(previousMapperSplit(merged).first == trimmed);
+	});
+	size_t count = countAllocations([&]() {
+		CHECK(formatter.format(original) == trimmed);
+		CHECK(formatter.format(trimmed) == trimmed);
+		CHECK(mapper.split(merged).first == trimmed);
+	});
+	printBenchResult("formatter and mapper, previous", previousCount, "allocations");
+	printBenchResult("formatter and mapper", count, "allocations");
+	CHECK(count < previousCount);
+
+	// the copy of the argument only, when there is nothing to trim
+	CHECK_EQ(size_t(1), countAllocations([&]() { formatter.format(trimmed); }));
+
+	// looking the thread up in the list no longer allocates (the rest is the key generator and the tracker)
+	wstring threadName = L"TextHook" + wstring(20, L'x'), threadKey = threadName + L"-1";
+	wstring list = L"Other-1|" + threadName + L"|Another-2";
+	TestSentence sentence(threadName);
+	SentenceInfo sentenceInfo = sentence.getInfo();
+	SentenceInfoWrapper sentenceWrapper(sentenceInfo);
+	DefaultThreadKeyGenerator keyGenerator;
+	MapThreadTracker threadTracker;
+	DefaultThreadFilter threadFilter(keyGenerator, threadTracker);
+	ExtensionConfig disabled = makeFilterConfig(ExtensionConfig::FilterMode::Disabled, list);
+	ExtensionConfig whitelist = makeFilterConfig(ExtensionConfig::FilterMode::Whitelist, list);
+
+	threadFilter.isThreadAllowed(sentenceWrapper, disabled);
+	size_t unfilteredCount = countAllocations([&]() { threadFilter.isThreadAllowed(sentenceWrapper, disabled); });
+	CHECK_EQ(unfilteredCount, countAllocations([&]() { CHECK(threadFilter.isThreadAllowed(sentenceWrapper, whitelist)); }));
+	CHECK(countAllocations([&]() { previousIsInList(list, threadKey, L"|"); previousIsInList(list, threadName, L"|"); }) > 0);
+	CHECK(!threadFilter.isThreadAllowed(sentenceWrapper, makeFilterConfig(ExtensionConfig::FilterMode::Whitelist, L"Hook" + threadName)));
+}
+
+
+TEST_MAIN()
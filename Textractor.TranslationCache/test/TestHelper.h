@@ -0,0 +1,146 @@
+
+#pragma once
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+using namespace std;
+
+
+// Minimal test runner (no external dependencies):
+// TEST(name) { ... } registers a test case; CHECK/CHECK_EQ record a failure and let the case go on,
+// and an exception escaping a case fails it. Each test file ends with TEST_MAIN().
+struct TestCase {
+	const char* name;
+	void(*run)();
+};
+
+inline vector<TestCase>& getTestCases() {
+	static vector<TestCase> testCases{};
+	return testCases;
+}
+
+inline int& getTestFailureCount() {
+	static int failureCount = 0;
+	return failureCount;
+}
+
+struct TestRegistrar {
+	TestRegistrar(const char* name, void(*run)()) {
+		getTestCases().push_back(TestCase{ name, run });
+	}
+};
+
+inline void reportTestFailure(const char* file, int line, const string& message) {
+	fprintf(stderr, "  %s:%d: %s\n", file, line, message.c_str());
+	getTestFailureCount()++;
+}
+
+template<class T>
+string toTestString(const T& value) {
+	ostringstream stream;
+	stream << value;
+	return stream.str();
+}
+
+inline string toTestString(const wstring& value) {
+	return string(value.begin(), value.end());
+}
+
+inline int runTests() {
+	int failedCases = 0;
+
+	for (const TestCase& testCase : getTestCases()) {
+		int failuresBefore = getTestFailureCount();
+
+		try {
+			testCase.run();
+		}
+		catch (const exception& ex) {
+			reportTestFailure(testCase.name, 0, string("exception: ") + ex.what());
+		}
+
+		bool failed = getTestFailureCount() != failuresBefore;
+		if (failed) failedCases++;
+		printf("[%s] %s\n", failed ? "FAIL" : " OK ", testCase.name);
+	}
+
+	printf("%d of %d test(s) failed\n", failedCases, static_cast<int>(getTestCases().size()));
+	return failedCases == 0 ? 0 : 1;
+}
+
+#define TEST(name) \
+	static void name(); \
+	static TestRegistrar name##_registrar(#name, name); \
+	static void name()
+
+#define CHECK(condition) \
+	do { if (!(condition)) reportTestFailure(__FILE__, __LINE__, "CHECK(" #condition ")"); } while (0)
+
+#define CHECK_EQ(expected, actual) \
+	do { \
+		auto _expected = (expected); \
+		auto _actual = (actual); \
+		if (!(_expected == _actual)) reportTestFailure(__FILE__, __LINE__, "CHECK_EQ(" #expected ", " #actual "): '" \
+			+ toTestString(_expected) + "' != '" + toTestString(_actual) + "'"); \
+	} while (0)
+
+#define CHECK_THROWS(statement) \
+	do { \
+		bool _thrown = false; \
+		try { statement; } catch (...) { _thrown = true; } \
+		if (!_thrown) reportTestFailure(__FILE__, __LINE__, "CHECK_THROWS(" #statement ")"); \
+	} while (0)
+
+#define TEST_MAIN() int main() { return runTests(); }
+
+
+// A scratch directory under /tmp, removed with its content once the test is done.
+class TempDir {
+public:
+	TempDir() {
+		char pathTemplate[] = "/tmp/tc_test_XXXXXX";
+		_path = mkdtemp(pathTemplate);
+	}
+
+	~TempDir() {
+		string command = "rm -rf '" + _path + "'";
+		if (system(command.c_str()) != 0) fprintf(stderr, "failed to remove %s\n", _path.c_str());
+	}
+
+	string file(const string& name) const {
+		return _path + "/" + name;
+	}
+private:
+	string _path;
+};
+
+
+inline string readTestFile(const string& filePath) {
+	ifstream f(filePath, ios_base::in | ios_base::binary);
+	return string(istreambuf_iterator<char>(f), istreambuf_iterator<char>());
+}
+
+inline void writeTestFile(const string& filePath, const string& content) {
+	ofstream f(filePath, ios_base::out | ios_base::binary | ios_base::trunc);
+	f << content;
+}
+
+
+// Benchmark helpers: times 'iterations' runs of 'action', and reports the mean per run.
+template<class Fn>
+double measureNs(size_t iterations, Fn&& action) {
+	auto start = chrono::steady_clock::now();
+	for (size_t i = 0; i < iterations; i++) action();
+	return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / iterations;
+}
+
+inline void printBenchResult(const string& name, double value, const string& unit) {
+	printf("  %-52s %12.1f %s\n", name.c_str(), value, unit.c_str());
+}
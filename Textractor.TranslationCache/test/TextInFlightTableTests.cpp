@@ -0,0 +1,344 @@
+#include "TestHelper.h"
+#include "CacheManager.h"
+#include "TextInFlightTable.h"
+#include "Cache/MemoryTextMapCache.h"
+#include "Cache/SharedHashTableTextMapCache.h"
+#include <atomic>
+#include <sys/wait.h>
+
+
+namespace {
+	const wstring REGION_IDENTIFIER = L"inflight";
+
+	// regions are named per test process, so that runs don't share (or leave behind) tables
+	string getRegionPrefix() {
+		return "/tc_inflight_" + to_string(getpid()) + "_";
+	}
+
+	// counts full reads of the table, which hold up the claims of every module
+	class CountingSharedHashTableTextMapCache : public SharedHashTableTextMapCache {
+	public:
+		using SharedHashTableTextMapCache::SharedHashTableTextMapCache;
+		mutable atomic<size_t> readAllCount{ 0 };
+
+		unordered_map<wstring, wstring> readAllFromCache() const override {
+			readAllCount++;
+			return SharedHashTableTextMapCache::readAllFromCache();
+		}
+	};
+
+	// each process (and each module within one) opens the shared table on its own
+	struct Module {
+		PosixSharedMemoryRegionManager regionManager;
+		DefaultTextFormatter formatter;
+		CountingSharedHashTableTextMapCache cache{ formatter, regionManager, REGION_IDENTIFIER };
+		MapCacheTextInFlightTable table;
+
+		Module(const string& regionPrefix, uint32_t maxWaitMs = 500, uint32_t completedTtlMs = 5000,
+			uint32_t maintenanceIntervalMs = 1000, uint32_t claimTimeoutMs = 10000) : regionManager(regionPrefix),
+				table(cache, cache, claimTimeoutMs, completedTtlMs, 5, maintenanceIntervalMs, maxWaitMs) { }
+	};
+
+	// records what the cache manager completes, instead of handing it over
+	class RecordingTextInFlightTable : public NoTextInFlightTable {
+	public:
+		vector<pair<wstring, wstring>> completions{};
+
+		void complete(const wstring& key, const wstring& value) override {
+			completions.push_back(pair<wstring, wstring>(key, value));
+		}
+	};
+
+	class FailingMemoryTextMapCache : public MemoryTextMapCache {
+	public:
+		using MemoryTextMapCache::MemoryTextMapCache;
+		bool failing = false;
+
+		void writeToCache(const wstring& key, const wstring& value) override {
+			if (failing) throw runtime_error("write failed");
+			MemoryTextMapCache::writeToCache(key, value);
+		}
+	};
+
+	class SwitchableExtExecRequirements : public ExtExecRequirements {
+	public:
+		bool met = true;
+
+		bool meetsRequirements(SentenceInfoWrapper& sentInfoWrapper, const ExtensionConfig& config, bool readMode) const override {
+			return met;
+		}
+	};
+
+	struct Fixture {
+		string regionPrefix = getRegionPrefix();
+
+		~Fixture() {
+			PosixSharedMemoryRegionManager(regionPrefix).removeRegion(REGION_IDENTIFIER);
+		}
+	};
+
+	wstring getSentence(uint32_t i) {
+		return L"sentence" + to_wstring(i);
+	}
+
+	wstring translate(const wstring& sentence) {
+		return L"T(" + sentence + L")";
+	}
+
+	// runs 'action' in a child process, which exits with whether it succeeded
+	pid_t runChild(const function<bool()>& action) {
+		pid_t pid = fork();
+		if (pid != 0) return pid;
+
+		bool succeeded = false;
+		try {
+			succeeded = action();
+		}
+		catch (const exception& ex) {
+			fprintf(stderr, "  child %d: %s\n", getpid(), ex.what());
+		}
+
+		_exit(succeeded ? 0 : 1);
+	}
+
+	bool waitChild(pid_t pid) {
+		int status = 0;
+		return waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+	}
+}
+
+
+// Reader processes see each sentence several times (like hooks firing more than once), and send the ones they
+// claim to a stub translator in the writer process, which completes them after a delay.
+// Each sentence must be translated once, and every repeat must get its translation.
+TEST(repeatsAcrossProcessesAreTranslatedOnce) {
+	Fixture fixture;
+	const uint32_t sentenceCount = 40, readerCount = 3, repeatCount = 2;
+	int sentenceFds[2], readyFds[2];
+	CHECK(pipe(sentenceFds) == 0 && pipe(readyFds) == 0);
+
+	pid_t writerPid = runChild([&]() {
+		close(sentenceFds[1]);
+		close(readyFds[0]);
+		Module writer(fixture.regionPrefix);
+		writer.table.startMaintenance();
+		if (write(readyFds[1], "r", 1) != 1) return false;
+
+		vector<int> translationCounts(sentenceCount, 0);
+		uint32_t i = 0;
+
+		while (read(sentenceFds[0], &i, sizeof(i)) == sizeof(i)) {
+			translationCounts[i]++;
+			this_thread::sleep_for(chrono::milliseconds(10));
+			writer.table.complete(getSentence(i), translate(getSentence(i)));
+		}
+
+		writer.table.stopMaintenance();
+		bool succeeded = true;
+
+		for (i = 0; i < sentenceCount; i++) {
+			if (translationCounts[i] == 1) continue;
+			fprintf(stderr, "  sentence %u translated %d times\n", i, translationCounts[i]);
+			succeeded = false;
+		}
+
+		return succeeded;
+	});
+
+	close(readyFds[1]);
+	char ready = 0;
+	CHECK(read(readyFds[0], &ready, 1) == 1);
+	close(readyFds[0]);
+	close(sentenceFds[0]);
+
+	vector<pid_t> readerPids{};
+	for (uint32_t reader = 0; reader < readerCount; reader++) {
+		readerPids.push_back(runChild([&, reader]() {
+			Module module(fixture.regionPrefix);
+			bool succeeded = true;
+
+			for (uint32_t i = 0; i < sentenceCount * repeatCount; i++) {
+				uint32_t sentenceIndex = i / repeatCount;
+				wstring sentence = getSentence(sentenceIndex);
+				wstring transText = module.table.claimOrWait(sentence);
+
+				if (transText.empty()) {
+					if (write(sentenceFds[1], &sentenceIndex, sizeof(sentenceIndex)) != sizeof(sentenceIndex)) return false;
+				}
+				else if (transText != translate(sentence)) {
+					succeeded = false;
+				}
+
+				if ((i + reader) % 3 == 0) this_thread::sleep_for(chrono::milliseconds(1));
+			}
+
+			return succeeded;
+		}));
+	}
+
+	close(sentenceFds[1]);
+	for (pid_t pid : readerPids) CHECK(waitChild(pid));
+	CHECK(waitChild(writerPid));
+}
+
+// without a writer, a sentence is neither claimed nor waited for, and a claim left behind by the writer is released
+TEST(skipsWaitingWhenWriterIsAbsent) {
+	Fixture fixture;
+	Module reader(fixture.regionPrefix);
+
+	auto start = chrono::steady_clock::now();
+	CHECK_EQ(wstring(L""), reader.table.claimOrWait(L"a"));
+	CHECK_EQ(wstring(L""), reader.table.claimOrWait(L"a"));
+	CHECK(chrono::steady_clock::now() - start < chrono::milliseconds(500));
+	CHECK_EQ(wstring(L""), reader.cache.readFromCache(L"a"));
+
+	{
+		Module writer(fixture.regionPrefix);
+		writer.table.startMaintenance();
+		CHECK_EQ(wstring(L""), reader.table.claimOrWait(L"b"));
+		CHECK(!reader.cache.readFromCache(L"b").empty());
+	}
+
+	start = chrono::steady_clock::now();
+	CHECK_EQ(wstring(L""), reader.table.claimOrWait(L"b"));
+	CHECK(chrono::steady_clock::now() - start < chrono::milliseconds(500));
+	CHECK_EQ(wstring(L""), reader.cache.readFromCache(L"b"));
+}
+
+// a repeat waits for the claim's translation for at most 'maxWaitMs', or about one round trip once one is known
+TEST(capsWaitForLateTranslation) {
+	Fixture fixture;
+	Module writer(fixture.regionPrefix, 300, 5000, 20);
+	Module reader(fixture.regionPrefix, 300);
+	writer.table.startMaintenance();
+
+	CHECK_EQ(wstring(L""), reader.table.claimOrWait(L"a"));
+	auto start = chrono::steady_clock::now();
+	CHECK_EQ(wstring(L""), reader.table.claimOrWait(L"a"));
+	auto waited = chrono::steady_clock::now() - start;
+	CHECK(waited >= chrono::milliseconds(250) && waited < chrono::milliseconds(1500));
+
+	// the late translation still completes the claim, for the repeats after it
+	writer.table.complete(L"a", L"A");
+	CHECK_EQ(wstring(L"A"), reader.table.claimOrWait(L"a"));
+
+	// quick translations bring the wait down with them
+	for (int i = 0; i < 8; i++) {
+		wstring key = L"quick" + to_wstring(i);
+		CHECK_EQ(wstring(L""), reader.table.claimOrWait(key));
+		writer.table.complete(key, L"Q");
+	}
+
+	this_thread::sleep_for(chrono::milliseconds(100));
+	CHECK_EQ(wstring(L""), reader.table.claimOrWait(L"b"));
+	start = chrono::steady_clock::now();
+	CHECK_EQ(wstring(L""), reader.table.claimOrWait(L"b"));
+	CHECK(chrono::steady_clock::now() - start < chrono::milliseconds(200));
+}
+
+TEST(writerPrunesExpiredEntries) {
+	Fixture fixture;
+	Module writer(fixture.regionPrefix, 2000, 50, 20);
+	Module reader(fixture.regionPrefix, 2000, 50, 20);
+	writer.table.startMaintenance();
+
+	CHECK_EQ(wstring(L""), reader.table.claimOrWait(L"a"));
+	writer.table.complete(L"a", L"A");
+	CHECK_EQ(wstring(L"A"), reader.table.claimOrWait(L"a"));
+
+	this_thread::sleep_for(chrono::milliseconds(200));
+	CHECK_EQ(wstring(L""), reader.cache.readFromCache(L"a"));
+	CHECK_EQ(size_t(1), reader.cache.readAllFromCache().size());
+
+	writer.table.stopMaintenance();
+	CHECK(reader.cache.readAllFromCache().empty());
+}
+
+
+// entries the writer completed are pruned on their own; the whole table is only read every FULL_SWEEP_INTERVALS runs,
+// to release the claims which were never completed
+TEST(writerSweepsWholeTableRarely) {
+	Fixture fixture;
+	Module writer(fixture.regionPrefix, 500, 20, 5, 50);
+	Module reader(fixture.regionPrefix, 500, 20, 5, 50);
+	writer.table.startMaintenance();
+
+	CHECK_EQ(wstring(L""), reader.table.claimOrWait(L"abandoned"));
+	CHECK_EQ(wstring(L""), reader.table.claimOrWait(L"a"));
+	writer.table.complete(L"a", L"A");
+
+	this_thread::sleep_for(chrono::milliseconds(100));
+	CHECK_EQ(size_t(0), writer.cache.readAllCount.load());
+	CHECK_EQ(wstring(L""), reader.cache.readFromCache(L"a"));
+	CHECK(!reader.cache.readFromCache(L"abandoned").empty());
+
+	for (int i = 0; i < 2000 && !reader.cache.readFromCache(L"abandoned").empty(); i++) {
+		this_thread::sleep_for(chrono::milliseconds(1));
+	}
+
+	CHECK_EQ(wstring(L""), reader.cache.readFromCache(L"abandoned"));
+	CHECK(writer.cache.readAllCount > 0);
+}
+
+// a repeat holds up its text thread while it waits, so it only waits for a short while by default
+TEST(defaultWaitIsShort) {
+	Fixture fixture;
+	Module writer(fixture.regionPrefix);
+	PosixSharedMemoryRegionManager regionManager(fixture.regionPrefix);
+	DefaultTextFormatter formatter;
+	SharedHashTableTextMapCache cache(formatter, regionManager, REGION_IDENTIFIER);
+	MapCacheTextInFlightTable table(cache, cache);
+	writer.table.startMaintenance();
+
+	CHECK_EQ(wstring(L""), table.claimOrWait(L"a"));
+	auto start = chrono::steady_clock::now();
+	CHECK_EQ(wstring(L""), table.claimOrWait(L"a"));
+	auto waited = chrono::steady_clock::now() - start;
+	CHECK(waited >= chrono::milliseconds(400) && waited < chrono::milliseconds(1000));
+}
+
+// a claim is completed (or released, if the translation isn't taken in) on every way out of the writer
+TEST(cacheManagerCompletesClaims) {
+	DefaultTextFormatter formatter;
+	FailingMemoryTextMapCache cache(formatter);
+	NoTextTempStore tempStore;
+	RecordingTextInFlightTable inFlightTable;
+	NoTextPrefetcher prefetcher;
+	TextractorTextMapper textMapper(formatter);
+	NoKeyCanonicalizer keyCanonicalizer;
+	SwitchableExtExecRequirements execRequirements;
+	DefaultCacheManager cacheManager(cache, tempStore, inFlightTable, prefetcher, textMapper, keyCanonicalizer,
+		execRequirements, false);
+
+	const InfoForExtension infos[] = { { nullptr, 0 } };
+	SentenceInfo sentenceInfo{ infos };
+	SentenceInfoWrapper sentInfoWrapper(sentenceInfo);
+	ExtensionConfig config = DefaultConfig;
+	auto writeSentence = [&](const wstring& text) {
+		wstring sentence = text;
+		cacheManager.writeCacheOrLoadTemp(sentence, sentInfoWrapper, config);
+	};
+
+	writeSentence(L"a\x200B\nA");
+	CHECK_EQ(wstring(L"A"), cache.readFromCache(L"a"));
+
+	config.disabledMode = ExtensionConfig::DisableWrite;
+	writeSentence(L"b\x200B\nB");
+	CHECK_EQ(wstring(L""), cache.readFromCache(L"b"));
+	config.disabledMode = DefaultConfig.disabledMode;
+
+	execRequirements.met = false;
+	writeSentence(L"c\x200B\nC");
+	writeSentence(L"untranslated");
+	execRequirements.met = true;
+
+	cache.failing = true;
+	CHECK_THROWS(writeSentence(L"d\x200B\nD"));
+
+	vector<pair<wstring, wstring>> expectedCompletions = { { L"a", L"A" }, { L"b", L"B" }, { L"c", L"" },
+		{ L"untranslated", L"" }, { L"d", L"D" } };
+	CHECK((inFlightTable.completions == expectedCompletions));
+}
+
+
+TEST_MAIN()
@@ -0,0 +1,171 @@
+#include "TestHelper.h"
+#include "TextPrefetcher.h"
+#include "Cache/MemoryTextMapCache.h"
+#include <algorithm>
+#include <mutex>
+#include <thread>
+
+
+namespace {
+	const wstring SENTINEL_KEY = L"~sentinel", SENTINEL_NEXT_KEY = L"~next";
+	const int64_t SENTINEL_THREAD = 99;
+
+	// records what the prefetcher warms, without keeping it (so the sentinel can be warmed again)
+	class RecordingWarmTarget : public CacheWarmTarget {
+	public:
+		unordered_set<wstring> warmKeys{};
+
+		bool isWarm(const wstring& key) const override {
+			return warmKeys.find(key) != warmKeys.end();
+		}
+
+		void warmEntry(const wstring& key, const wstring& value) override {
+			lock_guard<mutex> lock(_mtx);
+			_warmed.push_back(key + L"=" + value);
+		}
+
+		vector<wstring> getWarmed() {
+			lock_guard<mutex> lock(_mtx);
+			return _warmed;
+		}
+	private:
+		mutex _mtx;
+		vector<wstring> _warmed{};
+	};
+
+	// the infos Textractor sends with a sentence, for a given text thread
+	class ThreadSentence {
+	public:
+		ThreadSentence(int64_t threadNumber) : _infos{ { "current select", 1 }, { "process id", 1234 },
+			{ "text number", threadNumber }, { nullptr, 0 } }, _sentenceInfo{ _infos }, wrapper(_sentenceInfo) { }
+	private:
+		const InfoForExtension _infos[4];
+		SentenceInfo _sentenceInfo;
+	public:
+		SentenceInfoWrapper wrapper;
+	};
+
+	struct Fixture {
+		DefaultTextFormatter formatter;
+		RecordingWarmTarget warmTarget;
+		MemoryTextMapCache sourceCache{ formatter };
+		SuccessorTextPrefetcher prefetcher;
+
+		Fixture(size_t prefetchDepth = 3, size_t maxTrackedKeys = 65536)
+			: prefetcher(warmTarget, sourceCache, formatter, prefetchDepth, maxTrackedKeys)
+		{
+			for (const wchar_t* key : { L"a", L"b", L"c", L"d", L"e", L"x", L"y" }) sourceCache.writeToCache(key, wstring(L"V") + key);
+			sourceCache.writeToCache(SENTINEL_NEXT_KEY, L"S");
+		}
+
+		void lookUp(int64_t threadNumber, const vector<wstring>& keys, bool hit = false) {
+			ThreadSentence sentence(threadNumber);
+			for (const wstring& key : keys) prefetcher.onLookup(sentence.wrapper, key, hit);
+		}
+
+		// prefetches are made in order on one thread, so once a sentinel prediction made last is warmed,
+		// every earlier one has been handled; returns what was warmed, without the sentinel
+		vector<wstring> waitForPrefetches() {
+			size_t sentinelsBefore = countSentinels();
+			lookUp(SENTINEL_THREAD, { SENTINEL_KEY, SENTINEL_NEXT_KEY });
+			lookUp(SENTINEL_THREAD + 1, { SENTINEL_KEY }, true);
+
+			for (int i = 0; i < 2000 && countSentinels() == sentinelsBefore; i++) this_thread::sleep_for(chrono::milliseconds(1));
+			CHECK(countSentinels() > sentinelsBefore);
+
+			vector<wstring> warmed = warmTarget.getWarmed();
+			warmed.erase(remove(warmed.begin(), warmed.end(), SENTINEL_NEXT_KEY + L"=S"), warmed.end());
+			return warmed;
+		}
+	private:
+		size_t countSentinels() {
+			vector<wstring> warmed = warmTarget.getWarmed();
+			return count(warmed.begin(), warmed.end(), SENTINEL_NEXT_KEY + L"=S");
+		}
+	};
+}
+
+
+TEST(prefetchesSuccessorsAfterHit) {
+	Fixture fixture;
+	fixture.lookUp(1, { L"a", L"b", L"c", L"d", L"e" });
+	CHECK(fixture.waitForPrefetches().empty());
+
+	// only 'prefetchDepth' keys ahead
+	fixture.lookUp(2, { L"a" }, true);
+	CHECK((fixture.waitForPrefetches() == vector<wstring>{ L"b=Vb", L"c=Vc", L"d=Vd" }));
+}
+
+TEST(missesDoNotPrefetch) {
+	Fixture fixture;
+	fixture.lookUp(1, { L"a", L"b", L"c" });
+	fixture.lookUp(2, { L"a" }, false);
+
+	CHECK(fixture.waitForPrefetches().empty());
+}
+
+// keys are formatted, and a key repeated (ex: the same line sent twice) doesn't become its own successor
+TEST(formatsAndSkipsRepeatedKeys) {
+	Fixture fixture;
+	fixture.lookUp(1, { L" a", L"a\n", L"b", L"\tb", L"  ", L"c" });
+	fixture.lookUp(2, { L"a", L"a " });
+	fixture.lookUp(3, { L"a " }, true);
+
+	CHECK((fixture.waitForPrefetches() == vector<wstring>{ L"b=Vb", L"c=Vc" }));
+}
+
+TEST(successorsAreLearnedPerThread) {
+	Fixture fixture;
+	fixture.lookUp(1, { L"a" });
+	fixture.lookUp(2, { L"x" });
+	fixture.lookUp(1, { L"b" });
+	fixture.lookUp(2, { L"y" });
+	fixture.lookUp(3, { L"a" }, true);
+
+	CHECK((fixture.waitForPrefetches() == vector<wstring>{ L"b=Vb" }));
+}
+
+// a different successor has to outnumber the current one to replace it
+TEST(majorityVoteKeepsSuccessor) {
+	Fixture fixture(1);
+	for (int i = 0; i < 3; i++) fixture.lookUp(1, { L"a", L"b" });
+	fixture.lookUp(1, { L"a", L"x" });
+
+	fixture.lookUp(2, { L"a" }, true);
+	CHECK((fixture.waitForPrefetches() == vector<wstring>{ L"b=Vb" }));
+
+	for (int i = 0; i < 2; i++) fixture.lookUp(1, { L"a", L"x" });
+	fixture.lookUp(3, { L"a" }, true);
+	CHECK((fixture.waitForPrefetches() == vector<wstring>{ L"b=Vb", L"x=Vx" }));
+}
+
+TEST(stopsAtCycles) {
+	Fixture fixture;
+	fixture.lookUp(1, { L"a", L"b", L"c", L"b" });
+	fixture.lookUp(2, { L"a" }, true);
+
+	CHECK((fixture.waitForPrefetches() == vector<wstring>{ L"b=Vb", L"c=Vc" }));
+}
+
+// keys already warm, or without a value in the source cache, are skipped but still followed
+TEST(skipsWarmAndMissingKeys) {
+	Fixture fixture;
+	fixture.warmTarget.warmKeys.insert(L"b");
+	fixture.lookUp(1, { L"a", L"b", L"missing", L"d" });
+	fixture.lookUp(2, { L"a" }, true);
+
+	CHECK((fixture.waitForPrefetches() == vector<wstring>{ L"d=Vd" }));
+}
+
+// past 'maxTrackedKeys', what was learned is dropped and learning starts over
+TEST(forgetsPastMaxTrackedKeys) {
+	Fixture fixture(3, 3);
+	fixture.lookUp(1, { L"a", L"b", L"c", L"d", L"e" });
+	fixture.lookUp(2, { L"a" }, true);
+	fixture.lookUp(3, { L"d" }, true);
+
+	CHECK((fixture.waitForPrefetches() == vector<wstring>{ L"e=Ve" }));
+}
+
+
+TEST_MAIN()
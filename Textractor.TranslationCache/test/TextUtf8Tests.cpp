@@ -0,0 +1,131 @@
+#include "TestHelper.h"
+#include "TextFormatter.h"
+#include "TextMapper.h"
+#include "Cache/CacheLineFormatter.h"
+#include <random>
+
+
+namespace {
+	// only implements the UTF-16 operations, so the UTF-8 ones go through the base classes' conversions
+	class ConvertingTextFormatter : public TextFormatter {
+	public:
+		wstring format(wstring text) const override {
+			return _formatter.format(move(text));
+		}
+	private:
+		DefaultTextFormatter _formatter;
+	};
+
+	// pieces which the UTF-8 operations must not cut through: whitespace (ASCII and full-width),
+	// the delimiter, and multi-byte characters (ex: 3 bytes for kana, 4 bytes for an emoji)
+	const vector<string> validPieces = { "a", " ", "\t", "\r\n", "\xE3\x80\x80", "|~|", "\xE3\x81\x82", "\xC3\xA9",
+		"\xF0\x9F\x98\x80", "\xE2\x80\x8B", "\\n" };
+	// lone/stray bytes and truncated sequences, some of them the start of a full-width space
+	const vector<string> invalidPieces = { "\x80", "\xFF", "\xE3", "\xE3\x80", "\xC3", "\xF0\x9F\x98", "\xED\xA0\x80" };
+
+	string makeRandomText(mt19937& random, bool withInvalidBytes) {
+		string text;
+
+		for (size_t i = random() % 12; i > 0; i--) {
+			bool invalid = withInvalidBytes && random() % 4 == 0;
+			const vector<string>& pieces = invalid ? invalidPieces : validPieces;
+			text += pieces[random() % pieces.size()];
+		}
+
+		return text;
+	}
+}
+
+
+// trimming the UTF-8 bytes gives what trimming the converted text gives, even around bytes which aren't valid UTF-8
+// (which the conversion turns into U+FFFD), since no whitespace sequence can start in the middle of a character
+TEST(formatUtf8MatchesFormat) {
+	DefaultTextFormatter formatter;
+	ConvertingTextFormatter convertingFormatter;
+	mt19937 random(14);
+
+	for (int i = 0; i < 100000; i++) {
+		string text = makeRandomText(random, i % 2 == 1);
+		wstring expected = formatter.format(StrHelper::convertToW(text));
+
+		bool matches = StrHelper::convertToW(formatter.formatUtf8(text)) == expected
+			&& StrHelper::convertToW(convertingFormatter.formatUtf8(text)) == expected;
+		CHECK(matches);
+		if (!matches) break;
+	}
+}
+
+TEST(formatUtf8KeepsPartialSequences) {
+	DefaultTextFormatter formatter;
+
+	CHECK_EQ(string("\xE3\x81\x82"), formatter.formatUtf8("\xE3\x80\x80\xE3\x81\x82\xE3\x80\x80"));
+	CHECK_EQ(string("a\xE3\x80"), formatter.formatUtf8(" a\xE3\x80"));
+	CHECK_EQ(string("\x80\x80 a"), formatter.formatUtf8("\x80\x80 a\xE3\x80\x80"));
+	CHECK_EQ(string("\xE3"), formatter.formatUtf8("\xE3\xE3\x80\x80"));
+	CHECK_EQ(string("\xF0\x9F\x98\x80"), formatter.formatUtf8(" \xF0\x9F\x98\x80\t"));
+}
+
+TEST(delimMapperUtf8MatchesMapper) {
+	DefaultTextFormatter formatter;
+	ConvertingTextFormatter convertingFormatter;
+	DelimTextMapper mapper(formatter);
+	DelimTextMapper convertingMapper(convertingFormatter);
+	DelimTextMapper wideDelimMapper(formatter, L"\x3042\x200b");
+	mt19937 random(15);
+
+	for (int i = 0; i < 50000; i++) {
+		string text1 = makeRandomText(random, i % 2 == 1), text2 = makeRandomText(random, i % 2 == 1);
+		string line = text1 + (random() % 2 == 0 ? "|~|" : "\xE3\x81\x82\xE2\x80\x8B") + text2;
+		wstring wideLine = StrHelper::convertToW(line);
+		bool matches = true;
+
+		for (const DelimTextMapper* textMapper : { &mapper, &convertingMapper, &wideDelimMapper }) {
+			pair<wstring, wstring> expected = textMapper->split(wideLine);
+			pair<string, string> textPair = textMapper->splitUtf8(line);
+			matches = matches && StrHelper::convertToW(textPair.first) == expected.first
+				&& StrHelper::convertToW(textPair.second) == expected.second;
+
+			wstring expectedMerge = textMapper->merge(StrHelper::convertToW(text1), StrHelper::convertToW(text2));
+			matches = matches && StrHelper::convertToW(textMapper->mergeUtf8(text1, text2)) == expectedMerge;
+		}
+
+		CHECK(matches);
+		if (!matches) break;
+	}
+}
+
+// the Textractor mapper keeps the base class' conversions, splitting on the first and last zero-width space
+TEST(textractorMapperUtf8MatchesMapper) {
+	DefaultTextFormatter formatter;
+	TextractorTextMapper mapper(formatter);
+	string text = "\xE3\x80\x80\xE3\x81\x82\xE2\x80\x8B\n\xE2\x80\x8B\xF0\x9F\x98\x80 \xFF";
+
+	pair<string, string> textPair = mapper.splitUtf8(text);
+	CHECK_EQ(string("\xE3\x81\x82"), textPair.first);
+	CHECK_EQ(string("\xF0\x9F\x98\x80 \xEF\xBF\xBD"), textPair.second);
+	CHECK_EQ(string("\xE3\x81\x82\xE2\x80\x8B\n\xC3\xA9"), mapper.mergeUtf8(" \xE3\x81\x82", "\xC3\xA9\t"));
+}
+
+TEST(importFormatUtf8MatchesImportFormat) {
+	DefaultTextFormatter formatter;
+	DelimTextMapper mapper(formatter);
+	DefaultCacheLineFormatter lineFormatter(formatter, mapper);
+	mt19937 random(16);
+
+	for (int i = 0; i < 20000; i++) {
+		wstring key = StrHelper::convertToW(makeRandomText(random, false));
+		wstring value = StrHelper::convertToW(makeRandomText(random, false));
+		string line = i % 2 == 0 ? lineFormatter.exportFormat(key, value)
+			: StrHelper::convertFromW(key) + "|~|" + makeRandomText(random, true);
+
+		pair<wstring, wstring> expected = lineFormatter.importFormat(line);
+		pair<string, string> textPair = lineFormatter.importFormatUtf8(line);
+		bool matches = StrHelper::convertToW(textPair.first) == expected.first
+			&& StrHelper::convertToW(textPair.second) == expected.second;
+		CHECK(matches);
+		if (!matches) break;
+	}
+}
+
+
+TEST_MAIN()
@@ -0,0 +1,217 @@
+#include "TestHelper.h"
+#include "_Libraries/strhelper.h"
+#include <random>
+
+
+namespace {
+	// A scalar decoder written from the well-formed byte sequences table of the Unicode standard (Table 3-7),
+	// replacing each maximal subpart of an ill-formed sequence with U+FFFD
+	struct SequenceForm {
+		unsigned char leadMin, leadMax;
+		// the ranges of the bytes after the lead
+		vector<pair<unsigned char, unsigned char>> tail;
+	};
+
+	const vector<SequenceForm> SEQUENCE_FORMS = {
+		{ 0x00, 0x7F, {} },
+		{ 0xC2, 0xDF, { { 0x80, 0xBF } } },
+		{ 0xE0, 0xE0, { { 0xA0, 0xBF }, { 0x80, 0xBF } } },
+		{ 0xE1, 0xEC, { { 0x80, 0xBF }, { 0x80, 0xBF } } },
+		{ 0xED, 0xED, { { 0x80, 0x9F }, { 0x80, 0xBF } } },
+		{ 0xEE, 0xEF, { { 0x80, 0xBF }, { 0x80, 0xBF } } },
+		{ 0xF0, 0xF0, { { 0x90, 0xBF }, { 0x80, 0xBF }, { 0x80, 0xBF } } },
+		{ 0xF1, 0xF3, { { 0x80, 0xBF }, { 0x80, 0xBF }, { 0x80, 0xBF } } },
+		{ 0xF4, 0xF4, { { 0x80, 0x8F }, { 0x80, 0xBF }, { 0x80, 0xBF } } },
+	};
+
+	// returns whether 'bytes' is valid
+	bool referenceDecode(const string& bytes, u32string& codePoints) {
+		bool valid = true;
+		codePoints.clear();
+
+		for (size_t i = 0; i < bytes.length();) {
+			unsigned char lead = static_cast<unsigned char>(bytes[i]);
+			const SequenceForm* form = nullptr;
+
+			for (const SequenceForm& sequenceForm : SEQUENCE_FORMS) {
+				if (lead >= sequenceForm.leadMin && lead <= sequenceForm.leadMax) form = &sequenceForm;
+			}
+
+			size_t matched = 1;
+			if (form != nullptr) {
+				while (matched <= form->tail.size() && i + matched < bytes.length()) {
+					unsigned char byte = static_cast<unsigned char>(bytes[i + matched]);
+					if (byte < form->tail[matched - 1].first || byte > form->tail[matched - 1].second) break;
+					matched++;
+				}
+			}
+
+			if (form == nullptr || matched != form->tail.size() + 1) {
+				codePoints.push_back(0xFFFD);
+				valid = false;
+			}
+			else {
+				uint32_t codePoint = form->tail.empty() ? lead : lead & (0x7F >> (form->tail.size() + 1));
+				for (size_t j = 1; j < matched; j++) codePoint = (codePoint << 6) | (bytes[i + j] & 0x3F);
+				codePoints.push_back(codePoint);
+			}
+
+			i += matched;
+		}
+
+		return valid;
+	}
+
+	// returns whether 'codePoints' are all valid scalar values
+	bool referenceEncode(const u32string& codePoints, string& bytes) {
+		bool valid = true;
+		bytes.clear();
+
+		for (uint32_t codePoint : codePoints) {
+			if (codePoint > 0x10FFFF || (codePoint >= 0xD800 && codePoint <= 0xDFFF)) {
+				codePoint = 0xFFFD;
+				valid = false;
+			}
+
+			if (codePoint < 0x80) {
+				bytes += static_cast<char>(codePoint);
+				continue;
+			}
+
+			size_t tailLength = codePoint < 0x800 ? 1 : codePoint < 0x10000 ? 2 : 3;
+			static const unsigned char LEADS[] = { 0, 0xC0, 0xE0, 0xF0 };
+			bytes += static_cast<char>(LEADS[tailLength] | (codePoint >> (6 * tailLength)));
+			for (size_t j = tailLength; j > 0; j--) bytes += static_cast<char>(0x80 | ((codePoint >> (6 * (j - 1))) & 0x3F));
+		}
+
+		return valid;
+	}
+
+	wstring toWstring(const u32string& codePoints) {
+		return wstring(codePoints.begin(), codePoints.end());
+	}
+
+	uint32_t randomCodePoint(mt19937& random) {
+		switch (random() % 4) {
+		case 0: return 0x20 + random() % 0x60;
+		case 1: return 0x80 + random() % 0x780;
+		// mostly kana/kanji
+		case 2: return random() % 4 != 0 ? 0x3000 + random() % 0x6000 : 0xE000 + random() % 0x2000;
+		default: return 0x10000 + random() % 0x100000;
+		}
+	}
+
+	// mixes long ASCII runs (for the SIMD path), valid sequences, and invalid/truncated/overlong ones at any offset
+	string makeFuzzBytes(mt19937& random) {
+		string bytes{};
+		size_t partCount = random() % 12;
+
+		for (size_t part = 0; part < partCount; part++) {
+			switch (random() % 7) {
+			case 0:
+				bytes += string(random() % 40, static_cast<char>('a' + random() % 26));
+				break;
+			case 1: case 2: {
+				string encoded;
+				referenceEncode(u32string(1, randomCodePoint(random)), encoded);
+				bytes += encoded;
+				break;
+			}
+			case 3: {
+				// a valid sequence, cut short
+				string encoded;
+				referenceEncode(u32string(1, randomCodePoint(random)), encoded);
+				bytes += encoded.substr(0, encoded.length() > 1 ? 1 + random() % (encoded.length() - 1) : 1);
+				break;
+			}
+			case 4: {
+				// ill-formed sequences of each kind, and the last BMP character
+				static const vector<string> edgeForms = { "\xC0\xAF", "\xE0\x80\xAF", "\xED\xA0\x80", "\xF4\x90\x80\x80",
+					"\xF8\x88\x80\x80\x80", "\xFF", "\x80", "\xBF\xBF", "\xF0\x80\x80\x41", "\xC1\xBF", "\xEF\xBF\xBF" };
+				bytes += edgeForms[random() % edgeForms.size()];
+				break;
+			}
+			case 5:
+				bytes += static_cast<char>(random() % 256);
+				break;
+			default:
+				bytes += string(1, '\0') + "x";
+				break;
+			}
+		}
+
+		return bytes;
+	}
+}
+
+
+TEST(decodesKnownSequences) {
+	CHECK(StrHelper::convertToW("a\xE3\x81\x82\xF0\x9F\x98\x80") == wstring(L"a\x3042") + static_cast<wchar_t>(0x1F600));
+	CHECK(StrHelper::convertToW(string("a\0b", 3)) == wstring(L"a\0b", 3));
+	CHECK(StrHelper::convertFromW(wstring(L"a\0b", 3)) == string("a\0b", 3));
+
+	// one U+FFFD per maximal subpart
+	CHECK(StrHelper::convertToW("\xF0\x80\x80\x41") == L"\xFFFD\xFFFD\xFFFD" L"A");
+	CHECK(StrHelper::convertToW("\xE3\x81") == L"\xFFFD");
+	CHECK(StrHelper::convertToW("\xE3\x81\xE3\x81\x82") == L"\xFFFD\x3042");
+	CHECK(StrHelper::convertToW("\xED\xA0\x80") == L"\xFFFD\xFFFD\xFFFD");
+
+	wstring wstr = L"keep";
+	string str = "keep";
+	CHECK(!StrHelper::tryConvertToW("ok\xC3", wstr) && wstr.empty());
+	CHECK(!StrHelper::tryConvertFromW(wstring(1, static_cast<wchar_t>(0xD800)), str) && str.empty());
+	CHECK(StrHelper::convertFromW(wstring(1, static_cast<wchar_t>(0xDC00))) == "\xEF\xBF\xBD");
+}
+
+TEST(matchesScalarReferenceOnFuzzedUtf8) {
+	mt19937 random(23);
+	u32string expectedCodePoints;
+
+	for (int i = 0; i < 100000; i++) {
+		string bytes = makeFuzzBytes(random);
+		bool expectedValid = referenceDecode(bytes, expectedCodePoints);
+		wstring expected = toWstring(expectedCodePoints), actual;
+
+		bool decoded = Utf8Transcoder::toWide(bytes.data(), bytes.length(), actual);
+		bool matches = decoded && actual == expected;
+		CHECK(matches);
+		CHECK_EQ(expectedValid, Utf8Transcoder::isValidUtf8(bytes.data(), bytes.length()));
+		CHECK_EQ(expectedValid, StrHelper::tryConvertToW(bytes, actual));
+
+		// valid text converts back to the same bytes
+		if (expectedValid) CHECK(StrHelper::convertFromW(StrHelper::convertToW(bytes)) == bytes);
+		if (!matches) {
+			fprintf(stderr, "  mismatch on input %d (%zu bytes)\n", i, bytes.length());
+			break;
+		}
+	}
+}
+
+TEST(matchesScalarReferenceOnFuzzedWideText) {
+	mt19937 random(29);
+	string expected, actual;
+
+	for (int i = 0; i < 100000; i++) {
+		u32string codePoints{};
+		size_t length = random() % 48;
+
+		for (size_t j = 0; j < length; j++) {
+			uint32_t kind = random() % 10;
+			if (kind < 4) codePoints += static_cast<char32_t>('a' + random() % 26);
+			else if (kind < 8) codePoints += static_cast<char32_t>(randomCodePoint(random));
+			else if (kind == 8) codePoints += static_cast<char32_t>(0xD800 + random() % 0x800);
+			else codePoints += static_cast<char32_t>(0x110000 + random() % 0x1000);
+		}
+
+		bool expectedValid = referenceEncode(codePoints, expected);
+		wstring wstr = toWstring(codePoints);
+
+		bool matches = Utf8Transcoder::fromWide(wstr.data(), wstr.length(), actual) && actual == expected;
+		CHECK(matches);
+		CHECK_EQ(expectedValid, StrHelper::tryConvertFromW(wstr, actual));
+		if (!matches) break;
+	}
+}
+
+
+TEST_MAIN()
@@ -0,0 +1,154 @@
+#include "TestHelper.h"
+#include "File/Writer/WriteBehindFileWriter.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+
+namespace {
+	// records what the background thread hands it, optionally failing or taking its time
+	class RecordingFileWriter : public FileWriter {
+	public:
+		atomic<bool> failing{ false };
+		atomic<int> delayMs{ 0 };
+
+		void writeToFile(const string& filePath, const string& text) override {
+			writeToFile(filePath, vector<string>{ text });
+		}
+
+		void writeToFile(const string& filePath, const vector<string>& lines, size_t startIndex = 0) override {
+			record("write " + filePath, lines, startIndex);
+		}
+
+		void appendToFile(const string& filePath, const string& text) override {
+			appendToFile(filePath, vector<string>{ text });
+		}
+
+		void appendToFile(const string& filePath, const vector<string>& lines, size_t startIndex = 0) override {
+			record("append " + filePath, lines, startIndex);
+		}
+
+		void closeFile(const string& filePath) override {
+			record("close " + filePath, {}, 0);
+		}
+
+		void flushFile(const string& filePath, bool toDisk = false) override {
+			record((toDisk ? "sync " : "flush ") + filePath, {}, 0);
+		}
+
+		vector<string> getOps() {
+			lock_guard<mutex> lock(_mtx);
+			return _ops;
+		}
+	private:
+		mutex _mtx;
+		vector<string> _ops{};
+
+		void record(const string& op, const vector<string>& lines, size_t startIndex) {
+			if (delayMs > 0) this_thread::sleep_for(chrono::milliseconds(delayMs));
+			if (failing) throw runtime_error("write failed");
+
+			string entry = op;
+			for (size_t i = startIndex; i < lines.size(); i++) entry += " " + lines[i];
+
+			lock_guard<mutex> lock(_mtx);
+			_ops.push_back(entry);
+		}
+	};
+}
+
+
+// appends queued together are coalesced, but never across an overwrite of the same file
+TEST(keepsOrderOfWritesToAFile) {
+	RecordingFileWriter mainWriter;
+	WriteBehindFileWriter writer(mainWriter, 1000, 512);
+
+	writer.appendToFile("a", "1");
+	writer.appendToFile("a", vector<string>{ "2", "3" });
+	writer.writeToFile("a", vector<string>{ "x", "4" }, 1);
+	writer.appendToFile("a", "5");
+	writer.appendToFile("b", "6");
+	writer.flushFile("a");
+
+	vector<string> ops = mainWriter.getOps();
+	CHECK(find(ops.begin(), ops.end(), "append b 6") != ops.end());
+
+	// files are committed in no set order, so only the ops on 'a' are held to it
+	vector<string> opsOnA{};
+	for (const string& op : ops) if (op.find(" a") != string::npos) opsOnA.push_back(op);
+	CHECK(opsOnA == vector<string>({ "append a 1 2 3", "write a 4", "append a 5", "flush a" }));
+}
+
+TEST(flushWaitsForQueuedWrites) {
+	RecordingFileWriter mainWriter;
+	mainWriter.delayMs = 20;
+	WriteBehindFileWriter writer(mainWriter, 1000, 1);
+
+	for (int i = 0; i < 5; i++) writer.appendToFile("a", to_string(i));
+	writer.flushFile("a");
+	CHECK_EQ(size_t(6), mainWriter.getOps().size());
+	CHECK_EQ(string("append a 4"), mainWriter.getOps()[4]);
+}
+
+// the error is rethrown once, by the next flush/close, and the writes after it still go through
+TEST(rethrowsErrorOnFlushAndClose) {
+	RecordingFileWriter mainWriter;
+	WriteBehindFileWriter writer(mainWriter, 0);
+
+	mainWriter.failing = true;
+	writer.appendToFile("a", "1");
+	CHECK_THROWS(writer.flushFile("a"));
+
+	mainWriter.failing = false;
+	writer.flushFile("a");
+	writer.appendToFile("a", "2");
+	writer.flushFile("a");
+	CHECK_EQ(string("append a 2"), mainWriter.getOps()[1]);
+
+	mainWriter.failing = true;
+	writer.writeToFile("a", "3");
+	CHECK_THROWS(writer.closeFile("a"));
+	mainWriter.failing = false;
+	writer.closeFile("a");
+}
+
+TEST(destructorWritesEverythingQueued) {
+	RecordingFileWriter mainWriter;
+	mainWriter.delayMs = 5;
+
+	{
+		WriteBehindFileWriter writer(mainWriter, 1000, 1);
+		for (int i = 0; i < 10; i++) writer.appendToFile("a", to_string(i));
+	}
+
+	vector<string> ops = mainWriter.getOps();
+	CHECK_EQ(size_t(10), ops.size());
+	if (!ops.empty()) CHECK_EQ(string("append a 9"), ops.back());
+}
+
+// each batch ends with a flush (or sync) of every file it wrote to
+TEST(durabilityFlushesOrSyncsWrittenFiles) {
+	for (WriteBehindFileWriter::Durability durability : { WriteBehindFileWriter::None,
+		WriteBehindFileWriter::Flush, WriteBehindFileWriter::Sync })
+	{
+		RecordingFileWriter mainWriter;
+
+		{
+			WriteBehindFileWriter writer(mainWriter, 1000, 512, durability);
+			writer.appendToFile("a", "1");
+			writer.writeToFile("b", "2");
+		}
+
+		vector<string> ops = mainWriter.getOps();
+		size_t flushes = count(ops.begin(), ops.end(), "flush a") + count(ops.begin(), ops.end(), "flush b");
+		size_t syncs = count(ops.begin(), ops.end(), "sync a") + count(ops.begin(), ops.end(), "sync b");
+
+		CHECK_EQ(size_t(durability == WriteBehindFileWriter::Flush ? 2 : 0), flushes);
+		CHECK_EQ(size_t(durability == WriteBehindFileWriter::Sync ? 2 : 0), syncs);
+		CHECK_EQ(size_t(2) + flushes + syncs, ops.size());
+	}
+}
+
+
+TEST_MAIN()
@@ -0,0 +1,58 @@
+
+#pragma once
+#include "../TestHelper.h"
+#include <functional>
+#include <sys/wait.h>
+
+
+// Reads a field of /proc/self/status (ex: "VmRSS", "VmHWM", "RssAnon", "RssFile"), in KB.
+inline long getProcessStatusKb(const string& field) {
+	ifstream f("/proc/self/status");
+	string line;
+
+	while (getline(f, line)) {
+		if (line.compare(0, field.length() + 1, field + ":") == 0) return stol(line.substr(field.length() + 1));
+	}
+
+	return -1;
+}
+
+// Runs 'action' in a forked child (so that each variant starts from the same memory state, and its peak RSS is its own),
+// and returns the values it reported.
+inline vector<double> runIsolated(const function<vector<double>()>& action) {
+	int fds[2];
+	if (pipe(fds) != 0) return {};
+
+	pid_t pid = fork();
+	if (pid == 0) {
+		close(fds[0]);
+		vector<double> values = action();
+		size_t count = values.size();
+		if (write(fds[1], &count, sizeof(count)) < 0 || write(fds[1], values.data(), count * sizeof(double)) < 0) _exit(1);
+		_exit(0);
+	}
+
+	close(fds[1]);
+	size_t count = 0;
+	vector<double> values{};
+
+	if (read(fds[0], &count, sizeof(count)) == sizeof(count)) {
+		values.resize(count);
+		if (read(fds[0], values.data(), count * sizeof(double)) != static_cast<ssize_t>(count * sizeof(double))) values.clear();
+	}
+
+	close(fds[0]);
+	waitpid(pid, nullptr, 0);
+	return values;
+}
+
+// A line of Japanese-like text of about 'length' characters, unique per 'seed'.
+inline wstring makeBenchText(size_t seed, size_t length) {
+	wstring text = L"\x300C" + to_wstring(seed) + L"\x300D";
+	for (size_t i = 0; text.length() < length; i++) text += static_cast<wchar_t>(0x3041 + (seed * 7 + i * 13) % 83);
+	return text;
+}
+
+inline double elapsedMs(chrono::steady_clock::time_point start) {
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
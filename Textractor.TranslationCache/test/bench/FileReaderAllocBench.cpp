@@ -0,0 +1,98 @@
+#include "BenchHelper.h"
+#include "File/MappedFileReader.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Allocations made by a full line scan of a cache file, and the time it takes, for the stream reader as it was
+// (a 512 KB buffer per call, never freed, and a string built per line), the stream reader and the mapped reader.
+// usage: FileReaderAllocBench [line count (default 100000)]
+
+
+static atomic<size_t> allocationCount{ 0 };
+static atomic<size_t> allocatedBytes{ 0 };
+
+void* operator new(size_t size) {
+	void* memory = malloc(size > 0 ? size : 1);
+	if (memory == nullptr) throw bad_alloc();
+	allocationCount++;
+	allocatedBytes += size;
+	return memory;
+}
+
+// not inlined, since a 'free' inlined into a caller looks (to the compiler) like a mismatch with the 'new' it called
+__attribute__((noinline)) void operator delete(void* memory) noexcept {
+	free(memory);
+}
+
+__attribute__((noinline)) void operator delete(void* memory, size_t size) noexcept {
+	free(memory);
+}
+
+
+namespace {
+	// 'readLine' of FstreamFileReader before the reused line buffer
+	class PreviousFstreamFileReader : public FstreamFileReader {
+	public:
+		string readLine(const string& filePath, const function<bool(const string& line)> condition) override {
+			ifstream f(filePath, ios_base::in);
+			if (!f.good()) return "";
+			char* line = new char[MAX_LENGTH];
+
+			while (f.getline(line, MAX_LENGTH)) {
+				if (condition(line)) return line;
+			}
+
+			return "";
+		}
+	private:
+		static const int MAX_LENGTH = 524288;
+	};
+
+	struct ScanResult {
+		size_t allocations;
+		size_t bytes;
+		double ms;
+	};
+
+	ScanResult measureScan(FileReader& reader, const string& filePath, size_t& lineCount) {
+		size_t allocationsBefore = allocationCount, bytesBefore = allocatedBytes;
+		auto start = chrono::steady_clock::now();
+		reader.readLines(filePath, [&lineCount](const string& line) { lineCount++; });
+		return ScanResult{ allocationCount - allocationsBefore, allocatedBytes - bytesBefore, elapsedMs(start) };
+	}
+}
+
+
+int main(int argc, char** argv) {
+	size_t lineCount = argc > 1 ? stoul(argv[1]) : 100000;
+	TempDir dir;
+	string filePath = dir.file("cache.txt");
+
+	string text = "";
+	for (size_t i = 0; i < lineCount; i++) {
+		text += StrHelper::convertFromW(makeBenchText(i, 30)) + "|~|" + StrHelper::convertFromW(makeBenchText(i, 80)) + "\n";
+	}
+	writeTestFile(filePath, text);
+
+	WinApiFileMapper mapper;
+	PreviousFstreamFileReader previousReader;
+	FstreamFileReader streamReader;
+	MappedFileReader mappedReader(mapper);
+	vector<pair<string, FileReader*>> readers{ { "FstreamFileReader (previous)", &previousReader },
+		{ "FstreamFileReader", &streamReader }, { "MappedFileReader", &mappedReader } };
+
+	printf("full scan of %zu lines (%.1f MB)\n", lineCount, text.length() / 1048576.0);
+	printf("  %-30s %12s %14s %10s\n", "", "allocations", "allocated", "time");
+
+	for (auto& reader : readers) {
+		size_t scannedLines = 0;
+		measureScan(*reader.second, filePath, scannedLines);
+		ScanResult result = measureScan(*reader.second, filePath, scannedLines);
+		if (scannedLines != lineCount * 2) fprintf(stderr, "scanned %zu lines, expected %zu\n", scannedLines, lineCount * 2);
+
+		printf("  %-30s %12zu %11.1f KB %7.1f ms\n", reader.first.c_str(), result.allocations, result.bytes / 1024.0, result.ms);
+	}
+
+	return 0;
+}
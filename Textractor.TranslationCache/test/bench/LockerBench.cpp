@@ -0,0 +1,160 @@
+#include "BenchHelper.h"
+#include "_Libraries/Locker.h"
+#include <atomic>
+#include <thread>
+
+// The cost of a short locked action (a map lookup), for the lockers as they were (an action wrapped in a 'function',
+// a condition variable notified on every unlock) and as they are (through the 'Locker' interface, through the
+// 'lock' template, and shared for the 'SharedLocker'), uncontended and with 1/4/16 threads locking at once.
+// usage: LockerBench [iterations (default 1000000)]
+
+
+namespace {
+	class PreviousBasicLocker {
+	public:
+		int lockI(const function<int()>& action) {
+			return lock<int>(action);
+		}
+	private:
+		mutex _mtx;
+		condition_variable _cv;
+		bool _busy = false;
+
+		template<typename T>
+		T lock(const function<T()>& action) {
+			T output;
+			{
+				lock_guard<mutex> lock(_mtx);
+				output = performAction(action);
+			}
+
+			_cv.notify_all();
+			return output;
+		}
+
+		template<typename T>
+		T performAction(const function<T()>& action) {
+			_busy = true;
+
+			try {
+				T output = action();
+				_busy = false;
+				return output;
+			}
+			catch (exception&) {
+				_busy = false;
+				_cv.notify_all();
+				throw;
+			}
+		}
+	};
+
+	class PreviousSemaphoreLocker {
+	public:
+		PreviousSemaphoreLocker(int maxCount) : _maxCount(maxCount) { }
+
+		int lockI(const function<int()>& action) {
+			return lock<int>(action);
+		}
+	private:
+		mutex _mtx;
+		condition_variable _cv;
+		int _maxCount;
+		atomic<int> _takenCount{ 0 };
+
+		template<typename T>
+		T lock(const function<T()>& action) {
+			{
+				unique_lock<mutex> lock(_mtx);
+				_cv.wait(lock, [this]() { return _takenCount < _maxCount; });
+				_takenCount++;
+			}
+
+			return performAction(action);
+		}
+
+		template<typename T>
+		T performAction(const function<T()>& action) {
+			try {
+				T output = action();
+				_takenCount--;
+				_cv.notify_all();
+				return output;
+			}
+			catch (exception&) {
+				_takenCount--;
+				_cv.notify_all();
+				throw;
+			}
+		}
+	};
+
+	// millions of locked actions per second, over all threads
+	double measureContended(int threadCount, const function<int(size_t)>& lockOnce) {
+		atomic<bool> stop{ false };
+		atomic<size_t> totalLocks{ 0 };
+		vector<thread> threads{};
+
+		for (int t = 0; t < threadCount; t++) {
+			threads.push_back(thread([&, t]() {
+				size_t locks = 0, sum = 0;
+				for (size_t i = t * 7919; !stop; i++, locks++) sum += lockOnce(i);
+				totalLocks += locks;
+				if (sum == 0) fprintf(stderr, "nothing read\n");
+			}));
+		}
+
+		auto start = chrono::steady_clock::now();
+		this_thread::sleep_for(chrono::milliseconds(300));
+		stop = true;
+		double ms = elapsedMs(start);
+
+		for (thread& lockingThread : threads) lockingThread.join();
+		return totalLocks / ms / 1000;
+	}
+}
+
+
+int main(int argc, char** argv) {
+	size_t iterations = argc > 1 ? stoul(argv[1]) : 1000000;
+	unordered_map<int, int> map{};
+	for (int i = 0; i < 1024; i++) map[i] = i + 1;
+
+	PreviousBasicLocker previousBasicLocker;
+	PreviousSemaphoreLocker previousSemaphoreLocker(1);
+	BasicLocker basicLocker;
+	SemaphoreLocker semaphoreLocker(1);
+	SharedLocker sharedLocker;
+	Locker& basicLockerInterface = basicLocker;
+	Locker& semaphoreLockerInterface = semaphoreLocker;
+
+	auto read = [&map](size_t i) { return map.find(static_cast<int>(i % 1024))->second; };
+	vector<pair<string, function<int(size_t)>>> variants = {
+		{ "BasicLocker (old)", [&](size_t i) { return previousBasicLocker.lockI([&]() { return read(i); }); } },
+		{ "BasicLocker, Locker&", [&](size_t i) { return basicLockerInterface.lockI([&]() { return read(i); }); } },
+		{ "BasicLocker, lock template", [&](size_t i) { return basicLocker.lock([&]() { return read(i); }); } },
+		{ "SemaphoreLocker(1) (old)", [&](size_t i) { return previousSemaphoreLocker.lockI([&]() { return read(i); }); } },
+		{ "SemaphoreLocker(1), Locker&", [&](size_t i) { return semaphoreLockerInterface.lockI([&]() { return read(i); }); } },
+		{ "SemaphoreLocker(1), lock template", [&](size_t i) { return semaphoreLocker.lock([&]() { return read(i); }); } },
+		{ "SharedLocker, lock template", [&](size_t i) { return sharedLocker.lock([&]() { return read(i); }); } },
+		{ "SharedLocker, lockShared", [&](size_t i) { return sharedLocker.lockShared([&]() { return read(i); }); } },
+	};
+
+	printf("%u hardware threads\n", thread::hardware_concurrency());
+	printf("  %-36s %12s %10s %10s %10s\n", "", "ns/lock", "1 thread", "4 threads", "16 threads");
+	printf("  %-36s %12s %10s %10s %10s\n", "", "uncontended", "M locks/s", "M locks/s", "M locks/s");
+
+	for (auto& variant : variants) {
+		const function<int(size_t)>& lockOnce = variant.second;
+		size_t sum = 0, i = 0;
+		// every variant is called through the same 'function', so the differences are the lockers' own
+		double ns = measureNs(iterations, [&]() { sum += lockOnce(i++); });
+
+		printf("  %-36s %12.1f", variant.first.c_str(), ns);
+		for (int threadCount : { 1, 4, 16 }) printf(" %10.2f", measureContended(threadCount, lockOnce));
+		printf("\n");
+		if (sum == 0) fprintf(stderr, "nothing read\n");
+	}
+
+	return 0;
+}
@@ -0,0 +1,111 @@
+#include "BenchHelper.h"
+#include "SharedMemory/SharedHashTable.h"
+#include <sys/mman.h>
+
+// Cost of the shared-memory hash table: uncontended reads (hit/miss) and writes, then the writer lock handed off
+// between 1/2/4 writer processes (each writing its own keys), with a reader process reading all along.
+// usage: SharedHashTableBench [iterations (default 200000)] [key count (default 1000)]
+
+
+namespace {
+	const uint32_t slotCount = 8192, slabChars = 1 << 20;
+
+	// millions of operations per second, for the writers (over all of them) and for the reader
+	pair<double, double> measureProcesses(PosixSharedMemoryRegionManager& regionManager, const wstring& identifier,
+		const vector<wstring>& keys, const wstring& value, int writerCount)
+	{
+		// counts are handed back through anonymous shared memory: one per writer, then the reader's
+		void* countsMemory = mmap(nullptr, sizeof(atomic<uint64_t>) * (writerCount + 1), PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+		if (countsMemory == MAP_FAILED) return pair<double, double>(0, 0);
+		atomic<uint64_t>* counts = new (countsMemory) atomic<uint64_t>[writerCount + 1]();
+		atomic<uint32_t>* stop = new (mmap(nullptr, sizeof(atomic<uint32_t>), PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_ANONYMOUS, -1, 0)) atomic<uint32_t>(0);
+		vector<pid_t> pids{};
+
+		auto openTable = [&regionManager, &identifier]() {
+			shared_ptr<SharedMemoryRegion> region = regionManager.createOrOpenRegion(identifier,
+				SharedHashTable::getRegionSize(slotCount, slabChars));
+			return make_unique<SharedHashTable>(region, slotCount, slabChars);
+		};
+
+		for (int p = 0; p <= writerCount; p++) {
+			pid_t pid = fork();
+			if (pid != 0) {
+				pids.push_back(pid);
+				continue;
+			}
+
+			unique_ptr<SharedHashTable> table = openTable();
+			uint64_t count = 0, found = 0;
+
+			if (p < writerCount) {
+				for (size_t i = p; !*stop; i += writerCount, count++) table->write(keys[i % keys.size()], value);
+			}
+			else {
+				for (size_t i = 0; !*stop; i++, count++) found += !table->read(keys[i % keys.size()]).empty();
+				if (found == 0) fprintf(stderr, "nothing read\n");
+			}
+
+			counts[p] = count;
+			_exit(0);
+		}
+
+		auto start = chrono::steady_clock::now();
+		this_thread::sleep_for(chrono::milliseconds(300));
+		*stop = 1;
+		for (pid_t pid : pids) waitpid(pid, nullptr, 0);
+		double ms = elapsedMs(start);
+
+		uint64_t writes = 0;
+		for (int w = 0; w < writerCount; w++) writes += counts[w];
+		pair<double, double> result(writes / ms / 1000, counts[writerCount] / ms / 1000);
+
+		munmap(countsMemory, sizeof(atomic<uint64_t>) * (writerCount + 1));
+		munmap(stop, sizeof(atomic<uint32_t>));
+		return result;
+	}
+}
+
+
+int main(int argc, char** argv) {
+	size_t iterations = argc > 1 ? stoul(argv[1]) : 200000;
+	size_t keyCount = argc > 2 ? stoul(argv[2]) : 1000;
+	PosixSharedMemoryRegionManager regionManager{ "/tc_bench_" + to_string(getpid()) + "_" };
+	wstring identifier = L"table";
+	regionManager.removeRegion(identifier);
+
+	vector<wstring> keys{}, missingKeys{};
+	for (size_t i = 0; i < keyCount; i++) keys.push_back(makeBenchText(i, 20));
+	for (size_t i = 0; i < keyCount; i++) missingKeys.push_back(makeBenchText(keyCount + i, 20));
+	wstring value = makeBenchText(0, 60);
+
+	{
+		shared_ptr<SharedMemoryRegion> region = regionManager.createOrOpenRegion(identifier,
+			SharedHashTable::getRegionSize(slotCount, slabChars));
+		SharedHashTable table(region, slotCount, slabChars);
+		for (const wstring& key : keys) table.write(key, value);
+
+		size_t i = 0, found = 0;
+		double hitNs = measureNs(iterations, [&]() { found += table.read(keys[i++ % keyCount]).length(); });
+		double missNs = measureNs(iterations, [&]() { found += table.read(missingKeys[i++ % keyCount]).length(); });
+		double writeNs = measureNs(iterations, [&]() { table.write(keys[i++ % keyCount], value); });
+		if (found == 0) fprintf(stderr, "nothing read\n");
+
+		printf("%zu keys, one process\n", keyCount);
+		printBenchResult("read (hit)", hitNs, "ns");
+		printBenchResult("read (miss)", missNs, "ns");
+		printBenchResult("write", writeNs, "ns");
+	}
+
+	printf("writer lock handed off between processes, one reader process alongside\n");
+	printf("  %-20s %16s %16s\n", "", "M writes/s", "M reads/s");
+
+	for (int writerCount : { 1, 2, 4 }) {
+		pair<double, double> result = measureProcesses(regionManager, identifier, keys, value, writerCount);
+		printf("  %d writer process(es) %14.2f %16.2f\n", writerCount, result.first, result.second);
+	}
+
+	regionManager.removeRegion(identifier);
+	return 0;
+}
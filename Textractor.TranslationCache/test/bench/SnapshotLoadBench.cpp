@@ -0,0 +1,118 @@
+#include "BenchHelper.h"
+#include "Cache/FileTextMapCache.h"
+#include "Cache/MappedSnapshotTextMapCache.h"
+#include "Cache/MemoryTextMapCache.h"
+#include "File/Writer/FstreamFileWriter.h"
+#include <random>
+
+// Startup cost of the Read module's cache: the time to load a cache file, the memory it takes once loaded,
+// and the lookup cost afterwards, for the in-memory loaders and for the memory-mapped snapshot.
+// usage: SnapshotLoadBench [line count (default 200000)]
+
+
+namespace {
+	struct Deps {
+		FstreamFileWriter writer;
+		FstreamFileReader reader;
+		CRemoveFileDeleter deleter;
+		WinApiFileRenamer renamer;
+		WinApiFileMapper mapper;
+		FstreamFileInspector inspector;
+		DefaultTextFormatter formatter;
+		DelimTextMapper textMapper{ formatter };
+		DefaultCacheLineFormatter lineFormatter{ formatter, textMapper };
+	};
+
+	vector<wstring> getLookupKeys(size_t lineCount) {
+		mt19937 random(42);
+		vector<wstring> keys{};
+		for (int i = 0; i < 10000; i++) keys.push_back(makeBenchText(random() % lineCount, 30));
+		return keys;
+	}
+
+	// load time (ms), RSS growth (KB), anonymous RSS growth (KB), first and second lookup pass times (ns)
+	vector<double> measureLoad(const function<unique_ptr<TextMapCache>()>& load, const vector<wstring>& keys) {
+		long rssBefore = getProcessStatusKb("VmRSS"), anonBefore = getProcessStatusKb("RssAnon");
+		auto start = chrono::steady_clock::now();
+		unique_ptr<TextMapCache> cache = load();
+		double loadMs = elapsedMs(start);
+
+		size_t hits = 0, i = 0;
+		double firstLookupNs = measureNs(keys.size(), [&]() { hits += !cache->readFromCache(keys[i++]).empty(); });
+		if (hits != keys.size()) fprintf(stderr, "only %zu of %zu lookups hit\n", hits, keys.size());
+
+		// the first pass includes faulting in the pages of a mapped file
+		long rssGrowth = getProcessStatusKb("VmRSS") - rssBefore, anonGrowth = getProcessStatusKb("RssAnon") - anonBefore;
+		i = 0;
+		double lookupNs = measureNs(keys.size(), [&]() { hits += !cache->readFromCache(keys[i++]).empty(); });
+
+		return { loadMs, static_cast<double>(rssGrowth), static_cast<double>(anonGrowth), firstLookupNs, lookupNs };
+	}
+
+	void printLoadResult(const string& name, const vector<double>& values) {
+		if (values.size() != 5) return;
+		printf("  %-44s %9.1f ms %9.1f MB %9.1f MB %9.0f ns %9.0f ns\n", name.c_str(),
+			values[0], values[1] / 1024, values[2] / 1024, values[3], values[4]);
+	}
+}
+
+
+int main(int argc, char** argv) {
+	size_t lineCount = argc > 1 ? stoul(argv[1]) : 200000;
+	TempDir dir;
+	string filePath = dir.file("cache.txt");
+	Deps deps;
+
+	vector<string> lines{};
+	for (size_t i = 0; i < lineCount; i++) {
+		lines.push_back(deps.lineFormatter.exportFormat(makeBenchText(i, 30), makeBenchText(i, 80)));
+	}
+
+	deps.writer.writeToFile(filePath, lines);
+	lines.clear();
+	lines.shrink_to_fit();
+	vector<wstring> keys = getLookupKeys(lineCount);
+
+	printf("%zu lines, %.1f MB cache file\n", lineCount, deps.inspector.getFileSize(filePath) / 1048576.0);
+	printf("  %-44s %12s %12s %12s %12s %12s\n", "", "load", "RSS growth", "anon growth", "1st lookup", "lookup");
+
+	printLoadResult("readLines + map + MemoryTextMapCache (old)", runIsolated([&]() {
+		return measureLoad([&]() {
+			unordered_map<wstring, wstring> map{};
+
+			deps.reader.readLines(filePath, [&](const string& line) {
+				pair<wstring, wstring> textPair = deps.lineFormatter.importFormat(line);
+				map[textPair.first] = textPair.second;
+			});
+
+			return make_unique<MemoryTextMapCache>(deps.formatter, map);
+		}, keys);
+	}));
+
+	printLoadResult("FileTextMapCache load + MemoryTextMapCache", runIsolated([&]() {
+		return measureLoad([&]() {
+			FileTextMapCache fileCache(deps.writer, deps.reader, deps.deleter, deps.renamer,
+				deps.inspector, deps.formatter, deps.textMapper, filePath);
+			return make_unique<MemoryTextMapCache>(deps.formatter, fileCache.readAllFromCache());
+		}, keys);
+	}));
+
+	auto loadSnapshot = [&]() {
+		auto cache = make_unique<MappedSnapshotTextMapCache>(deps.mapper, deps.renamer, deps.deleter,
+			deps.inspector, deps.formatter, deps.textMapper);
+		cache->loadSnapshot(filePath);
+		return cache;
+	};
+
+	deps.deleter.deleteFile(filePath + ".snap");
+	deps.deleter.deleteFile(filePath + ".2.snap");
+	printLoadResult("MappedSnapshotTextMapCache, compiling sidecar", runIsolated([&]() {
+		return measureLoad(loadSnapshot, keys);
+	}));
+
+	printLoadResult("MappedSnapshotTextMapCache, reusing sidecar", runIsolated([&]() {
+		return measureLoad(loadSnapshot, keys);
+	}));
+
+	return 0;
+}
@@ -0,0 +1,58 @@
+#include "BenchHelper.h"
+#include "_Libraries/strhelper.h"
+
+// Escaping a long sentence's line breaks (as the cache line formatter does), with 'replace' as it was
+// (searching from the start after every replacement, then erasing and inserting in place), with one single-pass
+// 'replace' call per target, and with a prepared 'StrReplaceSet' applying both targets in one pass.
+// usage: StrReplaceBench [iterations (default 50)]
+
+
+namespace {
+	wstring previousReplace(wstring str, const wstring& target, const wstring& replacement) {
+		if (str.empty()) return str;
+		size_t targetIndex;
+
+		while ((targetIndex = str.find(target)) != wstring::npos) {
+			str = str.erase(targetIndex, target.length());
+			str = str.insert(targetIndex, replacement);
+		}
+
+		return str;
+	}
+
+	// a sentence of about 'length' characters, with a line break every 40 or so
+	wstring makeSentence(size_t length) {
+		wstring sentence{};
+		for (size_t i = 0; sentence.length() < length; i++) sentence += makeBenchText(i, 40) + (i % 3 == 0 ? L"\r\n" : L"\n");
+		return sentence;
+	}
+}
+
+
+int main(int argc, char** argv) {
+	size_t iterations = argc > 1 ? stoul(argv[1]) : 50;
+	const StrReplaceSet<wchar_t> escapes({ { L"\r", L"\\r" }, { L"\n", L"\\n" } });
+
+	for (size_t length : { 10000, 20000, 100000 }) {
+		wstring sentence = makeSentence(length);
+		wstring expected = escapes.apply(sentence);
+		printf("%zu character sentence, %zu line breaks\n", sentence.length(), (expected.length() - sentence.length()));
+
+		wstring output;
+		printBenchResult("in-place replace, chained (old)", measureNs(iterations, [&]() {
+			output = previousReplace(previousReplace(sentence, L"\r", L"\\r"), L"\n", L"\\n");
+		}) / 1000, "us");
+		if (output != expected) fprintf(stderr, "old replace gave a different result\n");
+
+		printBenchResult("single-pass replace, chained", measureNs(iterations, [&]() {
+			output = StrHelper::replace<wchar_t>(StrHelper::replace<wchar_t>(sentence, L"\r", L"\\r"), L"\n", L"\\n");
+		}) / 1000, "us");
+		if (output != expected) fprintf(stderr, "chained replace gave a different result\n");
+
+		printBenchResult("StrReplaceSet (prepared)", measureNs(iterations, [&]() {
+			output = escapes.apply(sentence);
+		}) / 1000, "us");
+	}
+
+	return 0;
+}
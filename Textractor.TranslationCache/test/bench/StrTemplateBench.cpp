@@ -0,0 +1,90 @@
+#include "BenchHelper.h"
+#include "_Libraries/strhelper.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Rendering the logger's message template with a sentence, per render: the allocations made and the time taken,
+// for 'format' as it was (one in-place replace per placeholder), for 'format' (which parses the template on every call)
+// and for a kept 'StrTemplate'.
+// usage: StrTemplateBench [iterations (default 20000)]
+
+
+static atomic<size_t> allocationCount{ 0 };
+
+void* operator new(size_t size) {
+	void* memory = malloc(size > 0 ? size : 1);
+	if (memory == nullptr) throw bad_alloc();
+	allocationCount++;
+	return memory;
+}
+
+// not inlined, since a 'free' inlined into a caller looks (to the compiler) like a mismatch with the 'new' it called
+__attribute__((noinline)) void operator delete(void* memory) noexcept {
+	free(memory);
+}
+
+__attribute__((noinline)) void operator delete(void* memory, size_t size) noexcept {
+	free(memory);
+}
+
+
+namespace {
+	wstring previousReplace(wstring str, const wstring& target, const wstring& replacement) {
+		if (str.empty()) return str;
+		size_t targetIndex;
+
+		while ((targetIndex = str.find(target)) != wstring::npos) {
+			str = str.erase(targetIndex, target.length());
+			str = str.insert(targetIndex, replacement);
+		}
+
+		return str;
+	}
+
+	wstring previousFormat(wstring str, const vector<wstring> pars) {
+		for (size_t i = 0; i < pars.size(); i++) {
+			str = previousReplace(str, L"{" + to_wstring(i) + L"}", pars[i]);
+		}
+
+		return str;
+	}
+
+	template<class Fn>
+	void measureRender(const string& name, size_t iterations, Fn&& render) {
+		size_t allocationsBefore = allocationCount;
+		double ns = measureNs(iterations, render);
+		double allocations = static_cast<double>(allocationCount - allocationsBefore) / iterations;
+		printf("  %-40s %10.1f allocations %10.0f ns %10.0f renders/s\n", name.c_str(), allocations, ns, 1e9 / ns);
+	}
+}
+
+
+int main(int argc, char** argv) {
+	size_t iterations = argc > 1 ? stoul(argv[1]) : 20000;
+	const wstring templateStr = L"[{4}] {1} ({2}:{3})\n{0}\n";
+	const StrTemplate<wchar_t> strTemplate(templateStr);
+
+	for (size_t length : { 100, 1000, 10000 }) {
+		const vector<wstring> values = { makeBenchText(1, length), L"game.exe", L"0:1:2", L"Thread", L"2026-10-17 12:00:00" };
+		wstring expected = strTemplate.render(values), output;
+		printf("%zu character sentence\n", values[0].length());
+
+		// the values are passed the same way the logger passes them, by copy
+		measureRender("in-place replace per placeholder (old)", iterations, [&]() {
+			output = previousFormat(templateStr, values);
+		});
+		if (output != expected) fprintf(stderr, "old format gave a different result\n");
+
+		measureRender("StrHelper::format (parsed per call)", iterations, [&]() {
+			output = StrHelper::format<wchar_t>(templateStr, values);
+		});
+		if (output != expected) fprintf(stderr, "format gave a different result\n");
+
+		measureRender("StrTemplate (kept)", iterations, [&]() {
+			output = strTemplate.render(values);
+		});
+	}
+
+	return 0;
+}
@@ -0,0 +1,59 @@
+#include "BenchHelper.h"
+#include "File/FileTruncater.h"
+#include "File/Writer/FstreamFileWriter.h"
+
+// Cost of truncating a large cache file down to its size limit: time taken, and peak memory growth,
+// for the line-loading truncater and for the streaming one (in place).
+// usage: TruncateBench [file size in MB (default 128)] [size limit in MB (default 16)]
+
+
+namespace {
+	void writeBenchFile(const string& filePath, uint64_t sizeBytes) {
+		ofstream f(filePath, ios_base::out | ios_base::binary | ios_base::trunc);
+		string line;
+
+		for (size_t i = 0; static_cast<uint64_t>(f.tellp()) < sizeBytes; i++) {
+			line = "\xE3\x80\x8C" + to_string(i) + "\xE3\x80\x8D|~|";
+			while (line.length() < 150) line += "\xE3\x81\x82";
+			f << line << '\n';
+		}
+	}
+}
+
+
+int main(int argc, char** argv) {
+	uint64_t fileSizeMb = argc > 1 ? stoull(argv[1]) : 128;
+	uint64_t limitBytes = (argc > 2 ? stoull(argv[2]) : 16) * 1024 * 1024;
+	TempDir dir;
+	string sourcePath = dir.file("source.txt"), filePath = dir.file("cache.txt");
+	writeBenchFile(sourcePath, fileSizeMb * 1024 * 1024);
+
+	FstreamFileReader reader;
+	FstreamFileWriter writer;
+	DefaultFileTruncater loadingTruncater(reader, writer, limitBytes);
+	StreamingFileTruncater streamingTruncater(limitBytes);
+	vector<pair<string, FileTruncater*>> truncaters{ { "DefaultFileTruncater (loads lines)", &loadingTruncater },
+		{ "StreamingFileTruncater (in place)", &streamingTruncater } };
+
+	printf("%llu MB file truncated to %llu MB\n", static_cast<unsigned long long>(fileSizeMb),
+		static_cast<unsigned long long>(limitBytes / 1024 / 1024));
+	printf("  %-36s %10s %16s %12s\n", "", "time", "peak RSS growth", "result");
+
+	for (auto& truncater : truncaters) {
+		if (system(("cp '" + sourcePath + "' '" + filePath + "'").c_str()) != 0) return 1;
+
+		vector<double> values = runIsolated([&]() {
+			long peakBefore = getProcessStatusKb("VmHWM");
+			auto start = chrono::steady_clock::now();
+			truncater.second->truncateFile(filePath);
+			double ms = elapsedMs(start);
+			return vector<double>{ ms, static_cast<double>(getProcessStatusKb("VmHWM") - peakBefore) };
+		});
+
+		if (values.size() != 2) continue;
+		printf("  %-36s %7.0f ms %13.1f MB %9.1f MB\n", truncater.first.c_str(), values[0], values[1] / 1024,
+			readTestFile(filePath).length() / 1048576.0);
+	}
+
+	return 0;
+}
@@ -0,0 +1,64 @@
+#include "BenchHelper.h"
+#include "_Libraries/strhelper.h"
+#include <codecvt>
+#include <locale>
+
+// Throughput of the UTF-8 transcoder (to wide, from wide, and validation) on Japanese, ASCII and mixed text,
+// next to the standard library's codecvt_utf8 (there is no MultiByteToWideChar to compare with off Windows).
+// usage: Utf8TranscodeBench [text size in MB (default 1)]
+
+
+namespace {
+	string makeText(size_t byteCount, const function<wstring(size_t)>& makeLine) {
+		string text{};
+		for (size_t i = 0; text.length() < byteCount; i++) text += StrHelper::convertFromW(makeLine(i)) + "\n";
+		return text;
+	}
+
+	// the best of a few runs, since a run on a busy machine only ever gets slower
+	void printThroughput(const string& name, size_t byteCount, size_t iterations, const function<void()>& convert) {
+		double bestNs = 0;
+
+		for (int run = 0; run < 5; run++) {
+			double ns = measureNs(iterations, convert);
+			if (run == 0 || ns < bestNs) bestNs = ns;
+		}
+
+		printBenchResult(name, byteCount / bestNs * 1e9 / 1048576, "MB/s");
+	}
+}
+
+
+int main(int argc, char** argv) {
+	size_t byteCount = (argc > 1 ? stoul(argv[1]) : 1) * 1048576;
+	wstring_convert<codecvt_utf8<wchar_t>> codecvtConverter;
+
+	vector<pair<string, string>> texts = {
+		{ "Japanese", makeText(byteCount, [](size_t i) { return makeBenchText(i, 40); }) },
+		{ "ASCII", makeText(byteCount, [](size_t i) { return L"Line " + to_wstring(i) + L": the quick brown fox jumps over the lazy dog"; }) },
+		{ "mixed", makeText(byteCount, [](size_t i) { return L"[" + to_wstring(i) + L"] Name: " + makeBenchText(i, 20) + L" (ok)"; }) },
+	};
+
+	for (const auto& text : texts) {
+		const string& bytes = text.second;
+		wstring wide = StrHelper::convertToW(bytes), output;
+		string narrow;
+		size_t iterations = max<size_t>(1, 4 * 1048576 / bytes.length());
+		bool valid = true;
+		printf("%s text, %.1f MB as UTF-8\n", text.first.c_str(), bytes.length() / 1048576.0);
+
+		printThroughput("convertToW", bytes.length(), iterations, [&]() { output = StrHelper::convertToW(bytes); });
+		printThroughput("codecvt_utf8 from_bytes", bytes.length(), iterations, [&]() {
+			output = codecvtConverter.from_bytes(bytes);
+		});
+		printThroughput("convertFromW", bytes.length(), iterations, [&]() { narrow = StrHelper::convertFromW(wide); });
+		printThroughput("codecvt_utf8 to_bytes", bytes.length(), iterations, [&]() {
+			narrow = codecvtConverter.to_bytes(wide);
+		});
+		printThroughput("isValidUtf8", bytes.length(), iterations, [&]() { valid &= StrHelper::isValidUtf8(bytes); });
+
+		if (!valid || narrow != bytes || output != wide) fprintf(stderr, "conversions gave different results\n");
+	}
+
+	return 0;
+}
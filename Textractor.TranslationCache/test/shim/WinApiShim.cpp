@@ -0,0 +1,465 @@
+#include <windows.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <sched.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+
+namespace {
+	// a file opened with 'CreateFile'; it stays open (for the sharing rules) until its handle,
+	// and every mapping and view made from it, are closed
+	struct OpenFile {
+		dev_t dev;
+		ino_t ino;
+		bool read;
+		bool write;
+		DWORD shareMode;
+		int mappingCount;
+	};
+
+	struct ShimHandle {
+		int fd;
+		bool isMapping;
+		uint64_t mappingSize;
+		bool writable;
+		shared_ptr<OpenFile> openFile;
+	};
+
+	struct View {
+		size_t size;
+		shared_ptr<OpenFile> openFile;
+	};
+
+	thread_local DWORD _lastError = 0;
+	mutex _viewsMtx;
+	unordered_map<const void*, View> _views{};
+	mutex _openFilesMtx;
+	vector<weak_ptr<OpenFile>> _openFiles{};
+
+	BOOL fail(int err) {
+		_lastError = err == ENOENT ? ERROR_FILE_NOT_FOUND : err == EEXIST ? ERROR_ALREADY_EXISTS : ERROR_ACCESS_DENIED;
+		return FALSE;
+	}
+
+	BOOL failWith(DWORD errCode) {
+		_lastError = errCode;
+		return FALSE;
+	}
+
+	bool statPath(const string& path, struct stat& st) {
+		return stat(path.c_str(), &st) == 0;
+	}
+
+	// calls 'action' for each file still open with the same inode as 'st', until it returns true; needs '_openFilesMtx'
+	template<class Fn>
+	bool anyOpenFile(const struct stat& st, Fn action) {
+		bool found = false;
+
+		for (size_t i = 0; i < _openFiles.size();) {
+			shared_ptr<OpenFile> openFile = _openFiles[i].lock();
+			if (openFile == nullptr) {
+				_openFiles[i] = _openFiles.back();
+				_openFiles.pop_back();
+				continue;
+			}
+
+			if (!found && openFile->dev == st.st_dev && openFile->ino == st.st_ino) found = action(*openFile);
+			i++;
+		}
+
+		return found;
+	}
+
+	// a file can only be renamed over/deleted if every handle to it shares deletion, and it is not mapped
+	BOOL checkDeletable(const string& path) {
+		struct stat st;
+		lock_guard<mutex> lock(_openFilesMtx);
+		if (!statPath(path, st)) return TRUE;
+
+		bool inUse = anyOpenFile(st, [](const OpenFile& openFile) {
+			return (openFile.shareMode & FILE_SHARE_DELETE) == 0 || openFile.mappingCount > 0;
+		});
+		return inUse ? failWith(ERROR_SHARING_VIOLATION) : TRUE;
+	}
+
+	ShimHandle* toShim(HANDLE handle) {
+		return handle == nullptr || handle == INVALID_HANDLE_VALUE ? nullptr : static_cast<ShimHandle*>(handle);
+	}
+
+	string toUtf8Path(LPCWSTR path) {
+		int length = WideCharToMultiByte(CP_UTF8, 0, path, -1, nullptr, 0, nullptr, nullptr);
+		string narrow(length > 0 ? length - 1 : 0, '\0');
+		if (length > 1) WideCharToMultiByte(CP_UTF8, 0, path, -1, &narrow[0], length, nullptr, nullptr);
+		return narrow;
+	}
+
+	// decodes one code point; returns the bytes consumed, or 0 if the sequence is invalid/truncated
+	int decodeUtf8(const unsigned char* s, int remaining, uint32_t& cp) {
+		unsigned char c = s[0];
+		int length = c < 0x80 ? 1 : (c >= 0xC2 && c < 0xE0) ? 2 : (c >= 0xE0 && c < 0xF0) ? 3 : (c >= 0xF0 && c < 0xF5) ? 4 : 0;
+		if (length == 0 || length > remaining) return 0;
+
+		cp = length == 1 ? c : length == 2 ? (c & 0x1F) : length == 3 ? (c & 0x0F) : (c & 0x07);
+		for (int i = 1; i < length; i++) {
+			if ((s[i] & 0xC0) != 0x80) return 0;
+			cp = (cp << 6) | (s[i] & 0x3F);
+		}
+
+		bool overlong = (length == 3 && cp < 0x800) || (length == 4 && cp < 0x10000);
+		if (overlong || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) return 0;
+		return length;
+	}
+
+	void encodeUtf8(uint32_t cp, string& output) {
+		if (cp < 0x80) output += static_cast<char>(cp);
+		else if (cp < 0x800) {
+			output += static_cast<char>(0xC0 | (cp >> 6));
+			output += static_cast<char>(0x80 | (cp & 0x3F));
+		}
+		else if (cp < 0x10000) {
+			output += static_cast<char>(0xE0 | (cp >> 12));
+			output += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+			output += static_cast<char>(0x80 | (cp & 0x3F));
+		}
+		else {
+			output += static_cast<char>(0xF0 | (cp >> 18));
+			output += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+			output += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+			output += static_cast<char>(0x80 | (cp & 0x3F));
+		}
+	}
+}
+
+
+// *** TEXT
+
+int MultiByteToWideChar(UINT codePage, DWORD flags, LPCSTR str, int length, wchar_t* output, int outputLength) {
+	if (length < 0) length = static_cast<int>(strlen(str)) + 1;
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(str);
+	int count = 0;
+
+	for (int i = 0; i < length;) {
+		uint32_t cp = 0xFFFD;
+		int consumed = decodeUtf8(bytes + i, length - i, cp);
+
+		if (consumed == 0) {
+			if (flags & MB_ERR_INVALID_CHARS) return fail(EINVAL);
+			cp = 0xFFFD;
+			consumed = 1;
+		}
+
+		if (outputLength > 0) {
+			if (count >= outputLength) return fail(EINVAL);
+			output[count] = static_cast<wchar_t>(cp);
+		}
+
+		count++;
+		i += consumed;
+	}
+
+	return count;
+}
+
+int WideCharToMultiByte(UINT codePage, DWORD flags, LPCWSTR str, int length, char* output, int outputLength,
+	LPCSTR defaultChar, BOOL* usedDefaultChar)
+{
+	if (length < 0) length = static_cast<int>(wcslen(str)) + 1;
+	string encoded;
+
+	for (int i = 0; i < length; i++) {
+		uint32_t cp = static_cast<uint32_t>(str[i]);
+		bool invalid = cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF);
+		if (invalid && (flags & WC_ERR_INVALID_CHARS)) return fail(EINVAL);
+		encodeUtf8(invalid ? 0xFFFD : cp, encoded);
+	}
+
+	if (outputLength > 0) {
+		if (static_cast<int>(encoded.length()) > outputLength) return fail(EINVAL);
+		memcpy(output, encoded.data(), encoded.length());
+	}
+
+	return static_cast<int>(encoded.length());
+}
+
+int lstrcpyW(wchar_t* dest, const wchar_t* src) {
+	wcscpy(dest, src);
+	return 1;
+}
+
+
+// *** FILES
+
+HANDLE CreateFile(LPCWSTR filePath, DWORD access, DWORD shareMode, LPSECURITY_ATTRIBUTES security,
+	DWORD creation, DWORD flags, HANDLE templateFile)
+{
+	bool read = (access & GENERIC_READ) != 0;
+	bool write = (access & (GENERIC_WRITE | FILE_APPEND_DATA)) != 0;
+	int openFlags = read && write ? O_RDWR : write ? O_WRONLY : O_RDONLY;
+	string path = toUtf8Path(filePath);
+
+	if (access & FILE_APPEND_DATA) openFlags |= O_APPEND;
+	if (creation == CREATE_ALWAYS) openFlags |= O_CREAT | O_TRUNC;
+	else if (creation == OPEN_ALWAYS) openFlags |= O_CREAT;
+
+	// the access asked for must be shared by the handles already open, and theirs by the share mode asked for
+	lock_guard<mutex> lock(_openFilesMtx);
+	struct stat st;
+	DWORD conflict = 0;
+
+	if (statPath(path, st)) {
+		anyOpenFile(st, [read, write, shareMode, creation, &conflict](const OpenFile& openFile) {
+			bool denied = (read && !(openFile.shareMode & FILE_SHARE_READ)) || (write && !(openFile.shareMode & FILE_SHARE_WRITE))
+				|| (openFile.read && !(shareMode & FILE_SHARE_READ)) || (openFile.write && !(shareMode & FILE_SHARE_WRITE));
+			if (denied) conflict = ERROR_SHARING_VIOLATION;
+			else if (creation == CREATE_ALWAYS && openFile.mappingCount > 0) conflict = ERROR_USER_MAPPED_FILE;
+			return conflict != 0;
+		});
+	}
+
+	if (conflict != 0) {
+		failWith(conflict);
+		return INVALID_HANDLE_VALUE;
+	}
+
+	int fd = open(path.c_str(), openFlags | O_CLOEXEC, 0644);
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		fail(errno);
+		if (fd >= 0) close(fd);
+		return INVALID_HANDLE_VALUE;
+	}
+
+	auto openFile = make_shared<OpenFile>(OpenFile{ st.st_dev, st.st_ino, read, write, shareMode, 0 });
+	_openFiles.push_back(openFile);
+	return new ShimHandle{ fd, false, 0, write, openFile };
+}
+
+BOOL CloseHandle(HANDLE handle) {
+	ShimHandle* shim = toShim(handle);
+	if (shim == nullptr) return fail(EBADF);
+
+	int result = close(shim->fd);
+
+	if (shim->isMapping) {
+		lock_guard<mutex> lock(_openFilesMtx);
+		shim->openFile->mappingCount--;
+	}
+
+	delete shim;
+	return result == 0 ? TRUE : fail(errno);
+}
+
+DWORD GetLastError() {
+	return _lastError;
+}
+
+BOOL GetFileSizeEx(HANDLE hFile, PLARGE_INTEGER fileSize) {
+	struct stat st;
+	ShimHandle* shim = toShim(hFile);
+	if (shim == nullptr || fstat(shim->fd, &st) != 0) return fail(errno);
+
+	fileSize->QuadPart = st.st_size;
+	return TRUE;
+}
+
+BOOL GetFileTime(HANDLE hFile, FILETIME* creationTime, FILETIME* accessTime, FILETIME* writeTime) {
+	struct stat st;
+	ShimHandle* shim = toShim(hFile);
+	if (shim == nullptr || fstat(shim->fd, &st) != 0) return fail(errno);
+
+	// 100ns intervals, like FILETIME (the epoch differs, which doesn't matter for comparisons)
+	ULARGE_INTEGER time{};
+	time.QuadPart = static_cast<uint64_t>(st.st_mtim.tv_sec) * 10000000ULL + st.st_mtim.tv_nsec / 100;
+
+	if (writeTime != nullptr) {
+		writeTime->dwLowDateTime = time.LowPart;
+		writeTime->dwHighDateTime = time.HighPart;
+	}
+
+	return TRUE;
+}
+
+BOOL ReadFile(HANDLE hFile, LPVOID buffer, DWORD toRead, LPDWORD readCount, LPOVERLAPPED overlapped) {
+	ShimHandle* shim = toShim(hFile);
+	ssize_t result = shim != nullptr ? read(shim->fd, buffer, toRead) : -1;
+	if (result < 0) return fail(errno);
+
+	*readCount = static_cast<DWORD>(result);
+	return TRUE;
+}
+
+BOOL WriteFile(HANDLE hFile, LPCVOID buffer, DWORD toWrite, LPDWORD writtenCount, LPOVERLAPPED overlapped) {
+	ShimHandle* shim = toShim(hFile);
+	ssize_t result = shim != nullptr ? write(shim->fd, buffer, toWrite) : -1;
+	if (result < 0) return fail(errno);
+
+	if (writtenCount != nullptr) *writtenCount = static_cast<DWORD>(result);
+	return TRUE;
+}
+
+BOOL SetFilePointerEx(HANDLE hFile, LARGE_INTEGER distance, PLARGE_INTEGER newPointer, DWORD moveMethod) {
+	ShimHandle* shim = toShim(hFile);
+	int whence = moveMethod == FILE_BEGIN ? SEEK_SET : moveMethod == FILE_CURRENT ? SEEK_CUR : SEEK_END;
+	off_t position = shim != nullptr ? lseek(shim->fd, distance.QuadPart, whence) : -1;
+	if (position < 0) return fail(errno);
+
+	if (newPointer != nullptr) newPointer->QuadPart = position;
+	return TRUE;
+}
+
+// a mapped file can't be shortened
+BOOL SetEndOfFile(HANDLE hFile) {
+	ShimHandle* shim = toShim(hFile);
+	off_t position = shim != nullptr ? lseek(shim->fd, 0, SEEK_CUR) : -1;
+	struct stat st;
+	if (position < 0 || fstat(shim->fd, &st) != 0) return fail(errno);
+
+	if (position < st.st_size) {
+		lock_guard<mutex> lock(_openFilesMtx);
+		bool mapped = anyOpenFile(st, [](const OpenFile& openFile) { return openFile.mappingCount > 0; });
+		if (mapped) return failWith(ERROR_USER_MAPPED_FILE);
+	}
+
+	if (ftruncate(shim->fd, position) != 0) return fail(errno);
+	return TRUE;
+}
+
+BOOL FlushFileBuffers(HANDLE hFile) {
+	ShimHandle* shim = toShim(hFile);
+	return shim != nullptr && fsync(shim->fd) == 0 ? TRUE : fail(errno);
+}
+
+BOOL MoveFileEx(LPCWSTR srcFilePath, LPCWSTR destFilePath, DWORD flags) {
+	string srcPath = toUtf8Path(srcFilePath), destPath = toUtf8Path(destFilePath);
+	if (!checkDeletable(srcPath) || !checkDeletable(destPath)) return FALSE;
+
+	return rename(srcPath.c_str(), destPath.c_str()) == 0 ? TRUE : fail(errno);
+}
+
+BOOL DeleteFile(LPCWSTR filePath) {
+	string path = toUtf8Path(filePath);
+	if (!checkDeletable(path)) return FALSE;
+
+	return unlink(path.c_str()) == 0 ? TRUE : fail(errno);
+}
+
+
+// *** MAPPINGS
+
+HANDLE CreateFileMapping(HANDLE hFile, LPSECURITY_ATTRIBUTES security, DWORD protect,
+	DWORD maxSizeHigh, DWORD maxSizeLow, LPCWSTR name)
+{
+	ShimHandle* shim = toShim(hFile);
+	if (shim == nullptr || name != nullptr) {
+		fail(EINVAL);
+		return nullptr;
+	}
+
+	LARGE_INTEGER fileSize{};
+	if (!GetFileSizeEx(hFile, &fileSize)) return nullptr;
+
+	int fd = dup(shim->fd);
+	if (fd < 0) {
+		fail(errno);
+		return nullptr;
+	}
+
+	lock_guard<mutex> lock(_openFilesMtx);
+	shim->openFile->mappingCount++;
+	return new ShimHandle{ fd, true, static_cast<uint64_t>(fileSize.QuadPart), protect == PAGE_READWRITE, shim->openFile };
+}
+
+HANDLE OpenFileMapping(DWORD access, BOOL inherit, LPCWSTR name) {
+	fail(ENOENT);
+	return nullptr;
+}
+
+LPVOID MapViewOfFile(HANDLE hMapFile, DWORD access, DWORD offsetHigh, DWORD offsetLow, SIZE_T size) {
+	ShimHandle* shim = toShim(hMapFile);
+	if (shim == nullptr || !shim->isMapping) {
+		fail(EINVAL);
+		return nullptr;
+	}
+
+	size_t viewSize = size != 0 ? size : static_cast<size_t>(shim->mappingSize);
+	int prot = PROT_READ | (shim->writable && access == FILE_MAP_ALL_ACCESS ? PROT_WRITE : 0);
+	void* view = mmap(nullptr, viewSize, prot, MAP_SHARED, shim->fd, 0);
+	if (view == MAP_FAILED) {
+		fail(errno);
+		return nullptr;
+	}
+
+	{
+		lock_guard<mutex> lock(_openFilesMtx);
+		shim->openFile->mappingCount++;
+	}
+
+	lock_guard<mutex> lock(_viewsMtx);
+	_views[view] = View{ viewSize, shim->openFile };
+	return view;
+}
+
+BOOL UnmapViewOfFile(LPCVOID mapView) {
+	View view;
+
+	{
+		lock_guard<mutex> lock(_viewsMtx);
+		auto it = _views.find(mapView);
+		if (it == _views.end()) return fail(EINVAL);
+
+		view = it->second;
+		_views.erase(it);
+	}
+
+	BOOL result = munmap(const_cast<void*>(mapView), view.size) == 0 ? TRUE : fail(errno);
+	lock_guard<mutex> lock(_openFilesMtx);
+	view.openFile->mappingCount--;
+	return result;
+}
+
+SIZE_T VirtualQuery(LPCVOID address, MEMORY_BASIC_INFORMATION* info, SIZE_T length) {
+	lock_guard<mutex> lock(_viewsMtx);
+	auto it = _views.find(address);
+	if (it == _views.end()) return 0;
+
+	info->BaseAddress = const_cast<void*>(address);
+	info->RegionSize = it->second.size;
+	return sizeof(MEMORY_BASIC_INFORMATION);
+}
+
+
+// *** MISC
+
+void Sleep(DWORD ms) {
+	struct timespec duration { static_cast<time_t>(ms / 1000), static_cast<long>(ms % 1000) * 1000000 };
+	nanosleep(&duration, nullptr);
+}
+
+DWORD GetCurrentThreadId() {
+	return static_cast<DWORD>(syscall(SYS_gettid));
+}
+
+BOOL SwitchToThread() {
+	return sched_yield() == 0 ? TRUE : FALSE;
+}
+
+int MessageBoxA(HANDLE hWnd, LPCSTR text, LPCSTR caption, UINT type) {
+	fprintf(stderr, "[%s] %s\n", caption, text);
+	return 0;
+}
+
+DWORD GetModuleFileName(HMODULE hModule, wchar_t* fileName, DWORD size) {
+	if (size == 0) return 0;
+	fileName[0] = L'\0';
+	return 0;
+}
@@ -0,0 +1,112 @@
+
+#pragma once
+// Linux stand-in for the parts of <windows.h> used by Textractor.TranslationCache.Base,
+// so that its headers can be built and tested outside of Windows. Implemented in WinApiShim.cpp.
+// File handles follow the Windows sharing rules within the process (see 'CreateFile' there), so that code which would
+// fail on Windows while another module keeps the file open also fails here.
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cwchar>
+
+typedef void* HANDLE;
+typedef void* HMODULE;
+typedef void* LPVOID;
+typedef const void* LPCVOID;
+typedef unsigned long DWORD;
+typedef int BOOL;
+typedef long LONG;
+typedef int64_t LONGLONG;
+typedef unsigned int UINT;
+typedef unsigned short WORD;
+typedef const wchar_t* LPCWSTR;
+typedef const char* LPCSTR;
+typedef DWORD* LPDWORD;
+typedef void* LPOVERLAPPED;
+typedef void* LPSECURITY_ATTRIBUTES;
+typedef uintptr_t SIZE_T;
+
+typedef union { struct { DWORD LowPart; LONG HighPart; }; LONGLONG QuadPart; } LARGE_INTEGER;
+typedef LARGE_INTEGER* PLARGE_INTEGER;
+typedef union { struct { DWORD LowPart; DWORD HighPart; }; uint64_t QuadPart; } ULARGE_INTEGER;
+typedef struct { DWORD dwLowDateTime; DWORD dwHighDateTime; } FILETIME;
+typedef struct { void* BaseAddress; SIZE_T RegionSize; } MEMORY_BASIC_INFORMATION;
+
+#define TRUE 1
+#define FALSE 0
+#define MAXINT INT_MAX
+#define MAXDWORD 0xffffffff
+#define INFINITE 0xFFFFFFFF
+#define WINAPI
+#define __declspec(x)
+#define INVALID_HANDLE_VALUE ((HANDLE)(intptr_t)-1)
+
+#define CP_UTF8 65001
+#define MB_ERR_INVALID_CHARS 0x8
+#define WC_ERR_INVALID_CHARS 0x80
+
+#define GENERIC_READ 0x80000000
+#define GENERIC_WRITE 0x40000000
+#define FILE_APPEND_DATA 0x4
+#define FILE_SHARE_READ 0x1
+#define FILE_SHARE_WRITE 0x2
+#define FILE_SHARE_DELETE 0x4
+#define CREATE_ALWAYS 2
+#define OPEN_EXISTING 3
+#define OPEN_ALWAYS 4
+#define FILE_ATTRIBUTE_NORMAL 0x80
+#define FILE_FLAG_SEQUENTIAL_SCAN 0x08000000
+#define FILE_BEGIN 0
+#define FILE_CURRENT 1
+#define FILE_END 2
+#define MOVEFILE_REPLACE_EXISTING 0x1
+#define MOVEFILE_WRITE_THROUGH 0x8
+
+#define PAGE_READONLY 0x2
+#define PAGE_READWRITE 0x4
+#define FILE_MAP_READ 0x4
+#define FILE_MAP_ALL_ACCESS 0xf001f
+
+#define ERROR_FILE_NOT_FOUND 2
+#define ERROR_ACCESS_DENIED 5
+#define ERROR_SHARING_VIOLATION 32
+#define ERROR_USER_MAPPED_FILE 1224
+#define ERROR_ALREADY_EXISTS 183
+#define MB_ICONERROR 0x10
+#define MB_OK 0x0
+#define DLL_PROCESS_DETACH 0
+#define DLL_PROCESS_ATTACH 1
+
+int MultiByteToWideChar(UINT codePage, DWORD flags, LPCSTR str, int length, wchar_t* output, int outputLength);
+int WideCharToMultiByte(UINT codePage, DWORD flags, LPCWSTR str, int length, char* output, int outputLength,
+	LPCSTR defaultChar, BOOL* usedDefaultChar);
+int lstrcpyW(wchar_t* dest, const wchar_t* src);
+
+HANDLE CreateFile(LPCWSTR filePath, DWORD access, DWORD shareMode, LPSECURITY_ATTRIBUTES security,
+	DWORD creation, DWORD flags, HANDLE templateFile);
+BOOL CloseHandle(HANDLE handle);
+DWORD GetLastError();
+BOOL GetFileSizeEx(HANDLE hFile, PLARGE_INTEGER fileSize);
+BOOL GetFileTime(HANDLE hFile, FILETIME* creationTime, FILETIME* accessTime, FILETIME* writeTime);
+BOOL ReadFile(HANDLE hFile, LPVOID buffer, DWORD toRead, LPDWORD readCount, LPOVERLAPPED overlapped);
+BOOL WriteFile(HANDLE hFile, LPCVOID buffer, DWORD toWrite, LPDWORD writtenCount, LPOVERLAPPED overlapped);
+BOOL SetFilePointerEx(HANDLE hFile, LARGE_INTEGER distance, PLARGE_INTEGER newPointer, DWORD moveMethod);
+BOOL SetEndOfFile(HANDLE hFile);
+BOOL FlushFileBuffers(HANDLE hFile);
+BOOL MoveFileEx(LPCWSTR srcFilePath, LPCWSTR destFilePath, DWORD flags);
+BOOL DeleteFile(LPCWSTR filePath);
+
+// only file-backed mappings are supported (named shared memory goes through 'PosixSharedMemoryRegionManager')
+HANDLE CreateFileMapping(HANDLE hFile, LPSECURITY_ATTRIBUTES security, DWORD protect,
+	DWORD maxSizeHigh, DWORD maxSizeLow, LPCWSTR name);
+HANDLE OpenFileMapping(DWORD access, BOOL inherit, LPCWSTR name);
+LPVOID MapViewOfFile(HANDLE hMapFile, DWORD access, DWORD offsetHigh, DWORD offsetLow, SIZE_T size);
+BOOL UnmapViewOfFile(LPCVOID mapView);
+SIZE_T VirtualQuery(LPCVOID address, MEMORY_BASIC_INFORMATION* info, SIZE_T length);
+
+void Sleep(DWORD ms);
+DWORD GetCurrentThreadId();
+BOOL SwitchToThread();
+int MessageBoxA(HANDLE hWnd, LPCSTR text, LPCSTR caption, UINT type);
+DWORD GetModuleFileName(HMODULE hModule, wchar_t* fileName, DWORD size);
@@ -56,7 +56,7 @@ private:
 	}
 
 	Gender parseGender(const wstring& name, const gender_map& genderMap) const {
-		wstring newName = StrHelper::split<wchar_t>(name, L' ', true).back();
+		wstring newName = StrHelper::splitView<wchar_t>(name, L' ', true).back().str();
 		Gender gender = genderMap.find(newName) != genderMap.end() ? genderMap.at(newName) : Gender::Unknown;
 		return gender;
 	}